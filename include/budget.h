@@ -0,0 +1,42 @@
+/* This file is part of the RobinHood Library
+ * Copyright (C) 2022 Commissariat a l'energie atomique et aux energies
+ *                    alternatives
+ *
+ * SPDX-License-Identifer: LGPL-3.0-or-later
+ */
+
+#ifndef RBH_BUDGET_H
+#define RBH_BUDGET_H
+
+/** @file
+ * Process-wide accounting of the memory containers allocate for their data
+ * (refer to rbh_memory_stats() and rbh_memory_set_budget())
+ */
+
+#include <stddef.h>
+
+/**
+ * Account for memory about to be allocated
+ *
+ * @param size      the number of bytes about to be allocated
+ *
+ * @return          0 on success, -1 on error and errno is set appropriately
+ *
+ * @error ENOBUFS   allocating \p size more bytes would exceed the memory
+ *                  budget, even after cached mappings were released
+ *
+ * On success, the memory must eventually be accounted for as released with
+ * memory_discharge().
+ */
+int
+memory_charge(size_t size);
+
+/**
+ * Account for memory that was released
+ *
+ * @param size      the number of bytes that were released
+ */
+void
+memory_discharge(size_t size);
+
+#endif
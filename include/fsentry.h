@@ -0,0 +1,34 @@
+/* This file is part of the RobinHood Library
+ * Copyright (C) 2022 Commissariat a l'energie atomique et aux energies
+ *                    alternatives
+ *
+ * SPDX-License-Identifer: LGPL-3.0-or-later
+ */
+
+#ifndef RBH_FSENTRY_H
+#define RBH_FSENTRY_H
+
+/** @file
+ * A few helpers around struct rbh_fsentry to be used internally
+ */
+
+#include "robinhood/fsentry.h"
+
+/**
+ * Make a standalone copy of an fsentry
+ *
+ * @param fsentry   the fsentry to copy
+ *
+ * @return          a pointer to a newly allocated struct rbh_fsentry on
+ *                  success, NULL on error and errno is set appropriately
+ *
+ * @error ENOMEM    there was not enough memory available
+ *
+ * Only the fields set in the mask of \p fsentry are copied. The returned
+ * fsentry does not share any of the data \p fsentry points at, it can be freed
+ * with free().
+ */
+struct rbh_fsentry *
+fsentry_clone(const struct rbh_fsentry *fsentry);
+
+#endif
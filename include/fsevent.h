@@ -0,0 +1,33 @@
+/* This file is part of the RobinHood Library
+ * Copyright (C) 2022 Commissariat a l'energie atomique et aux energies
+ *                    alternatives
+ *
+ * SPDX-License-Identifer: LGPL-3.0-or-later
+ */
+
+#ifndef RBH_FSEVENT_H
+#define RBH_FSEVENT_H
+
+/** @file
+ * A few helpers around struct rbh_fsevent to be used internally
+ */
+
+#include "robinhood/fsevent.h"
+
+/**
+ * Make a standalone copy of an fsevent
+ *
+ * @param fsevent   the fsevent to copy
+ *
+ * @return          a pointer to a newly allocated struct rbh_fsevent on
+ *                  success, NULL on error and errno is set appropriately
+ *
+ * @error ENOMEM    there was not enough memory available
+ *
+ * The returned fsevent does not share any of the data \p fsevent points at,
+ * it can be freed with free().
+ */
+struct rbh_fsevent *
+fsevent_clone(const struct rbh_fsevent *fsevent);
+
+#endif
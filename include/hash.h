@@ -0,0 +1,90 @@
+/* This file is part of the RobinHood Library
+ * Copyright (C) 2022 Commissariat a l'energie atomique et aux energies
+ *                    alternatives
+ *
+ * SPDX-License-Identifer: LGPL-3.0-or-later
+ */
+
+#ifndef RBH_HASH_H
+#define RBH_HASH_H
+
+/**
+ * @file
+ *
+ * Internal header which provides a fast, non-cryptographic, hash function.
+ *
+ * Hashes are stable across processes and hosts (as long as they share the same
+ * endianness), they can be persisted or exchanged.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+/* Finalizer of MurmurHash3 */
+static inline uint64_t
+hash64_mix(uint64_t hash)
+{
+    hash ^= hash >> 33;
+    hash *= UINT64_C(0xff51afd7ed558ccd);
+    hash ^= hash >> 33;
+    hash *= UINT64_C(0xc4ceb9fe1a85ec53);
+    hash ^= hash >> 33;
+    return hash;
+}
+
+/* MurmurHash64A, by Austin Appleby (public domain) */
+static inline uint64_t
+hash64(const void *data, size_t size, uint64_t seed)
+{
+    const uint64_t m = UINT64_C(0xc6a4a7935bd1e995);
+    const unsigned char *bytes = data;
+    uint64_t hash = seed ^ (size * m);
+    uint64_t tail = 0;
+
+    for (; size >= sizeof(uint64_t); size -= sizeof(uint64_t)) {
+        uint64_t k;
+
+        memcpy(&k, bytes, sizeof(k));
+        bytes += sizeof(k);
+
+        k *= m;
+        k ^= k >> 47;
+        k *= m;
+
+        hash ^= k;
+        hash *= m;
+    }
+
+    switch (size) {
+    case 7:
+        tail ^= (uint64_t)bytes[6] << 48;
+        /* Fallthrough */
+    case 6:
+        tail ^= (uint64_t)bytes[5] << 40;
+        /* Fallthrough */
+    case 5:
+        tail ^= (uint64_t)bytes[4] << 32;
+        /* Fallthrough */
+    case 4:
+        tail ^= (uint64_t)bytes[3] << 24;
+        /* Fallthrough */
+    case 3:
+        tail ^= (uint64_t)bytes[2] << 16;
+        /* Fallthrough */
+    case 2:
+        tail ^= (uint64_t)bytes[1] << 8;
+        /* Fallthrough */
+    case 1:
+        tail ^= (uint64_t)bytes[0];
+        hash ^= tail;
+        hash *= m;
+    }
+
+    hash ^= hash >> 47;
+    hash *= m;
+    hash ^= hash >> 47;
+    return hash;
+}
+
+#endif
@@ -0,0 +1,77 @@
+/* This file is part of the RobinHood Library
+ * Copyright (C) 2022 Commissariat a l'energie atomique et aux energies
+ *                    alternatives
+ *
+ * SPDX-License-Identifer: LGPL-3.0-or-later
+ */
+
+#ifndef RBH_HUGEPAGES_H
+#define RBH_HUGEPAGES_H
+
+/** @file
+ * Helpers to back the library's containers with huge pages, according to the
+ * policy set with rbh_memory_set_huge_pages()
+ */
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/**
+ * Get the default size of huge pages
+ *
+ * @return          the default size of huge pages, or 0 if it is unknown
+ */
+size_t
+huge_page_size(void);
+
+/**
+ * Should a buffer be allocated from the hugetlb pool?
+ *
+ * @param size      the size of the buffer
+ *
+ * @return          true if the policy is RBH_HP_EXPLICIT and \p size is a
+ *                  multiple of the size of huge pages, false otherwise
+ */
+bool
+huge_pages_explicit(size_t size);
+
+/**
+ * Advise the kernel to back a range of memory with transparent huge pages
+ *
+ * @param address   the start of the range (must be page-aligned)
+ * @param size      the size of the range
+ *
+ * This is a no-op if the policy is RBH_HP_NONE or if \p size is less than the
+ * size of a huge page. Errors are ignored.
+ */
+void
+huge_pages_advise(void *address, size_t size);
+
+/**
+ * Allocate a buffer, backed by huge pages if the policy says so
+ *
+ * @param size      the size of the buffer to allocate
+ * @param mapped    set to whether the buffer was mmap'ed (true) or malloc'ed
+ *                  (false) on success
+ *
+ * @return          the address of a buffer of \p size bytes on success, NULL on
+ *                  error and errno is set appropriately
+ *
+ * @error ENOMEM    there was not enough memory available
+ *
+ * The buffer is at least aligned on max_align_t.
+ */
+void *
+huge_pages_alloc(size_t size, bool *mapped);
+
+/**
+ * Free a buffer allocated with huge_pages_alloc()
+ *
+ * @param buffer    the buffer to free
+ * @param size      the size \p buffer was allocated with
+ * @param mapped    the value huge_pages_alloc() set its own \p mapped to
+ */
+void
+huge_pages_free(void *buffer, size_t size, bool mapped);
+
+#endif
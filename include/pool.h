@@ -0,0 +1,56 @@
+/* This file is part of the RobinHood Library
+ * Copyright (C) 2022 Commissariat a l'energie atomique et aux energies
+ *                    alternatives
+ *
+ * SPDX-License-Identifer: LGPL-3.0-or-later
+ */
+
+#ifndef RBH_POOL_H
+#define RBH_POOL_H
+
+/** @file
+ * A process-wide cache of memory mappings, to recycle the buffers of
+ * short-lived rings and stacks without going through the kernel
+ *
+ * Mappings are sorted by kind and size. The cache is bounded (refer to
+ * rbh_memory_set_cache_limit()).
+ */
+
+#include <stdbool.h>
+#include <stddef.h>
+
+enum pool_kind {
+    /** A double mapping of `size' bytes, as made by rbh_ring_new() */
+    POOL_RING,
+    /** A mapping of `size' bytes, as made by huge_pages_alloc() */
+    POOL_STACK,
+};
+
+/**
+ * Get a mapping out of the cache
+ *
+ * @param kind      the kind of mapping to get
+ * @param size      the size of the mapping to get
+ *
+ * @return          the address of a cached mapping of kind \p kind and size
+ *                  \p size, or NULL if there is none
+ *
+ * The content of the mapping is unspecified.
+ */
+void *
+pool_get(enum pool_kind kind, size_t size);
+
+/**
+ * Hand a mapping over to the cache
+ *
+ * @param kind      the kind of \p mapping
+ * @param mapping   the mapping to cache
+ * @param size      the size of \p mapping
+ *
+ * @return          true if \p mapping was cached, false otherwise (the caller
+ *                  remains in charge of \p mapping)
+ */
+bool
+pool_put(enum pool_kind kind, void *mapping, size_t size);
+
+#endif
@@ -0,0 +1,126 @@
+/* This file is part of the RobinHood Library
+ * Copyright (C) 2022 Commissariat a l'energie atomique et aux energies
+ *                    alternatives
+ *
+ * SPDX-License-Identifer: LGPL-3.0-or-later
+ */
+
+#ifndef RBH_RANDOM_H
+#define RBH_RANDOM_H
+
+/**
+ * @file
+ *
+ * Internal header which provides a fast, non-cryptographic, pseudo-random
+ * number generator (xoshiro256**), and a few helpers to draw samples from
+ * usual distributions.
+ *
+ * Generators are not thread-safe, each thread should use its own.
+ */
+
+#include <math.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <time.h>
+
+#include <sys/random.h>
+
+struct rand64 {
+    uint64_t state[4];
+};
+
+static inline uint64_t
+rand64_splitmix(uint64_t *seed)
+{
+    uint64_t z = (*seed += UINT64_C(0x9e3779b97f4a7c15));
+
+    z = (z ^ (z >> 30)) * UINT64_C(0xbf58476d1ce4e5b9);
+    z = (z ^ (z >> 27)) * UINT64_C(0x94d049bb133111eb);
+    return z ^ (z >> 31);
+}
+
+/* Seed a generator deterministically */
+static inline void
+rand64_seed(struct rand64 *rand, uint64_t seed)
+{
+    for (int i = 0; i < 4; i++)
+        rand->state[i] = rand64_splitmix(&seed);
+}
+
+/* Seed a generator from the kernel's entropy pool (or the clock) */
+static inline void
+rand64_init(struct rand64 *rand)
+{
+    struct timespec now;
+    uint64_t seed;
+
+    if (getrandom(&seed, sizeof(seed), GRND_NONBLOCK) == sizeof(seed)) {
+        rand64_seed(rand, seed);
+        return;
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    seed = (uint64_t)now.tv_sec * UINT64_C(1000000000) + now.tv_nsec;
+    rand64_seed(rand, seed ^ (uintptr_t)rand);
+}
+
+static inline uint64_t
+rand64_rotl(uint64_t x, int k)
+{
+    return (x << k) | (x >> (64 - k));
+}
+
+static inline uint64_t
+rand64_next(struct rand64 *rand)
+{
+    uint64_t *s = rand->state;
+    const uint64_t result = rand64_rotl(s[1] * 5, 7) * 9;
+    const uint64_t t = s[1] << 17;
+
+    s[2] ^= s[0];
+    s[3] ^= s[1];
+    s[1] ^= s[2];
+    s[0] ^= s[3];
+    s[2] ^= t;
+    s[3] = rand64_rotl(s[3], 45);
+
+    return result;
+}
+
+/* Draw a number uniformly from [0, bound[ (bound must not be 0) */
+static inline uint64_t
+rand64_below(struct rand64 *rand, uint64_t bound)
+{
+    const uint64_t threshold = -bound % bound;
+    uint64_t x;
+
+    do {
+        x = rand64_next(rand);
+    } while (x < threshold);
+
+    return x % bound;
+}
+
+/* Draw a number uniformly from ]0, 1[ */
+static inline double
+rand64_open01(struct rand64 *rand)
+{
+    return ((rand64_next(rand) >> 11) + 0.5) * 0x1.0p-53;
+}
+
+/* Draw the number of failures before the first success of a series of
+ * Bernoulli trials of parameter `rate' (which must be in ]0, 1])
+ */
+static inline size_t
+rand64_geometric(struct rand64 *rand, double rate)
+{
+    double skip;
+
+    if (rate >= 1.)
+        return 0;
+
+    skip = floor(log(rand64_open01(rand)) / log1p(-rate));
+    return skip < (double)SIZE_MAX ? (size_t)skip : SIZE_MAX;
+}
+
+#endif
@@ -22,6 +22,8 @@ struct rbh_ring {
     char *head;
     size_t used;
     char *data;
+    size_t max_size;
+    int fd; /* only open for growable rings */
 };
 
 #endif
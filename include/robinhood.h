@@ -8,18 +8,32 @@
 #ifndef ROBINHOOD_H
 #define ROBINHOOD_H
 
+#include "robinhood/async.h"
 #include "robinhood/backend.h"
+#include "robinhood/backend_cache.h"
+#include "robinhood/backend_pool.h"
+#include "robinhood/backend_result_cache.h"
+#include "robinhood/backend_tee.h"
+#include "robinhood/broadcast.h"
+#include "robinhood/distinct.h"
 #include "robinhood/filter.h"
 #include "robinhood/fsentry.h"
 #include "robinhood/fsevent.h"
 #include "robinhood/id.h"
+#include "robinhood/idmap.h"
+#include "robinhood/instrument.h"
 #include "robinhood/iterator.h"
 #include "robinhood/itertools.h"
+#include "robinhood/memory.h"
+#include "robinhood/mpmc_queue.h"
 #include "robinhood/plugin.h"
 #include "robinhood/plugins/backend.h"
 #include "robinhood/queue.h"
+#include "robinhood/resolver.h"
 #include "robinhood/ring.h"
 #include "robinhood/ringr.h"
+#include "robinhood/sampling.h"
+#include "robinhood/sketch.h"
 #include "robinhood/sstack.h"
 #include "robinhood/stack.h"
 #include "robinhood/statx.h"
@@ -0,0 +1,92 @@
+/* This file is part of the RobinHood Library
+ * Copyright (C) 2022 Commissariat a l'energie atomique et aux energies
+ *                    alternatives
+ *
+ * SPDX-License-Identifer: LGPL-3.0-or-later
+ */
+
+#ifndef ROBINHOOD_ASYNC_H
+#define ROBINHOOD_ASYNC_H
+
+#include <stddef.h>
+
+#include "robinhood/iterator.h"
+
+/** @file
+ * Asynchronous iterators
+ *
+ * An asynchronous iterator wraps a (potentially blocking) iterator and fetches
+ * its elements from a small pool of worker threads, shared by every
+ * asynchronous iterator of the process.
+ *
+ * Asynchronous iterators are pollable (cf. robinhood/iterator.h): their `next'
+ * method never blocks, it fails with EAGAIN until the next element has been
+ * fetched, at which point the file descriptor returned by rbh_iter_fileno()
+ * (or rbh_mut_iter_fileno()) becomes readable. This makes it possible to
+ * multiplex many queries on a single event loop.
+ *
+ * Elements are fetched one at a time, in order: the fetch of an element starts
+ * as soon as the previous one is yielded.
+ */
+
+/**
+ * Set the number of worker threads that serve asynchronous iterators
+ *
+ * @param count     the number of worker threads to use
+ *
+ * @return          0 on success, -1 on error and errno is set appropriately
+ *
+ * @error EINVAL    \p count is 0
+ * @error EBUSY     the worker threads are already running
+ *
+ * Workers are started when the first asynchronous iterator is created. By
+ * default, there are 4 of them.
+ */
+int
+rbh_async_set_workers(size_t count);
+
+/**
+ * Make an iterator asynchronous
+ *
+ * @param iterator  the iterator to wrap
+ *
+ * @return          a pointer to a newly allocated, pollable, struct
+ *                  rbh_iterator on success, NULL on error and errno is set
+ *                  appropriately
+ *
+ * @error ENOMEM    there was not enough memory available
+ * @error EAGAIN    the worker threads could not be started
+ *
+ * Any call to \p iterator's `next' method happens on a worker thread.
+ * \p iterator should not be used anymore after a successful call to this
+ * function.
+ *
+ * Elements yielded by \p iterator must remain valid until the returned iterator
+ * is destroyed, even if they were not yielded yet.
+ */
+struct rbh_iterator *
+rbh_iter_async(struct rbh_iterator *iterator);
+
+/**
+ * Make a mutable iterator asynchronous
+ *
+ * @param iterator  the mutable iterator to wrap
+ *
+ * @return          a pointer to a newly allocated, pollable, struct
+ *                  rbh_mut_iterator on success, NULL on error and errno is set
+ *                  appropriately
+ *
+ * @error ENOMEM    there was not enough memory available
+ * @error EAGAIN    the worker threads could not be started
+ *
+ * Any call to \p iterator's `next' method happens on a worker thread.
+ * \p iterator should not be used anymore after a successful call to this
+ * function.
+ *
+ * If the returned iterator is destroyed while an element was fetched but not
+ * yielded yet, that element is freed with free().
+ */
+struct rbh_mut_iterator *
+rbh_mut_iter_async(struct rbh_mut_iterator *iterator);
+
+#endif
@@ -95,6 +95,10 @@ enum rbh_backend_id {
 
 /**
  * A backend, ie. anything that can store/serve a filesystem's metadata
+ *
+ * Backends are not thread-safe: a backend may only be used by one thread at a
+ * time. Threads that need to work in parallel on the same backend should each
+ * use their own clone of it (cf. rbh_backend_clone()).
  */
 struct rbh_backend {
     /** A unique identifier */
@@ -152,6 +156,20 @@ struct rbh_filter_options {
         const struct rbh_filter_sort *items;
         size_t count;
     } sort;
+    /** How to sample the fsentries that match the filter
+     *
+     * Sampling happens before sorting, skipping and limiting. A limit can be
+     * used to stop a Bernoulli sample early.
+     */
+    struct {
+        /** The probability for each fsentry to be kept, in [0, 1]
+         *
+         * 0 means no Bernoulli sampling.
+         */
+        double rate;
+        /** The number of fsentries to select uniformly (0 means no limit) */
+        size_t size;
+    } sample;
 };
 
 /**
@@ -196,6 +214,16 @@ struct rbh_backend_operations {
     void (*destroy)(
             void *backend
             );
+    struct rbh_backend *(*clone)(
+            void *backend
+            );
+    int (*filter_partitioned)(
+            void *backend,
+            const struct rbh_filter *filter,
+            const struct rbh_filter_options *options,
+            struct rbh_mut_iterator **partitions,
+            size_t count
+            );
 };
 
 /**
@@ -237,6 +265,28 @@ enum rbh_generic_backend_option {
      * type: bool
      */
     RBH_GBO_GC,
+    /** Statistics of a caching backend (read-only)
+     *
+     * Only caching backends support this option (cf. rbh_backend_cache_new()).
+     *
+     * type: struct rbh_backend_cache_stats
+     */
+    RBH_GBO_CACHE_STATS,
+    /** Statistics of a result caching backend (read-only)
+     *
+     * Only result caching backends support this option (cf.
+     * rbh_backend_result_cache_new()).
+     *
+     * type: struct rbh_backend_result_cache_stats
+     */
+    RBH_GBO_RESULT_CACHE_STATS,
+    /** Statistics of the backends a tee backend updates (read-only)
+     *
+     * Only tee backends support this option (cf. rbh_backend_tee_new()).
+     *
+     * type: struct rbh_backend_tee_stats[]
+     */
+    RBH_GBO_TEE_STATS,
 };
 
 /**
@@ -433,6 +483,36 @@ rbh_backend_branch(struct rbh_backend *backend, const struct rbh_id *id)
     return backend->ops->branch(backend, id);
 }
 
+/**
+ * Create an independent copy of a backend
+ *
+ * @param backend   the backend to copy
+ *
+ * @return          a pointer to a newly allocated struct rbh_backend on
+ *                  success, NULL on error and errno is set appropriately
+ *
+ * @error ENOMEM    there was not enough memory available
+ * @error ENOTSUP   \p backend cannot be cloned
+ *
+ * The clone manages the same entries as \p backend (a clone of a branch is a
+ * clone of the same branch), with the same options set. It is meant to be
+ * cheap to create, and can be used from another thread than \p backend,
+ * concurrently.
+ *
+ * Setting an option on either \p backend or its clone does not affect the
+ * other one. The clone must be destroyed on its own, with
+ * rbh_backend_destroy(), and may outlive \p backend.
+ */
+static inline struct rbh_backend *
+rbh_backend_clone(struct rbh_backend *backend)
+{
+    if (backend->ops->clone == NULL) {
+        errno = ENOTSUP;
+        return NULL;
+    }
+    return backend->ops->clone(backend);
+}
+
 /**
  * Return the root of a backend
  *
@@ -482,6 +562,74 @@ rbh_backend_filter(struct rbh_backend *backend, const struct rbh_filter *filter,
     return backend->ops->filter(backend, filter, options);
 }
 
+/**
+ * Generic backend "filter_partitioned" operation
+ *
+ * This function is meant only to be called from
+ * rbh_backend_filter_partitioned(), for backends that do not know how to
+ * partition their own results.
+ *
+ * It runs a single query, and deals the fsentries it yields to whichever
+ * partition asks for one next (under a lock). Partitions may be consumed from
+ * different threads, but not from different processes, and must not outlive
+ * \p backend.
+ */
+int
+rbh_generic_backend_filter_partitioned(struct rbh_backend *backend,
+                                       const struct rbh_filter *filter,
+                                       const struct rbh_filter_options *options,
+                                       struct rbh_mut_iterator **partitions,
+                                       size_t count);
+
+/**
+ * Return several iterators that, together, yield the fsentries that match a
+ * set of criteria
+ *
+ * @param backend       the backend from which to fetch fsentries
+ * @param filter        a set of criteria that the returned fsentries must match
+ * @param options       a set of filtering options (must not be NULL)
+ * @param partitions    an array of \p count pointers, filled with iterators
+ *                      over mutable fsentries on success
+ * @param count         the number of partitions to split the result into
+ *
+ * @return              0 on success, -1 on error and errno is set appropriately
+ *
+ * @error EINVAL        \p count is 0
+ * @error ENOMEM        there was not enough memory available
+ * @error ENOTSUP       \p backend does not support filtering fsentries, or
+ *                      \p options cannot be applied to a partitioned result
+ *                      (eg. a limit, or a sort)
+ *
+ * Partitions are disjoint, and every fsentry that rbh_backend_filter() would
+ * yield is yielded by one of them. They are meant to be consumed in parallel,
+ * and may be of very different sizes (some may even be empty).
+ *
+ * Each partition must be destroyed on its own, with rbh_mut_iter_destroy(),
+ * before \p backend is: partitions may share resources with \p backend (the
+ * ones rbh_generic_backend_filter_partitioned() returns share a single query).
+ *
+ * This function may fail and set errno to any error number specifically
+ * documented by \p backend.
+ */
+static inline int
+rbh_backend_filter_partitioned(struct rbh_backend *backend,
+                               const struct rbh_filter *filter,
+                               const struct rbh_filter_options *options,
+                               struct rbh_mut_iterator **partitions,
+                               size_t count)
+{
+    if (count == 0) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    if (backend->ops->filter_partitioned == NULL)
+        return rbh_generic_backend_filter_partitioned(backend, filter, options,
+                                                      partitions, count);
+    return backend->ops->filter_partitioned(backend, filter, options,
+                                            partitions, count);
+}
+
 /**
  * Free resources associated to a struct rbh_backend
  *
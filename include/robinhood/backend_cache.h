@@ -0,0 +1,83 @@
+/* This file is part of the RobinHood Library
+ * Copyright (C) 2022 Commissariat a l'energie atomique et aux energies
+ *                    alternatives
+ *
+ * SPDX-License-Identifer: LGPL-3.0-or-later
+ */
+
+#ifndef ROBINHOOD_BACKEND_CACHE_H
+#define ROBINHOOD_BACKEND_CACHE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "robinhood/backend.h"
+
+/** @file
+ * A backend that caches the fsentries another backend serves
+ *
+ * Policy engines look up the same entries over and over: parents, the root,
+ * the components of paths, ... A caching backend wraps any backend, and keeps
+ * the fsentries such lookups return, up to a maximum number of them, in least
+ * recently used order.
+ *
+ * Cached fsentries are indexed both by ID and by parent ID and name. They are
+ * used to serve:
+ *   - rbh_backend_root();
+ *   - rbh_backend_filter() with a filter on a parent ID and a name (cf.
+ *     rbh_backend_fsentry_from_path());
+ *   - rbh_backend_filter() with a filter on an ID (cf.
+ *     rbh_backend_filter_one()), provided the cache knows the inode only has
+ *     one link (eg. it is a directory).
+ *
+ * A cached fsentry is only used if it was fetched with (at least) the fields a
+ * query projects. Other queries are forwarded to the wrapped backend as is.
+ *
+ * The fsevents that go through rbh_backend_update() invalidate the fsentries
+ * they apply to, and setting any option flushes the cache. Updates made to the
+ * wrapped backend by other means are not seen.
+ *
+ * Caching backends share the ID and the options of the backend they wrap,
+ * statistics are available through the generic option RBH_GBO_CACHE_STATS.
+ */
+
+/**
+ * Statistics of a caching backend
+ *
+ * The hit rate of a cache is \c hits / (\c hits + \c misses).
+ */
+struct rbh_backend_cache_stats {
+    /** The number of cached fsentries */
+    size_t count;
+    /** The maximum number of cached fsentries */
+    size_t capacity;
+    /** The number of lookups served from the cache */
+    uint64_t hits;
+    /** The number of lookups forwarded to the wrapped backend */
+    uint64_t misses;
+    /** The number of fsentries evicted to make room for others */
+    uint64_t evictions;
+    /** The number of fsentries dropped because of an update */
+    uint64_t invalidations;
+};
+
+/**
+ * Wrap a backend with a cache of fsentries
+ *
+ * @param backend   the backend to wrap
+ * @param capacity  the maximum number of fsentries to cache (must not be 0)
+ *
+ * @return          a pointer to a newly allocated struct rbh_backend on
+ *                  success, NULL on error and errno is set appropriately
+ *
+ * @error EINVAL    \p capacity is 0
+ * @error ENOMEM    there was not enough memory available
+ *
+ * On success, \p backend belongs to the returned backend, and is destroyed
+ * along with it. Branches and clones of the returned backend are caching
+ * backends of their own (with an empty cache).
+ */
+struct rbh_backend *
+rbh_backend_cache_new(struct rbh_backend *backend, size_t capacity);
+
+#endif
@@ -0,0 +1,118 @@
+/* This file is part of the RobinHood Library
+ * Copyright (C) 2022 Commissariat a l'energie atomique et aux energies
+ *                    alternatives
+ *
+ * SPDX-License-Identifer: LGPL-3.0-or-later
+ */
+
+#ifndef ROBINHOOD_BACKEND_POOL_H
+#define ROBINHOOD_BACKEND_POOL_H
+
+#include <stddef.h>
+
+#include "robinhood/backend.h"
+
+/** @file
+ * A pool of backends, keyed by URI
+ *
+ * Creating a backend from a URI means parsing the URI, importing a plugin,
+ * setting up the backend (eg. connecting to a database) and, often, branching
+ * it. Services that need a backend per request can instead check backends out
+ * of a pool, and check them back in when they are done with them.
+ *
+ * Backends that are checked in stay idle in the pool until they are checked out
+ * again with the same URI, or until they have been idle for too long. The root
+ * backends used to create branches are pooled as well (by backend type and
+ * fsname), so that creating a new branch does not involve setting up a
+ * new root.
+ *
+ * Every function of this interface is thread-safe. Backends themselves are
+ * not: a backend that is checked out belongs to a single user.
+ */
+
+struct rbh_backend_pool;
+
+/**
+ * Create a pool of backends
+ *
+ * @param max_idle      the maximum number of idle backends to keep per URI
+ * @param idle_timeout  the number of seconds after which idle backends are
+ *                      destroyed (0 means never)
+ *
+ * @return              a pointer to a newly allocated struct rbh_backend_pool
+ *                      on success, NULL on error and errno is set appropriately
+ *
+ * @error ENOMEM        there was not enough memory available
+ */
+struct rbh_backend_pool *
+rbh_backend_pool_new(size_t max_idle, unsigned int idle_timeout);
+
+/**
+ * Get a backend out of a pool
+ *
+ * @param pool  the pool to get a backend from
+ * @param uri   the URI of the backend to get (cf. rbh_backend_from_uri())
+ *
+ * @return      a pointer to a struct rbh_backend on success, NULL on error and
+ *              errno is set appropriately
+ *
+ * @error EINVAL    \p uri is not a valid robinhood URI
+ * @error ENOENT    the plugin of the backend could not be loaded (dlerror()
+ *                  can be used to establish a diagnostic)
+ * @error ENOMEM    there was not enough memory available
+ *
+ * If there is no idle backend for \p uri in \p pool, a new one is created, in
+ * which case this function may also fail and set errno for any of the errors
+ * specified for rbh_backend_plugin_import(), rbh_backend_branch(), and
+ * rbh_backend_fsentry_from_path().
+ *
+ * URIs are compared as strings: different URIs for the same backend do not
+ * share idle backends.
+ *
+ * The returned backend must eventually be handed back to \p pool with
+ * rbh_backend_pool_checkin(), and not be destroyed otherwise.
+ */
+struct rbh_backend *
+rbh_backend_pool_checkout(struct rbh_backend_pool *pool, const char *uri);
+
+/**
+ * Hand a backend back to a pool
+ *
+ * @param pool      the pool \p backend was checked out of
+ * @param backend   the backend to check in
+ *
+ * \p backend must not be used after this function returns. It is destroyed
+ * if \p pool already holds enough idle backends for its URI.
+ */
+void
+rbh_backend_pool_checkin(struct rbh_backend_pool *pool,
+                         struct rbh_backend *backend);
+
+/**
+ * Destroy the backends of a pool that have been idle for a while
+ *
+ * @param pool      the pool to evict backends from
+ * @param idle      the number of seconds a backend must have been idle for to
+ *                  be evicted (0 means every idle backend)
+ *
+ * @return          the number of backends that were destroyed
+ *
+ * Pools created with an idle timeout call this function on their own from
+ * time to time. Calling it explicitly is only needed to release resources
+ * sooner (eg. on a timer, or when memory runs low).
+ */
+size_t
+rbh_backend_pool_evict(struct rbh_backend_pool *pool, unsigned int idle);
+
+/**
+ * Free resources associated with a pool of backends
+ *
+ * @param pool  the pool to destroy
+ *
+ * Every idle backend of \p pool is destroyed. No backend may be checked out of
+ * \p pool when this function is called.
+ */
+void
+rbh_backend_pool_destroy(struct rbh_backend_pool *pool);
+
+#endif
@@ -0,0 +1,90 @@
+/* This file is part of the RobinHood Library
+ * Copyright (C) 2022 Commissariat a l'energie atomique et aux energies
+ *                    alternatives
+ *
+ * SPDX-License-Identifer: LGPL-3.0-or-later
+ */
+
+#ifndef ROBINHOOD_BACKEND_RESULT_CACHE_H
+#define ROBINHOOD_BACKEND_RESULT_CACHE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "robinhood/backend.h"
+
+/** @file
+ * A backend that caches the results of the queries another backend serves
+ *
+ * Dashboards and reports tend to run the same queries over and over. A result
+ * caching backend wraps any backend, and keeps the fsentries the queries made
+ * with rbh_backend_filter() yield, up to a maximum number of bytes, in least
+ * recently used order.
+ *
+ * Queries are identified by their filter and their options (projection, skip,
+ * limit and sort) which are serialized in a canonical form, and hashed. The
+ * results of a query are only cached once they were iterated over in full,
+ * queries that sample fsentries are never cached.
+ *
+ * Cached results are conservatively invalidated: any call to
+ * rbh_backend_update(), or to rbh_backend_set_option(), flushes the cache.
+ * Results also expire after a configurable amount of time, which bounds how
+ * stale they can get when the wrapped backend is updated by other means.
+ *
+ * Result caching backends share the ID and the options of the backend they
+ * wrap, statistics are available through the generic option
+ * RBH_GBO_RESULT_CACHE_STATS.
+ */
+
+/**
+ * Statistics of a result caching backend
+ */
+struct rbh_backend_result_cache_stats {
+    /** The number of cached result sets */
+    size_t count;
+    /** The number of bytes cached result sets use */
+    size_t size;
+    /** The maximum number of bytes cached result sets may use */
+    size_t max_size;
+    /** The number of queries served from the cache */
+    uint64_t hits;
+    /** The number of queries forwarded to the wrapped backend */
+    uint64_t misses;
+    /** The number of result sets evicted to make room for others */
+    uint64_t evictions;
+    /** The number of result sets dropped because they expired */
+    uint64_t expirations;
+    /** The number of result sets dropped because of an update */
+    uint64_t invalidations;
+};
+
+/**
+ * Wrap a backend with a cache of query results
+ *
+ * @param backend   the backend to wrap
+ * @param max_size  the maximum number of bytes cached results may use (must not
+ *                  be 0)
+ * @param ttl       the number of seconds after which cached results expire (0
+ *                  means they never do)
+ *
+ * @return          a pointer to a newly allocated struct rbh_backend on
+ *                  success, NULL on error and errno is set appropriately
+ *
+ * @error EINVAL    \p max_size is 0
+ * @error ENOMEM    there was not enough memory available
+ *
+ * On success, \p backend belongs to the returned backend, and is destroyed
+ * along with it. Branches and clones of the returned backend are result caching
+ * backends of their own (with an empty cache).
+ *
+ * The iterators rbh_backend_filter() returns may outlive the returned backend:
+ * \p backend is only destroyed once they are, too.
+ *
+ * Cached results are also accounted for in the process-wide memory budget (cf.
+ * rbh_memory_set_budget()), results that do not fit in it are not cached.
+ */
+struct rbh_backend *
+rbh_backend_result_cache_new(struct rbh_backend *backend, size_t max_size,
+                             unsigned int ttl);
+
+#endif
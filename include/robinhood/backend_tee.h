@@ -0,0 +1,79 @@
+/* This file is part of the RobinHood Library
+ * Copyright (C) 2022 Commissariat a l'energie atomique et aux energies
+ *                    alternatives
+ *
+ * SPDX-License-Identifer: LGPL-3.0-or-later
+ */
+
+#ifndef ROBINHOOD_BACKEND_TEE_H
+#define ROBINHOOD_BACKEND_TEE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "robinhood/backend.h"
+
+/** @file
+ * A backend that mirrors updates into several backends
+ *
+ * A tee backend wraps a list of backends, the first of which is the primary.
+ * rbh_backend_update() reads the fsevents it is given once, and fans them out
+ * to every backend concurrently: each backend is updated by a writer thread of
+ * its own, which it is fed through a bounded buffer. A slow backend only holds
+ * the others back once its buffer is full.
+ *
+ * Every other operation (queries, options, ...) is routed to the primary
+ * backend, tee backends share its ID and thus its options.
+ *
+ * Statistics about each wrapped backend, including how far behind the others
+ * it lags, are available through the generic option RBH_GBO_TEE_STATS.
+ */
+
+/**
+ * Statistics of a backend a tee backend updates
+ */
+struct rbh_backend_tee_stats {
+    /** The number of fsevents the backend applied */
+    uint64_t updated;
+    /** The number of fsevents that are buffered, waiting for the backend */
+    uint64_t lag;
+    /** The highest \c lag the backend ever had */
+    uint64_t max_lag;
+    /** The number of updates the backend failed */
+    uint64_t failures;
+};
+
+/**
+ * Mirror updates into several backends
+ *
+ * @param backends  an array of \p count backends to mirror updates into, the
+ *                  first one is the primary
+ * @param count     the number of backends in \p backends (must not be 0)
+ * @param buffer    the number of fsevents that may be buffered for each backend
+ *                  (must not be 0)
+ *
+ * @return          a pointer to a newly allocated struct rbh_backend on
+ *                  success, NULL on error and errno is set appropriately
+ *
+ * @error EINVAL    \p count or \p buffer is 0
+ * @error ENOMEM    there was not enough memory available
+ *
+ * On success, the backends in \p backends belong to the returned backend, and
+ * are destroyed along with it (\p backends itself is not used afterwards).
+ *
+ * rbh_backend_update() returns the number of fsevents the primary backend
+ * applied, or fails if any of the backends did, in which case errno is set
+ * by the first backend that failed (the primary one, if it did), as is
+ * rbh_backend_error if that errno is RBH_BACKEND_ERROR. The backends that did
+ * not fail still receive every fsevent.
+ *
+ * Branches and clones of the returned backend are tee backends made of
+ * branches and clones of every backend in \p backends.
+ *
+ * The statistics of the backends in \p backends are reported, in order, as an
+ * array of struct rbh_backend_tee_stats.
+ */
+struct rbh_backend *
+rbh_backend_tee_new(struct rbh_backend **backends, size_t count, size_t buffer);
+
+#endif
@@ -21,8 +21,11 @@
 #include <fts.h>
 
 #include "robinhood/backend.h"
+#include "robinhood/backends/posix.h"
 #include "robinhood/sstack.h"
 
+#include "random.h"
+
 /*----------------------------------------------------------------------------*
  |                               posix_iterator                               |
  *----------------------------------------------------------------------------*/
@@ -51,6 +54,20 @@ struct posix_iterator {
     size_t prefix_len;
     FTS *fts_handle;
     FTSENT *ftsent;
+
+    /* The maximum number of fsentries to yield (0 means no limit) */
+    size_t limit;
+    size_t yielded;
+
+    /* Bernoulli sampling: entries are skipped before their metadata is
+     * collected (a sample_rate of 0 means no sampling).
+     */
+    double sample_rate;
+    size_t sample_skip;
+    struct rand64 rand;
+
+    /* Only yield the fsentries whose parent belongs to this shard */
+    struct rbh_posix_shard shard;
 };
 
 struct posix_iterator *
@@ -65,6 +82,26 @@ struct posix_backend {
     struct posix_iterator *(*iter_new)(const char *, const char *, int);
     char *root;
     int statx_sync_type;
+    struct rbh_posix_shard shard;
+
+    /**
+     * Callback which tells which group (eg. which server) a directory belongs
+     * to, partitioned filters only ever walk a single group per partition
+     *
+     * It is only called on the top-level directories of the backend's root,
+     * the directories underneath them are walked along with them.
+     *
+     * @param fd        file descriptor of the directory
+     *
+     * @return          the index of the group of the directory, or -1 if it is
+     *                  unknown
+     *
+     * May be NULL, in which case every directory is in the same group.
+     */
+    int (*group_of)(int fd);
+
+    /* The maximum number of partitions per group (0 means no limit) */
+    uint32_t max_partitions_per_group;
 };
 
 #endif
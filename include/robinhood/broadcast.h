@@ -0,0 +1,164 @@
+/* This file is part of the RobinHood Library
+ * Copyright (C) 2022 Commissariat a l'energie atomique et aux energies
+ *                    alternatives
+ *
+ * SPDX-License-Identifer: LGPL-3.0-or-later
+ */
+
+#ifndef ROBINHOOD_BROADCAST_H
+#define ROBINHOOD_BROADCAST_H
+
+/**
+ * @file
+ *
+ * Thread-safe ring buffer with multiple readers
+ *
+ * A struct rbh_broadcast is the thread-safe counterpart of struct rbh_ringr:
+ * one thread (the producer) pushes data, and a fixed number of readers, each
+ * of which may run on its own thread, read all of it, at their own pace.
+ *
+ * Example: fan out fsevents to 2 sinks
+ *
+ *     broadcast = rbh_broadcast_new(1 << 20, 2);
+ *
+ *     // producer thread
+ *     rbh_broadcast_push(broadcast, fsevent, size);
+ *
+ *     // thread of the i-th sink
+ *     data = rbh_broadcast_peek(broadcast, i, &readable);
+ *     ...
+ *     rbh_broadcast_ack(broadcast, i, count);
+ *
+ * Data is released once every reader acknowledged it. Rather than looking
+ * for the slowest reader whenever space is needed, the ring is split into
+ * segments, each of which counts how many readers went past it.
+ * Acknowledging data only updates the counters of the segments a reader goes
+ * past, regardless of how many readers there are. As a consequence, space is
+ * only released one segment (1/64th of the ring) at a time.
+ *
+ * As with struct rbh_ring, pushed data is always stored contiguously, and the
+ * data that is readable from a reader's point of view can always be read in
+ * one pass.
+ */
+
+#include <stddef.h>
+
+struct rbh_broadcast;
+
+/**
+ * Create a thread-safe ring buffer with multiple readers
+ *
+ * @param size      the size of the ring buffer (must be a multiple of the
+ *                  running kernel's page size)
+ * @param readers   the number of readers
+ *
+ * @return          a pointer to a newly allocated struct rbh_broadcast on
+ *                  success, NULL on error and errno is set appropriately
+ *
+ * @error EINVAL    \p readers is 0
+ * @error ENOMEM    there was not enough memory available
+ *
+ * This function may also fail and set errno for any of the errors specified for
+ * the routine rbh_ring_new().
+ *
+ * Readers are identified by their index, in [0, \p readers[.
+ */
+struct rbh_broadcast *
+rbh_broadcast_new(size_t size, unsigned int readers);
+
+/**
+ * Reserve space in a broadcast ring
+ *
+ * @param broadcast the broadcast ring to reserve space in
+ * @param size      the number of bytes to reserve
+ *
+ * @return          the address of \p size contiguous writable bytes in
+ *                  \p broadcast on success, NULL on error and errno is set
+ *                  appropriately
+ *
+ * @error ENOBUFS   there is not enough space in \p broadcast
+ * @error EINVAL    \p size is greater than the total space of \p broadcast
+ *
+ * The reserved bytes are not visible to readers until they are committed with
+ * rbh_broadcast_commit().
+ *
+ * Only one thread at a time may push data into a broadcast ring.
+ */
+void *
+rbh_broadcast_reserve(struct rbh_broadcast *broadcast, size_t size);
+
+/**
+ * Make data written in reserved space visible to readers
+ *
+ * @param broadcast the broadcast ring to commit data to
+ * @param size      the number of bytes to commit
+ *
+ * @return          0 on success, -1 on error and errno is set appropriately
+ *
+ * @error EINVAL    \p size is greater than the available space in
+ *                  \p broadcast
+ */
+int
+rbh_broadcast_commit(struct rbh_broadcast *broadcast, size_t size);
+
+/**
+ * Push data into a broadcast ring
+ *
+ * @param broadcast the broadcast ring to push data into
+ * @param data      a pointer to the data to push into \p broadcast
+ * @param size      the size of the data to push into \p broadcast
+ *
+ * @return          the address in \p broadcast where \p data was pushed on
+ *                  success, NULL on error and errno is set appropriately
+ *
+ * This is a shorthand for rbh_broadcast_reserve(), memcpy(3) and
+ * rbh_broadcast_commit(), refer to rbh_broadcast_reserve() for the errors this
+ * function may fail with.
+ */
+void *
+rbh_broadcast_push(struct rbh_broadcast *broadcast, const void *data,
+                   size_t size);
+
+/**
+ * Peek at data in a broadcast ring from a reader's point of view
+ *
+ * @param broadcast the broadcast ring to peek at
+ * @param reader    the index of the reader
+ * @param readable  set to the number of readable bytes in \p broadcast from
+ *                  \p reader's point of view on return
+ *
+ * @return          the address of the first readable byte in \p broadcast
+ *
+ * Each reader may only be used by one thread at a time.
+ */
+void *
+rbh_broadcast_peek(struct rbh_broadcast *broadcast, unsigned int reader,
+                   size_t *readable);
+
+/**
+ * Acknowledge data in a broadcast ring from a reader's point of view
+ *
+ * @param broadcast the broadcast ring to acknowledge data in
+ * @param reader    the index of the reader
+ * @param count     the number of bytes to acknowledge
+ *
+ * @return          0 on success, -1 on error and errno is set appropriately
+ *
+ * @error EINVAL    \p count is greater than the number of readable bytes in
+ *                  \p broadcast from \p reader's point of view
+ */
+int
+rbh_broadcast_ack(struct rbh_broadcast *broadcast, unsigned int reader,
+                  size_t count);
+
+/**
+ * Free resources associated with a broadcast ring
+ *
+ * @param broadcast the broadcast ring to destroy
+ *
+ * No thread may use \p broadcast concurrently.
+ */
+void
+rbh_broadcast_destroy(struct rbh_broadcast *broadcast);
+
+#endif
@@ -0,0 +1,117 @@
+/* This file is part of the RobinHood Library
+ * Copyright (C) 2022 Commissariat a l'energie atomique et aux energies
+ *                    alternatives
+ *
+ * SPDX-License-Identifer: LGPL-3.0-or-later
+ */
+
+#ifndef ROBINHOOD_DISTINCT_H
+#define ROBINHOOD_DISTINCT_H
+
+#include <stddef.h>
+
+#include "robinhood/filter.h"
+#include "robinhood/iterator.h"
+
+/** @file
+ * Deduplication of fsentry streams
+ *
+ * Hardlinks and overlapping queries can make the same fsentry appear several
+ * times in a stream. The iterators defined here filter out any fsentry whose
+ * key (its ID, or any other field) was already seen.
+ */
+
+enum rbh_distinct_mode {
+    /** Remember every key, spill them to disk past a memory threshold */
+    RBH_DM_EXACT,
+    /** Use a blocked Bloom filter, some unique fsentries may be filtered out */
+    RBH_DM_APPROXIMATE,
+};
+
+struct rbh_distinct_options {
+    enum rbh_distinct_mode mode;
+    union {
+        /* RBH_DM_EXACT */
+        struct {
+            /** Number of bytes of memory to use before spilling keys to disk
+             *
+             * 0 means no limit. Limits below 1 MiB are rounded up to 1 MiB.
+             *
+             * The indexes and Bloom filters of the keys spilled to disk count
+             * towards this limit. Once they use more than three quarters of
+             * it, the limit is exceeded rather than keys spilled in ever
+             * smaller batches.
+             */
+            size_t memory;
+            /** Directory where to spill keys, NULL means $TMPDIR (or /tmp) */
+            const char *directory;
+        } exact;
+
+        /* RBH_DM_APPROXIMATE */
+        struct {
+            /** Expected number of distinct keys */
+            size_t capacity;
+            /** Expected rate of unique fsentries that will be filtered out
+             *
+             * Must be in ]0, 1[. The rate is only achieved as long as the
+             * number of distinct keys stays below \c capacity.
+             */
+            double false_positive_rate;
+        } approximate;
+    };
+};
+
+/**
+ * Filter out fsentries whose key was already seen
+ *
+ * @param fsentries an iterator of fsentries
+ * @param field     the field to use as a key, NULL means RBH_FP_ID
+ * @param options   how to remember which keys were seen
+ *
+ * @return          a pointer to a newly allocated struct rbh_iterator that
+ *                  yields the first fsentry of \p fsentries with a given key on
+ *                  success, NULL on error and errno is set appropriately
+ *
+ * @error EINVAL    \p options is invalid
+ * @error ENOMEM    there was not enough memory available
+ *
+ * The `next' method of the returned iterator may fail with:
+ *  - ENODATA: \p fsentries is exhausted;
+ *  - ENOTSUP: an fsentry's key is a sequence or a map;
+ *  - any error reported by \p fsentries, or by the functions used to spill
+ *    keys to disk.
+ *
+ * fsentries that do not have \p field set are never filtered out.
+ *
+ * \p fsentries should not be used anymore after a successful call to this
+ * function.
+ */
+struct rbh_iterator *
+rbh_iter_distinct(struct rbh_iterator *fsentries,
+                  const struct rbh_filter_field *field,
+                  const struct rbh_distinct_options *options);
+
+/**
+ * Filter out fsentries whose key was already seen
+ *
+ * @param fsentries a mutable iterator of fsentries
+ * @param field     the field to use as a key, NULL means RBH_FP_ID
+ * @param options   how to remember which keys were seen
+ *
+ * @return          a pointer to a newly allocated struct rbh_mut_iterator that
+ *                  yields the first fsentry of \p fsentries with a given key on
+ *                  success, NULL on error and errno is set appropriately
+ *
+ * @error EINVAL    \p options is invalid
+ * @error ENOMEM    there was not enough memory available
+ *
+ * fsentries that are filtered out are freed with free().
+ *
+ * Refer to rbh_iter_distinct() for more information.
+ */
+struct rbh_mut_iterator *
+rbh_mut_iter_distinct(struct rbh_mut_iterator *fsentries,
+                      const struct rbh_filter_field *field,
+                      const struct rbh_distinct_options *options);
+
+#endif
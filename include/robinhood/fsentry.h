@@ -15,6 +15,7 @@
  * fsentry is the generic name for a filesystem entry (file, dir, symlink, ...)
  */
 
+struct rbh_filter_field;
 struct rbh_statx;
 
 /**
@@ -137,4 +138,29 @@ rbh_fsentry_new(const struct rbh_id *id, const struct rbh_id *parent_id,
                 const struct rbh_value_map *ns_xattrs,
                 const struct rbh_value_map *xattrs, const char *symlink);
 
+/**
+ * Get the value of one of the fields of an fsentry
+ *
+ * @param fsentry       the fsentry to inspect
+ * @param field         the field whose value to get
+ * @param value         a pointer to a struct rbh_value to fill
+ *
+ * @return              0 on success, -1 on error and errno is set appropriately
+ *
+ * @error ENODATA       \p fsentry does not have \p field set
+ * @error EINVAL        \p field is not valid (eg. it designates more than one
+ *                      statx field at once)
+ *
+ * On success, \p value may point at data inside \p fsentry. It is only valid as
+ * long as \p fsentry is.
+ *
+ * IDs are returned as binary values, names and symlinks as strings, statx
+ * fields as integers (timestamps in seconds are signed) and xattrs as they are
+ * stored in \p fsentry.
+ */
+int
+rbh_fsentry_get_field(const struct rbh_fsentry *fsentry,
+                      const struct rbh_filter_field *field,
+                      struct rbh_value *value);
+
 #endif
@@ -8,7 +8,10 @@
 #ifndef ROBINHOOD_ID_H
 #define ROBINHOOD_ID_H
 
+#include <stdbool.h>
 #include <stddef.h>
+#include <stdint.h>
+#include <string.h>
 
 /** @file
  * IDs uniquely indentify the fsentries of a given filesystem.
@@ -126,4 +129,130 @@ rbh_id_from_lu_fid(const struct lu_fid *fid);
 struct file_handle *
 rbh_file_handle_from_id(const struct rbh_id *fid);
 
+/*----------------------------------------------------------------------------*
+ |                               rbh_compact_id                               |
+ *----------------------------------------------------------------------------*/
+
+/**
+ * The number of bytes a struct rbh_compact_id stores inline
+ *
+ * This is enough for the file handles of most filesystems, and for Lustre IDs.
+ */
+#define RBH_COMPACT_ID_INLINE_SIZE 40
+
+/**
+ * A self-contained, fixed-width representation of an ID
+ *
+ * IDs of up to RBH_COMPACT_ID_INLINE_SIZE bytes are stored inline (and padded
+ * with zeros), larger ones are stored on the heap. The hash of the ID is
+ * computed once and for all, so that comparing two different IDs rarely
+ * requires looking at their data.
+ *
+ * Compact IDs can be stored in arrays, rings, ... without pointing at separately
+ * allocated memory (as long as they are small enough). They must be initialized
+ * with rbh_compact_id_init() or rbh_compact_id_copy(), and released with
+ * rbh_compact_id_fini().
+ */
+struct rbh_compact_id {
+    uint32_t size;
+    uint32_t hash;
+    union {
+        char bytes[RBH_COMPACT_ID_INLINE_SIZE];
+        char *data;
+    };
+};
+
+/**
+ * Initialize a compact ID from a struct rbh_id
+ *
+ * @param compact   the compact ID to initialize
+ * @param id        the ID to copy into \p compact
+ *
+ * @return          0 on success, -1 on error and errno is set appropriately
+ *
+ * @error EINVAL    \p id is too large to fit in a compact ID (ie. larger than
+ *                  UINT32_MAX)
+ * @error ENOMEM    not enough memory available
+ */
+int
+rbh_compact_id_init(struct rbh_compact_id *compact, const struct rbh_id *id);
+
+/**
+ * Initialize a compact ID as a copy of another one
+ *
+ * @param dest      the compact ID to initialize
+ * @param src       the compact ID to copy
+ *
+ * @return          0 on success, -1 on error and errno is set appropriately
+ *
+ * @error ENOMEM    not enough memory available
+ */
+int
+rbh_compact_id_copy(struct rbh_compact_id *dest,
+                    const struct rbh_compact_id *src);
+
+/**
+ * Release the resources associated with a compact ID
+ *
+ * @param compact   the compact ID to release
+ */
+void
+rbh_compact_id_fini(struct rbh_compact_id *compact);
+
+/**
+ * Get a struct rbh_id out of a compact ID
+ *
+ * @param compact   the compact ID to convert
+ *
+ * @return          a struct rbh_id that points at the data of \p compact
+ *
+ * The returned ID is only valid as long as \p compact is (and is not moved,
+ * for inline IDs).
+ */
+static inline struct rbh_id
+rbh_compact_id_view(const struct rbh_compact_id *compact)
+{
+    return (struct rbh_id){
+        .data = compact->size > RBH_COMPACT_ID_INLINE_SIZE ?
+            compact->data : compact->bytes,
+        .size = compact->size,
+    };
+}
+
+/**
+ * Get the hash of a compact ID
+ *
+ * @param compact   the compact ID to hash
+ *
+ * @return          the hash of \p compact
+ */
+static inline uint32_t
+rbh_compact_id_hash(const struct rbh_compact_id *compact)
+{
+    return compact->hash;
+}
+
+/**
+ * Compare two compact IDs for equality
+ *
+ * @param x         a compact ID
+ * @param y         another compact ID
+ *
+ * @return          true if \p x and \p y represent the same ID, false
+ *                  otherwise
+ */
+static inline bool
+rbh_compact_id_equal(const struct rbh_compact_id *x,
+                     const struct rbh_compact_id *y)
+{
+    if (x->size != y->size || x->hash != y->hash)
+        return false;
+
+    /* Inline IDs are padded with zeros: compare their whole buffer at once */
+    if (x->size <= RBH_COMPACT_ID_INLINE_SIZE)
+        return memcmp(x->bytes, y->bytes, RBH_COMPACT_ID_INLINE_SIZE) == 0;
+
+    return memcmp(x->data, y->data, x->size) == 0;
+}
+
 #endif
@@ -0,0 +1,179 @@
+/* This file is part of the RobinHood Library
+ * Copyright (C) 2022 Commissariat a l'energie atomique et aux energies
+ *                    alternatives
+ *
+ * SPDX-License-Identifer: LGPL-3.0-or-later
+ */
+
+#ifndef ROBINHOOD_IDMAP_H
+#define ROBINHOOD_IDMAP_H
+
+/**
+ * @file
+ *
+ * Hash map keyed by struct rbh_id
+ *
+ * A struct rbh_idmap maps IDs to fixed-size values. It is meant for hardlink
+ * caches, memoization of parent IDs, deduplication tables, ...
+ *
+ * Example: memoize the number of links of an entry
+ *
+ *     map = rbh_idmap_new(sizeof(uint32_t), 0);
+ *
+ *     nlink = rbh_idmap_put(map, id, &created);
+ *     if (created)
+ *         *nlink = statx->stx_nlink;
+ *
+ * The map uses open addressing with Robin Hood hashing: keys are hashed, and
+ * each slot of the table records how far it is from where its key hashes to.
+ * Inserting a key takes the slot of any key that is closer to home, which keeps
+ * probe sequences short, and lookups stop as soon as they are further from home
+ * than the slot they look at.
+ *
+ * IDs and values are not stored in the table itself, but in an arena: slots
+ * only hold a part of the hash of their key and the offset of their key in the
+ * arena. The arena is compacted as entries are removed.
+ *
+ * The map can be bounded in memory, in which case the least recently used
+ * entries are evicted to make room for new ones.
+ */
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "robinhood/id.h"
+#include "robinhood/iterator.h"
+#include "robinhood/memory.h"
+
+struct rbh_idmap;
+
+/**
+ * Create a hash map keyed by struct rbh_id
+ *
+ * @param value_size    the size of the values of the map
+ * @param memory_limit  the maximum number of bytes the map may use (0 means
+ *                      no limit), this includes its table and the whole
+ *                      arena its entries are stored in
+ *
+ * @return              a pointer to a newly allocated struct rbh_idmap on
+ *                      success, NULL on error and errno is set appropriately
+ *
+ * @error ENOMEM        there was not enough memory available
+ *
+ * Values are aligned on max_align_t.
+ */
+struct rbh_idmap *
+rbh_idmap_new(size_t value_size, size_t memory_limit);
+
+/**
+ * Look up an ID in a map
+ *
+ * @param map       the map to look up \p id in
+ * @param id        the ID to look up
+ *
+ * @return          a pointer to the value associated with \p id on success,
+ *                  NULL on error and errno is set appropriately
+ *
+ * @error ENOENT    \p id is not in \p map
+ *
+ * The entry of \p id becomes the most recently used one.
+ *
+ * The returned pointer remains valid until the next call to rbh_idmap_put() or
+ * rbh_idmap_remove().
+ */
+void *
+rbh_idmap_get(struct rbh_idmap *map, const struct rbh_id *id);
+
+/**
+ * Insert an ID in a map (unless it already is in it)
+ *
+ * @param map       the map to insert \p id into
+ * @param id        the ID to insert
+ * @param created   set to whether \p id was inserted in \p map (true) or was
+ *                  already in it (false), on success
+ *
+ * @return          a pointer to the value associated with \p id on success,
+ *                  NULL on error and errno is set appropriately
+ *
+ * @error ENOMEM    there was not enough memory available
+ * @error ENOBUFS   the entry of \p id alone would exceed the memory limit of
+ *                  \p map
+ *
+ * New values are zero-initialized. The entry of \p id becomes the most recently
+ * used one. If \p map is bounded in memory, the least recently used entries
+ * are evicted until there is room for the entry of \p id.
+ *
+ * The returned pointer remains valid until the next call to rbh_idmap_put() or
+ * rbh_idmap_remove().
+ */
+void *
+rbh_idmap_put(struct rbh_idmap *map, const struct rbh_id *id, bool *created);
+
+/**
+ * Remove an ID from a map
+ *
+ * @param map       the map to remove \p id from
+ * @param id        the ID to remove
+ *
+ * @return          0 on success, -1 on error and errno is set appropriately
+ *
+ * @error ENOENT    \p id is not in \p map
+ */
+int
+rbh_idmap_remove(struct rbh_idmap *map, const struct rbh_id *id);
+
+/**
+ * Get the number of entries in a map
+ *
+ * @param map       the map to count the entries of
+ *
+ * @return          the number of entries in \p map
+ */
+size_t
+rbh_idmap_count(const struct rbh_idmap *map);
+
+/**
+ * An entry of a map, as yielded by rbh_idmap_iter()
+ */
+struct rbh_idmap_entry {
+    struct rbh_id id;
+    void *value;
+};
+
+/**
+ * Iterate over the entries of a map
+ *
+ * @param map       the map to iterate over
+ *
+ * @return          a pointer to a newly allocated iterator that yields
+ *                  const struct rbh_idmap_entry pointers, from the most
+ *                  recently used entry to the least recently used one, on
+ *                  success, NULL on error and errno is set appropriately
+ *
+ * @error ENOMEM    there was not enough memory available
+ *
+ * \p map must not be modified while the iterator is in use (values may be).
+ */
+struct rbh_iterator *
+rbh_idmap_iter(struct rbh_idmap *map);
+
+/**
+ * Get the memory footprint of a map
+ *
+ * @param map       the map to get the memory footprint of
+ * @param usage     filled with the memory footprint of \p map on return
+ *
+ * Removed entries that the arena still holds are reported as cached.
+ */
+void
+rbh_idmap_usage(const struct rbh_idmap *map, struct rbh_memory_usage *usage);
+
+/**
+ * Free resources associated with a map
+ *
+ * @param map       the map to destroy
+ */
+void
+rbh_idmap_destroy(struct rbh_idmap *map);
+
+#endif
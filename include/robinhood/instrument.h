@@ -0,0 +1,155 @@
+/* This file is part of the RobinHood Library
+ * Copyright (C) 2022 Commissariat a l'energie atomique et aux energies
+ *                    alternatives
+ *
+ * SPDX-License-Identifer: LGPL-3.0-or-later
+ */
+
+#ifndef ROBINHOOD_INSTRUMENT_H
+#define ROBINHOOD_INSTRUMENT_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "robinhood/iterator.h"
+
+/** @file
+ * Iterator instrumentation
+ *
+ * Instrumented iterators record how many elements, errors and end-of-streams
+ * they yield, and how long each call to their `next' method takes.
+ *
+ * Measures are aggregated in named "stages": every instrumented iterator that
+ * shares the same name contributes to the same stage. This makes it possible
+ * to instrument each step of a pipeline (eg. posix -> chunkify -> update) and
+ * to see where time goes.
+ *
+ * Instrumentation is disabled by default, and it costs nothing when it is.
+ */
+
+/**
+ * Enable or disable iterator instrumentation process-wide
+ *
+ * @param enable    whether to enable instrumentation or not
+ *
+ * When instrumentation is disabled, rbh_iter_instrument() and
+ * rbh_mut_iter_instrument() return the iterator they are given as is, and
+ * already instrumented iterators stop recording anything.
+ */
+void
+rbh_instrument_enable(bool enable);
+
+/**
+ * Is iterator instrumentation enabled?
+ *
+ * @return  true if iterator instrumentation is enabled, false otherwise
+ */
+bool
+rbh_instrument_enabled(void);
+
+/**
+ * Instrument an iterator
+ *
+ * @param iterator  the iterator to instrument
+ * @param name      the name of the stage \p iterator belongs to
+ *
+ * @return          a pointer to a newly allocated struct rbh_iterator that
+ *                  yields the same elements as \p iterator on success, NULL on
+ *                  error and errno is set appropriately
+ *
+ * @error ENOMEM    there was not enough memory available
+ *
+ * If instrumentation is disabled, this function returns \p iterator.
+ *
+ * \p iterator should not be used anymore after a successful call to this
+ * function.
+ *
+ * The returned iterator does not retry temporary failures (EAGAIN) itself,
+ * they are counted as errors and forwarded to the caller.
+ */
+struct rbh_iterator *
+rbh_iter_instrument(struct rbh_iterator *iterator, const char *name);
+
+/**
+ * Instrument a mutable iterator
+ *
+ * @param iterator  the mutable iterator to instrument
+ * @param name      the name of the stage \p iterator belongs to
+ *
+ * @return          a pointer to a newly allocated struct rbh_mut_iterator that
+ *                  yields the same elements as \p iterator on success, NULL on
+ *                  error and errno is set appropriately
+ *
+ * @error ENOMEM    there was not enough memory available
+ *
+ * Refer to rbh_iter_instrument() for more information.
+ */
+struct rbh_mut_iterator *
+rbh_mut_iter_instrument(struct rbh_mut_iterator *iterator, const char *name);
+
+struct rbh_iter_stats {
+    const char *name;
+
+    /** Number of elements yielded */
+    uint64_t count;
+    /** Number of errors (other than ENODATA) */
+    uint64_t errors;
+    /** Number of times the stage reported it was exhausted (ENODATA) */
+    uint64_t enodata;
+
+    /** Latencies of calls to `next' (in nanoseconds) */
+    struct {
+        /** Cumulated time spent in `next' */
+        uint64_t total;
+        uint64_t min;
+        uint64_t max;
+        uint64_t p50;
+        uint64_t p90;
+        uint64_t p99;
+        uint64_t p999;
+    } latency;
+
+    /** Elements yielded per second, between the first and last calls */
+    double throughput;
+};
+
+/**
+ * Get the statistics of a single stage
+ *
+ * @param name      the name of the stage
+ * @param stats     a pointer to a struct rbh_iter_stats to fill
+ *
+ * @return          0 on success, -1 on error and errno is set appropriately
+ *
+ * @error ENOENT    no iterator was ever instrumented with \p name
+ *
+ * On success, \p stats->name points at a string that lives as long as the
+ * process does.
+ *
+ * Percentiles are upper bounds: the error on each of them is lower than 4%.
+ */
+int
+rbh_instrument_stats(const char *name, struct rbh_iter_stats *stats);
+
+/**
+ * Dump the statistics of every known stage
+ *
+ * @return          a pointer to a newly allocated struct rbh_mut_iterator that
+ *                  yields pointers to struct rbh_iter_stats on success, NULL on
+ *                  error and errno is set appropriately
+ *
+ * @error ENOMEM    there was not enough memory available
+ *
+ * Stages are yielded in the order they were first instrumented. Each element
+ * must be freed by the caller with free().
+ */
+struct rbh_mut_iterator *
+rbh_instrument_dump(void);
+
+/**
+ * Reset the statistics of every known stage
+ */
+void
+rbh_instrument_reset(void);
+
+#endif
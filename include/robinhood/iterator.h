@@ -16,6 +16,12 @@
  *
  * This interface distinguishes mutable from immutable iterators which
  * respectively yield mutable and immutable references.
+ *
+ * Iterators may also be "pollable": their `next' method fails with EAGAIN
+ * rather than block, and they provide a file descriptor that becomes readable
+ * once the next element (or error) is available. Such iterators are meant to be
+ * used from an event loop, with rbh_iter_try_next() (or
+ * rbh_mut_iter_try_next()) and rbh_iter_fileno() (or rbh_mut_iter_fileno()).
  */
 
 /*----------------------------------------------------------------------------*
@@ -34,6 +40,8 @@ struct rbh_iterator {
 struct rbh_iterator_operations {
     const void *(*next)(void *iterator);
     void (*destroy)(void *iterator);
+    /* Optional, only pollable iterators need to implement it */
+    int (*fileno)(void *iterator);
 };
 
 /**
@@ -80,6 +88,49 @@ rbh_iter_next(struct rbh_iterator *iterator)
     return element;
 }
 
+/**
+ * Yield an immutable reference on the next element of an iterator, without
+ * retrying on temporary failures
+ *
+ * @param iterator  an iterator
+ *
+ * @return          a const pointer to the next element in the iterator on
+ *                  success, NULL on error and errno is set appropriately
+ *
+ * @error EAGAIN    the next element is not available yet, if \p iterator is
+ *                  pollable, the file descriptor returned by rbh_iter_fileno()
+ *                  becomes readable once it is
+ * @error ENODATA   the iterator is exhausted
+ */
+static inline const void *
+rbh_iter_try_next(struct rbh_iterator *iterator)
+{
+    return _rbh_iter_next(iterator);
+}
+
+/**
+ * Get the file descriptor to poll to know when an iterator can make progress
+ *
+ * @param iterator  an iterator
+ *
+ * @return          a file descriptor that becomes readable whenever the next
+ *                  call to rbh_iter_try_next() will not fail with EAGAIN, -1 on
+ *                  error and errno is set appropriately
+ *
+ * @error ENOTSUP   \p iterator is not pollable
+ *
+ * The returned file descriptor belongs to \p iterator, it must not be closed.
+ */
+static inline int
+rbh_iter_fileno(struct rbh_iterator *iterator)
+{
+    if (iterator->ops->fileno == NULL) {
+        errno = ENOTSUP;
+        return -1;
+    }
+    return iterator->ops->fileno(iterator);
+}
+
 /**
  * Free resources associated to a struct rbh_iterator
  *
@@ -109,6 +160,8 @@ struct rbh_mut_iterator {
 struct rbh_mut_iterator_operations {
     void *(*next)(void *iterator);
     void (*destroy)(void *iterator);
+    /* Optional, only pollable iterators need to implement it */
+    int (*fileno)(void *iterator);
 };
 
 /**
@@ -155,6 +208,50 @@ rbh_mut_iter_next(struct rbh_mut_iterator *iterator)
     return element;
 }
 
+/**
+ * Yield a mutable reference on the next element of an iterator, without
+ * retrying on temporary failures
+ *
+ * @param iterator  an iterator
+ *
+ * @return          a pointer to the next element in the iterator on success,
+ *                  NULL on error and errno is set appropriately
+ *
+ * @error EAGAIN    the next element is not available yet, if \p iterator is
+ *                  pollable, the file descriptor returned by
+ *                  rbh_mut_iter_fileno() becomes readable once it is
+ * @error ENODATA   the iterator is exhausted
+ */
+static inline void *
+rbh_mut_iter_try_next(struct rbh_mut_iterator *iterator)
+{
+    return _rbh_mut_iter_next(iterator);
+}
+
+/**
+ * Get the file descriptor to poll to know when a mutable iterator can make
+ * progress
+ *
+ * @param iterator  a mutable iterator
+ *
+ * @return          a file descriptor that becomes readable whenever the next
+ *                  call to rbh_mut_iter_try_next() will not fail with EAGAIN,
+ *                  -1 on error and errno is set appropriately
+ *
+ * @error ENOTSUP   \p iterator is not pollable
+ *
+ * The returned file descriptor belongs to \p iterator, it must not be closed.
+ */
+static inline int
+rbh_mut_iter_fileno(struct rbh_mut_iterator *iterator)
+{
+    if (iterator->ops->fileno == NULL) {
+        errno = ENOTSUP;
+        return -1;
+    }
+    return iterator->ops->fileno(iterator);
+}
+
 /**
  * Free resources associated to a struct rbh_iterator
  *
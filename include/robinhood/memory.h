@@ -0,0 +1,148 @@
+/* This file is part of the RobinHood Library
+ * Copyright (C) 2022 Commissariat a l'energie atomique et aux energies
+ *                    alternatives
+ *
+ * SPDX-License-Identifer: LGPL-3.0-or-later
+ */
+
+#ifndef ROBINHOOD_MEMORY_H
+#define ROBINHOOD_MEMORY_H
+
+/** @file
+ * Process-wide memory policies of the library's containers
+ *
+ * Rings (struct rbh_ring, struct rbh_ringr, struct rbh_spsc_ring, struct
+ * rbh_broadcast, and the chunks of struct rbh_queue) and stacks (struct
+ * rbh_stack and the chunks of struct rbh_sstack) can be backed by huge pages.
+ * Streaming through large buffers backed by regular pages puts a lot of
+ * pressure on the TLB, huge pages reduce the number of TLB misses.
+ *
+ * The memory mappings of fixed-size rings and of mmap'ed stacks are cached
+ * process-wide when they are destroyed, and reused by the next container of
+ * the same kind and size. Short-lived containers (eg. the queues of
+ * rbh_iter_tee()) thus avoid the cost of setting up new mappings. The cache is
+ * bounded, and it can be trimmed at any time.
+ *
+ * The memory containers allocate for their data is accounted for
+ * process-wide (refer to rbh_memory_stats()), and it can be capped with a
+ * budget (refer to rbh_memory_set_budget()). Containers also report their own
+ * footprint, with rbh_ring_usage(), rbh_stack_usage(), rbh_sstack_usage() and
+ * rbh_queue_usage().
+ */
+
+#include <stddef.h>
+
+/**
+ * Kinds of huge pages containers may be backed by
+ */
+enum rbh_huge_pages {
+    /** Regular pages only (the default) */
+    RBH_HP_NONE,
+    /** Transparent huge pages, with madvise(MADV_HUGEPAGE) */
+    RBH_HP_TRANSPARENT,
+    /** Pages from the hugetlb pool, with MFD_HUGETLB or MAP_HUGETLB */
+    RBH_HP_EXPLICIT,
+};
+
+/**
+ * Set the kind of huge pages containers should be backed by
+ *
+ * @param policy    the kind of huge pages containers created from now on
+ *                  should be backed by
+ *
+ * Only buffers that are at least as large as a huge page are concerned.
+ *
+ * Huge pages are a best effort: with RBH_HP_EXPLICIT, buffers whose size is
+ * not a multiple of the size of a huge page, or that cannot be allocated from
+ * the hugetlb pool (it is empty by default), fall back to transparent huge
+ * pages. Whether transparent huge pages are actually used is up to the kernel's
+ * configuration (/sys/kernel/mm/transparent_hugepage).
+ *
+ * Containers that already exist are not affected, and cached mappings are
+ * released (as with rbh_memory_trim(0)).
+ */
+void
+rbh_memory_set_huge_pages(enum rbh_huge_pages policy);
+
+/**
+ * Get the kind of huge pages containers are backed by
+ *
+ * @return          the last policy set with rbh_memory_set_huge_pages()
+ */
+enum rbh_huge_pages
+rbh_memory_huge_pages(void);
+
+/**
+ * Set the maximum amount of memory cached for reuse
+ *
+ * @param limit     the maximum number of bytes of memory to cache (the
+ *                  default is 64MiB, 0 disables caching)
+ *
+ * Cached mappings beyond \p limit are released.
+ */
+void
+rbh_memory_set_cache_limit(size_t limit);
+
+/**
+ * Release cached mappings
+ *
+ * @param keep      the maximum number of bytes of memory to keep cached
+ */
+void
+rbh_memory_trim(size_t keep);
+
+/**
+ * Process-wide memory statistics
+ */
+struct rbh_memory_stats {
+    /** Bytes of memory allocated by containers (cached memory included) */
+    size_t allocated;
+    /** Highest value `allocated' ever reached */
+    size_t peak;
+    /** Bytes of memory cached for reuse */
+    size_t cached;
+    /** The current budget (0 means there is none) */
+    size_t budget;
+    /** How many allocations failed because of the budget */
+    size_t failures;
+};
+
+/**
+ * Get process-wide memory statistics
+ *
+ * @param stats     filled with the current memory statistics on return
+ *
+ * This is cheap enough to be polled by a monitoring exporter.
+ */
+void
+rbh_memory_stats(struct rbh_memory_stats *stats);
+
+/**
+ * Cap the memory containers may allocate process-wide
+ *
+ * @param budget    the maximum number of bytes of memory containers may
+ *                  allocate for their data (0, the default, means no limit)
+ *
+ * Once the budget is exhausted, cached memory is released, and if that is not
+ * enough, operations that need more memory (constructors, but also pushes
+ * into a struct rbh_queue, a struct rbh_sstack or a growable struct rbh_ring)
+ * fail with ENOBUFS.
+ *
+ * Memory that is already allocated is not affected by a lower budget.
+ */
+void
+rbh_memory_set_budget(size_t budget);
+
+/**
+ * The memory footprint of a container
+ */
+struct rbh_memory_usage {
+    /** Bytes of memory the container allocated */
+    size_t allocated;
+    /** Bytes of memory that hold data */
+    size_t used;
+    /** Bytes of memory the container keeps for later reuse */
+    size_t cached;
+};
+
+#endif
@@ -0,0 +1,174 @@
+/* This file is part of the RobinHood Library
+ * Copyright (C) 2022 Commissariat a l'energie atomique et aux energies
+ *                    alternatives
+ *
+ * SPDX-License-Identifer: LGPL-3.0-or-later
+ */
+
+#ifndef ROBINHOOD_MPMC_QUEUE_H
+#define ROBINHOOD_MPMC_QUEUE_H
+
+/**
+ * @file
+ *
+ * Bounded multi-producer, multi-consumer queue of records (FIFO)
+ *
+ * A struct rbh_mpmc_queue is meant to connect the stages of a pipeline: any
+ * number of threads may push records into it while any number of threads pop
+ * records from it.
+ *
+ * Like struct rbh_queue, records are stored contiguously in fixed-size chunks,
+ * and they can be variable-sized. Unlike struct rbh_queue, the number of
+ * chunks is fixed: once every chunk is in use, producers block until
+ * consumers release enough records. This provides backpressure between the
+ * stages of a pipeline.
+ *
+ * Example: a producer thread
+ *
+ *     while ((entry = next_entry()) != NULL)
+ *         rbh_mpmc_queue_push(queue, entry, entry_size(entry), true);
+ *
+ *     rbh_mpmc_queue_close(queue); // once every producer is done
+ *
+ * Example: a consumer thread
+ *
+ *     while ((record = rbh_mpmc_queue_acquire(queue, &size, true)) != NULL) {
+ *         process(record, size);
+ *         rbh_mpmc_queue_release(queue, record);
+ *     }
+ *     assert(errno == ENODATA);
+ *
+ * Records are handed to consumers in the order they were reserved. Records are
+ * reserved and claimed with atomic operations on a per-chunk basis, threads
+ * only enter the kernel (futex(2)) to wait for a queue to be (or stop being)
+ * full or empty.
+ */
+
+#include <stdbool.h>
+#include <stddef.h>
+
+struct rbh_mpmc_queue;
+
+/**
+ * Create a bounded multi-producer, multi-consumer queue
+ *
+ * @param record_size   the maximum size of a record
+ * @param capacity      the number of bytes the queue should be able to hold,
+ *                      it is rounded up to a whole number of chunks (there are
+ *                      always at least two)
+ *
+ * @return              a pointer to a newly allocated queue on success, NULL on
+ *                      error and errno is set appropriately
+ *
+ * @error EINVAL        \p record_size is greater than 1GiB
+ * @error ENOMEM        there was not enough memory available
+ */
+struct rbh_mpmc_queue *
+rbh_mpmc_queue_new(size_t record_size, size_t capacity);
+
+/**
+ * Reserve space for a record in a queue
+ *
+ * @param queue     the queue to reserve a record in
+ * @param size      the size of the record
+ * @param block     whether to wait for space to be available if \p queue is
+ *                  full
+ *
+ * @return          the address of \p size contiguous writable bytes in \p queue
+ *                  on success, NULL on error and errno is set appropriately
+ *
+ * @error EINVAL    \p size is greater than the record size of \p queue
+ * @error EAGAIN    \p block is false and \p queue is full
+ * @error EPIPE     \p queue was closed
+ *
+ * The record must be committed with rbh_mpmc_queue_commit() once it is filled.
+ * Records reserved after it will only be handed to consumers once it is
+ * committed, this should happen quickly.
+ */
+void *
+rbh_mpmc_queue_reserve(struct rbh_mpmc_queue *queue, size_t size, bool block);
+
+/**
+ * Make a reserved record available to consumers
+ *
+ * @param queue     the queue \p record was reserved in
+ * @param record    a record returned by rbh_mpmc_queue_reserve()
+ */
+void
+rbh_mpmc_queue_commit(struct rbh_mpmc_queue *queue, void *record);
+
+/**
+ * Push a record into a queue
+ *
+ * @param queue     the queue to push a record into
+ * @param data      a pointer to the data to push into \p queue
+ * @param size      the size of the data to push into \p queue
+ * @param block     whether to wait for space to be available if \p queue is
+ *                  full
+ *
+ * @return          0 on success, -1 on error and errno is set appropriately
+ *
+ * This is a shorthand for rbh_mpmc_queue_reserve(), memcpy(3) and
+ * rbh_mpmc_queue_commit(), refer to rbh_mpmc_queue_reserve() for the errors
+ * this function may fail with.
+ */
+int
+rbh_mpmc_queue_push(struct rbh_mpmc_queue *queue, const void *data,
+                    size_t size, bool block);
+
+/**
+ * Claim the oldest record in a queue
+ *
+ * @param queue     the queue to claim a record from
+ * @param size      set to the size of the record on success
+ * @param block     whether to wait for a record to be available if \p queue
+ *                  is empty
+ *
+ * @return          the address of the record on success, NULL on error and
+ *                  errno is set appropriately
+ *
+ * @error EAGAIN    \p block is false and \p queue is empty
+ * @error ENODATA   \p queue was closed and every record was claimed
+ *
+ * The record remains valid until it is released with
+ * rbh_mpmc_queue_release(). The memory it occupies cannot be reused until
+ * then, so records should not be kept for too long.
+ */
+void *
+rbh_mpmc_queue_acquire(struct rbh_mpmc_queue *queue, size_t *size, bool block);
+
+/**
+ * Release a record claimed with rbh_mpmc_queue_acquire()
+ *
+ * @param queue     the queue \p record was claimed from
+ * @param record    the record to release
+ */
+void
+rbh_mpmc_queue_release(struct rbh_mpmc_queue *queue, void *record);
+
+/**
+ * Close a queue
+ *
+ * @param queue     the queue to close
+ *
+ * Once a queue is closed, records can no longer be pushed into it, and
+ * consumers are notified with ENODATA once they have claimed every record.
+ * Threads that are blocked on \p queue are woken up.
+ *
+ * Records that are being reserved concurrently may or may not be pushed: a
+ * queue should only be closed once every producer is done with it.
+ */
+void
+rbh_mpmc_queue_close(struct rbh_mpmc_queue *queue);
+
+/**
+ * Free resources associated with a queue
+ *
+ * @param queue     the queue to destroy
+ *
+ * No thread may use \p queue concurrently.
+ */
+void
+rbh_mpmc_queue_destroy(struct rbh_mpmc_queue *queue);
+
+#endif
@@ -27,10 +27,48 @@ struct rbh_plugin {
  * @return          the address where \p symbol is loaded into memory on
  *                  success, NULL on error and dlerror() can be used to
  *                  establish a diagnostic.
+ *
+ * Imported symbols are cached process-wide: importing the same symbol again
+ * does not involve the dynamic loader. Symbols registered with
+ * rbh_plugin_register() (such as the ones of plugins linked into the library,
+ * cf. the `static_plugins' build option) are imported from the cache.
  */
 void *
 rbh_plugin_import(const char *name, const char *symbol);
 
+/**
+ * Import a plugin ahead of time
+ *
+ * @param name      the name of the plugin
+ * @param symbol    the name of the symbol to import from the plugin
+ *
+ * @return          0 on success, -1 on error and dlerror() can be used to
+ *                  establish a diagnostic.
+ *
+ * This is meant to be called at startup, so that later calls to
+ * rbh_plugin_import() neither block on, nor fail in the dynamic loader.
+ */
+int
+rbh_plugin_preload(const char *name, const char *symbol);
+
+/**
+ * Make a symbol importable without loading any dynamic library
+ *
+ * @param name      the name of the plugin that \p symbol belongs to
+ * @param symbol    the name of the symbol
+ * @param address   the address of the symbol
+ *
+ * @return          0 on success, -1 on error and errno is set appropriately
+ *
+ * @error EEXIST    \p symbol was already imported or registered for \p name
+ * @error ENOMEM    there was not enough memory available
+ *
+ * This is how plugins linked into an executable (or into the library) make
+ * themselves available to rbh_plugin_import().
+ */
+int
+rbh_plugin_register(const char *name, const char *symbol, void *address);
+
 /*----------------------------------------------------------------------------*
  |                          Robinhood Plugin Version                          |
  *----------------------------------------------------------------------------*/
@@ -84,4 +84,21 @@ rbh_backend_plugin_symbol(const char *name);
 const struct rbh_backend_plugin *
 rbh_backend_plugin_import(const char *name);
 
+/**
+ * Import a backend plugin ahead of time
+ *
+ * @param name      the name of the plugin
+ *
+ * @return          0 on success, -1 on error in which case either errno is set
+ *                  appropriately, or dlerror() can be used to establish a
+ *                  diagnostic.
+ *
+ * @error ENOMEM    there was not enough memory available
+ *
+ * Applications that know which backends they will use can call this at
+ * startup, rather than on their first call to rbh_backend_from_uri().
+ */
+int
+rbh_backend_plugin_preload(const char *name);
+
 #endif
@@ -128,6 +128,8 @@
 
 #include <stddef.h>
 
+#include "robinhood/memory.h"
+
 struct rbh_queue;
 
 /**
@@ -204,6 +206,15 @@ rbh_queue_pop(struct rbh_queue *queue, size_t count);
 void
 rbh_queue_shrink(struct rbh_queue *queue);
 
+/**
+ * Get the memory footprint of a queue
+ *
+ * @param queue     the queue to get the memory footprint of
+ * @param usage     filled with the memory footprint of \p queue on return
+ */
+void
+rbh_queue_usage(struct rbh_queue *queue, struct rbh_memory_usage *usage);
+
 /**
  * Free resources associated with a queue
  *
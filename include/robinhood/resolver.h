@@ -0,0 +1,117 @@
+/* This file is part of the RobinHood Library
+ * Copyright (C) 2022 Commissariat a l'energie atomique et aux energies
+ *                    alternatives
+ *
+ * SPDX-License-Identifer: LGPL-3.0-or-later
+ */
+
+#ifndef ROBINHOOD_RESOLVER_H
+#define ROBINHOOD_RESOLVER_H
+
+#include <stddef.h>
+#include <sys/types.h>
+
+#include "robinhood/backend.h"
+#include "robinhood/id.h"
+
+/** @file
+ * Batched conversion of IDs into paths
+ *
+ * Reports and policy actions usually start from IDs, but end up needing paths.
+ * A struct rbh_resolver converts batches of IDs into paths, and remembers the
+ * paths it already resolved.
+ *
+ * There are two kinds of resolvers:
+ *   - the ones created with rbh_resolver_new() open file handles under a
+ *     mountpoint and ask the kernel for the path of the resulting file
+ *     descriptors, using several threads;
+ *   - the ones created with rbh_resolver_from_backend() look up the parent and
+ *     name of each entry in a backend, and walk up the namespace until they
+ *     reach the root (or a directory whose path they know).
+ *
+ * Paths are relative to the root of the filesystem, and start with a '/'
+ * (the path of the root itself is "/").
+ */
+
+struct rbh_resolver;
+
+/**
+ * Create a resolver that opens file handles under a mountpoint
+ *
+ * @param root      the path of the mountpoint (or of any directory of the
+ *                  filesystem, paths will be relative to it)
+ * @param threads   the number of threads to resolve IDs with (0 means as many
+ *                  as there are online CPUs)
+ * @param capacity  the number of paths to remember (0 means none)
+ *
+ * @return          a pointer to a newly allocated struct rbh_resolver on
+ *                  success, NULL on error and errno is set appropriately
+ *
+ * @error ENOMEM    there was not enough memory available
+ *
+ * This function may also fail and set errno for any of the errors specified for
+ * the routines realpath(3) and open(2).
+ *
+ * \p root is opened once and for all, rather than once per ID.
+ */
+struct rbh_resolver *
+rbh_resolver_new(const char *root, size_t threads, size_t capacity);
+
+/**
+ * Create a resolver that walks the namespace of a backend
+ *
+ * @param backend   the backend to look up entries in
+ * @param capacity  the number of paths to remember (0 means none)
+ *
+ * @return          a pointer to a newly allocated struct rbh_resolver on
+ *                  success, NULL on error and errno is set appropriately
+ *
+ * @error ENOMEM    there was not enough memory available
+ *
+ * \p backend must remain valid for as long as the resolver is in use.
+ *
+ * The paths of every directory the resolver walks through are remembered, so
+ * that resolving the IDs of siblings (or cousins) only requires looking up
+ * their own parent and name.
+ */
+struct rbh_resolver *
+rbh_resolver_from_backend(struct rbh_backend *backend, size_t capacity);
+
+/**
+ * Convert a batch of IDs into paths
+ *
+ * @param resolver  the resolver to use
+ * @param ids       an array of \p count IDs to resolve
+ * @param count     the number of IDs in \p ids
+ * @param paths     an array of \p count pointers, filled with the path of each
+ *                  ID in \p ids, on success
+ *
+ * @return          the number of IDs that were resolved on success, -1 on error
+ *                  and errno is set appropriately
+ *
+ * @error ENOMEM    there was not enough memory available
+ *
+ * IDs that cannot be resolved (because they do not exist anymore, they are not
+ * linked in the namespace, ...) get a NULL path. Every other path is a newly
+ * allocated string that the caller is responsible for freeing.
+ *
+ * On error, every element of \p paths is set to NULL.
+ *
+ * Backend resolvers may also fail and set errno for any of the errors
+ * specified for rbh_backend_filter().
+ */
+ssize_t
+rbh_resolver_resolve(struct rbh_resolver *resolver, const struct rbh_id *ids,
+                     size_t count, char **paths);
+
+/**
+ * Free resources associated with a struct rbh_resolver
+ *
+ * @param resolver  the resolver to destroy
+ *
+ * Backend resolvers do not destroy the backend they were created with.
+ */
+void
+rbh_resolver_destroy(struct rbh_resolver *resolver);
+
+#endif
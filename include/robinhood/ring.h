@@ -118,6 +118,8 @@
 
 #include <stddef.h>
 
+#include "robinhood/memory.h"
+
 struct rbh_ring;
 
 /**
@@ -138,6 +140,35 @@ struct rbh_ring;
 struct rbh_ring *
 rbh_ring_new(size_t size);
 
+/**
+ * Create a ring buffer that grows as needed
+ *
+ * @param size      the initial size of the ring buffer (must be a multiple of
+ *                  the running kernel's page size)
+ * @param max_size  the size the ring buffer may grow up to
+ *
+ * @return          a pointer to a newly allocated ring buffer on success, NULL
+ *                  on error and errno is set appropriately
+ *
+ * @error EINVAL    \p size is not a multiple of the running kernel's page size,
+ *                  or \p max_size is smaller than \p size
+ * @error ENOMEM    there was not enough memory available
+ *
+ * Whenever data does not fit in the ring buffer, its size is doubled (as many
+ * times as necessary, up to \p max_size) rather than failing with ENOBUFS.
+ * The ring grows in place: addresses returned by rbh_ring_push() or
+ * rbh_ring_peek() remain valid and point at the same data afterwards.
+ *
+ * \p max_size is rounded down to \p size times a power of 2. Address space is
+ * reserved for the ring buffer to reach \p max_size, but memory is only
+ * allocated as it grows.
+ *
+ * This function may also fail and set errno for any of the errors specified for
+ * the routine ftruncate(2), mmap(2) or close(2).
+ */
+struct rbh_ring *
+rbh_ring_new_growable(size_t size, size_t max_size);
+
 /**
  * Push data into a ring buffer
  *
@@ -148,8 +179,13 @@ rbh_ring_new(size_t size);
  * @return          the address in \p ring where \p data was pushed on success,
  *                  NULL on error and errno is set appropriately
  *
- * @error ENOBUFS   there is not enough space in \p ring
- * @error EINVAL    \p size is greater than the total space of \p ring
+ * @error ENOBUFS   there is not enough space in \p ring (and it cannot grow
+ *                  enough)
+ * @error EINVAL    \p size is greater than the total space \p ring may ever
+ *                  have
+ *
+ * If \p ring is growable, this function may also fail and set errno for any of
+ * the errors specified for the routine ftruncate(2) or mmap(2).
  *
  * \p data may be NULL, in which case nothing is copied into \p ring. \p size
  * bytes are still reserved in \p ring. They can be written to using the
@@ -184,6 +220,15 @@ rbh_ring_peek(struct rbh_ring *ring, size_t *readable);
 int
 rbh_ring_pop(struct rbh_ring *ring, size_t count);
 
+/**
+ * Get the memory footprint of a ring
+ *
+ * @param ring      the ring to get the memory footprint of
+ * @param usage     filled with the memory footprint of \p ring on return
+ */
+void
+rbh_ring_usage(struct rbh_ring *ring, struct rbh_memory_usage *usage);
+
 /**
  * Free resources associated with a ring buffer
  *
@@ -192,4 +237,144 @@ rbh_ring_pop(struct rbh_ring *ring, size_t count);
 void
 rbh_ring_destroy(struct rbh_ring *ring);
 
+/*----------------------------------------------------------------------------*
+ |                                rbh_spsc_ring                               |
+ *----------------------------------------------------------------------------*/
+
+/**
+ * Single-producer, single-consumer ring buffer
+ *
+ * A struct rbh_spsc_ring works like a struct rbh_ring, except that one thread
+ * (the producer) may push data into it while another one (the consumer)
+ * concurrently peeks at and pops data from it, without any locking.
+ *
+ * The producer should only call rbh_spsc_ring_reserve(),
+ * rbh_spsc_ring_commit() and rbh_spsc_ring_push(). The consumer should only
+ * call rbh_spsc_ring_peek() and rbh_spsc_ring_pop().
+ *
+ * Data that is pushed becomes visible to the consumer once it is committed,
+ * and space that is popped becomes available to the producer once the
+ * consumer is done with it. As with struct rbh_ring, pushed data is always
+ * stored contiguously and the whole readable part of the ring can always be
+ * read in one pass.
+ *
+ * Neither side ever blocks: pushing into a full ring or popping from an empty
+ * one fails immediately, it is up to the caller to decide how to wait.
+ */
+struct rbh_spsc_ring;
+
+/**
+ * Create a single-producer, single-consumer ring buffer
+ *
+ * @param size      the size of the ring buffer (must be a multiple of the
+ *                  running kernel's page size)
+ *
+ * @return          a pointer to a newly allocated ring buffer on success, NULL
+ *                  on error and errno is set appropriately
+ *
+ * @error EINVAL    \p size is not a multiple of the running kernel's page size
+ * @error ENOMEM    there was not enough memory available
+ *
+ * This function may also fail and set errno for any of the errors specified for
+ * the routine ftruncate(2), mmap(2) or close(2).
+ */
+struct rbh_spsc_ring *
+rbh_spsc_ring_new(size_t size);
+
+/**
+ * Reserve space in a single-producer, single-consumer ring buffer
+ *
+ * @param ring      the ring buffer to reserve space in
+ * @param size      the number of bytes to reserve
+ *
+ * @return          the address of \p size contiguous writable bytes in \p ring
+ *                  on success, NULL on error and errno is set appropriately
+ *
+ * @error ENOBUFS   there is not enough space in \p ring
+ * @error EINVAL    \p size is greater than the total space of \p ring
+ *
+ * The reserved bytes are not visible to the consumer until they are
+ * committed with rbh_spsc_ring_commit(). Reserving space again before
+ * committing returns the same address.
+ */
+void *
+rbh_spsc_ring_reserve(struct rbh_spsc_ring *ring, size_t size);
+
+/**
+ * Make data written in reserved space visible to the consumer
+ *
+ * @param ring      the ring buffer to commit data to
+ * @param size      the number of bytes to commit
+ *
+ * @return          0 on success, -1 on error and errno is set appropriately
+ *
+ * @error EINVAL    \p size is greater than the available space in \p ring
+ */
+int
+rbh_spsc_ring_commit(struct rbh_spsc_ring *ring, size_t size);
+
+/**
+ * Push data into a single-producer, single-consumer ring buffer
+ *
+ * @param ring      the ring buffer to push data into
+ * @param data      a pointer to the data to push into \p ring
+ * @param size      the size of the data to push into \p ring
+ *
+ * @return          the address in \p ring where \p data was pushed on success,
+ *                  NULL on error and errno is set appropriately
+ *
+ * @error ENOBUFS   there is not enough space in \p ring
+ * @error EINVAL    \p size is greater than the total space of \p ring
+ *
+ * This is a shorthand for rbh_spsc_ring_reserve(), memcpy(3) and
+ * rbh_spsc_ring_commit(). The returned address must not be written to: the
+ * consumer may already be reading from it.
+ */
+void *
+rbh_spsc_ring_push(struct rbh_spsc_ring *ring, const void *data, size_t size);
+
+/**
+ * Peek at data in a single-producer, single-consumer ring buffer
+ *
+ * @param ring      the ring buffer to peek at
+ * @param count     the number of bytes the caller needs to read
+ * @param readable  set to the number of readable bytes in \p ring on return
+ *
+ * @return          the address of the first readable byte in \p ring
+ *
+ * The progress of the producer is only checked when fewer than \p count bytes
+ * (or no byte at all) are known to be readable, \p readable may thus be lower
+ * than what the producer has committed so far. More data may become readable
+ * as soon as this function returns.
+ */
+void *
+rbh_spsc_ring_peek(struct rbh_spsc_ring *ring, size_t count, size_t *readable);
+
+/**
+ * Pop data from a single-producer, single-consumer ring buffer
+ *
+ * @param ring      the ring buffer to pop data from
+ * @param count     the number of bytes to pop from \p ring
+ *
+ * @return          0 on success, -1 on error and errno is set appropriately
+ *
+ * @error EINVAL    \p count is greater than the number of readable bytes in
+ *                  \p ring
+ *
+ * Popped bytes must not be accessed afterwards: the producer may already be
+ * writing over them.
+ */
+int
+rbh_spsc_ring_pop(struct rbh_spsc_ring *ring, size_t count);
+
+/**
+ * Free resources associated with a single-producer, single-consumer ring buffer
+ *
+ * @param ring  the ring to destroy
+ *
+ * Neither the producer nor the consumer may use \p ring concurrently.
+ */
+void
+rbh_spsc_ring_destroy(struct rbh_spsc_ring *ring);
+
 #endif
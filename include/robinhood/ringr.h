@@ -92,6 +92,25 @@ struct rbh_ringr;
 struct rbh_ringr *
 rbh_ringr_new(size_t size);
 
+/**
+ * Create a ring buffer with multiple readers that grows as needed
+ *
+ * @param size      the initial size of the ring buffer associated to the ringr
+ * @param max_size  the size the ring buffer may grow up to
+ *
+ * @return          a pointer to a newly allocated ringr on success,
+ *                  NULL on error and errno is set appropriately
+ *
+ * @error ENOMEM    there was not enough memory available
+ *
+ * Readers keep pointing at the same data when the ring buffer grows.
+ *
+ * This function may also fail and set errno for any of the errors specified
+ * for the rbh_ring_new_growable() call.
+ */
+struct rbh_ringr *
+rbh_ringr_new_growable(size_t size, size_t max_size);
+
 /**
  * Create a new reader for a ringr
  *
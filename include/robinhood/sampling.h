@@ -0,0 +1,257 @@
+/* This file is part of the RobinHood Library
+ * Copyright (C) 2022 Commissariat a l'energie atomique et aux energies
+ *                    alternatives
+ *
+ * SPDX-License-Identifer: LGPL-3.0-or-later
+ */
+
+#ifndef ROBINHOOD_SAMPLING_H
+#define ROBINHOOD_SAMPLING_H
+
+#include <stddef.h>
+
+#include "robinhood/iterator.h"
+
+/** @file
+ * Sampling of iterators, and estimators to extrapolate from samples
+ *
+ * Two sampling schemes are supported:
+ *  - Bernoulli sampling, where each element is kept independently with a
+ *    fixed probability. It streams, and it can stop early, but the size of
+ *    the sample is random;
+ *  - reservoir sampling, which selects a fixed number of elements uniformly.
+ *    It has to consume its whole input before yielding anything.
+ *
+ * Estimators return a point estimate and a confidence interval. Intervals
+ * rely on the normal approximation (except for quantiles), they are only
+ * meaningful for samples of reasonable size (a few dozens at least).
+ */
+
+/*----------------------------------------------------------------------------*
+ |                                  sampling                                  |
+ *----------------------------------------------------------------------------*/
+
+/**
+ * Keep each element of an iterator with a fixed probability
+ *
+ * @param iterator  the iterator to sample
+ * @param rate      the probability for each element to be kept, in ]0, 1]
+ *
+ * @return          a pointer to a newly allocated struct rbh_iterator on
+ *                  success, NULL on error and errno is set appropriately
+ *
+ * @error EINVAL    \p rate is not in ]0, 1]
+ * @error ENOMEM    there was not enough memory available
+ *
+ * The number of elements to skip is drawn once per kept element (from a
+ * geometric distribution), rather than once per element.
+ *
+ * \p iterator should not be used anymore after a successful call to this
+ * function.
+ */
+struct rbh_iterator *
+rbh_iter_bernoulli(struct rbh_iterator *iterator, double rate);
+
+/**
+ * Keep each element of a mutable iterator with a fixed probability
+ *
+ * @param iterator  the mutable iterator to sample
+ * @param rate      the probability for each element to be kept, in ]0, 1]
+ *
+ * @return          a pointer to a newly allocated struct rbh_mut_iterator on
+ *                  success, NULL on error and errno is set appropriately
+ *
+ * @error EINVAL    \p rate is not in ]0, 1]
+ * @error ENOMEM    there was not enough memory available
+ *
+ * Elements that are not kept are freed with free().
+ *
+ * Refer to rbh_iter_bernoulli() for more information.
+ */
+struct rbh_mut_iterator *
+rbh_mut_iter_bernoulli(struct rbh_mut_iterator *iterator, double rate);
+
+/**
+ * Select a fixed number of elements of a mutable iterator uniformly
+ *
+ * @param iterator      the mutable iterator to sample
+ * @param size          the number of elements to select
+ * @param population    where to store the number of elements \p iterator
+ *                      yielded (may be NULL)
+ *
+ * @return              a pointer to a newly allocated struct rbh_mut_iterator
+ *                      on success, NULL on error and errno is set
+ *                      appropriately
+ *
+ * @error EINVAL        \p size is 0
+ * @error ENOMEM        there was not enough memory available
+ *
+ * The first call to the returned iterator's `next' method consumes \p iterator
+ * entirely (using Li's "Algorithm L", which only draws O(size * log(n / size))
+ * random numbers), and sets \p population. If \p iterator yields less than
+ * \p size elements, they are all selected.
+ *
+ * Elements that are not selected are freed with free().
+ *
+ * \p iterator should not be used anymore after a successful call to this
+ * function.
+ */
+struct rbh_mut_iterator *
+rbh_mut_iter_reservoir(struct rbh_mut_iterator *iterator, size_t size,
+                       size_t *population);
+
+/*----------------------------------------------------------------------------*
+ |                                 estimators                                 |
+ *----------------------------------------------------------------------------*/
+
+struct rbh_estimate {
+    /** Point estimate */
+    double value;
+    /** Lower bound of the confidence interval */
+    double lower;
+    /** Upper bound of the confidence interval */
+    double upper;
+};
+
+/**
+ * Running statistics of a sample
+ *
+ * Must be zero-initialized before use.
+ */
+struct rbh_sample_stats {
+    /** Number of values in the sample */
+    size_t count;
+    /** Mean of the sample */
+    double mean;
+    /** Sum of the squared differences to the mean */
+    double m2;
+};
+
+/**
+ * Add a value to a sample
+ *
+ * @param stats the statistics of the sample
+ * @param value the value to add
+ */
+void
+rbh_sample_stats_add(struct rbh_sample_stats *stats, double value);
+
+/**
+ * Estimate the mean of a population
+ *
+ * @param stats         the statistics of a uniform sample of the population
+ * @param population    the size of the population (0 if unknown or infinite)
+ * @param confidence    the confidence level of the interval, in ]0, 1[
+ * @param estimate      where to store the estimate
+ *
+ * @return              0 on success, -1 on error and errno is set appropriately
+ *
+ * @error EINVAL        \p confidence is not in ]0, 1[
+ * @error ENODATA       \p stats contains less than 2 values
+ *
+ * When \p population is known, the finite population correction is applied.
+ */
+int
+rbh_estimate_mean(const struct rbh_sample_stats *stats, size_t population,
+                  double confidence, struct rbh_estimate *estimate);
+
+/**
+ * Estimate the total of a population from a fixed size sample
+ *
+ * @param stats         the statistics of a uniform sample of the population
+ *                      (eg. one produced by rbh_mut_iter_reservoir())
+ * @param population    the size of the population
+ * @param confidence    the confidence level of the interval, in ]0, 1[
+ * @param estimate      where to store the estimate
+ *
+ * @return              0 on success, -1 on error and errno is set appropriately
+ *
+ * @error EINVAL        \p confidence is not in ]0, 1[, or \p population is 0
+ * @error ENODATA       \p stats contains less than 2 values
+ */
+int
+rbh_estimate_total(const struct rbh_sample_stats *stats, size_t population,
+                   double confidence, struct rbh_estimate *estimate);
+
+/**
+ * Estimate the total of a population from a Bernoulli sample
+ *
+ * @param stats         the statistics of a Bernoulli sample of the population
+ * @param rate          the sampling rate, in ]0, 1]
+ * @param confidence    the confidence level of the interval, in ]0, 1[
+ * @param estimate      where to store the estimate
+ *
+ * @return              0 on success, -1 on error and errno is set appropriately
+ *
+ * @error EINVAL        \p rate is not in ]0, 1], or \p confidence is not in
+ *                      ]0, 1[
+ *
+ * This is the Horvitz-Thompson estimator. An empty sample is valid, it yields
+ * an estimate of 0.
+ */
+int
+rbh_estimate_bernoulli_total(const struct rbh_sample_stats *stats, double rate,
+                             double confidence, struct rbh_estimate *estimate);
+
+/**
+ * Estimate the size of a population from a Bernoulli sample
+ *
+ * @param count         the number of elements in the sample
+ * @param rate          the sampling rate, in ]0, 1]
+ * @param confidence    the confidence level of the interval, in ]0, 1[
+ * @param estimate      where to store the estimate
+ *
+ * @return              0 on success, -1 on error and errno is set appropriately
+ *
+ * @error EINVAL        \p rate is not in ]0, 1], or \p confidence is not in
+ *                      ]0, 1[
+ */
+int
+rbh_estimate_bernoulli_count(size_t count, double rate, double confidence,
+                             struct rbh_estimate *estimate);
+
+/**
+ * Estimate the proportion of a population that matches a criterion
+ *
+ * @param matches       the number of elements of the sample that match
+ * @param count         the number of elements in the sample
+ * @param confidence    the confidence level of the interval, in ]0, 1[
+ * @param estimate      where to store the estimate
+ *
+ * @return              0 on success, -1 on error and errno is set appropriately
+ *
+ * @error EINVAL        \p confidence is not in ]0, 1[, or \p matches is greater
+ *                      than \p count
+ * @error ENODATA       \p count is 0
+ *
+ * The interval is Wilson's score interval, which behaves well even for
+ * proportions close to 0 or 1.
+ */
+int
+rbh_estimate_proportion(size_t matches, size_t count, double confidence,
+                        struct rbh_estimate *estimate);
+
+/**
+ * Estimate a quantile of a population
+ *
+ * @param values        the values of a uniform sample of the population
+ * @param count         the number of elements in \p values
+ * @param quantile      the quantile to estimate, in [0, 1]
+ * @param confidence    the confidence level of the interval, in ]0, 1[
+ * @param estimate      where to store the estimate
+ *
+ * @return              0 on success, -1 on error and errno is set appropriately
+ *
+ * @error EINVAL        \p quantile is not in [0, 1], or \p confidence is not in
+ *                      ]0, 1[
+ * @error ENODATA       \p count is 0
+ *
+ * \p values is sorted in place. The bounds of the interval are order
+ * statistics of the sample: they do not depend on the distribution of the
+ * population.
+ */
+int
+rbh_estimate_quantile(double *values, size_t count, double quantile,
+                      double confidence, struct rbh_estimate *estimate);
+
+#endif
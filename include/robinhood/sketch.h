@@ -0,0 +1,317 @@
+/* This file is part of the RobinHood Library
+ * Copyright (C) 2022 Commissariat a l'energie atomique et aux energies
+ *                    alternatives
+ *
+ * SPDX-License-Identifer: LGPL-3.0-or-later
+ */
+
+#ifndef ROBINHOOD_SKETCH_H
+#define ROBINHOOD_SKETCH_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "robinhood/filter.h"
+#include "robinhood/fsentry.h"
+#include "robinhood/iterator.h"
+#include "robinhood/value.h"
+
+/** @file
+ * Streaming aggregators
+ *
+ * Sketches summarize a stream of values in a small, bounded, amount of memory
+ * and answer approximate queries about it:
+ *  - HyperLogLog sketches count distinct values;
+ *  - KLL sketches estimate quantiles (and ranks) of numeric values;
+ *  - count-min sketches estimate the frequency of values, and can keep track
+ *    of the most frequent ones (heavy hitters).
+ *
+ * Values are extracted from fsentries with rbh_fsentry_get_field(), using the
+ * field the sketch was created with.
+ *
+ * Sketches are not thread-safe. To aggregate a stream in parallel, use one
+ * sketch per thread (or process) and merge them with rbh_sketch_merge(). Use
+ * rbh_sketch_serialize() and rbh_sketch_deserialize() to exchange sketches
+ * between processes, or to store them.
+ */
+
+enum rbh_sketch_type {
+    RBH_SKT_HYPERLOGLOG,
+    RBH_SKT_KLL,
+    RBH_SKT_COUNT_MIN,
+};
+
+struct rbh_sketch_options {
+    enum rbh_sketch_type type;
+    union {
+        /* RBH_SKT_HYPERLOGLOG */
+        struct {
+            /** log2 of the number of registers, in [4, 18] (0 means 14)
+             *
+             * The relative standard error of the estimates is about
+             * 1.04 / sqrt(2^precision), and the sketch uses 2^precision bytes.
+             */
+            unsigned int precision;
+        } hyperloglog;
+
+        /* RBH_SKT_KLL */
+        struct {
+            /** Accuracy parameter, in [8, 65535] (0 means 200)
+             *
+             * The rank error is about 1.65 / k, and the sketch uses about
+             * 3 * k values.
+             */
+            unsigned int k;
+        } kll;
+
+        /* RBH_SKT_COUNT_MIN */
+        struct {
+            /** Frequencies are overestimated by at most epsilon times the
+             * number of values in the sketch, in ]0, 1[
+             */
+            double epsilon;
+            /** ... with a probability of 1 - delta, in ]0, 1[ */
+            double delta;
+            /** The number of most frequent values to keep track of */
+            size_t heavy_hitters;
+        } count_min;
+    };
+};
+
+struct rbh_sketch;
+
+/**
+ * Create a sketch
+ *
+ * @param field     the field to extract values from, NULL means RBH_FP_ID
+ * @param options   the type of sketch to create, and its parameters
+ *
+ * @return          a pointer to a newly allocated struct rbh_sketch on success,
+ *                  NULL on error and errno is set appropriately
+ *
+ * @error EINVAL    \p options is invalid
+ * @error ENOMEM    there was not enough memory available
+ */
+struct rbh_sketch *
+rbh_sketch_new(const struct rbh_filter_field *field,
+               const struct rbh_sketch_options *options);
+
+/**
+ * Add a value to a sketch
+ *
+ * @param sketch    the sketch to add \p value to
+ * @param value     the value to add
+ *
+ * @return          0 on success, -1 on error and errno is set appropriately
+ *
+ * @error ENOTSUP   \p value is a sequence or a map, or \p sketch is a KLL
+ *                  sketch and \p value is not an integer
+ * @error ENOMEM    there was not enough memory available
+ */
+int
+rbh_sketch_add_value(struct rbh_sketch *sketch, const struct rbh_value *value);
+
+/**
+ * Add the value of an fsentry's field to a sketch
+ *
+ * @param sketch    the sketch to add \p fsentry to
+ * @param fsentry   the fsentry whose field to add
+ *
+ * @return          0 on success, -1 on error and errno is set appropriately
+ *
+ * @error EINVAL    the field \p sketch was created with is invalid
+ *
+ * fsentries that do not have the field \p sketch was created with set are
+ * ignored.
+ *
+ * Refer to rbh_sketch_add_value() for the other errors this function may fail
+ * with.
+ */
+int
+rbh_sketch_add(struct rbh_sketch *sketch, const struct rbh_fsentry *fsentry);
+
+/**
+ * Add every fsentry of an iterator to a sketch
+ *
+ * @param sketch    the sketch to add fsentries to
+ * @param fsentries an iterator of fsentries
+ *
+ * @return          0 once \p fsentries is exhausted, -1 on error and errno is
+ *                  set appropriately
+ *
+ * This function may fail and set errno to any error number specified for
+ * rbh_sketch_add(), or reported by \p fsentries.
+ *
+ * \p fsentries is not destroyed.
+ */
+int
+rbh_sketch_feed(struct rbh_sketch *sketch, struct rbh_iterator *fsentries);
+
+/**
+ * Merge a sketch into another
+ *
+ * @param dest      the sketch to merge \p src into
+ * @param src       the sketch to merge into \p dest
+ *
+ * @return          0 on success, -1 on error and errno is set appropriately
+ *
+ * @error EINVAL    \p dest and \p src are not of the same type, or they were
+ *                  created with different parameters
+ * @error ENOMEM    there was not enough memory available
+ *
+ * The fields \p dest and \p src were created with are not compared.
+ */
+int
+rbh_sketch_merge(struct rbh_sketch *dest, const struct rbh_sketch *src);
+
+/**
+ * Get the number of values that were added to a sketch
+ *
+ * @param sketch    the sketch to query
+ *
+ * @return          the number of values that were added to \p sketch (or to
+ *                  any sketch that was merged into it)
+ */
+uint64_t
+rbh_sketch_count(const struct rbh_sketch *sketch);
+
+/**
+ * Estimate the number of distinct values in a HyperLogLog sketch
+ *
+ * @param sketch        the sketch to query
+ * @param cardinality   where to store the estimate
+ *
+ * @return              0 on success, -1 on error and errno is set
+ *                      appropriately
+ *
+ * @error EINVAL        \p sketch is not a HyperLogLog sketch
+ */
+int
+rbh_sketch_cardinality(const struct rbh_sketch *sketch, double *cardinality);
+
+/**
+ * Estimate a quantile of the values in a KLL sketch
+ *
+ * @param sketch    the sketch to query
+ * @param quantile  the quantile to estimate, in [0, 1]
+ * @param value     where to store the estimate
+ *
+ * @return          0 on success, -1 on error and errno is set appropriately
+ *
+ * @error EINVAL    \p sketch is not a KLL sketch, or \p quantile is not in
+ *                  [0, 1]
+ * @error ENODATA   \p sketch is empty
+ * @error ENOMEM    there was not enough memory available
+ *
+ * The 0 and 1 quantiles are exact.
+ */
+int
+rbh_sketch_quantile(const struct rbh_sketch *sketch, double quantile,
+                    double *value);
+
+/**
+ * Estimate the proportion of values lower or equal to a value in a KLL sketch
+ *
+ * @param sketch    the sketch to query
+ * @param value     the value whose rank to estimate
+ * @param rank      where to store the estimate
+ *
+ * @return          0 on success, -1 on error and errno is set appropriately
+ *
+ * @error EINVAL    \p sketch is not a KLL sketch
+ * @error ENODATA   \p sketch is empty
+ */
+int
+rbh_sketch_rank(const struct rbh_sketch *sketch, double value, double *rank);
+
+/**
+ * Estimate how many times a value was added to a count-min sketch
+ *
+ * @param sketch    the sketch to query
+ * @param value     the value whose frequency to estimate
+ * @param frequency where to store the estimate
+ *
+ * @return          0 on success, -1 on error and errno is set appropriately
+ *
+ * @error EINVAL    \p sketch is not a count-min sketch
+ * @error ENOTSUP   \p value is a sequence or a map
+ *
+ * The estimate is never lower than the actual frequency.
+ */
+int
+rbh_sketch_frequency(const struct rbh_sketch *sketch,
+                     const struct rbh_value *value, uint64_t *frequency);
+
+struct rbh_sketch_item {
+    struct rbh_value value;
+    uint64_t frequency;
+};
+
+/**
+ * Get the most frequent values of a count-min sketch
+ *
+ * @param sketch    the sketch to query
+ * @param items     an array of at least \p count items
+ * @param count     a pointer to the number of elements in \p items, on success
+ *                  it is set to the number of items that were filled
+ *
+ * @return          0 on success, -1 on error and errno is set appropriately
+ *
+ * @error EINVAL    \p sketch is not a count-min sketch
+ * @error EOVERFLOW \p items is too small, \p count is set to the minimum number
+ *                  of items required
+ *
+ * Items are sorted by decreasing frequency. Their values point at memory owned
+ * by \p sketch, which is only valid until \p sketch is modified or destroyed.
+ *
+ * Heavy hitters are tracked as values are added, a value that is added mostly
+ * early in the stream may be missed.
+ */
+int
+rbh_sketch_heavy_hitters(const struct rbh_sketch *sketch,
+                         struct rbh_sketch_item *items, size_t *count);
+
+/**
+ * Serialize a sketch
+ *
+ * @param sketch    the sketch to serialize
+ * @param data      a buffer of at least \p size bytes
+ * @param size      a pointer to the size of \p data, on success it is set to
+ *                  the number of bytes that were written to \p data
+ *
+ * @return          0 on success, -1 on error and errno is set appropriately
+ *
+ * @error EOVERFLOW \p data is too small, \p size is set to the minimum number
+ *                  of bytes required
+ *
+ * The serialized form of a sketch does not depend on the host it was produced
+ * on.
+ */
+int
+rbh_sketch_serialize(const struct rbh_sketch *sketch, void *data,
+                     size_t *size);
+
+/**
+ * Deserialize a sketch
+ *
+ * @param data      the serialized sketch
+ * @param size      the size of \p data
+ *
+ * @return          a pointer to a newly allocated struct rbh_sketch on success,
+ *                  NULL on error and errno is set appropriately
+ *
+ * @error EINVAL    \p data is not a valid serialized sketch
+ * @error ENOMEM    there was not enough memory available
+ */
+struct rbh_sketch *
+rbh_sketch_deserialize(const void *data, size_t size);
+
+/**
+ * Free a sketch
+ *
+ * @param sketch    the sketch to free
+ */
+void
+rbh_sketch_destroy(struct rbh_sketch *sketch);
+
+#endif
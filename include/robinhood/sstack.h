@@ -119,13 +119,15 @@
 
 #include <stddef.h>
 
+#include "robinhood/memory.h"
+
 struct rbh_sstack;
 
 /**
  * Create a new sstack
  *
- * @param chunk_size    the maximum number of bytes that can be pushed onto the
- *                      sstack at once
+ * @param chunk_size    the size of the chunks of the sstack (larger chunks are
+ *                      allocated for data that does not fit in one)
  *
  * @return              a pointer to a newly allocated sstack on success, NULL
  *                      on error and errno is set appropriately
@@ -145,11 +147,13 @@ rbh_sstack_new(size_t chunk_size);
  * @return          the address where \p data was pushed on success, NULL on
  *                  error and errno is set appropriately
  *
- * @error EINVAL    \p size is greater than \p sstack's chunk size
  * @error ENOMEM    there is not enough memory available
  *
  * \p data is guaranteed to be stored contiguously in \p sstack.
  *
+ * If \p size is greater than \p sstack's chunk size, a chunk of chunk size
+ * times the smallest power of 2 that makes it large enough is allocated.
+ *
  * \p data may be NULL, in which case nothing is copied onto \p sstack. \p size
  * bytes are still reserved in \p sstack. They can be written to using the
  * returned pointer. Reading these bytes before writing them yields undefined
@@ -158,6 +162,27 @@ rbh_sstack_new(size_t chunk_size);
 void *
 rbh_sstack_push(struct rbh_sstack *sstack, const void *data, size_t size);
 
+/**
+ * Allocate aligned space on an sstack
+ *
+ * @param sstack    the sstack to allocate space on
+ * @param size      the number of bytes to allocate
+ * @param alignment the alignment of the allocated bytes (a power of 2)
+ *
+ * @return          the address of \p size contiguous bytes aligned on
+ *                  \p alignment in \p sstack on success, NULL on error and
+ *                  errno is set appropriately
+ *
+ * @error EINVAL    \p alignment is not a power of 2
+ * @error ENOMEM    there is not enough memory available
+ *
+ * This is rbh_sstack_push() with \p data = NULL, and an alignment constraint.
+ * Up to \p alignment - 1 bytes of padding may be pushed along with the
+ * allocated bytes.
+ */
+void *
+rbh_sstack_alloc(struct rbh_sstack *sstack, size_t size, size_t alignment);
+
 /**
  * Peek at data in an sstack
  *
@@ -182,6 +207,43 @@ rbh_sstack_peek(struct rbh_sstack *sstack, size_t *readable);
 int
 rbh_sstack_pop(struct rbh_sstack *sstack, size_t count);
 
+/**
+ * A position in an sstack
+ *
+ * A zero-initialized mark designates the bottom of any sstack.
+ */
+struct rbh_sstack_mark {
+    size_t chunk;
+    size_t used;
+};
+
+/**
+ * Get the current position in an sstack
+ *
+ * @param sstack   the sstack to get the position of
+ *
+ * @return          a mark that rbh_sstack_rewind() can later roll \p sstack
+ *                  back to
+ */
+struct rbh_sstack_mark
+rbh_sstack_mark(struct rbh_sstack *sstack);
+
+/**
+ * Roll an sstack back to a previous position
+ *
+ * @param sstack    the sstack to rewind
+ * @param mark      a mark returned by rbh_sstack_mark() on \p sstack
+ *
+ * Everything pushed onto \p sstack since \p mark was taken is discarded at
+ * once, in constant time. This makes sstacks usable as scratch (arena)
+ * allocators.
+ *
+ * The behaviour is undefined if data below \p mark was popped (or rewound
+ * over) since \p mark was taken.
+ */
+void
+rbh_sstack_rewind(struct rbh_sstack *sstack, struct rbh_sstack_mark mark);
+
 /**
  * Discard unused allocated memory in an sstack
  *
@@ -190,6 +252,15 @@ rbh_sstack_pop(struct rbh_sstack *sstack, size_t count);
 void
 rbh_sstack_shrink(struct rbh_sstack *sstack);
 
+/**
+ * Get the memory footprint of an sstack
+ *
+ * @param sstack    the sstack to get the memory footprint of
+ * @param usage     filled with the memory footprint of \p sstack on return
+ */
+void
+rbh_sstack_usage(struct rbh_sstack *sstack, struct rbh_memory_usage *usage);
+
 /**
  * Free resources associated with an sstack
  *
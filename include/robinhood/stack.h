@@ -95,6 +95,8 @@
 
 #include <stddef.h>
 
+#include "robinhood/memory.h"
+
 struct rbh_stack;
 
 /**
@@ -131,6 +133,28 @@ rbh_stack_new(size_t size);
 void *
 rbh_stack_push(struct rbh_stack *stack, const void *data, size_t size);
 
+/**
+ * Allocate aligned space on a stack
+ *
+ * @param stack     the stack to allocate space on
+ * @param size      the number of bytes to allocate
+ * @param alignment the alignment of the allocated bytes (a power of 2)
+ *
+ * @return          the address of \p size bytes aligned on \p alignment in
+ *                  \p stack on success, NULL on error and errno is set
+ *                  appropriately
+ *
+ * @error ENOBUFS   there is not enough space in \p stack to store \p size
+ *                  bytes aligned on \p alignment
+ * @error EINVAL    \p size is greater than the total space of \p stack, or
+ *                  \p alignment is not a power of 2
+ *
+ * Up to \p alignment - 1 bytes of padding are pushed along with the allocated
+ * bytes, they are part of the readable bytes of \p stack.
+ */
+void *
+rbh_stack_alloc(struct rbh_stack *stack, size_t size, size_t alignment);
+
 /**
  * Peek at a stack
  *
@@ -155,6 +179,15 @@ rbh_stack_peek(struct rbh_stack *stack, size_t *readable);
 int
 rbh_stack_pop(struct rbh_stack *stack, size_t count);
 
+/**
+ * Get the memory footprint of a stack
+ *
+ * @param stack     the stack to get the memory footprint of
+ * @param usage     filled with the memory footprint of \p stack on return
+ */
+void
+rbh_stack_usage(struct rbh_stack *stack, struct rbh_memory_usage *usage);
+
 /**
  * Release resources associated with a stack
  *
@@ -20,6 +20,28 @@
 #include <stddef.h>
 #include <stdint.h>
 
+struct rbh_backend;
+
+/**
+ * Branch a backend at a path
+ *
+ * @param backend   the backend to branch
+ * @param fsname    the name of the filesystem \p backend manages
+ * @param path      the path to branch \p backend at, relative to \p fsname
+ *
+ * @return          a pointer to a newly allocated struct rbh_backend on
+ *                  success, NULL on error and errno is set appropriately
+ *
+ * @error ENODATA   \p backend does not know the ID of \p path
+ *
+ * Any error rbh_backend_fsentry_from_path() or rbh_backend_branch() may fail
+ * with may also be reported. Backends that cannot look paths up are branched
+ * at the ID of \p path in \p fsname.
+ */
+struct rbh_backend *
+backend_branch_from_path(struct rbh_backend *backend, const char *fsname,
+                         const char *path);
+
 #ifndef ARRAY_SIZE
 #define ARRAY_SIZE(array) (sizeof(array) / sizeof(array[0]))
 #endif
@@ -92,4 +92,26 @@ int
 value_map_copy(struct rbh_value_map *dest, const struct rbh_value_map *src,
                char **buffer, size_t *bufsize);
 
+/**
+ * Get the bytes that make up a scalar value
+ *
+ * @param value     the value whose bytes to get
+ * @param data      where to store a pointer to the bytes of \p value
+ * @param size      where to store the number of bytes \p data points at
+ *
+ * @return          0 on success, -1 on error and errno is set appropriately
+ *
+ * @error ENOTSUP   \p value is a sequence or a map
+ * @error EINVAL    \p value's type is invalid
+ *
+ * Strings and regexes do not include their terminating null byte, and regex
+ * options are not taken into account.
+ *
+ * The type byte of \p value followed by \p data make a compact key suitable
+ * for hashing or comparing values.
+ */
+int
+value_scalar_bytes(const struct rbh_value *value, const void **data,
+                   size_t *size);
+
 #endif
@@ -0,0 +1,391 @@
+/* This file is part of the RobinHood Library
+ * Copyright (C) 2022 Commissariat a l'energie atomique et aux energies
+ *                    alternatives
+ *
+ * SPDX-License-Identifer: LGPL-3.0-or-later
+ */
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <sys/eventfd.h>
+
+#include "robinhood/async.h"
+
+enum async_state {
+    AS_IDLE,        /* nothing to yield, no fetch in progress */
+    AS_QUEUED,      /* waiting for a worker */
+    AS_RUNNING,     /* a worker is fetching the next element */
+    AS_READY,       /* the next element (or error) is available */
+};
+
+struct async_iterator {
+    struct rbh_iterator iterator;
+
+    struct rbh_iterator *subiter;
+    /* Whether or not elements belong to the caller (ie. mutable iterator) */
+    bool owned;
+    int fd;
+
+    /* Everything below is protected by the pool's lock */
+    enum async_state state;
+    const void *element;
+    int error;
+    bool exhausted;
+    bool destroyed;
+    struct async_iterator *next;
+};
+
+/*----------------------------------------------------------------------------*
+ |                                    pool                                    |
+ *----------------------------------------------------------------------------*/
+
+static struct {
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    /* FIFO of iterators waiting for a worker */
+    struct async_iterator *head;
+    struct async_iterator **tail;
+
+    size_t worker_count;
+    pthread_t *workers;
+    bool started;
+    bool stopping;
+} pool = {
+    .lock = PTHREAD_MUTEX_INITIALIZER,
+    .cond = PTHREAD_COND_INITIALIZER,
+    .head = NULL,
+    .tail = &pool.head,
+    .worker_count = 4,
+};
+
+int
+rbh_async_set_workers(size_t count)
+{
+    int rc = 0;
+
+    if (count == 0) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    pthread_mutex_lock(&pool.lock);
+    if (pool.started) {
+        errno = EBUSY;
+        rc = -1;
+    } else {
+        pool.worker_count = count;
+    }
+    pthread_mutex_unlock(&pool.lock);
+    return rc;
+}
+
+/* Must be called with the pool's lock held */
+static void
+pool_enqueue(struct async_iterator *async)
+{
+    async->state = AS_QUEUED;
+    async->next = NULL;
+    *pool.tail = async;
+    pool.tail = &async->next;
+    pthread_cond_signal(&pool.cond);
+}
+
+/* Must be called with the pool's lock held */
+static struct async_iterator *
+pool_dequeue(void)
+{
+    struct async_iterator *async = pool.head;
+
+    pool.head = async->next;
+    if (pool.head == NULL)
+        pool.tail = &pool.head;
+    return async;
+}
+
+/* Must be called with the pool's lock held */
+static void
+pool_remove(struct async_iterator *async)
+{
+    struct async_iterator **pnext = &pool.head;
+
+    while (*pnext != async)
+        pnext = &(*pnext)->next;
+
+    *pnext = async->next;
+    if (*pnext == NULL)
+        pool.tail = pnext;
+}
+
+static void
+async_iter_free(struct async_iterator *async)
+{
+    if (async->owned && async->state == AS_READY)
+        free((void *)async->element);
+    rbh_iter_destroy(async->subiter);
+    close(async->fd);
+    free(async);
+}
+
+static void *
+worker(void *arg)
+{
+    pthread_mutex_lock(&pool.lock);
+    while (true) {
+        struct async_iterator *async;
+        const void *element;
+        int error;
+
+        while (pool.head == NULL && !pool.stopping)
+            pthread_cond_wait(&pool.cond, &pool.lock);
+        if (pool.stopping)
+            break;
+
+        async = pool_dequeue();
+        async->state = AS_RUNNING;
+        pthread_mutex_unlock(&pool.lock);
+
+        errno = 0;
+        element = rbh_iter_next(async->subiter);
+        error = element == NULL ? errno : 0;
+
+        pthread_mutex_lock(&pool.lock);
+        async->element = element;
+        async->error = error;
+        async->state = AS_READY;
+
+        if (async->destroyed) {
+            pthread_mutex_unlock(&pool.lock);
+            async_iter_free(async);
+            pthread_mutex_lock(&pool.lock);
+            continue;
+        }
+
+        eventfd_write(async->fd, 1);
+    }
+    pthread_mutex_unlock(&pool.lock);
+    return NULL;
+}
+
+static void
+pool_stop(void) __attribute__((destructor));
+
+static void
+pool_stop(void)
+{
+    pthread_mutex_lock(&pool.lock);
+    if (!pool.started) {
+        pthread_mutex_unlock(&pool.lock);
+        return;
+    }
+    pool.stopping = true;
+    pthread_cond_broadcast(&pool.cond);
+    pthread_mutex_unlock(&pool.lock);
+
+    for (size_t i = 0; i < pool.worker_count; i++)
+        pthread_join(pool.workers[i], NULL);
+    free(pool.workers);
+}
+
+/* Must be called with the pool's lock held */
+static int
+pool_start(void)
+{
+    size_t i;
+    int rc;
+
+    if (pool.started)
+        return 0;
+
+    pool.workers = malloc(sizeof(*pool.workers) * pool.worker_count);
+    if (pool.workers == NULL)
+        return -1;
+
+    for (i = 0; i < pool.worker_count; i++) {
+        rc = pthread_create(&pool.workers[i], NULL, worker, NULL);
+        if (rc)
+            goto out_stop;
+    }
+
+    pool.started = true;
+    return 0;
+
+out_stop:
+    pool.stopping = true;
+    pthread_cond_broadcast(&pool.cond);
+    pthread_mutex_unlock(&pool.lock);
+    while (i-- > 0)
+        pthread_join(pool.workers[i], NULL);
+    pthread_mutex_lock(&pool.lock);
+    pool.stopping = false;
+
+    free(pool.workers);
+    errno = rc;
+    return -1;
+}
+
+/*----------------------------------------------------------------------------*
+ |                              rbh_iter_async()                              |
+ *----------------------------------------------------------------------------*/
+
+static const void *
+async_iter_next(void *iterator)
+{
+    struct async_iterator *async = iterator;
+    const void *element = NULL;
+    eventfd_t value;
+    int error = 0;
+
+    pthread_mutex_lock(&pool.lock);
+    switch (async->state) {
+    case AS_IDLE:
+        if (async->exhausted) {
+            error = ENODATA;
+            break;
+        }
+        pool_enqueue(async);
+        /* Fallthrough */
+    case AS_QUEUED:
+    case AS_RUNNING:
+        error = EAGAIN;
+        break;
+    case AS_READY:
+        eventfd_read(async->fd, &value);
+        element = async->element;
+        error = async->error;
+        async->state = AS_IDLE;
+
+        if (error == ENODATA)
+            async->exhausted = true;
+        else if (error == 0)
+            /* Start fetching the next element right away */
+            pool_enqueue(async);
+        break;
+    }
+    pthread_mutex_unlock(&pool.lock);
+
+    if (error)
+        errno = error;
+    return element;
+}
+
+static void
+async_iter_destroy(void *iterator)
+{
+    struct async_iterator *async = iterator;
+
+    pthread_mutex_lock(&pool.lock);
+    switch (async->state) {
+    case AS_RUNNING:
+        /* The worker will free everything once it is done */
+        async->destroyed = true;
+        pthread_mutex_unlock(&pool.lock);
+        return;
+    case AS_QUEUED:
+        pool_remove(async);
+        async->state = AS_IDLE;
+        break;
+    case AS_IDLE:
+    case AS_READY:
+        break;
+    }
+    pthread_mutex_unlock(&pool.lock);
+
+    async_iter_free(async);
+}
+
+static int
+async_iter_fileno(void *iterator)
+{
+    struct async_iterator *async = iterator;
+
+    return async->fd;
+}
+
+static const struct rbh_iterator_operations ASYNC_ITER_OPS = {
+    .next = async_iter_next,
+    .destroy = async_iter_destroy,
+    .fileno = async_iter_fileno,
+};
+
+static const struct rbh_iterator ASYNC_ITER = {
+    .ops = &ASYNC_ITER_OPS,
+};
+
+static struct async_iterator *
+async_iter_new(struct rbh_iterator *subiter, bool owned)
+{
+    struct async_iterator *async;
+    int save_errno;
+
+    async = malloc(sizeof(*async));
+    if (async == NULL)
+        return NULL;
+
+    async->fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    if (async->fd < 0) {
+        save_errno = errno;
+        free(async);
+        errno = save_errno;
+        return NULL;
+    }
+
+    async->iterator = ASYNC_ITER;
+    async->subiter = subiter;
+    async->owned = owned;
+    async->element = NULL;
+    async->error = 0;
+    async->exhausted = false;
+    async->destroyed = false;
+
+    pthread_mutex_lock(&pool.lock);
+    if (pool_start()) {
+        save_errno = errno;
+        pthread_mutex_unlock(&pool.lock);
+        close(async->fd);
+        free(async);
+        errno = save_errno;
+        return NULL;
+    }
+    /* Start fetching the first element right away */
+    pool_enqueue(async);
+    pthread_mutex_unlock(&pool.lock);
+
+    return async;
+}
+
+struct rbh_iterator *
+rbh_iter_async(struct rbh_iterator *iterator)
+{
+    struct async_iterator *async;
+
+    async = async_iter_new(iterator, false);
+    if (async == NULL)
+        return NULL;
+
+    return &async->iterator;
+}
+
+/*----------------------------------------------------------------------------*
+ |                            rbh_mut_iter_async()                            |
+ *----------------------------------------------------------------------------*/
+
+struct rbh_mut_iterator *
+rbh_mut_iter_async(struct rbh_mut_iterator *iterator)
+{
+    struct async_iterator *async;
+
+    async = async_iter_new((struct rbh_iterator *)iterator, true);
+    if (async == NULL)
+        return NULL;
+
+    return (struct rbh_mut_iterator *)&async->iterator;
+}
@@ -10,6 +10,8 @@
 #endif
 
 #include <assert.h>
+#include <pthread.h>
+#include <stdbool.h>
 #include <stdlib.h>
 #include <string.h>
 
@@ -32,6 +34,9 @@ rbh_generic_backend_get_option(struct rbh_backend *backend, unsigned int option,
         errno = ENOTSUP;
         return -1;
     case RBH_GBO_GC:
+    case RBH_GBO_CACHE_STATS:
+    case RBH_GBO_RESULT_CACHE_STATS:
+    case RBH_GBO_TEE_STATS:
         if (backend->ops->get_option == NULL) {
             errno = ENOTSUP;
             return -1;
@@ -53,6 +58,9 @@ rbh_generic_backend_set_option(struct rbh_backend *backend, unsigned int option,
 {
     switch (option) {
     case RBH_GBO_DEPRECATED:
+    case RBH_GBO_CACHE_STATS:
+    case RBH_GBO_RESULT_CACHE_STATS:
+    case RBH_GBO_TEE_STATS:
         errno = ENOTSUP;
         return -1;
     case RBH_GBO_GC:
@@ -99,6 +107,134 @@ rbh_backend_filter_one(struct rbh_backend *backend,
     return fsentry;
 }
 
+/*----------------------------------------------------------------------------*
+ |                  rbh_generic_backend_filter_partitioned()                  |
+ *----------------------------------------------------------------------------*/
+
+/* Every partition pulls from the same iterator, one fsentry at a time */
+struct shared_fsentries {
+    pthread_mutex_t mutex;
+    struct rbh_mut_iterator *fsentries;
+    size_t refcount;
+};
+
+struct partition_iterator {
+    struct rbh_mut_iterator iterator;
+    struct shared_fsentries *shared;
+};
+
+static void *
+partition_iter_next(void *iterator)
+{
+    struct partition_iterator *partition = iterator;
+    struct shared_fsentries *shared = partition->shared;
+    struct rbh_fsentry *fsentry;
+    int save_errno;
+
+    pthread_mutex_lock(&shared->mutex);
+    fsentry = rbh_mut_iter_next(shared->fsentries);
+    save_errno = errno;
+    pthread_mutex_unlock(&shared->mutex);
+
+    errno = save_errno;
+    return fsentry;
+}
+
+static void
+shared_fsentries_release(struct shared_fsentries *shared)
+{
+    bool last;
+
+    pthread_mutex_lock(&shared->mutex);
+    last = --shared->refcount == 0;
+    pthread_mutex_unlock(&shared->mutex);
+
+    if (!last)
+        return;
+
+    rbh_mut_iter_destroy(shared->fsentries);
+    pthread_mutex_destroy(&shared->mutex);
+    free(shared);
+}
+
+static void
+partition_iter_destroy(void *iterator)
+{
+    struct partition_iterator *partition = iterator;
+
+    shared_fsentries_release(partition->shared);
+    free(partition);
+}
+
+static const struct rbh_mut_iterator_operations PARTITION_ITER_OPS = {
+    .next = partition_iter_next,
+    .destroy = partition_iter_destroy,
+};
+
+static const struct rbh_mut_iterator PARTITION_ITER = {
+    .ops = &PARTITION_ITER_OPS,
+};
+
+int
+rbh_generic_backend_filter_partitioned(struct rbh_backend *backend,
+                                       const struct rbh_filter *filter,
+                                       const struct rbh_filter_options *options,
+                                       struct rbh_mut_iterator **partitions,
+                                       size_t count)
+{
+    struct shared_fsentries *shared;
+    struct rbh_mut_iterator *fsentries;
+    int save_errno;
+    size_t i;
+
+    fsentries = rbh_backend_filter(backend, filter, options);
+    if (fsentries == NULL)
+        return -1;
+
+    if (count == 1) {
+        partitions[0] = fsentries;
+        return 0;
+    }
+
+    shared = malloc(sizeof(*shared));
+    if (shared == NULL) {
+        save_errno = errno;
+        rbh_mut_iter_destroy(fsentries);
+        errno = save_errno;
+        return -1;
+    }
+
+    pthread_mutex_init(&shared->mutex, NULL);
+    shared->fsentries = fsentries;
+    /* Released once every partition is allocated */
+    shared->refcount = 1;
+
+    for (i = 0; i < count; i++) {
+        struct partition_iterator *partition;
+
+        partition = malloc(sizeof(*partition));
+        if (partition == NULL)
+            break;
+
+        partition->iterator = PARTITION_ITER;
+        partition->shared = shared;
+        shared->refcount++;
+        partitions[i] = &partition->iterator;
+    }
+
+    if (i < count) {
+        save_errno = errno;
+        while (i-- > 0)
+            rbh_mut_iter_destroy(partitions[i]);
+        shared_fsentries_release(shared);
+        errno = save_errno;
+        return -1;
+    }
+
+    shared_fsentries_release(shared);
+    return 0;
+}
+
 /*----------------------------------------------------------------------------*
  |                      rbh_backend_fsentry_from_path()                       |
  *----------------------------------------------------------------------------*/
@@ -0,0 +1,871 @@
+/* This file is part of the RobinHood Library
+ * Copyright (C) 2022 Commissariat a l'energie atomique et aux energies
+ *                    alternatives
+ *
+ * SPDX-License-Identifer: LGPL-3.0-or-later
+ */
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <errno.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#include "robinhood/backend_cache.h"
+#include "robinhood/fsevent.h"
+#include "robinhood/idmap.h"
+#include "robinhood/statx.h"
+
+#include "fsentry.h"
+
+#define KEY_FIELDS (RBH_FP_ID | RBH_FP_PARENT_ID | RBH_FP_NAME)
+#define XATTRS_FIELDS (RBH_FP_NAMESPACE_XATTRS | RBH_FP_INODE_XATTRS)
+
+struct cached_fsentry {
+    struct rbh_fsentry *fsentry;
+
+    /* The projection `fsentry' was fetched with */
+    unsigned int fsentry_mask;
+    unsigned int statx_mask;
+    /* The kinds of xattrs (RBH_FP_*_XATTRS) that were fetched in full */
+    unsigned int xattrs_mask;
+
+    /* Whether `fsentry' is known to be the only link of its inode, lookups by
+     * ID may only be served by such fsentries.
+     */
+    bool sole_link;
+
+    /* The key of `fsentry' in the (parent ID, name) index */
+    struct rbh_id link;
+
+    /* Most recently used first */
+    struct cached_fsentry *prev;
+    struct cached_fsentry *next;
+
+    /* The other cached links of the same inode */
+    struct cached_fsentry *id_prev;
+    struct cached_fsentry *id_next;
+};
+
+struct cache_backend {
+    struct rbh_backend backend;
+    struct rbh_backend *origin;
+
+    /* ID -> struct cached_fsentry * (the first cached link of the inode) */
+    struct rbh_idmap *ids;
+    /* (parent ID, name) -> struct cached_fsentry * */
+    struct rbh_idmap *links;
+    struct cached_fsentry *head;
+    struct cached_fsentry *tail;
+    struct cached_fsentry *root;
+
+    /* Whether `origin' was switched to garbage collecting mode */
+    bool gc;
+
+    struct rbh_backend_cache_stats stats;
+};
+
+/*----------------------------------------------------------------------------*
+ |                                  entries                                   |
+ *----------------------------------------------------------------------------*/
+
+/* Keys of the (parent ID, name) index are made of the size of the parent ID,
+ * the parent ID, and the name.
+ */
+static int
+link_key_init(struct rbh_id *key, const struct rbh_id *parent_id,
+              const char *name)
+{
+    size_t name_length = strlen(name);
+    char *data;
+
+    data = malloc(sizeof(parent_id->size) + parent_id->size + name_length);
+    if (data == NULL)
+        return -1;
+
+    memcpy(data, &parent_id->size, sizeof(parent_id->size));
+    /* The parent ID of the root is empty (and may be NULL) */
+    if (parent_id->size)
+        memcpy(data + sizeof(parent_id->size), parent_id->data,
+               parent_id->size);
+    memcpy(data + sizeof(parent_id->size) + parent_id->size, name,
+           name_length);
+
+    key->data = data;
+    key->size = sizeof(parent_id->size) + parent_id->size + name_length;
+    return 0;
+}
+
+static bool
+is_sole_link(const struct rbh_fsentry *fsentry)
+{
+    const struct rbh_statx *statxbuf = fsentry->statx;
+
+    if (!(fsentry->mask & RBH_FP_STATX))
+        return false;
+
+    /* Directories cannot be hardlinked */
+    if (statxbuf->stx_mask & RBH_STATX_TYPE && S_ISDIR(statxbuf->stx_mode))
+        return true;
+
+    return statxbuf->stx_mask & RBH_STATX_NLINK && statxbuf->stx_nlink == 1;
+}
+
+/* Can `cached' serve a query that projects `projection'? */
+static bool
+covers(const struct cached_fsentry *cached,
+       const struct rbh_filter_projection *projection)
+{
+    unsigned int xattrs = projection->fsentry_mask & XATTRS_FIELDS;
+
+    if (projection->fsentry_mask & ~cached->fsentry_mask)
+        return false;
+
+    if (projection->fsentry_mask & RBH_FP_STATX
+            && projection->statx_mask & ~cached->statx_mask)
+        return false;
+
+    return (xattrs & ~cached->xattrs_mask) == 0;
+}
+
+/* Fsentries are fetched with the fields they are indexed with */
+static struct rbh_filter_projection
+cached_projection(const struct rbh_filter_projection *projection)
+{
+    struct rbh_filter_projection cached = *projection;
+
+    cached.fsentry_mask |= KEY_FIELDS;
+    return cached;
+}
+
+/*----------------------------------------------------------------------------*
+ |                                   cache                                    |
+ *----------------------------------------------------------------------------*/
+
+static void
+lru_unlink(struct cache_backend *cache, struct cached_fsentry *cached)
+{
+    if (cached->prev)
+        cached->prev->next = cached->next;
+    else
+        cache->head = cached->next;
+
+    if (cached->next)
+        cached->next->prev = cached->prev;
+    else
+        cache->tail = cached->prev;
+}
+
+static void
+lru_push(struct cache_backend *cache, struct cached_fsentry *cached)
+{
+    cached->prev = NULL;
+    cached->next = cache->head;
+    if (cache->head)
+        cache->head->prev = cached;
+    else
+        cache->tail = cached;
+    cache->head = cached;
+}
+
+static void
+cache_remove(struct cache_backend *cache, struct cached_fsentry *cached)
+{
+    lru_unlink(cache, cached);
+    rbh_idmap_remove(cache->links, &cached->link);
+
+    if (cached->id_next)
+        cached->id_next->id_prev = cached->id_prev;
+    if (cached->id_prev) {
+        cached->id_prev->id_next = cached->id_next;
+    } else if (cached->id_next) {
+        struct cached_fsentry **first;
+
+        first = rbh_idmap_get(cache->ids, &cached->fsentry->id);
+        *first = cached->id_next;
+    } else {
+        rbh_idmap_remove(cache->ids, &cached->fsentry->id);
+    }
+
+    if (cache->root == cached)
+        cache->root = NULL;
+    cache->stats.count--;
+
+    free((char *)cached->link.data);
+    free(cached->fsentry);
+    free(cached);
+}
+
+static void
+cache_flush(struct cache_backend *cache)
+{
+    while (cache->head)
+        cache_remove(cache, cache->head);
+}
+
+static struct cached_fsentry *
+cache_get_link(struct cache_backend *cache, const struct rbh_id *parent_id,
+               const char *name)
+{
+    struct cached_fsentry **cached;
+    struct rbh_id key;
+    int save_errno;
+
+    if (link_key_init(&key, parent_id, name))
+        return NULL;
+
+    cached = rbh_idmap_get(cache->links, &key);
+    save_errno = errno;
+    free((char *)key.data);
+    errno = save_errno;
+
+    return cached == NULL ? NULL : *cached;
+}
+
+/* Cache (a copy of) `fsentry', as fetched with `projection'
+ *
+ * Fsentries that are missing one of the fields they are indexed with are not
+ * cached. Errors are not reported: the worst that can happen is that the next
+ * lookup of `fsentry' is a miss.
+ */
+static struct cached_fsentry *
+cache_insert(struct cache_backend *cache, const struct rbh_fsentry *fsentry,
+             const struct rbh_filter_projection *projection, bool sole_link)
+{
+    struct cached_fsentry **first;
+    struct cached_fsentry **slot;
+    struct cached_fsentry *cached;
+    struct cached_fsentry *stale;
+    bool created;
+
+    if ((fsentry->mask & KEY_FIELDS) != KEY_FIELDS)
+        return NULL;
+
+    /* A link only ever refers to one inode */
+    stale = cache_get_link(cache, &fsentry->parent_id, fsentry->name);
+    if (stale)
+        cache_remove(cache, stale);
+    else if (errno != ENOENT)
+        return NULL;
+
+    cached = malloc(sizeof(*cached));
+    if (cached == NULL)
+        return NULL;
+
+    cached->fsentry = fsentry_clone(fsentry);
+    if (cached->fsentry == NULL)
+        goto out_free_cached;
+
+    if (link_key_init(&cached->link, &fsentry->parent_id, fsentry->name))
+        goto out_free_fsentry;
+
+    slot = rbh_idmap_put(cache->links, &cached->link, &created);
+    if (slot == NULL)
+        goto out_free_link;
+    *slot = cached;
+
+    first = rbh_idmap_put(cache->ids, &cached->fsentry->id, &created);
+    if (first == NULL) {
+        rbh_idmap_remove(cache->links, &cached->link);
+        goto out_free_link;
+    }
+
+    cached->id_prev = NULL;
+    cached->id_next = created ? NULL : *first;
+    if (cached->id_next)
+        cached->id_next->id_prev = cached;
+    *first = cached;
+
+    cached->fsentry_mask = projection->fsentry_mask;
+    cached->statx_mask = projection->statx_mask;
+    cached->xattrs_mask = 0;
+    if (projection->xattrs.ns.count == 0)
+        cached->xattrs_mask |= RBH_FP_NAMESPACE_XATTRS;
+    if (projection->xattrs.inode.count == 0)
+        cached->xattrs_mask |= RBH_FP_INODE_XATTRS;
+    cached->sole_link = sole_link || is_sole_link(fsentry);
+
+    lru_push(cache, cached);
+    if (++cache->stats.count > cache->stats.capacity) {
+        cache_remove(cache, cache->tail);
+        cache->stats.evictions++;
+    }
+
+    return cached;
+
+out_free_link:
+    free((char *)cached->link.data);
+out_free_fsentry:
+    free(cached->fsentry);
+out_free_cached:
+    free(cached);
+    return NULL;
+}
+
+/* `cached' becomes the most recently used fsentry, return a copy of it */
+static struct rbh_fsentry *
+cache_hit(struct cache_backend *cache, struct cached_fsentry *cached)
+{
+    lru_unlink(cache, cached);
+    lru_push(cache, cached);
+    cache->stats.hits++;
+
+    return fsentry_clone(cached->fsentry);
+}
+
+static void
+cache_invalidate(struct cache_backend *cache, struct cached_fsentry *cached)
+{
+    cache_remove(cache, cached);
+    cache->stats.invalidations++;
+}
+
+static void
+cache_invalidate_id(struct cache_backend *cache, const struct rbh_id *id)
+{
+    struct cached_fsentry **first;
+    struct cached_fsentry *cached;
+
+    first = rbh_idmap_get(cache->ids, id);
+    if (first == NULL)
+        return;
+
+    cached = *first;
+    while (cached) {
+        struct cached_fsentry *next = cached->id_next;
+
+        cache_invalidate(cache, cached);
+        cached = next;
+    }
+}
+
+/*----------------------------------------------------------------------------*
+ |                              lookup_iterator                               |
+ *----------------------------------------------------------------------------*/
+
+/* Yields the fsentries a lookup already fetched, and then those of `rest' */
+struct lookup_iterator {
+    struct rbh_mut_iterator iterator;
+
+    struct rbh_fsentry *fetched[2];
+    size_t index;
+    size_t count;
+    struct rbh_mut_iterator *rest;
+};
+
+static void *
+lookup_iter_next(void *iterator)
+{
+    struct lookup_iterator *lookup = iterator;
+
+    if (lookup->index < lookup->count)
+        return lookup->fetched[lookup->index++];
+
+    if (lookup->rest)
+        return rbh_mut_iter_next(lookup->rest);
+
+    errno = ENODATA;
+    return NULL;
+}
+
+static void
+lookup_iter_destroy(void *iterator)
+{
+    struct lookup_iterator *lookup = iterator;
+
+    while (lookup->index < lookup->count)
+        free(lookup->fetched[lookup->index++]);
+    if (lookup->rest)
+        rbh_mut_iter_destroy(lookup->rest);
+    free(lookup);
+}
+
+static const struct rbh_mut_iterator_operations LOOKUP_ITER_OPS = {
+    .next = lookup_iter_next,
+    .destroy = lookup_iter_destroy,
+};
+
+static const struct rbh_mut_iterator LOOKUP_ITER = {
+    .ops = &LOOKUP_ITER_OPS,
+};
+
+/* Consumes `fetched' and `rest', even on error */
+static struct rbh_mut_iterator *
+lookup_iter_new(struct rbh_fsentry **fetched, size_t count,
+                struct rbh_mut_iterator *rest)
+{
+    struct lookup_iterator *lookup;
+
+    lookup = malloc(sizeof(*lookup));
+    if (lookup == NULL) {
+        int save_errno = errno;
+
+        for (size_t i = 0; i < count; i++)
+            free(fetched[i]);
+        if (rest)
+            rbh_mut_iter_destroy(rest);
+        errno = save_errno;
+        return NULL;
+    }
+
+    lookup->iterator = LOOKUP_ITER;
+    for (size_t i = 0; i < count; i++)
+        lookup->fetched[i] = fetched[i];
+    lookup->index = 0;
+    lookup->count = count;
+    lookup->rest = rest;
+
+    return &lookup->iterator;
+}
+
+/*----------------------------------------------------------------------------*
+ |                               cache_backend                                |
+ *----------------------------------------------------------------------------*/
+
+    /*--------------------------------------------------------------------*
+     |                            get_option()                            |
+     *--------------------------------------------------------------------*/
+
+static int
+cache_backend_get_option(void *backend, unsigned int option, void *data,
+                         size_t *data_size)
+{
+    struct cache_backend *cache = backend;
+
+    if (option != RBH_GBO_CACHE_STATS)
+        return rbh_backend_get_option(cache->origin, option, data, data_size);
+
+    if (*data_size < sizeof(cache->stats)) {
+        *data_size = sizeof(cache->stats);
+        errno = EOVERFLOW;
+        return -1;
+    }
+    memcpy(data, &cache->stats, sizeof(cache->stats));
+    *data_size = sizeof(cache->stats);
+    return 0;
+}
+
+    /*--------------------------------------------------------------------*
+     |                            set_option()                            |
+     *--------------------------------------------------------------------*/
+
+static int
+cache_backend_set_option(void *backend, unsigned int option, const void *data,
+                         size_t data_size)
+{
+    struct cache_backend *cache = backend;
+
+    if (rbh_backend_set_option(cache->origin, option, data, data_size))
+        return -1;
+
+    /* Options may change what the backend yields (eg. sharding) */
+    cache_flush(cache);
+    if (option == RBH_GBO_GC)
+        memcpy(&cache->gc, data, sizeof(cache->gc));
+
+    return 0;
+}
+
+    /*--------------------------------------------------------------------*
+     |                              update()                              |
+     *--------------------------------------------------------------------*/
+
+/* Invalidates the fsentries fsevents apply to, as they go through */
+struct invalidate_iterator {
+    struct rbh_iterator iterator;
+    struct rbh_iterator *fsevents;
+    struct cache_backend *cache;
+};
+
+static const void *
+invalidate_iter_next(void *iterator)
+{
+    struct invalidate_iterator *invalidate = iterator;
+    struct cache_backend *cache = invalidate->cache;
+    const struct rbh_fsevent *fsevent;
+
+    fsevent = rbh_iter_next(invalidate->fsevents);
+    if (fsevent == NULL)
+        return NULL;
+
+    cache_invalidate_id(cache, &fsevent->id);
+
+    switch (fsevent->type) {
+    case RBH_FET_LINK:
+    case RBH_FET_UNLINK:
+    case RBH_FET_XATTR:
+        if (fsevent->link.parent_id != NULL) {
+            struct cached_fsentry *cached;
+            int save_errno = errno;
+
+            /* The link may have referred to another inode */
+            cached = cache_get_link(cache, fsevent->link.parent_id,
+                                    fsevent->link.name);
+            if (cached == NULL && errno == ENOMEM) {
+                /* Better safe than sorry */
+                cache->stats.invalidations += cache->stats.count;
+                cache_flush(cache);
+            } else if (cached) {
+                cache_invalidate(cache, cached);
+            }
+            errno = save_errno;
+        }
+        break;
+    default:
+        break;
+    }
+
+    return fsevent;
+}
+
+static void
+invalidate_iter_destroy(void *iterator)
+{
+    /* Invalidate iterators live on the stack of cache_backend_update(), and
+     * `fsevents' belongs to the caller of rbh_backend_update().
+     */
+}
+
+static const struct rbh_iterator_operations INVALIDATE_ITER_OPS = {
+    .next = invalidate_iter_next,
+    .destroy = invalidate_iter_destroy,
+};
+
+static const struct rbh_iterator INVALIDATE_ITER = {
+    .ops = &INVALIDATE_ITER_OPS,
+};
+
+static ssize_t
+cache_backend_update(void *backend, struct rbh_iterator *fsevents)
+{
+    struct invalidate_iterator invalidate = {
+        .iterator = INVALIDATE_ITER,
+        .fsevents = fsevents,
+        .cache = backend,
+    };
+    struct cache_backend *cache = backend;
+
+    return rbh_backend_update(cache->origin, &invalidate.iterator);
+}
+
+    /*--------------------------------------------------------------------*
+     |                              branch()                              |
+     *--------------------------------------------------------------------*/
+
+/* Consumes `backend', even on error */
+static struct rbh_backend *
+cache_wrap(struct cache_backend *cache, struct rbh_backend *backend)
+{
+    struct rbh_backend *wrapped;
+
+    if (backend == NULL)
+        return NULL;
+
+    wrapped = rbh_backend_cache_new(backend, cache->stats.capacity);
+    if (wrapped == NULL) {
+        int save_errno = errno;
+
+        rbh_backend_destroy(backend);
+        errno = save_errno;
+    }
+    return wrapped;
+}
+
+static struct rbh_backend *
+cache_backend_branch(void *backend, const struct rbh_id *id)
+{
+    struct cache_backend *cache = backend;
+
+    return cache_wrap(cache, rbh_backend_branch(cache->origin, id));
+}
+
+    /*--------------------------------------------------------------------*
+     |                              clone()                               |
+     *--------------------------------------------------------------------*/
+
+static struct rbh_backend *
+cache_backend_clone(void *backend)
+{
+    struct cache_backend *cache = backend;
+
+    return cache_wrap(cache, rbh_backend_clone(cache->origin));
+}
+
+    /*--------------------------------------------------------------------*
+     |                               root()                               |
+     *--------------------------------------------------------------------*/
+
+static struct rbh_fsentry *
+cache_backend_root(void *backend,
+                   const struct rbh_filter_projection *projection)
+{
+    const struct rbh_filter_projection cached = cached_projection(projection);
+    struct cache_backend *cache = backend;
+    struct rbh_fsentry *root;
+
+    if (cache->root && covers(cache->root, projection))
+        return cache_hit(cache, cache->root);
+    cache->stats.misses++;
+
+    root = rbh_backend_root(cache->origin, &cached);
+    if (root == NULL)
+        return NULL;
+
+    cache->root = cache_insert(cache, root, &cached, false);
+    return root;
+}
+
+    /*--------------------------------------------------------------------*
+     |                              filter()                              |
+     *--------------------------------------------------------------------*/
+
+static bool
+is_compare(const struct rbh_filter *filter, enum rbh_fsentry_property field,
+           enum rbh_value_type type)
+{
+    return filter != NULL && filter->op == RBH_FOP_EQUAL
+        && filter->compare.field.fsentry == field
+        && filter->compare.value.type == type;
+}
+
+/* Does `filter' look up an fsentry by ID? */
+static bool
+is_id_lookup(const struct rbh_filter *filter, struct rbh_id *id)
+{
+    if (!is_compare(filter, RBH_FP_ID, RBH_VT_BINARY))
+        return false;
+
+    id->data = filter->compare.value.binary.data;
+    id->size = filter->compare.value.binary.size;
+    return true;
+}
+
+/* Does `filter' look up an fsentry by parent ID and name? */
+static bool
+is_link_lookup(const struct rbh_filter *filter, struct rbh_id *parent_id,
+               const char **name)
+{
+    const struct rbh_filter *parent;
+    const struct rbh_filter *child;
+
+    if (filter == NULL || filter->op != RBH_FOP_AND
+            || filter->logical.count != 2)
+        return false;
+
+    parent = filter->logical.filters[0];
+    child = filter->logical.filters[1];
+    if (is_compare(child, RBH_FP_PARENT_ID, RBH_VT_BINARY)) {
+        parent = filter->logical.filters[1];
+        child = filter->logical.filters[0];
+    }
+
+    if (!is_compare(parent, RBH_FP_PARENT_ID, RBH_VT_BINARY)
+            || !is_compare(child, RBH_FP_NAME, RBH_VT_STRING))
+        return false;
+
+    parent_id->data = parent->compare.value.binary.data;
+    parent_id->size = parent->compare.value.binary.size;
+    *name = child->compare.value.string;
+    return true;
+}
+
+static struct rbh_mut_iterator *
+cache_lookup_hit(struct cache_backend *cache, struct cached_fsentry *cached)
+{
+    struct rbh_fsentry *fsentry = cache_hit(cache, cached);
+
+    if (fsentry == NULL)
+        return NULL;
+
+    return lookup_iter_new(&fsentry, 1, NULL);
+}
+
+/* Forward a lookup to the backend, and cache what it yields */
+static struct rbh_mut_iterator *
+cache_lookup_miss(struct cache_backend *cache, const struct rbh_filter *filter,
+                  const struct rbh_filter_options *options, bool by_id)
+{
+    struct rbh_filter_options cached = *options;
+    struct rbh_mut_iterator *fsentries;
+    struct rbh_fsentry *fetched[2];
+    size_t count = 0;
+    int save_errno;
+    bool sole_link;
+
+    cache->stats.misses++;
+    cached.projection = cached_projection(&options->projection);
+
+    fsentries = rbh_backend_filter(cache->origin, filter, &cached);
+    if (fsentries == NULL)
+        return NULL;
+
+    fetched[0] = rbh_mut_iter_next(fsentries);
+    if (fetched[0] == NULL) {
+        if (errno != ENODATA)
+            goto out_destroy_fsentries;
+        rbh_mut_iter_destroy(fsentries);
+        return lookup_iter_new(fetched, 0, NULL);
+    }
+    count++;
+
+    /* A lookup by ID yields every link of an inode: if it only yields one,
+     * this one can serve lookups by ID.
+     */
+    sole_link = false;
+    if (by_id && options->limit != 1) {
+        fetched[1] = rbh_mut_iter_next(fsentries);
+        if (fetched[1] != NULL)
+            count++;
+        else if (errno == ENODATA)
+            sole_link = true;
+        else
+            goto out_free_fetched;
+    }
+
+    if (count == 1)
+        cache_insert(cache, fetched[0], &cached.projection, sole_link);
+
+    return lookup_iter_new(fetched, count, fsentries);
+
+out_free_fetched:
+    save_errno = errno;
+    free(fetched[0]);
+    errno = save_errno;
+out_destroy_fsentries:
+    save_errno = errno;
+    rbh_mut_iter_destroy(fsentries);
+    errno = save_errno;
+    return NULL;
+}
+
+static struct rbh_mut_iterator *
+cache_backend_filter(void *backend, const struct rbh_filter *filter,
+                     const struct rbh_filter_options *options)
+{
+    struct cache_backend *cache = backend;
+    struct cached_fsentry *cached;
+    struct rbh_id id;
+    const char *name;
+
+    /* Lookups yield at most one fsentry (per link), only skipping or sampling
+     * can change that.
+     */
+    if (cache->gc || options->skip || options->sample.rate != 0.
+            || options->sample.size)
+        return rbh_backend_filter(cache->origin, filter, options);
+
+    if (is_id_lookup(filter, &id)) {
+        struct cached_fsentry **first = rbh_idmap_get(cache->ids, &id);
+
+        for (cached = first ? *first : NULL; cached; cached = cached->id_next) {
+            if (cached->sole_link && covers(cached, &options->projection))
+                return cache_lookup_hit(cache, cached);
+        }
+        return cache_lookup_miss(cache, filter, options, true);
+    }
+
+    if (is_link_lookup(filter, &id, &name)) {
+        cached = cache_get_link(cache, &id, name);
+        if (cached && covers(cached, &options->projection))
+            return cache_lookup_hit(cache, cached);
+        return cache_lookup_miss(cache, filter, options, false);
+    }
+
+    return rbh_backend_filter(cache->origin, filter, options);
+}
+
+    /*--------------------------------------------------------------------*
+     |                        filter_partitioned()                        |
+     *--------------------------------------------------------------------*/
+
+static int
+cache_backend_filter_partitioned(void *backend, const struct rbh_filter *filter,
+                                 const struct rbh_filter_options *options,
+                                 struct rbh_mut_iterator **partitions,
+                                 size_t count)
+{
+    struct cache_backend *cache = backend;
+
+    return rbh_backend_filter_partitioned(cache->origin, filter, options,
+                                          partitions, count);
+}
+
+    /*--------------------------------------------------------------------*
+     |                             destroy()                              |
+     *--------------------------------------------------------------------*/
+
+static void
+cache_backend_destroy(void *backend)
+{
+    struct cache_backend *cache = backend;
+
+    cache_flush(cache);
+    rbh_idmap_destroy(cache->links);
+    rbh_idmap_destroy(cache->ids);
+    rbh_backend_destroy(cache->origin);
+    free(cache);
+}
+
+static const struct rbh_backend_operations CACHE_BACKEND_OPS = {
+    .get_option = cache_backend_get_option,
+    .set_option = cache_backend_set_option,
+    .update = cache_backend_update,
+    .branch = cache_backend_branch,
+    .clone = cache_backend_clone,
+    .root = cache_backend_root,
+    .filter = cache_backend_filter,
+    .filter_partitioned = cache_backend_filter_partitioned,
+    .destroy = cache_backend_destroy,
+};
+
+struct rbh_backend *
+rbh_backend_cache_new(struct rbh_backend *backend, size_t capacity)
+{
+    struct cache_backend *cache;
+    int save_errno;
+
+    if (capacity == 0) {
+        errno = EINVAL;
+        return NULL;
+    }
+
+    cache = malloc(sizeof(*cache));
+    if (cache == NULL)
+        return NULL;
+
+    cache->ids = rbh_idmap_new(sizeof(struct cached_fsentry *), 0);
+    if (cache->ids == NULL)
+        goto out_free_cache;
+
+    cache->links = rbh_idmap_new(sizeof(struct cached_fsentry *), 0);
+    if (cache->links == NULL)
+        goto out_destroy_ids;
+
+    /* Caching backends are transparent: they share the ID (and thus the
+     * options) of the backend they wrap.
+     */
+    cache->backend.id = backend->id;
+    cache->backend.name = backend->name;
+    cache->backend.ops = &CACHE_BACKEND_OPS;
+    cache->origin = backend;
+    cache->head = cache->tail = cache->root = NULL;
+    cache->gc = false;
+    memset(&cache->stats, 0, sizeof(cache->stats));
+    cache->stats.capacity = capacity;
+
+    return &cache->backend;
+
+out_destroy_ids:
+    save_errno = errno;
+    rbh_idmap_destroy(cache->ids);
+    errno = save_errno;
+out_free_cache:
+    save_errno = errno;
+    free(cache);
+    errno = save_errno;
+    return NULL;
+}
@@ -0,0 +1,475 @@
+/* This file is part of the RobinHood Library
+ * Copyright (C) 2022 Commissariat a l'energie atomique et aux energies
+ *                    alternatives
+ *
+ * SPDX-License-Identifer: LGPL-3.0-or-later
+ */
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "robinhood/backend_pool.h"
+#include "robinhood/idmap.h"
+#include "robinhood/plugins/backend.h"
+#include "robinhood/uri.h"
+
+#include "utils.h"
+
+struct idle_backend {
+    struct idle_backend *next;
+    struct rbh_backend *backend;
+    time_t since;
+};
+
+/* The idle backends of a given URI (or the idle roots of a given backend type
+ * and fsname)
+ */
+struct pool_entry {
+    struct pool_entry *next;
+    /* Most recently checked in first */
+    struct idle_backend *idle;
+    size_t idle_count;
+};
+
+struct rbh_backend_pool {
+    pthread_mutex_t mutex;
+    /* URI -> struct pool_entry * */
+    struct rbh_idmap *uris;
+    /* backend type '\0' fsname -> struct pool_entry * */
+    struct rbh_idmap *roots;
+    /* address of a checked out backend -> struct pool_entry * */
+    struct rbh_idmap *leases;
+    /* Every entry of `uris' and `roots' */
+    struct pool_entry *entries;
+
+    size_t max_idle;
+    unsigned int idle_timeout;
+    time_t last_sweep;
+};
+
+static time_t
+now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec;
+}
+
+struct rbh_backend_pool *
+rbh_backend_pool_new(size_t max_idle, unsigned int idle_timeout)
+{
+    struct rbh_backend_pool *pool;
+    int save_errno;
+
+    pool = malloc(sizeof(*pool));
+    if (pool == NULL)
+        return NULL;
+
+    pool->uris = rbh_idmap_new(sizeof(struct pool_entry *), 0);
+    if (pool->uris == NULL)
+        goto out_free_pool;
+
+    pool->roots = rbh_idmap_new(sizeof(struct pool_entry *), 0);
+    if (pool->roots == NULL)
+        goto out_destroy_uris;
+
+    pool->leases = rbh_idmap_new(sizeof(struct pool_entry *), 0);
+    if (pool->leases == NULL)
+        goto out_destroy_roots;
+
+    pthread_mutex_init(&pool->mutex, NULL);
+    pool->entries = NULL;
+    pool->max_idle = max_idle;
+    pool->idle_timeout = idle_timeout;
+    pool->last_sweep = now();
+    return pool;
+
+out_destroy_roots:
+    rbh_idmap_destroy(pool->roots);
+out_destroy_uris:
+    rbh_idmap_destroy(pool->uris);
+out_free_pool:
+    save_errno = errno;
+    free(pool);
+    errno = save_errno;
+    return NULL;
+}
+
+/*----------------------------------------------------------------------------*
+ |                                  entries                                   |
+ *----------------------------------------------------------------------------*/
+
+/* Must be called with the pool's mutex held */
+static struct pool_entry *
+pool_entry_get(struct rbh_backend_pool *pool, struct rbh_idmap *map,
+               const struct rbh_id *key)
+{
+    struct pool_entry **value;
+    struct pool_entry *entry;
+    bool created;
+
+    value = rbh_idmap_put(map, key, &created);
+    if (value == NULL)
+        return NULL;
+
+    if (!created)
+        return *value;
+
+    entry = malloc(sizeof(*entry));
+    if (entry == NULL) {
+        int save_errno = errno;
+
+        rbh_idmap_remove(map, key);
+        errno = save_errno;
+        return NULL;
+    }
+
+    entry->idle = NULL;
+    entry->idle_count = 0;
+    entry->next = pool->entries;
+    pool->entries = entry;
+
+    *value = entry;
+    return entry;
+}
+
+/* Must be called with the pool's mutex held */
+static struct rbh_backend *
+pool_entry_pop(struct pool_entry *entry)
+{
+    struct idle_backend *idle = entry->idle;
+    struct rbh_backend *backend;
+
+    if (idle == NULL)
+        return NULL;
+
+    entry->idle = idle->next;
+    entry->idle_count--;
+    backend = idle->backend;
+    free(idle);
+    return backend;
+}
+
+/* Must be called with the pool's mutex held
+ *
+ * Returns false if `backend' could not be kept idle (in which case the caller
+ * is responsible for destroying it).
+ */
+static bool
+pool_entry_push(struct rbh_backend_pool *pool, struct pool_entry *entry,
+                struct rbh_backend *backend)
+{
+    struct idle_backend *idle;
+
+    if (entry->idle_count >= pool->max_idle)
+        return false;
+
+    idle = malloc(sizeof(*idle));
+    if (idle == NULL)
+        return false;
+
+    idle->backend = backend;
+    idle->since = now();
+    idle->next = entry->idle;
+    entry->idle = idle;
+    entry->idle_count++;
+    return true;
+}
+
+/* Must be called with the pool's mutex held
+ *
+ * Evicted backends are moved to `victims', they should be destroyed once the
+ * pool's mutex is released.
+ */
+static size_t
+pool_sweep(struct rbh_backend_pool *pool, unsigned int idle,
+           struct idle_backend **victims)
+{
+    time_t current = now();
+    size_t count = 0;
+
+    for (struct pool_entry *entry = pool->entries; entry != NULL;
+         entry = entry->next) {
+        struct idle_backend **next = &entry->idle;
+
+        while (*next != NULL) {
+            struct idle_backend *backend = *next;
+
+            if (current - backend->since < (time_t)idle) {
+                next = &backend->next;
+                continue;
+            }
+
+            *next = backend->next;
+            entry->idle_count--;
+            backend->next = *victims;
+            *victims = backend;
+            count++;
+        }
+    }
+
+    pool->last_sweep = current;
+    return count;
+}
+
+/* Must be called with the pool's mutex held */
+static void
+pool_maybe_sweep(struct rbh_backend_pool *pool, struct idle_backend **victims)
+{
+    if (pool->idle_timeout == 0)
+        return;
+
+    if (now() - pool->last_sweep >= (time_t)pool->idle_timeout)
+        pool_sweep(pool, pool->idle_timeout, victims);
+}
+
+static void
+destroy_victims(struct idle_backend *victims)
+{
+    while (victims != NULL) {
+        struct idle_backend *next = victims->next;
+
+        rbh_backend_destroy(victims->backend);
+        free(victims);
+        victims = next;
+    }
+}
+
+/*----------------------------------------------------------------------------*
+ |                             backend creation                               |
+ *----------------------------------------------------------------------------*/
+
+static struct rbh_backend *
+backend_new(const char *type, const char *fsname)
+{
+    const struct rbh_backend_plugin *plugin;
+
+    errno = 0;
+    plugin = rbh_backend_plugin_import(type);
+    if (plugin == NULL) {
+        /* dlerror() has the details */
+        if (errno == 0)
+            errno = ENOENT;
+        return NULL;
+    }
+
+    return rbh_backend_plugin_new(plugin, fsname);
+}
+
+/* Branch a pooled root backend */
+static struct rbh_backend *
+pool_branch(struct rbh_backend_pool *pool, const struct rbh_uri *uri)
+{
+    size_t backend_size = strlen(uri->backend) + 1;
+    size_t fsname_size = strlen(uri->fsname);
+    struct idle_backend *victims = NULL;
+    struct rbh_backend *branch;
+    struct pool_entry *entry;
+    struct rbh_backend *root;
+    struct rbh_id key;
+    int save_errno;
+    char *data;
+    bool kept;
+
+    data = malloc(backend_size + fsname_size);
+    if (data == NULL)
+        return NULL;
+    memcpy(data, uri->backend, backend_size);
+    memcpy(data + backend_size, uri->fsname, fsname_size);
+    key.data = data;
+    key.size = backend_size + fsname_size;
+
+    pthread_mutex_lock(&pool->mutex);
+    entry = pool_entry_get(pool, pool->roots, &key);
+    root = entry ? pool_entry_pop(entry) : NULL;
+    pthread_mutex_unlock(&pool->mutex);
+    save_errno = errno;
+    free(data);
+    if (entry == NULL) {
+        errno = save_errno;
+        return NULL;
+    }
+
+    if (root == NULL) {
+        root = backend_new(uri->backend, uri->fsname);
+        if (root == NULL)
+            return NULL;
+    }
+
+    if (uri->type == RBH_UT_ID)
+        branch = rbh_backend_branch(root, uri->id);
+    else
+        branch = backend_branch_from_path(root, uri->fsname, uri->path);
+    save_errno = errno;
+
+    pthread_mutex_lock(&pool->mutex);
+    kept = pool_entry_push(pool, entry, root);
+    pool_maybe_sweep(pool, &victims);
+    pthread_mutex_unlock(&pool->mutex);
+
+    if (!kept)
+        rbh_backend_destroy(root);
+    destroy_victims(victims);
+
+    errno = save_errno;
+    return branch;
+}
+
+static struct rbh_backend *
+pool_backend_new(struct rbh_backend_pool *pool, const char *string)
+{
+    struct rbh_backend *backend;
+    struct rbh_raw_uri *raw_uri;
+    struct rbh_uri *uri;
+    int save_errno;
+
+    raw_uri = rbh_raw_uri_from_string(string);
+    if (raw_uri == NULL)
+        return NULL;
+
+    uri = rbh_uri_from_raw_uri(raw_uri);
+    save_errno = errno;
+    free(raw_uri);
+    if (uri == NULL) {
+        errno = save_errno;
+        return NULL;
+    }
+
+    if (uri->type == RBH_UT_BARE)
+        backend = backend_new(uri->backend, uri->fsname);
+    else
+        backend = pool_branch(pool, uri);
+
+    save_errno = errno;
+    free(uri);
+    errno = save_errno;
+    return backend;
+}
+
+/*----------------------------------------------------------------------------*
+ |                                    API                                     |
+ *----------------------------------------------------------------------------*/
+
+static struct rbh_id
+backend_key(struct rbh_backend **backend)
+{
+    return (struct rbh_id){
+        .data = (const char *)backend,
+        .size = sizeof(*backend),
+    };
+}
+
+struct rbh_backend *
+rbh_backend_pool_checkout(struct rbh_backend_pool *pool, const char *uri)
+{
+    const struct rbh_id key = {
+        .data = uri,
+        .size = strlen(uri),
+    };
+    struct idle_backend *victims = NULL;
+    struct rbh_backend *backend;
+    struct pool_entry **lease;
+    struct pool_entry *entry;
+    struct rbh_id lease_key;
+    bool created;
+
+    pthread_mutex_lock(&pool->mutex);
+    pool_maybe_sweep(pool, &victims);
+    entry = pool_entry_get(pool, pool->uris, &key);
+    backend = entry ? pool_entry_pop(entry) : NULL;
+    pthread_mutex_unlock(&pool->mutex);
+
+    destroy_victims(victims);
+    if (entry == NULL)
+        return NULL;
+
+    if (backend == NULL) {
+        backend = pool_backend_new(pool, uri);
+        if (backend == NULL)
+            return NULL;
+    }
+
+    lease_key = backend_key(&backend);
+    pthread_mutex_lock(&pool->mutex);
+    lease = rbh_idmap_put(pool->leases, &lease_key, &created);
+    if (lease != NULL)
+        *lease = entry;
+    pthread_mutex_unlock(&pool->mutex);
+
+    if (lease == NULL) {
+        int save_errno = errno;
+
+        rbh_backend_destroy(backend);
+        errno = save_errno;
+        return NULL;
+    }
+
+    return backend;
+}
+
+void
+rbh_backend_pool_checkin(struct rbh_backend_pool *pool,
+                         struct rbh_backend *backend)
+{
+    const struct rbh_id lease_key = backend_key(&backend);
+    struct idle_backend *victims = NULL;
+    struct pool_entry **lease;
+    bool kept = false;
+
+    pthread_mutex_lock(&pool->mutex);
+    lease = rbh_idmap_get(pool->leases, &lease_key);
+    if (lease != NULL) {
+        struct pool_entry *entry = *lease;
+
+        rbh_idmap_remove(pool->leases, &lease_key);
+        kept = pool_entry_push(pool, entry, backend);
+    }
+    pool_maybe_sweep(pool, &victims);
+    pthread_mutex_unlock(&pool->mutex);
+
+    if (!kept)
+        rbh_backend_destroy(backend);
+    destroy_victims(victims);
+}
+
+size_t
+rbh_backend_pool_evict(struct rbh_backend_pool *pool, unsigned int idle)
+{
+    struct idle_backend *victims = NULL;
+    size_t count;
+
+    pthread_mutex_lock(&pool->mutex);
+    count = pool_sweep(pool, idle, &victims);
+    pthread_mutex_unlock(&pool->mutex);
+
+    destroy_victims(victims);
+    return count;
+}
+
+void
+rbh_backend_pool_destroy(struct rbh_backend_pool *pool)
+{
+    rbh_backend_pool_evict(pool, 0);
+
+    while (pool->entries != NULL) {
+        struct pool_entry *next = pool->entries->next;
+
+        free(pool->entries);
+        pool->entries = next;
+    }
+
+    rbh_idmap_destroy(pool->leases);
+    rbh_idmap_destroy(pool->roots);
+    rbh_idmap_destroy(pool->uris);
+    pthread_mutex_destroy(&pool->mutex);
+    free(pool);
+}
@@ -0,0 +1,957 @@
+/* This file is part of the RobinHood Library
+ * Copyright (C) 2022 Commissariat a l'energie atomique et aux energies
+ *                    alternatives
+ *
+ * SPDX-License-Identifer: LGPL-3.0-or-later
+ */
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <errno.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "robinhood/backend_result_cache.h"
+#include "robinhood/idmap.h"
+#include "robinhood/statx.h"
+
+#include "budget.h"
+#include "fsentry.h"
+#include "value.h"
+
+struct cached_result {
+    /* The serialized query the results belong to */
+    struct rbh_id key;
+
+    struct rbh_fsentry **fsentries;
+    size_t count;
+
+    /* The number of bytes accounted for the result set */
+    size_t size;
+    /* When the result set expires (in milliseconds, 0 means never) */
+    uint64_t expiration;
+
+    /* The cache and the replay iterators that use the result set */
+    size_t refcount;
+
+    /* Most recently used first */
+    struct cached_result *prev;
+    struct cached_result *next;
+};
+
+struct result_cache_backend {
+    struct rbh_backend backend;
+    struct rbh_backend *origin;
+
+    /* Serialized query -> struct cached_result * */
+    struct rbh_idmap *results;
+    struct cached_result *head;
+    struct cached_result *tail;
+
+    unsigned int ttl;
+
+    /* Incremented whenever cached results are invalidated, results that were
+     * being recorded at the time are not cached.
+     */
+    uint64_t generation;
+
+    /* The backend itself and the record iterators that may still commit */
+    size_t refcount;
+
+    struct rbh_backend_result_cache_stats stats;
+};
+
+/* In milliseconds */
+static uint64_t
+now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+/*----------------------------------------------------------------------------*
+ |                                    keys                                    |
+ *----------------------------------------------------------------------------*/
+
+/* Queries are serialized field by field, every variable-length field is
+ * prefixed with its length, so that two different queries never share the
+ * same key. Fields that are irrelevant to a query (eg. the statx mask of a
+ * projection that does not include RBH_FP_STATX) are left out.
+ */
+
+struct key {
+    char *data;
+    size_t size;
+    size_t capacity;
+};
+
+static int
+key_append(struct key *key, const void *data, size_t size)
+{
+    if (key->size + size > key->capacity) {
+        size_t capacity = key->capacity ? key->capacity : 256;
+        char *tmp;
+
+        while (capacity < key->size + size)
+            capacity *= 2;
+
+        tmp = realloc(key->data, capacity);
+        if (tmp == NULL)
+            return -1;
+        key->data = tmp;
+        key->capacity = capacity;
+    }
+
+    if (size)
+        memcpy(key->data + key->size, data, size);
+    key->size += size;
+    return 0;
+}
+
+static int
+key_append_uint64(struct key *key, uint64_t integer)
+{
+    return key_append(key, &integer, sizeof(integer));
+}
+
+static int
+key_append_bytes(struct key *key, const void *data, size_t size)
+{
+    if (key_append_uint64(key, size))
+        return -1;
+    return key_append(key, data, size);
+}
+
+static int
+key_append_string(struct key *key, const char *string)
+{
+    return key_append_bytes(key, string, strlen(string));
+}
+
+static int
+key_append_value(struct key *key, const struct rbh_value *value);
+
+static int
+key_append_map(struct key *key, const struct rbh_value_map *map)
+{
+    if (key_append_uint64(key, map->count))
+        return -1;
+
+    for (size_t i = 0; i < map->count; i++) {
+        const struct rbh_value_pair *pair = &map->pairs[i];
+
+        if (key_append_string(key, pair->key))
+            return -1;
+
+        if (key_append_uint64(key, pair->value != NULL))
+            return -1;
+        if (pair->value && key_append_value(key, pair->value))
+            return -1;
+    }
+    return 0;
+}
+
+static int
+key_append_value(struct key *key, const struct rbh_value *value)
+{
+    const void *data;
+    size_t size;
+
+    if (key_append_uint64(key, value->type))
+        return -1;
+
+    switch (value->type) {
+    case RBH_VT_SEQUENCE:
+        if (key_append_uint64(key, value->sequence.count))
+            return -1;
+        for (size_t i = 0; i < value->sequence.count; i++) {
+            if (key_append_value(key, &value->sequence.values[i]))
+                return -1;
+        }
+        return 0;
+    case RBH_VT_MAP:
+        return key_append_map(key, &value->map);
+    case RBH_VT_REGEX:
+        if (key_append_uint64(key, value->regex.options))
+            return -1;
+        break;
+    default:
+        break;
+    }
+
+    if (value_scalar_bytes(value, &data, &size))
+        return -1;
+    return key_append_bytes(key, data, size);
+}
+
+static int
+key_append_field(struct key *key, const struct rbh_filter_field *field)
+{
+    if (key_append_uint64(key, field->fsentry))
+        return -1;
+
+    switch (field->fsentry) {
+    case RBH_FP_STATX:
+        return key_append_uint64(key, field->statx);
+    case RBH_FP_NAMESPACE_XATTRS:
+    case RBH_FP_INODE_XATTRS:
+        if (key_append_uint64(key, field->xattr != NULL))
+            return -1;
+        return field->xattr ? key_append_string(key, field->xattr) : 0;
+    default:
+        return 0;
+    }
+}
+
+static int
+key_append_filter(struct key *key, const struct rbh_filter *filter)
+{
+    /* Not a valid operator */
+    if (filter == NULL)
+        return key_append_uint64(key, UINT64_MAX);
+
+    if (key_append_uint64(key, filter->op))
+        return -1;
+
+    if (rbh_is_comparison_operator(filter->op)) {
+        if (key_append_field(key, &filter->compare.field))
+            return -1;
+        return key_append_value(key, &filter->compare.value);
+    }
+
+    if (key_append_uint64(key, filter->logical.count))
+        return -1;
+    for (size_t i = 0; i < filter->logical.count; i++) {
+        if (key_append_filter(key, filter->logical.filters[i]))
+            return -1;
+    }
+    return 0;
+}
+
+static int
+key_append_options(struct key *key, const struct rbh_filter_options *options)
+{
+    const struct rbh_filter_projection *projection = &options->projection;
+
+    if (key_append_uint64(key, projection->fsentry_mask))
+        return -1;
+    if (projection->fsentry_mask & RBH_FP_STATX
+            && key_append_uint64(key, projection->statx_mask))
+        return -1;
+    if (projection->fsentry_mask & RBH_FP_NAMESPACE_XATTRS
+            && key_append_map(key, &projection->xattrs.ns))
+        return -1;
+    if (projection->fsentry_mask & RBH_FP_INODE_XATTRS
+            && key_append_map(key, &projection->xattrs.inode))
+        return -1;
+
+    if (key_append_uint64(key, options->skip)
+            || key_append_uint64(key, options->limit))
+        return -1;
+
+    if (key_append_uint64(key, options->sort.count))
+        return -1;
+    for (size_t i = 0; i < options->sort.count; i++) {
+        const struct rbh_filter_sort *sort = &options->sort.items[i];
+
+        if (key_append_field(key, &sort->field)
+                || key_append_uint64(key, sort->ascending))
+            return -1;
+    }
+    return 0;
+}
+
+static int
+key_init(struct rbh_id *id, const struct rbh_filter *filter,
+         const struct rbh_filter_options *options)
+{
+    struct key key = {
+        .data = NULL,
+        .size = 0,
+        .capacity = 0,
+    };
+
+    if (key_append_filter(&key, filter) || key_append_options(&key, options)) {
+        int save_errno = errno;
+
+        free(key.data);
+        errno = save_errno;
+        return -1;
+    }
+
+    id->data = key.data;
+    id->size = key.size;
+    return 0;
+}
+
+/*----------------------------------------------------------------------------*
+ |                               cached_result                                |
+ *----------------------------------------------------------------------------*/
+
+/* The number of bytes rbh_fsentry_new() allocates (give or take alignment) */
+static size_t
+fsentry_size(const struct rbh_fsentry *fsentry)
+{
+    size_t size = sizeof(*fsentry);
+
+    if (fsentry->mask & RBH_FP_SYMLINK)
+        size += strlen(fsentry->symlink) + 1;
+    if (fsentry->mask & RBH_FP_ID)
+        size += fsentry->id.size;
+    if (fsentry->mask & RBH_FP_PARENT_ID)
+        size += fsentry->parent_id.size;
+    if (fsentry->mask & RBH_FP_NAME)
+        size += strlen(fsentry->name) + 1;
+    if (fsentry->mask & RBH_FP_STATX)
+        size += sizeof(*fsentry->statx);
+    if (fsentry->mask & RBH_FP_NAMESPACE_XATTRS)
+        size += value_map_data_size(&fsentry->xattrs.ns);
+    if (fsentry->mask & RBH_FP_INODE_XATTRS)
+        size += value_map_data_size(&fsentry->xattrs.inode);
+
+    return size;
+}
+
+/* Consumes `key', even on error */
+static struct cached_result *
+result_new(struct rbh_id *key)
+{
+    struct cached_result *result;
+
+    result = malloc(sizeof(*result));
+    if (result == NULL) {
+        int save_errno = errno;
+
+        free((char *)key->data);
+        errno = save_errno;
+        return NULL;
+    }
+
+    result->key = *key;
+    result->fsentries = NULL;
+    result->count = 0;
+    result->size = sizeof(*result) + key->size;
+    result->expiration = 0;
+    result->refcount = 1;
+    return result;
+}
+
+static void
+result_destroy(struct cached_result *result)
+{
+    for (size_t i = 0; i < result->count; i++)
+        free(result->fsentries[i]);
+    free(result->fsentries);
+    free((char *)result->key.data);
+    free(result);
+}
+
+/* Drop a reference on a result set that was committed to a cache */
+static void
+result_put(struct cached_result *result)
+{
+    if (--result->refcount)
+        return;
+
+    memory_discharge(result->size);
+    result_destroy(result);
+}
+
+/*----------------------------------------------------------------------------*
+ |                                   cache                                    |
+ *----------------------------------------------------------------------------*/
+
+static void
+lru_unlink(struct result_cache_backend *cache, struct cached_result *result)
+{
+    if (result->prev)
+        result->prev->next = result->next;
+    else
+        cache->head = result->next;
+
+    if (result->next)
+        result->next->prev = result->prev;
+    else
+        cache->tail = result->prev;
+}
+
+static void
+lru_push(struct result_cache_backend *cache, struct cached_result *result)
+{
+    result->prev = NULL;
+    result->next = cache->head;
+    if (cache->head)
+        cache->head->prev = result;
+    else
+        cache->tail = result;
+    cache->head = result;
+}
+
+static void
+cache_remove(struct result_cache_backend *cache, struct cached_result *result)
+{
+    lru_unlink(cache, result);
+    rbh_idmap_remove(cache->results, &result->key);
+
+    cache->stats.count--;
+    cache->stats.size -= result->size;
+    result_put(result);
+}
+
+/* Drop every cached result set, and the ones being recorded */
+static void
+cache_invalidate(struct result_cache_backend *cache)
+{
+    cache->stats.invalidations += cache->stats.count;
+    while (cache->head)
+        cache_remove(cache, cache->head);
+    cache->generation++;
+}
+
+static void
+cache_put(struct result_cache_backend *cache)
+{
+    if (--cache->refcount)
+        return;
+
+    /* Replay iterators hold their own reference on the result sets */
+    while (cache->head)
+        cache_remove(cache, cache->head);
+    rbh_idmap_destroy(cache->results);
+    rbh_backend_destroy(cache->origin);
+    free(cache);
+}
+
+static struct cached_result *
+cache_get(struct result_cache_backend *cache, const struct rbh_id *key)
+{
+    struct cached_result **slot;
+    struct cached_result *result;
+
+    slot = rbh_idmap_get(cache->results, key);
+    if (slot == NULL)
+        return NULL;
+    result = *slot;
+
+    if (result->expiration && now() >= result->expiration) {
+        cache_remove(cache, result);
+        cache->stats.expirations++;
+        errno = ENOENT;
+        return NULL;
+    }
+
+    lru_unlink(cache, result);
+    lru_push(cache, result);
+    return result;
+}
+
+/* Cache a result set that was recorded since `generation', as of `start'
+ *
+ * Consumes `result'. Errors are not reported: the worst that can happen is
+ * that the next run of the query is a miss.
+ */
+static void
+cache_commit(struct result_cache_backend *cache, struct cached_result *result,
+             uint64_t generation, uint64_t start)
+{
+    struct cached_result **slot;
+    struct cached_result *stale;
+    bool created;
+
+    /* The results may predate an update */
+    if (generation != cache->generation)
+        goto out_destroy_result;
+
+    /* Keys count towards the size of result sets, even empty ones may not fit
+     * in the cache
+     */
+    if (result->size > cache->stats.max_size)
+        goto out_destroy_result;
+
+    if (memory_charge(result->size))
+        goto out_destroy_result;
+
+    stale = cache_get(cache, &result->key);
+    if (stale)
+        cache_remove(cache, stale);
+
+    slot = rbh_idmap_put(cache->results, &result->key, &created);
+    if (slot == NULL) {
+        memory_discharge(result->size);
+        goto out_destroy_result;
+    }
+    *slot = result;
+
+    result->expiration = cache->ttl ? start + cache->ttl * UINT64_C(1000) : 0;
+    lru_push(cache, result);
+    cache->stats.count++;
+    cache->stats.size += result->size;
+
+    /* The result set fits on its own, so it is never evicted right away */
+    while (cache->stats.size > cache->stats.max_size) {
+        cache_remove(cache, cache->tail);
+        cache->stats.evictions++;
+    }
+    return;
+
+out_destroy_result:
+    result_destroy(result);
+}
+
+/*----------------------------------------------------------------------------*
+ |                              replay_iterator                               |
+ *----------------------------------------------------------------------------*/
+
+/* Yields copies of the fsentries of a cached result set */
+struct replay_iterator {
+    struct rbh_mut_iterator iterator;
+    struct cached_result *result;
+    size_t index;
+};
+
+static void *
+replay_iter_next(void *iterator)
+{
+    struct replay_iterator *replay = iterator;
+    struct rbh_fsentry *fsentry;
+
+    if (replay->index == replay->result->count) {
+        errno = ENODATA;
+        return NULL;
+    }
+
+    fsentry = fsentry_clone(replay->result->fsentries[replay->index]);
+    if (fsentry == NULL)
+        return NULL;
+
+    replay->index++;
+    return fsentry;
+}
+
+static void
+replay_iter_destroy(void *iterator)
+{
+    struct replay_iterator *replay = iterator;
+
+    result_put(replay->result);
+    free(replay);
+}
+
+static const struct rbh_mut_iterator_operations REPLAY_ITER_OPS = {
+    .next = replay_iter_next,
+    .destroy = replay_iter_destroy,
+};
+
+static const struct rbh_mut_iterator REPLAY_ITER = {
+    .ops = &REPLAY_ITER_OPS,
+};
+
+static struct rbh_mut_iterator *
+replay_iter_new(struct cached_result *result)
+{
+    struct replay_iterator *replay;
+
+    replay = malloc(sizeof(*replay));
+    if (replay == NULL)
+        return NULL;
+
+    replay->iterator = REPLAY_ITER;
+    replay->result = result;
+    replay->index = 0;
+    result->refcount++;
+
+    return &replay->iterator;
+}
+
+/*----------------------------------------------------------------------------*
+ |                              record_iterator                               |
+ *----------------------------------------------------------------------------*/
+
+/* Yields the fsentries of another iterator, and records copies of them: once
+ * the iterator is exhausted, the recorded result set is cached.
+ */
+struct record_iterator {
+    struct rbh_mut_iterator iterator;
+    struct rbh_mut_iterator *fsentries;
+    struct result_cache_backend *cache;
+    uint64_t generation;
+    uint64_t start;
+
+    /* NULL once recording is abandoned */
+    struct cached_result *result;
+    size_t capacity;
+};
+
+static void
+record_abandon(struct record_iterator *record)
+{
+    int save_errno = errno;
+
+    if (record->result)
+        result_destroy(record->result);
+    record->result = NULL;
+    errno = save_errno;
+}
+
+static int
+record_append(struct record_iterator *record,
+              const struct rbh_fsentry *fsentry)
+{
+    struct cached_result *result = record->result;
+    struct rbh_fsentry *copy;
+
+    if (result->count == record->capacity) {
+        size_t capacity = record->capacity ? record->capacity * 2 : 16;
+        struct rbh_fsentry **tmp;
+
+        tmp = reallocarray(result->fsentries, capacity, sizeof(*tmp));
+        if (tmp == NULL)
+            return -1;
+        result->fsentries = tmp;
+        record->capacity = capacity;
+    }
+
+    /* Result sets that would not fit in the cache are not worth recording */
+    result->size += sizeof(*result->fsentries) + fsentry_size(fsentry);
+    if (result->size > record->cache->stats.max_size)
+        return -1;
+
+    copy = fsentry_clone(fsentry);
+    if (copy == NULL)
+        return -1;
+
+    result->fsentries[result->count++] = copy;
+    return 0;
+}
+
+static void *
+record_iter_next(void *iterator)
+{
+    struct record_iterator *record = iterator;
+    struct rbh_fsentry *fsentry;
+
+    fsentry = rbh_mut_iter_next(record->fsentries);
+    if (fsentry == NULL) {
+        if (errno == ENODATA && record->result) {
+            cache_commit(record->cache, record->result, record->generation,
+                         record->start);
+            record->result = NULL;
+            errno = ENODATA;
+        }
+        record_abandon(record);
+        return NULL;
+    }
+
+    if (record->result && record_append(record, fsentry))
+        record_abandon(record);
+
+    return fsentry;
+}
+
+static void
+record_iter_destroy(void *iterator)
+{
+    struct record_iterator *record = iterator;
+
+    record_abandon(record);
+    rbh_mut_iter_destroy(record->fsentries);
+    cache_put(record->cache);
+    free(record);
+}
+
+static const struct rbh_mut_iterator_operations RECORD_ITER_OPS = {
+    .next = record_iter_next,
+    .destroy = record_iter_destroy,
+};
+
+static const struct rbh_mut_iterator RECORD_ITER = {
+    .ops = &RECORD_ITER_OPS,
+};
+
+/* Consumes `key', and `fsentries' on success */
+static struct rbh_mut_iterator *
+record_iter_new(struct result_cache_backend *cache,
+                struct rbh_mut_iterator *fsentries, struct rbh_id *key,
+                uint64_t start)
+{
+    struct record_iterator *record;
+
+    record = malloc(sizeof(*record));
+    if (record == NULL) {
+        int save_errno = errno;
+
+        free((char *)key->data);
+        errno = save_errno;
+        return NULL;
+    }
+
+    record->result = result_new(key);
+    if (record->result == NULL) {
+        int save_errno = errno;
+
+        free(record);
+        errno = save_errno;
+        return NULL;
+    }
+
+    record->iterator = RECORD_ITER;
+    record->fsentries = fsentries;
+    record->cache = cache;
+    record->generation = cache->generation;
+    record->start = start;
+    record->capacity = 0;
+    /* The fsentries may still be drained once the backend is destroyed */
+    cache->refcount++;
+
+    return &record->iterator;
+}
+
+/*----------------------------------------------------------------------------*
+ |                           result_cache_backend                             |
+ *----------------------------------------------------------------------------*/
+
+    /*--------------------------------------------------------------------*
+     |                            get_option()                            |
+     *--------------------------------------------------------------------*/
+
+static int
+result_cache_backend_get_option(void *backend, unsigned int option, void *data,
+                                size_t *data_size)
+{
+    struct result_cache_backend *cache = backend;
+
+    if (option != RBH_GBO_RESULT_CACHE_STATS)
+        return rbh_backend_get_option(cache->origin, option, data, data_size);
+
+    if (*data_size < sizeof(cache->stats)) {
+        *data_size = sizeof(cache->stats);
+        errno = EOVERFLOW;
+        return -1;
+    }
+    memcpy(data, &cache->stats, sizeof(cache->stats));
+    *data_size = sizeof(cache->stats);
+    return 0;
+}
+
+    /*--------------------------------------------------------------------*
+     |                            set_option()                            |
+     *--------------------------------------------------------------------*/
+
+static int
+result_cache_backend_set_option(void *backend, unsigned int option,
+                                const void *data, size_t data_size)
+{
+    struct result_cache_backend *cache = backend;
+
+    if (rbh_backend_set_option(cache->origin, option, data, data_size))
+        return -1;
+
+    /* Options may change what the backend yields (eg. garbage collection) */
+    cache_invalidate(cache);
+    return 0;
+}
+
+    /*--------------------------------------------------------------------*
+     |                              update()                              |
+     *--------------------------------------------------------------------*/
+
+static ssize_t
+result_cache_backend_update(void *backend, struct rbh_iterator *fsevents)
+{
+    struct result_cache_backend *cache = backend;
+
+    /* Telling which queries an fsevent affects is about as costly as running
+     * them again.
+     */
+    cache_invalidate(cache);
+    return rbh_backend_update(cache->origin, fsevents);
+}
+
+    /*--------------------------------------------------------------------*
+     |                              branch()                              |
+     *--------------------------------------------------------------------*/
+
+/* Consumes `backend', even on error */
+static struct rbh_backend *
+result_cache_wrap(struct result_cache_backend *cache,
+                  struct rbh_backend *backend)
+{
+    struct rbh_backend *wrapped;
+
+    if (backend == NULL)
+        return NULL;
+
+    wrapped = rbh_backend_result_cache_new(backend, cache->stats.max_size,
+                                           cache->ttl);
+    if (wrapped == NULL) {
+        int save_errno = errno;
+
+        rbh_backend_destroy(backend);
+        errno = save_errno;
+    }
+    return wrapped;
+}
+
+static struct rbh_backend *
+result_cache_backend_branch(void *backend, const struct rbh_id *id)
+{
+    struct result_cache_backend *cache = backend;
+
+    return result_cache_wrap(cache, rbh_backend_branch(cache->origin, id));
+}
+
+    /*--------------------------------------------------------------------*
+     |                              clone()                               |
+     *--------------------------------------------------------------------*/
+
+static struct rbh_backend *
+result_cache_backend_clone(void *backend)
+{
+    struct result_cache_backend *cache = backend;
+
+    return result_cache_wrap(cache, rbh_backend_clone(cache->origin));
+}
+
+    /*--------------------------------------------------------------------*
+     |                               root()                               |
+     *--------------------------------------------------------------------*/
+
+static struct rbh_fsentry *
+result_cache_backend_root(void *backend,
+                          const struct rbh_filter_projection *projection)
+{
+    struct result_cache_backend *cache = backend;
+
+    return rbh_backend_root(cache->origin, projection);
+}
+
+    /*--------------------------------------------------------------------*
+     |                              filter()                              |
+     *--------------------------------------------------------------------*/
+
+static struct rbh_mut_iterator *
+result_cache_backend_filter(void *backend, const struct rbh_filter *filter,
+                            const struct rbh_filter_options *options)
+{
+    struct result_cache_backend *cache = backend;
+    struct rbh_mut_iterator *fsentries;
+    struct rbh_mut_iterator *record;
+    struct cached_result *result;
+    struct rbh_id key;
+    uint64_t start;
+
+    /* Samples are meant to differ from one query to the next */
+    if (options->sample.rate != 0. || options->sample.size)
+        return rbh_backend_filter(cache->origin, filter, options);
+
+    /* Queries that cannot be serialized are not cached */
+    if (key_init(&key, filter, options))
+        return rbh_backend_filter(cache->origin, filter, options);
+
+    result = cache_get(cache, &key);
+    if (result) {
+        free((char *)key.data);
+        cache->stats.hits++;
+        return replay_iter_new(result);
+    }
+    cache->stats.misses++;
+
+    start = now();
+    fsentries = rbh_backend_filter(cache->origin, filter, options);
+    if (fsentries == NULL) {
+        int save_errno = errno;
+
+        free((char *)key.data);
+        errno = save_errno;
+        return NULL;
+    }
+
+    record = record_iter_new(cache, fsentries, &key, start);
+    /* The results can still be served, they just will not be cached */
+    return record ? record : fsentries;
+}
+
+    /*--------------------------------------------------------------------*
+     |                        filter_partitioned()                        |
+     *--------------------------------------------------------------------*/
+
+static int
+result_cache_backend_filter_partitioned(
+        void *backend, const struct rbh_filter *filter,
+        const struct rbh_filter_options *options,
+        struct rbh_mut_iterator **partitions, size_t count)
+{
+    struct result_cache_backend *cache = backend;
+
+    return rbh_backend_filter_partitioned(cache->origin, filter, options,
+                                          partitions, count);
+}
+
+    /*--------------------------------------------------------------------*
+     |                             destroy()                              |
+     *--------------------------------------------------------------------*/
+
+static void
+result_cache_backend_destroy(void *backend)
+{
+    cache_put(backend);
+}
+
+static const struct rbh_backend_operations RESULT_CACHE_BACKEND_OPS = {
+    .get_option = result_cache_backend_get_option,
+    .set_option = result_cache_backend_set_option,
+    .update = result_cache_backend_update,
+    .branch = result_cache_backend_branch,
+    .clone = result_cache_backend_clone,
+    .root = result_cache_backend_root,
+    .filter = result_cache_backend_filter,
+    .filter_partitioned = result_cache_backend_filter_partitioned,
+    .destroy = result_cache_backend_destroy,
+};
+
+struct rbh_backend *
+rbh_backend_result_cache_new(struct rbh_backend *backend, size_t max_size,
+                             unsigned int ttl)
+{
+    struct result_cache_backend *cache;
+
+    if (max_size == 0) {
+        errno = EINVAL;
+        return NULL;
+    }
+
+    cache = malloc(sizeof(*cache));
+    if (cache == NULL)
+        return NULL;
+
+    cache->results = rbh_idmap_new(sizeof(struct cached_result *), 0);
+    if (cache->results == NULL) {
+        int save_errno = errno;
+
+        free(cache);
+        errno = save_errno;
+        return NULL;
+    }
+
+    /* Result caching backends are transparent: they share the ID (and thus
+     * the options) of the backend they wrap.
+     */
+    cache->backend.id = backend->id;
+    cache->backend.name = backend->name;
+    cache->backend.ops = &RESULT_CACHE_BACKEND_OPS;
+    cache->origin = backend;
+    cache->head = cache->tail = NULL;
+    cache->ttl = ttl;
+    cache->generation = 0;
+    cache->refcount = 1;
+    memset(&cache->stats, 0, sizeof(cache->stats));
+    cache->stats.max_size = max_size;
+
+    return &cache->backend;
+}
@@ -0,0 +1,541 @@
+/* This file is part of the RobinHood Library
+ * Copyright (C) 2022 Commissariat a l'energie atomique et aux energies
+ *                    alternatives
+ *
+ * SPDX-License-Identifer: LGPL-3.0-or-later
+ */
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "robinhood/backend_tee.h"
+#include "robinhood/mpmc_queue.h"
+
+#include "fsevent.h"
+
+/* Fsevents are copied once, and shared by the writers of every backend: the
+ * last one to go past an fsevent frees it.
+ */
+struct shared_fsevent {
+    atomic_size_t readers;
+    struct rbh_fsevent *fsevent;
+};
+
+struct tee_child {
+    struct rbh_backend *backend;
+
+    /* Only used while an update is running */
+    struct rbh_mpmc_queue *queue;
+    pthread_t writer;
+    struct shared_fsevent *current;
+    ssize_t count;
+    int errnum;
+    /* rbh_backend_error is thread-local, keep the writer's message around */
+    char error[sizeof(rbh_backend_error)];
+    atomic_bool failed;
+
+    /* Statistics may be read while an update is running: the lag of a backend
+     * is the number of fsevents pushed into its buffer that it did not pop yet.
+     */
+    _Atomic uint64_t pushed;
+    _Atomic uint64_t popped;
+    _Atomic uint64_t updated;
+    _Atomic uint64_t max_lag;
+    _Atomic uint64_t failures;
+};
+
+struct tee_backend {
+    struct rbh_backend backend;
+    size_t buffer;
+    size_t count;
+    struct tee_child children[];
+};
+
+/*----------------------------------------------------------------------------*
+ |                               shared_fsevent                               |
+ *----------------------------------------------------------------------------*/
+
+static struct shared_fsevent *
+shared_fsevent_new(const struct rbh_fsevent *fsevent, size_t readers)
+{
+    struct shared_fsevent *shared;
+
+    shared = malloc(sizeof(*shared));
+    if (shared == NULL)
+        return NULL;
+
+    shared->fsevent = fsevent_clone(fsevent);
+    if (shared->fsevent == NULL) {
+        int save_errno = errno;
+
+        free(shared);
+        errno = save_errno;
+        return NULL;
+    }
+    atomic_init(&shared->readers, readers);
+
+    return shared;
+}
+
+static void
+shared_fsevent_put(struct shared_fsevent *shared)
+{
+    if (atomic_fetch_sub(&shared->readers, 1) != 1)
+        return;
+
+    free(shared->fsevent);
+    free(shared);
+}
+
+/*----------------------------------------------------------------------------*
+ |                                   writer                                   |
+ *----------------------------------------------------------------------------*/
+
+/* Pops the fsevents of a backend's buffer, until it is closed and empty */
+struct writer_iterator {
+    struct rbh_iterator iterator;
+    struct tee_child *child;
+};
+
+static struct shared_fsevent *
+writer_pop(struct tee_child *child)
+{
+    struct shared_fsevent *shared;
+    void *record;
+    size_t size;
+
+    if (child->current) {
+        shared_fsevent_put(child->current);
+        child->current = NULL;
+    }
+
+    record = rbh_mpmc_queue_acquire(child->queue, &size, true);
+    if (record == NULL)
+        return NULL;
+
+    memcpy(&shared, record, sizeof(shared));
+    rbh_mpmc_queue_release(child->queue, record);
+    atomic_fetch_add(&child->popped, 1);
+
+    /* Backends may use an fsevent until they ask for the next one */
+    child->current = shared;
+    return shared;
+}
+
+static const void *
+writer_iter_next(void *iterator)
+{
+    struct writer_iterator *writer = iterator;
+    struct shared_fsevent *shared = writer_pop(writer->child);
+
+    return shared ? shared->fsevent : NULL;
+}
+
+static void
+writer_iter_destroy(void *iterator)
+{
+    /* Writer iterators live on the stack of their writer thread */
+}
+
+static const struct rbh_iterator_operations WRITER_ITER_OPS = {
+    .next = writer_iter_next,
+    .destroy = writer_iter_destroy,
+};
+
+static const struct rbh_iterator WRITER_ITER = {
+    .ops = &WRITER_ITER_OPS,
+};
+
+static void *
+tee_write(void *data)
+{
+    struct writer_iterator writer = {
+        .iterator = WRITER_ITER,
+        .child = data,
+    };
+    struct tee_child *child = data;
+
+    child->count = rbh_backend_update(child->backend, &writer.iterator);
+    if (child->count < 0) {
+        child->errnum = errno;
+        if (child->errnum == RBH_BACKEND_ERROR)
+            memcpy(child->error, rbh_backend_error, sizeof(child->error));
+        atomic_store(&child->failed, true);
+    }
+
+    /* The backend may not have gone through every fsevent (eg. if it failed),
+     * the others still need their share of the buffer.
+     */
+    while (writer_pop(child) != NULL)
+        ;
+
+    return NULL;
+}
+
+/*----------------------------------------------------------------------------*
+ |                                tee_backend                                 |
+ *----------------------------------------------------------------------------*/
+
+    /*--------------------------------------------------------------------*
+     |                            get_option()                            |
+     *--------------------------------------------------------------------*/
+
+static void
+tee_child_stats(struct tee_child *child, struct rbh_backend_tee_stats *stats)
+{
+    uint64_t popped = atomic_load(&child->popped);
+
+    stats->updated = atomic_load(&child->updated);
+    stats->lag = atomic_load(&child->pushed) - popped;
+    stats->max_lag = atomic_load(&child->max_lag);
+    stats->failures = atomic_load(&child->failures);
+}
+
+static int
+tee_backend_get_option(void *backend, unsigned int option, void *data,
+                       size_t *data_size)
+{
+    struct tee_backend *tee = backend;
+    struct rbh_backend_tee_stats *stats = data;
+
+    if (option != RBH_GBO_TEE_STATS)
+        return rbh_backend_get_option(tee->children[0].backend, option, data,
+                                      data_size);
+
+    if (*data_size < tee->count * sizeof(*stats)) {
+        *data_size = tee->count * sizeof(*stats);
+        errno = EOVERFLOW;
+        return -1;
+    }
+
+    for (size_t i = 0; i < tee->count; i++)
+        tee_child_stats(&tee->children[i], &stats[i]);
+    *data_size = tee->count * sizeof(*stats);
+    return 0;
+}
+
+    /*--------------------------------------------------------------------*
+     |                            set_option()                            |
+     *--------------------------------------------------------------------*/
+
+static int
+tee_backend_set_option(void *backend, unsigned int option, const void *data,
+                       size_t data_size)
+{
+    struct tee_backend *tee = backend;
+
+    return rbh_backend_set_option(tee->children[0].backend, option, data,
+                                  data_size);
+}
+
+    /*--------------------------------------------------------------------*
+     |                              update()                              |
+     *--------------------------------------------------------------------*/
+
+static void
+tee_push(struct tee_child *child, struct shared_fsevent *shared)
+{
+    uint64_t lag;
+
+    /* Count the fsevent first, so that the lag never appears negative */
+    lag = atomic_fetch_add(&child->pushed, 1) + 1 - atomic_load(&child->popped);
+    if (lag > atomic_load_explicit(&child->max_lag, memory_order_relaxed))
+        atomic_store(&child->max_lag, lag);
+
+    /* Writers drain their buffer until it is closed, pushing cannot fail */
+    if (atomic_load(&child->failed)
+            || rbh_mpmc_queue_push(child->queue, &shared, sizeof(shared),
+                                   true)) {
+        atomic_fetch_add(&child->popped, 1);
+        shared_fsevent_put(shared);
+    }
+}
+
+/* Close the buffers of the first `count' backends, and wait for the first
+ * `spawned' writers
+ */
+static void
+tee_join(struct tee_backend *tee, size_t count, size_t spawned)
+{
+    for (size_t i = 0; i < count; i++)
+        rbh_mpmc_queue_close(tee->children[i].queue);
+
+    for (size_t i = 0; i < spawned; i++)
+        pthread_join(tee->children[i].writer, NULL);
+
+    for (size_t i = 0; i < count; i++)
+        rbh_mpmc_queue_destroy(tee->children[i].queue);
+}
+
+static int
+tee_start(struct tee_backend *tee)
+{
+    size_t count = 0;
+    size_t spawned = 0;
+    int save_errno;
+
+    for (; count < tee->count; count++) {
+        struct tee_child *child = &tee->children[count];
+
+        /* Records are pointers, prefixed with a header of the same size */
+        child->queue = rbh_mpmc_queue_new(sizeof(struct shared_fsevent *),
+                                          2 * tee->buffer
+                                            * sizeof(struct shared_fsevent *));
+        if (child->queue == NULL)
+            goto out_join;
+
+        child->current = NULL;
+        child->count = 0;
+        child->errnum = 0;
+        atomic_store(&child->failed, false);
+    }
+
+    for (; spawned < tee->count; spawned++) {
+        int rc;
+
+        rc = pthread_create(&tee->children[spawned].writer, NULL, tee_write,
+                            &tee->children[spawned]);
+        if (rc) {
+            errno = rc;
+            goto out_join;
+        }
+    }
+
+    return 0;
+
+out_join:
+    save_errno = errno;
+    tee_join(tee, count, spawned);
+    errno = save_errno;
+    return -1;
+}
+
+static ssize_t
+tee_backend_update(void *backend, struct rbh_iterator *fsevents)
+{
+    struct tee_backend *tee = backend;
+    const struct rbh_fsevent *fsevent;
+    struct tee_child *culprit = NULL;
+    int errnum = 0;
+
+    if (tee_start(tee))
+        return -1;
+
+    while ((fsevent = rbh_iter_next(fsevents)) != NULL) {
+        struct shared_fsevent *shared;
+
+        shared = shared_fsevent_new(fsevent, tee->count);
+        if (shared == NULL)
+            break;
+
+        for (size_t i = 0; i < tee->count; i++)
+            tee_push(&tee->children[i], shared);
+    }
+    if (errno != ENODATA)
+        errnum = errno;
+
+    tee_join(tee, tee->count, tee->count);
+
+    for (size_t i = 0; i < tee->count; i++) {
+        struct tee_child *child = &tee->children[i];
+
+        if (atomic_load(&child->failed)) {
+            atomic_fetch_add(&child->failures, 1);
+            if (errnum == 0) {
+                errnum = child->errnum;
+                culprit = child;
+            }
+        } else {
+            atomic_fetch_add(&child->updated, child->count);
+        }
+    }
+
+    if (errnum) {
+        if (culprit && errnum == RBH_BACKEND_ERROR)
+            memcpy(rbh_backend_error, culprit->error,
+                   sizeof(rbh_backend_error));
+        errno = errnum;
+        return -1;
+    }
+    return tee->children[0].count;
+}
+
+    /*--------------------------------------------------------------------*
+     |                              branch()                              |
+     *--------------------------------------------------------------------*/
+
+static struct rbh_backend *
+tee_map(struct tee_backend *tee,
+        struct rbh_backend *(*map)(struct rbh_backend *backend,
+                                   const struct rbh_id *id),
+        const struct rbh_id *id)
+{
+    struct rbh_backend *mapped;
+    struct rbh_backend **backends;
+    size_t count = 0;
+    int save_errno;
+
+    backends = malloc(tee->count * sizeof(*backends));
+    if (backends == NULL)
+        return NULL;
+
+    for (; count < tee->count; count++) {
+        backends[count] = map(tee->children[count].backend, id);
+        if (backends[count] == NULL)
+            goto out_destroy_backends;
+    }
+
+    mapped = rbh_backend_tee_new(backends, count, tee->buffer);
+    if (mapped == NULL)
+        goto out_destroy_backends;
+
+    free(backends);
+    return mapped;
+
+out_destroy_backends:
+    save_errno = errno;
+    for (size_t i = 0; i < count; i++)
+        rbh_backend_destroy(backends[i]);
+    free(backends);
+    errno = save_errno;
+    return NULL;
+}
+
+static struct rbh_backend *
+tee_branch_one(struct rbh_backend *backend, const struct rbh_id *id)
+{
+    return rbh_backend_branch(backend, id);
+}
+
+static struct rbh_backend *
+tee_backend_branch(void *backend, const struct rbh_id *id)
+{
+    return tee_map(backend, tee_branch_one, id);
+}
+
+    /*--------------------------------------------------------------------*
+     |                              clone()                               |
+     *--------------------------------------------------------------------*/
+
+static struct rbh_backend *
+tee_clone_one(struct rbh_backend *backend, const struct rbh_id *id)
+{
+    return rbh_backend_clone(backend);
+}
+
+static struct rbh_backend *
+tee_backend_clone(void *backend)
+{
+    return tee_map(backend, tee_clone_one, NULL);
+}
+
+    /*--------------------------------------------------------------------*
+     |                               root()                               |
+     *--------------------------------------------------------------------*/
+
+static struct rbh_fsentry *
+tee_backend_root(void *backend, const struct rbh_filter_projection *projection)
+{
+    struct tee_backend *tee = backend;
+
+    return rbh_backend_root(tee->children[0].backend, projection);
+}
+
+    /*--------------------------------------------------------------------*
+     |                              filter()                              |
+     *--------------------------------------------------------------------*/
+
+static struct rbh_mut_iterator *
+tee_backend_filter(void *backend, const struct rbh_filter *filter,
+                   const struct rbh_filter_options *options)
+{
+    struct tee_backend *tee = backend;
+
+    return rbh_backend_filter(tee->children[0].backend, filter, options);
+}
+
+    /*--------------------------------------------------------------------*
+     |                        filter_partitioned()                        |
+     *--------------------------------------------------------------------*/
+
+static int
+tee_backend_filter_partitioned(void *backend, const struct rbh_filter *filter,
+                               const struct rbh_filter_options *options,
+                               struct rbh_mut_iterator **partitions,
+                               size_t count)
+{
+    struct tee_backend *tee = backend;
+
+    return rbh_backend_filter_partitioned(tee->children[0].backend, filter,
+                                          options, partitions, count);
+}
+
+    /*--------------------------------------------------------------------*
+     |                             destroy()                              |
+     *--------------------------------------------------------------------*/
+
+static void
+tee_backend_destroy(void *backend)
+{
+    struct tee_backend *tee = backend;
+
+    for (size_t i = 0; i < tee->count; i++)
+        rbh_backend_destroy(tee->children[i].backend);
+    free(tee);
+}
+
+static const struct rbh_backend_operations TEE_BACKEND_OPS = {
+    .get_option = tee_backend_get_option,
+    .set_option = tee_backend_set_option,
+    .update = tee_backend_update,
+    .branch = tee_backend_branch,
+    .clone = tee_backend_clone,
+    .root = tee_backend_root,
+    .filter = tee_backend_filter,
+    .filter_partitioned = tee_backend_filter_partitioned,
+    .destroy = tee_backend_destroy,
+};
+
+struct rbh_backend *
+rbh_backend_tee_new(struct rbh_backend **backends, size_t count, size_t buffer)
+{
+    struct tee_backend *tee;
+
+    if (count == 0 || buffer == 0) {
+        errno = EINVAL;
+        return NULL;
+    }
+
+    tee = malloc(sizeof(*tee) + count * sizeof(*tee->children));
+    if (tee == NULL)
+        return NULL;
+
+    /* Tee backends share the ID (and thus the options) of their primary */
+    tee->backend.id = backends[0]->id;
+    tee->backend.name = backends[0]->name;
+    tee->backend.ops = &TEE_BACKEND_OPS;
+    tee->buffer = buffer;
+    tee->count = count;
+
+    for (size_t i = 0; i < count; i++) {
+        struct tee_child *child = &tee->children[i];
+
+        child->backend = backends[i];
+        atomic_init(&child->failed, false);
+        atomic_init(&child->pushed, 0);
+        atomic_init(&child->popped, 0);
+        atomic_init(&child->updated, 0);
+        atomic_init(&child->max_lag, 0);
+        atomic_init(&child->failures, 0);
+    }
+
+    return &tee->backend;
+}
@@ -736,6 +736,18 @@ lustre_iterator_new(const char *root, const char *entry, int statx_sync_type)
     return lustre_iter;
 }
 
+/* Top-level directories are grouped by the MDT which holds their inode */
+static int
+lustre_mdt_of(int fd)
+{
+    int mdt;
+
+    if (llapi_file_fget_mdtidx(fd, &mdt))
+        return -1;
+
+    return mdt;
+}
+
 struct rbh_backend *
 rbh_lustre_backend_new(const char *path)
 {
@@ -746,6 +758,7 @@ rbh_lustre_backend_new(const char *path)
         return NULL;
 
     lustre->iter_new = lustre_iterator_new;
+    lustre->group_of = lustre_mdt_of;
     lustre->backend.id = RBH_BI_LUSTRE;
     lustre->backend.name = RBH_LUSTRE_BACKEND_NAME;
 
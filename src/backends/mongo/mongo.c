@@ -90,15 +90,23 @@ bson_pipeline_from_filter_and_options(const struct rbh_filter *filter,
                                       const struct rbh_filter_options *options)
 {
     bson_t *pipeline;
+    bson_t document;
     uint8_t i = 0;
     bson_t array;
     bson_t stage;
 
-    if (options->skip > INT64_MAX || options->limit > INT64_MAX) {
+    if (options->skip > INT64_MAX || options->limit > INT64_MAX
+     || options->sample.size > INT64_MAX) {
         errno = ENOTSUP;
         return NULL;
     }
 
+    /* Written this way so that NaNs are rejected too */
+    if (!(options->sample.rate >= 0. && options->sample.rate <= 1.)) {
+        errno = EINVAL;
+        return NULL;
+    }
+
     pipeline = bson_new();
 
     if (BSON_APPEND_ARRAY_BEGIN(pipeline, "pipeline", &array)
@@ -108,6 +116,18 @@ bson_pipeline_from_filter_and_options(const struct rbh_filter *filter,
      && BSON_APPEND_DOCUMENT_BEGIN(&array, UINT8_TO_STR[i], &stage) && ++i
      && BSON_APPEND_RBH_FILTER(&stage, "$match", filter)
      && bson_append_document_end(&array, &stage)
+     && (options->sample.rate == 0. || options->sample.rate == 1.
+      || (BSON_APPEND_DOCUMENT_BEGIN(&array, UINT8_TO_STR[i], &document) && ++i
+       && BSON_APPEND_DOCUMENT_BEGIN(&document, "$match", &stage)
+       && BSON_APPEND_DOUBLE(&stage, "$sampleRate", options->sample.rate)
+       && bson_append_document_end(&document, &stage)
+       && bson_append_document_end(&array, &document)))
+     && (options->sample.size == 0
+      || (BSON_APPEND_DOCUMENT_BEGIN(&array, UINT8_TO_STR[i], &document) && ++i
+       && BSON_APPEND_DOCUMENT_BEGIN(&document, "$sample", &stage)
+       && BSON_APPEND_INT64(&stage, "size", options->sample.size)
+       && bson_append_document_end(&document, &stage)
+       && bson_append_document_end(&array, &document)))
      && (options->sort.count == 0
       || (BSON_APPEND_DOCUMENT_BEGIN(&array, UINT8_TO_STR[i], &stage) && ++i
        && BSON_APPEND_RBH_FILTER_SORTS(&stage, "$sort", options->sort.items,
@@ -563,13 +583,24 @@ mongo_backend_destroy(void *backend)
 static struct rbh_backend *
 mongo_backend_branch(void *backend, const struct rbh_id *id);
 
+static struct rbh_backend *
+mongo_backend_clone(void *backend);
+
+static int
+mongo_backend_filter_partitioned(void *backend, const struct rbh_filter *filter,
+                                 const struct rbh_filter_options *options,
+                                 struct rbh_mut_iterator **partitions,
+                                 size_t count);
+
 static const struct rbh_backend_operations MONGO_BACKEND_OPS = {
     .get_option = mongo_get_option,
     .set_option = mongo_set_option,
     .branch = mongo_backend_branch,
+    .clone = mongo_backend_clone,
     .root = mongo_root,
     .update = mongo_backend_update,
     .filter = mongo_backend_filter,
+    .filter_partitioned = mongo_backend_filter_partitioned,
     .destroy = mongo_backend_destroy,
 };
 
@@ -582,7 +613,8 @@ bson_from_options(const struct rbh_filter_options *options)
 {
     bson_t *bson;
 
-    if (options->skip > INT64_MAX || options->limit > INT64_MAX) {
+    if (options->skip > INT64_MAX || options->limit > INT64_MAX
+     || options->sample.rate != 0. || options->sample.size != 0) {
         errno = ENOTSUP;
         return NULL;
     }
@@ -681,9 +713,11 @@ mongo_gc_backend_filter(void *backend, const struct rbh_filter *filter_,
 static const struct rbh_backend_operations MONGO_GC_BACKEND_OPS = {
     .get_option = mongo_get_option,
     .set_option = mongo_set_option,
+    .clone = mongo_backend_clone,
     .root = mongo_root,
     .update = mongo_backend_update,
     .filter = mongo_gc_backend_filter,
+    .filter_partitioned = mongo_backend_filter_partitioned,
     .destroy = mongo_backend_destroy,
 };
 
@@ -1013,7 +1047,7 @@ record_id:
         /* Record this directory for a later traversal */
         if (value->binary.data == NULL) {
             switch (errno) {
-            case ENOBUFS: /* the ring is full */
+            case ENOBUFS: /* the ring is full, and cannot grow anymore */
                 /* Should we traverse directories or fsentries? */
                 switch (ringr_largest_reader(iter->ids)) {
                 case RRT_DIRECTORIES:
@@ -1052,7 +1086,7 @@ record_rbh_value:
         /* Then, record the associated rbh_value in `iterator->values' */
         if (rbh_ringr_push(*iter->values, value, sizeof(*value)) == NULL) {
             switch (errno) {
-            case ENOBUFS: /* the ring is full */
+            case ENOBUFS: /* the ring is full, and cannot grow anymore */
                 /* Should we traverse directories or fsentries? */
                 switch (ringr_largest_reader(iter->ids)) {
                 case RRT_DIRECTORIES:
@@ -1169,6 +1203,12 @@ filter_one(void *backend, const struct rbh_id *id,
 #define VALUE_RING_SIZE (1 << 14) /* 16MB */
 #define ID_RING_SIZE (1 << 14) /* 16MB */
 
+/* Rings grow rather than force a traversal whenever they are full, up to a
+ * point: every ID the value ring holds ends up in a single $in query.
+ */
+#define VALUE_RING_MAX_SIZE (1 << 20)
+#define ID_RING_MAX_SIZE (1 << 20)
+
 struct rbh_mut_iterator *
 generic_branch_backend_filter(void *backend, const struct rbh_filter *filter,
                               const struct rbh_filter_options *options)
@@ -1182,7 +1222,8 @@ generic_branch_backend_filter(void *backend, const struct rbh_filter *filter,
     /* The recursive traversal of the branch prevents a few features from
      * working out of the box.
      */
-    if (options->skip || options->limit || options->sort.count) {
+    if (options->skip || options->limit || options->sort.count
+     || options->sample.rate != 0. || options->sample.size) {
         errno = ENOTSUP;
         return NULL;
     }
@@ -1213,7 +1254,8 @@ generic_branch_backend_filter(void *backend, const struct rbh_filter *filter,
     }
     errno = save_errno;
 
-    iter->values[0] = rbh_ringr_new(VALUE_RING_SIZE);
+    iter->values[0] = rbh_ringr_new_growable(VALUE_RING_SIZE,
+                                             VALUE_RING_MAX_SIZE);
     if (iter->values[0] == NULL) {
         save_errno = errno;
         goto out_free_filter;
@@ -1225,7 +1267,7 @@ generic_branch_backend_filter(void *backend, const struct rbh_filter *filter,
         goto out_free_first_values_ringr;
     }
 
-    iter->ids[0] = rbh_ringr_new(ID_RING_SIZE);
+    iter->ids[0] = rbh_ringr_new_growable(ID_RING_SIZE, ID_RING_MAX_SIZE);
     if (iter->ids[0] == NULL) {
         save_errno = errno;
         goto out_free_second_values_ringr;
@@ -1266,8 +1308,12 @@ out_free_iter:
     return NULL;
 }
 
+static struct rbh_backend *
+mongo_branch_backend_clone(void *backend);
+
 static const struct rbh_backend_operations MONGO_BRANCH_BACKEND_OPS = {
     .branch = mongo_backend_branch,
+    .clone = mongo_branch_backend_clone,
     .root = mongo_branch_root,
     .update = mongo_backend_update,
     .filter = generic_branch_backend_filter,
@@ -1348,6 +1394,317 @@ mongo_backend_branch(void *backend, const struct rbh_id *id)
     return &branch->mongo.backend;
 }
 
+    /*--------------------------------------------------------------------*
+     |                               clone                                |
+     *--------------------------------------------------------------------*/
+
+/* mongoc_client_t is not thread-safe: every clone gets its own client, set up
+ * from the URI of the original one.
+ */
+
+static struct rbh_backend *
+mongo_backend_clone(void *backend)
+{
+    struct mongo_backend *mongo = backend;
+    struct mongo_backend *clone;
+
+    clone = malloc(sizeof(*clone));
+    if (clone == NULL)
+        return NULL;
+
+    if (mongo_backend_init_from_uri(clone,
+                                    mongoc_client_get_uri(mongo->client))) {
+        int save_errno = errno;
+
+        free(clone);
+        errno = save_errno;
+        return NULL;
+    }
+
+    /* Keeps the RBH_GBO_GC option */
+    clone->backend = mongo->backend;
+
+    return &clone->backend;
+}
+
+static struct rbh_backend *
+mongo_branch_backend_clone(void *backend)
+{
+    struct mongo_branch_backend *branch = backend;
+
+    return mongo_backend_branch(backend, &branch->id);
+}
+
+    /*--------------------------------------------------------------------*
+     |                         filter_partitioned                         |
+     *--------------------------------------------------------------------*/
+
+/* Partitions are ranges of _id, whose bounds are computed on a sample of the
+ * collection. Every partition queries its own clone of the backend, so that
+ * partitions can be consumed from different threads.
+ */
+
+/* The number of documents to sample per partition to compute bounds */
+#define PARTITION_SAMPLE_SIZE (1 << 10)
+
+struct partition_iterator {
+    struct rbh_mut_iterator iterator;
+    struct rbh_mut_iterator *fsentries;
+    struct rbh_backend *backend;
+};
+
+static void *
+partition_iter_next(void *iterator)
+{
+    struct partition_iterator *partition = iterator;
+
+    return rbh_mut_iter_next(partition->fsentries);
+}
+
+static void
+partition_iter_destroy(void *iterator)
+{
+    struct partition_iterator *partition = iterator;
+
+    rbh_mut_iter_destroy(partition->fsentries);
+    rbh_backend_destroy(partition->backend);
+    free(partition);
+}
+
+static const struct rbh_mut_iterator_operations PARTITION_ITER_OPS = {
+    .next = partition_iter_next,
+    .destroy = partition_iter_destroy,
+};
+
+static const struct rbh_mut_iterator PARTITION_ITER = {
+    .ops = &PARTITION_ITER_OPS,
+};
+
+/* Only yield the fsentries of `filter' whose ID is in [lower, upper) */
+static struct rbh_mut_iterator *
+partition_iter_new(struct mongo_backend *mongo, const struct rbh_filter *filter,
+                   const struct rbh_filter_options *options,
+                   const struct rbh_id *lower, const struct rbh_id *upper)
+{
+    struct rbh_filter bounds[2] = {
+        {
+            .op = RBH_FOP_GREATER_OR_EQUAL,
+        }, {
+            .op = RBH_FOP_STRICTLY_LOWER,
+        },
+    };
+    const struct rbh_filter *filters[3];
+    struct partition_iterator *partition;
+    struct rbh_filter and_filter = {
+        .op = RBH_FOP_AND,
+        .logical = {
+            .filters = filters,
+        },
+    };
+    const struct rbh_id *limits[2] = { lower, upper };
+    size_t count = 0;
+
+    for (size_t i = 0; i < 2; i++) {
+        const struct rbh_id *bound = limits[i];
+
+        bounds[i].compare.field.fsentry = RBH_FP_ID;
+        bounds[i].compare.value.type = RBH_VT_BINARY;
+        if (bound == NULL)
+            continue;
+
+        bounds[i].compare.value.binary.data = bound->data;
+        bounds[i].compare.value.binary.size = bound->size;
+        filters[count++] = &bounds[i];
+    }
+    if (filter)
+        filters[count++] = filter;
+    and_filter.logical.count = count;
+
+    partition = malloc(sizeof(*partition));
+    if (partition == NULL)
+        return NULL;
+
+    partition->backend = mongo_backend_clone(mongo);
+    if (partition->backend == NULL)
+        goto out_free_partition;
+
+    partition->fsentries = rbh_backend_filter(
+            partition->backend,
+            count == 0 ? NULL : count == 1 ? filters[0] : &and_filter,
+            options
+            );
+    if (partition->fsentries == NULL)
+        goto out_destroy_backend;
+
+    partition->iterator = PARTITION_ITER;
+    return &partition->iterator;
+
+out_destroy_backend:
+    {
+        int save_errno = errno;
+
+        rbh_backend_destroy(partition->backend);
+        errno = save_errno;
+    }
+out_free_partition:
+    {
+        int save_errno = errno;
+
+        free(partition);
+        errno = save_errno;
+    }
+    return NULL;
+}
+
+/* Fill `bounds' with the lower bound of every partition but the first one
+ *
+ * Returns the number of bounds that were computed (there may be less
+ * partitions than requested, if the collection is small).
+ */
+static ssize_t
+partition_bounds(struct mongo_backend *mongo, size_t count,
+                 struct rbh_id **bounds)
+{
+    mongoc_cursor_t *cursor;
+    bson_error_t error;
+    const bson_t *doc;
+    bson_t *pipeline;
+    size_t buckets = 0;
+    int save_errno;
+
+    pipeline = BCON_NEW("pipeline", "[",
+        "{", "$sample", "{",
+            "size", BCON_INT64(PARTITION_SAMPLE_SIZE * count),
+        "}", "}",
+        "{", "$bucketAuto", "{",
+            "groupBy", BCON_UTF8("$" MFF_ID),
+            "buckets", BCON_INT32(count),
+        "}", "}",
+    "]");
+
+    cursor = mongoc_collection_aggregate(mongo->entries, MONGOC_QUERY_NONE,
+                                         pipeline, NULL, NULL);
+    bson_destroy(pipeline);
+    if (cursor == NULL) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    while (buckets < count && mongoc_cursor_next(cursor, &doc)) {
+        bson_iter_t iter, subiter;
+        bson_subtype_t subtype;
+        const uint8_t *data;
+        uint32_t size;
+
+        /* { _id: { min: <_id>, max: <_id> }, count: <count> } */
+        if (!bson_iter_init_find(&iter, doc, "_id")
+         || !BSON_ITER_HOLDS_DOCUMENT(&iter)
+         || !bson_iter_recurse(&iter, &subiter)
+         || !bson_iter_find(&subiter, "min")
+         || !BSON_ITER_HOLDS_BINARY(&subiter)) {
+            save_errno = EINVAL;
+            goto out_free_bounds;
+        }
+
+        /* The first partition has no lower bound */
+        if (buckets++ == 0)
+            continue;
+
+        bson_iter_binary(&subiter, &subtype, &size, &data);
+        bounds[buckets - 2] = rbh_id_new((const char *)data, size);
+        if (bounds[buckets - 2] == NULL) {
+            save_errno = errno;
+            buckets--;
+            goto out_free_bounds;
+        }
+    }
+
+    if (mongoc_cursor_error(cursor, &error)) {
+        snprintf(rbh_backend_error, sizeof(rbh_backend_error), "%d.%d: %s",
+                 error.domain, error.code, error.message);
+        save_errno = RBH_BACKEND_ERROR;
+        goto out_free_bounds;
+    }
+
+    mongoc_cursor_destroy(cursor);
+    return buckets ? buckets - 1 : 0;
+
+out_free_bounds:
+    for (size_t i = 1; i < buckets; i++)
+        free(bounds[i - 1]);
+    mongoc_cursor_destroy(cursor);
+    errno = save_errno;
+    return -1;
+}
+
+static int
+mongo_backend_filter_partitioned(void *backend, const struct rbh_filter *filter,
+                                 const struct rbh_filter_options *options,
+                                 struct rbh_mut_iterator **partitions,
+                                 size_t count)
+{
+    struct mongo_backend *mongo = backend;
+    struct rbh_id **bounds;
+    ssize_t bounds_count;
+    int save_errno = 0;
+    size_t i;
+
+    /* Every partition applies `options' on its own */
+    if (options->skip || options->limit || options->sort.count
+     || options->sample.size) {
+        errno = ENOTSUP;
+        return -1;
+    }
+
+    if (count > INT32_MAX) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    if (rbh_filter_validate(filter))
+        return -1;
+
+    bounds = calloc(count, sizeof(*bounds));
+    if (bounds == NULL)
+        return -1;
+
+    bounds_count = count > 1 ? partition_bounds(mongo, count, bounds) : 0;
+    if (bounds_count < 0) {
+        save_errno = errno;
+        free(bounds);
+        errno = save_errno;
+        return -1;
+    }
+
+    for (i = 0; i < count; i++) {
+        if (i > (size_t)bounds_count)
+            /* Empty partition */
+            partitions[i] = rbh_mut_iter_array(NULL, 0, 0);
+        else
+            partitions[i] = partition_iter_new(
+                    mongo, filter, options, i > 0 ? bounds[i - 1] : NULL,
+                    i < (size_t)bounds_count ? bounds[i] : NULL
+                    );
+        if (partitions[i] == NULL) {
+            save_errno = errno;
+            break;
+        }
+    }
+
+    for (size_t j = 0; j < (size_t)bounds_count; j++)
+        free(bounds[j]);
+    free(bounds);
+
+    if (i < count) {
+        while (i-- > 0)
+            rbh_mut_iter_destroy(partitions[i]);
+        errno = save_errno;
+        return -1;
+    }
+
+    return 0;
+}
+
 /*----------------------------------------------------------------------------*
  |                               MONGO_BACKEND                                |
  *----------------------------------------------------------------------------*/
@@ -10,6 +10,7 @@
 #endif
 
 #include <assert.h>
+#include <dirent.h>
 #include <fts.h>
 #include <fcntl.h>
 #include <limits.h>
@@ -23,9 +24,11 @@
 
 #include "robinhood/backends/posix.h"
 #include "robinhood/backends/posix_internal.h"
+#include "robinhood/sampling.h"
 #include "robinhood/sstack.h"
 #include "robinhood/statx.h"
 
+#include "hash.h"
 
 /*----------------------------------------------------------------------------*
  |                               posix_iterator                               |
@@ -39,6 +42,23 @@ static const struct rbh_id ROOT_PARENT_ID = {
     .size = 0,
 };
 
+static const struct rbh_posix_shard NO_SHARD = {
+    .index = 0,
+    .count = 1,
+};
+
+/* Whether the children of `parent_id' belong to `shard' */
+static bool
+in_shard(const struct rbh_id *parent_id, const struct rbh_posix_shard *shard)
+{
+    const struct rbh_id *id = parent_id ? : &ROOT_PARENT_ID;
+
+    if (shard->count <= 1)
+        return true;
+
+    return hash64(id->data, id->size, 0) % shard->count == shard->index;
+}
+
 static struct rbh_id *
 id_from_fd(int fd)
 {
@@ -272,18 +292,9 @@ getxattrs(char *proc_fd_path, struct rbh_value_pair **_pairs, size_t *_pairs_cou
 static void
 sstack_clear(struct rbh_sstack *sstack)
 {
-    size_t readable;
+    static const struct rbh_sstack_mark BOTTOM;
 
-    while (true) {
-        int rc;
-
-        rbh_sstack_peek(sstack, &readable);
-        if (readable == 0)
-            break;
-
-        rc = rbh_sstack_pop(sstack, readable);
-        assert(rc == 0);
-    }
+    rbh_sstack_rewind(sstack, BOTTOM);
 }
 
 static __thread struct rbh_value_pair *ns_pairs;
@@ -476,6 +487,30 @@ out_close:
     return NULL;
 }
 
+/* Memoize the ID of a directory that was not sampled, its children need it */
+static int
+memoize_directory_id(FTSENT *ftsent)
+{
+    int save_errno;
+    int fd;
+
+    if (ftsent->fts_pointer != NULL)
+        return 0;
+
+    fd = openat(AT_FDCWD, ftsent->fts_accpath,
+                O_CLOEXEC | O_NOFOLLOW | O_PATH);
+    if (fd < 0)
+        return -1;
+
+    ftsent->fts_pointer = id_from_fd(fd);
+    save_errno = errno;
+    /* Ignore errors on close */
+    close(fd);
+    errno = save_errno;
+
+    return ftsent->fts_pointer == NULL ? -1 : 0;
+}
+
 static void *
 posix_iter_next(void *iterator)
 {
@@ -484,6 +519,11 @@ posix_iter_next(void *iterator)
     FTSENT *ftsent;
     int save_errno = errno;
 
+    if (posix_iter->limit && posix_iter->yielded >= posix_iter->limit) {
+        errno = ENODATA;
+        return NULL;
+    }
+
 skip:
     errno = 0;
     ftsent = fts_read(posix_iter->fts_handle);
@@ -509,6 +549,28 @@ skip:
         return NULL;
     }
 
+    if (!in_shard(ftsent->fts_parent->fts_pointer, &posix_iter->shard)) {
+        /* Entries of other shards are still walked through: the ID of
+         * directories is needed to shard their own children.
+         */
+        if (ftsent->fts_info == FTS_D && memoize_directory_id(ftsent)
+         && errno != ENOENT && errno != ESTALE)
+            return NULL;
+        goto skip;
+    }
+
+    if (posix_iter->sample_rate > 0.) {
+        if (posix_iter->sample_skip > 0) {
+            posix_iter->sample_skip--;
+            if (ftsent->fts_info == FTS_D && memoize_directory_id(ftsent)
+             && errno != ENOENT && errno != ESTALE)
+                return NULL;
+            goto skip;
+        }
+        posix_iter->sample_skip = rand64_geometric(&posix_iter->rand,
+                                                   posix_iter->sample_rate);
+    }
+
     fsentry = fsentry_from_ftsent(ftsent, posix_iter->statx_sync_type,
                                   posix_iter->prefix_len,
                                   posix_iter->ns_xattrs_callback);
@@ -516,6 +578,9 @@ skip:
         /* The entry moved from under our feet */
         goto skip;
 
+    if (fsentry != NULL)
+        posix_iter->yielded++;
+
     return fsentry;
 }
 
@@ -586,6 +651,11 @@ posix_iterator_new(const char *root, const char *entry, int statx_sync_type)
     posix_iter->ns_xattrs_callback = NULL;
     posix_iter->statx_sync_type = statx_sync_type;
     posix_iter->prefix_len = strcmp(root, "/") ? strlen(root) : 0;
+    posix_iter->limit = 0;
+    posix_iter->yielded = 0;
+    posix_iter->sample_rate = 0.;
+    posix_iter->sample_skip = 0;
+    posix_iter->shard = NO_SHARD;
     posix_iter->fts_handle =
         fts_open(paths, FTS_PHYSICAL | FTS_NOSTAT | FTS_XDEV, NULL);
     save_errno = errno;
@@ -623,15 +693,58 @@ posix_get_statx_sync_type(struct posix_backend *posix, void *data,
     return 0;
 }
 
+static int
+posix_get_shard(struct posix_backend *posix, void *data, size_t *data_size)
+{
+    if (*data_size < sizeof(posix->shard)) {
+        *data_size = sizeof(posix->shard);
+        errno = EOVERFLOW;
+        return -1;
+    }
+    memcpy(data, &posix->shard, sizeof(posix->shard));
+    *data_size = sizeof(posix->shard);
+    return 0;
+}
+
+static int
+posix_get_max_partitions_per_group(struct posix_backend *posix, void *data,
+                                   size_t *data_size)
+{
+    uint32_t max = posix->max_partitions_per_group;
+
+    if (*data_size < sizeof(max)) {
+        *data_size = sizeof(max);
+        errno = EOVERFLOW;
+        return -1;
+    }
+    memcpy(data, &max, sizeof(max));
+    *data_size = sizeof(max);
+    return 0;
+}
+
+/* Backends that overload this one (eg. lustre) share its options, with their
+ * own backend ID.
+ */
+static unsigned int
+posix_option(struct posix_backend *posix, unsigned int option)
+{
+    return option - RBH_BO_FIRST(posix->backend.id)
+         + RBH_BO_FIRST(RBH_BI_POSIX);
+}
+
 static int
 posix_backend_get_option(void *backend, unsigned int option, void *data,
                          size_t *data_size)
 {
     struct posix_backend *posix = backend;
 
-    switch (option) {
+    switch (posix_option(posix, option)) {
     case RBH_PBO_STATX_SYNC_TYPE:
         return posix_get_statx_sync_type(posix, data, data_size);
+    case RBH_PBO_SHARD:
+        return posix_get_shard(posix, data, data_size);
+    case RBH_PBO_MAX_PARTITIONS_PER_GROUP:
+        return posix_get_max_partitions_per_group(posix, data, data_size);
     }
 
     errno = ENOPROTOOPT;
@@ -676,15 +789,56 @@ posix_set_statx_sync_type(struct posix_backend *posix, const void *data,
     return -1;
 }
 
+static int
+posix_set_shard(struct posix_backend *posix, const void *data,
+                size_t data_size)
+{
+    struct rbh_posix_shard shard;
+
+    if (data_size != sizeof(shard)) {
+        errno = EINVAL;
+        return -1;
+    }
+    memcpy(&shard, data, sizeof(shard));
+
+    if (shard.index >= shard.count) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    posix->shard = shard;
+    return 0;
+}
+
+static int
+posix_set_max_partitions_per_group(struct posix_backend *posix,
+                                   const void *data, size_t data_size)
+{
+    uint32_t max;
+
+    if (data_size != sizeof(max)) {
+        errno = EINVAL;
+        return -1;
+    }
+    memcpy(&max, data, sizeof(max));
+
+    posix->max_partitions_per_group = max;
+    return 0;
+}
+
 static int
 posix_backend_set_option(void *backend, unsigned int option, const void *data,
                          size_t data_size)
 {
     struct posix_backend *posix = backend;
 
-    switch (option) {
+    switch (posix_option(posix, option)) {
     case RBH_PBO_STATX_SYNC_TYPE:
         return posix_set_statx_sync_type(posix, data, data_size);
+    case RBH_PBO_SHARD:
+        return posix_set_shard(posix, data, data_size);
+    case RBH_PBO_MAX_PARTITIONS_PER_GROUP:
+        return posix_set_max_partitions_per_group(posix, data, data_size);
     }
 
     errno = ENOPROTOOPT;
@@ -701,11 +855,17 @@ posix_root(void *backend, const struct rbh_filter_projection *projection)
     const struct rbh_filter_options options = {
         .projection = *projection,
     };
+    struct posix_backend *posix = backend;
     struct rbh_mut_iterator *fsentries;
+    struct rbh_posix_shard shard;
     struct rbh_fsentry *root;
     int save_errno;
 
+    /* The root is not part of any shard as far as lookups are concerned */
+    shard = posix->shard;
+    posix->shard = NO_SHARD;
     fsentries = rbh_backend_filter(backend, NULL, &options);
+    posix->shard = shard;
     if (fsentries == NULL)
         return NULL;
 
@@ -738,6 +898,60 @@ set_root_properties(FTSENT *root)
     root->fts_namelen = 0;
 }
 
+static int
+check_filter_options(const struct rbh_filter_options *options)
+{
+    if (options->skip > 0 || options->sort.count > 0) {
+        errno = ENOTSUP;
+        return -1;
+    }
+
+    /* Written this way so that NaNs are rejected too */
+    if (!(options->sample.rate >= 0. && options->sample.rate <= 1.)) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    return 0;
+}
+
+/* Apply `options' to `posix_iter', consumes `posix_iter' even on error */
+static struct rbh_mut_iterator *
+posix_iter_apply_options(struct posix_iterator *posix_iter,
+                         const struct rbh_filter_options *options)
+{
+    struct rbh_mut_iterator *fsentries;
+    size_t size = options->sample.size;
+    int save_errno;
+
+    posix_iter->limit = options->limit;
+    posix_iter->yielded = 0;
+    if (options->sample.rate > 0. && options->sample.rate < 1.) {
+        posix_iter->sample_rate = options->sample.rate;
+        rand64_init(&posix_iter->rand);
+        posix_iter->sample_skip = rand64_geometric(&posix_iter->rand,
+                                                   options->sample.rate);
+    }
+
+    if (size == 0)
+        return &posix_iter->iterator;
+
+    /* The first `limit' fsentries of a uniform sample of `size' fsentries are
+     * a uniform sample of `limit' fsentries.
+     */
+    if (options->limit > 0 && options->limit < size)
+        size = options->limit;
+    posix_iter->limit = 0;
+
+    fsentries = rbh_mut_iter_reservoir(&posix_iter->iterator, size, NULL);
+    if (fsentries == NULL) {
+        save_errno = errno;
+        rbh_mut_iter_destroy(&posix_iter->iterator);
+        errno = save_errno;
+    }
+    return fsentries;
+}
+
 static struct rbh_mut_iterator *
 posix_backend_filter(void *backend, const struct rbh_filter *filter,
                      const struct rbh_filter_options *options)
@@ -754,10 +968,8 @@ posix_backend_filter(void *backend, const struct rbh_filter *filter,
         return NULL;
     }
 
-    if (options->skip > 0 || options->limit > 0 || options->sort.count > 0) {
-        errno = ENOTSUP;
+    if (check_filter_options(options))
         return NULL;
-    }
 
     posix_iter = posix->iter_new(posix->root, NULL, posix->statx_sync_type);
     if (posix_iter == NULL)
@@ -773,7 +985,8 @@ posix_backend_filter(void *backend, const struct rbh_filter *filter,
         /* This should never happen */
         goto out_destroy_iter;
 
-    return &posix_iter->iterator;
+    posix_iter->shard = posix->shard;
+    return posix_iter_apply_options(posix_iter, options);
 
 out_destroy_iter:
     save_errno = errno;
@@ -782,6 +995,611 @@ out_destroy_iter:
     return NULL;
 }
 
+    /*--------------------------------------------------------------------*
+     |                        filter_partitioned()                        |
+     *--------------------------------------------------------------------*/
+
+/* Partitions are made of whole top-level subtrees of the backend's root.
+ *
+ * The size of each subtree is estimated with the number of entries its root
+ * holds, and subtrees are dealt to partitions, biggest first, so as to balance
+ * the estimated size of each partition.
+ *
+ * Backends which overload this one may also group subtrees (eg. by the server
+ * which holds them), in which case each partition is dedicated to a group.
+ * Only the roots of subtrees are grouped, whatever lies underneath them is
+ * walked along with them.
+ */
+
+struct subtree {
+    /* The path of the subtree, as `posix_iterator_new()' expects it */
+    char *entry;
+    size_t weight;
+    /* The subtree lives on another filesystem, do not descend into it */
+    bool xdev;
+    /* The group the subtree belongs to (-1 if it does not belong to any) */
+    int group;
+    /* The index of the partition the subtree is dealt to */
+    size_t partition;
+};
+
+static void
+subtrees_free(struct subtree *subtrees, size_t count)
+{
+    for (size_t i = 0; i < count; i++)
+        free(subtrees[i].entry);
+    free(subtrees);
+}
+
+static size_t
+directory_weight(int dirfd, const char *name, int (*group_of)(int fd),
+                 int *group)
+{
+    struct dirent *dirent;
+    size_t weight = 1;
+    DIR *dir;
+    int fd;
+
+    fd = openat(dirfd, name, O_RDONLY | O_DIRECTORY | O_CLOEXEC | O_NOFOLLOW);
+    if (fd < 0)
+        /* Whatever went wrong, fts will report it */
+        return weight;
+
+    if (group_of != NULL)
+        *group = group_of(fd);
+
+    dir = fdopendir(fd);
+    if (dir == NULL) {
+        close(fd);
+        return weight;
+    }
+
+    while ((dirent = readdir(dir)) != NULL) {
+        if (strcmp(dirent->d_name, ".") && strcmp(dirent->d_name, ".."))
+            weight++;
+    }
+
+    closedir(dir);
+    return weight;
+}
+
+/* List (weigh, and group) the top-level subtrees of `root' */
+static struct subtree *
+list_subtrees(const char *root, int (*group_of)(int fd), size_t *count)
+{
+    struct subtree *subtrees;
+    struct dirent *dirent;
+    size_t capacity = 64;
+    struct stat rootbuf;
+    int save_errno;
+    DIR *dir;
+
+    dir = opendir(root);
+    if (dir == NULL)
+        return NULL;
+
+    if (fstat(dirfd(dir), &rootbuf))
+        goto out_closedir;
+
+    subtrees = reallocarray(NULL, capacity, sizeof(*subtrees));
+    if (subtrees == NULL)
+        goto out_closedir;
+
+    *count = 0;
+    errno = 0;
+    while ((dirent = readdir(dir)) != NULL) {
+        struct subtree *subtree;
+        struct stat statbuf;
+
+        if (!strcmp(dirent->d_name, ".") || !strcmp(dirent->d_name, ".."))
+            continue;
+
+        if (fstatat(dirfd(dir), dirent->d_name, &statbuf,
+                    AT_SYMLINK_NOFOLLOW)) {
+            if (errno != ENOENT)
+                goto out_free_subtrees;
+            /* The entry moved from under our feet */
+            errno = 0;
+            continue;
+        }
+
+        if (*count == capacity) {
+            void *tmp;
+
+            capacity *= 2;
+            tmp = reallocarray(subtrees, capacity, sizeof(*subtrees));
+            if (tmp == NULL)
+                goto out_free_subtrees;
+            subtrees = tmp;
+        }
+
+        subtree = &subtrees[*count];
+        if (asprintf(&subtree->entry, "%s%s", strcmp(root, "/") ? "/" : "",
+                     dirent->d_name) < 0) {
+            errno = ENOMEM;
+            goto out_free_subtrees;
+        }
+        (*count)++;
+
+        subtree->xdev = statbuf.st_dev != rootbuf.st_dev;
+        subtree->group = -1;
+        subtree->weight = S_ISDIR(statbuf.st_mode) && !subtree->xdev ?
+            directory_weight(dirfd(dir), dirent->d_name, group_of,
+                             &subtree->group) : 1;
+    }
+
+    if (errno)
+        goto out_free_subtrees;
+
+    closedir(dir);
+    return subtrees;
+
+out_free_subtrees:
+    save_errno = errno;
+    subtrees_free(subtrees, *count);
+    errno = save_errno;
+out_closedir:
+    save_errno = errno;
+    closedir(dir);
+    errno = save_errno;
+    return NULL;
+}
+
+static int
+subtree_weight_cmp(const void *first_, const void *second_)
+{
+    const struct subtree *first = first_;
+    const struct subtree *second = second_;
+
+    /* Heaviest first */
+    return (first->weight < second->weight) - (first->weight > second->weight);
+}
+
+struct group {
+    int index;
+    size_t weight;
+    /* The partitions of the group are [first, first + count) */
+    size_t first;
+    size_t count;
+};
+
+static struct group *
+group_find(struct group *groups, size_t count, int index)
+{
+    for (size_t i = 0; i < count; i++) {
+        if (groups[i].index == index)
+            return &groups[i];
+    }
+    return NULL;
+}
+
+static int
+group_weight_cmp(const void *first_, const void *second_)
+{
+    const struct group *first = first_;
+    const struct group *second = second_;
+
+    /* Heaviest first */
+    return (first->weight < second->weight) - (first->weight > second->weight);
+}
+
+static size_t
+lightest_partition(const size_t *loads, size_t first, size_t count)
+{
+    size_t lightest = first;
+
+    for (size_t i = first + 1; i < first + count; i++) {
+        if (loads[i] < loads[lightest])
+            lightest = i;
+    }
+    return lightest;
+}
+
+/* Deal `subtrees' (heaviest first) to `count' partitions
+ *
+ * Partitions only ever walk the subtrees of a single group, and there are at
+ * most `max_per_group' partitions per group (0 means no limit), which are
+ * assigned in proportion of the groups' weights. If there are more groups than
+ * partitions, whole groups are dealt to partitions instead.
+ *
+ * Subtrees which do not belong to any group go to the lightest partition:
+ * partitions that no group may use get them first.
+ */
+static int
+deal_subtrees(struct subtree *subtrees, size_t subtrees_count, size_t count,
+              size_t max_per_group, size_t *sizes)
+{
+    size_t groups_count = 0;
+    struct group *groups;
+    size_t *loads;
+    size_t i;
+
+    loads = calloc(count, sizeof(*loads));
+    if (loads == NULL)
+        return -1;
+
+    groups = reallocarray(NULL, subtrees_count + 1, sizeof(*groups));
+    if (groups == NULL) {
+        int save_errno = errno;
+
+        free(loads);
+        errno = save_errno;
+        return -1;
+    }
+
+    for (i = 0; i < subtrees_count; i++) {
+        struct group *group;
+
+        if (subtrees[i].group < 0)
+            continue;
+
+        group = group_find(groups, groups_count, subtrees[i].group);
+        if (group == NULL) {
+            group = &groups[groups_count++];
+            group->index = subtrees[i].group;
+            group->weight = 0;
+        }
+        group->weight += subtrees[i].weight;
+    }
+
+    if (groups_count > count) {
+        qsort(groups, groups_count, sizeof(*groups), group_weight_cmp);
+
+        /* The root entry weighs in the first partition */
+        loads[0] = 1;
+        for (i = 0; i < groups_count; i++) {
+            groups[i].first = lightest_partition(loads, 0, count);
+            groups[i].count = 1;
+            loads[groups[i].first] += groups[i].weight;
+        }
+        memset(loads, 0, count * sizeof(*loads));
+    } else {
+        size_t first = 0;
+
+        /* Every group gets a partition, the others go one by one to the
+         * groups with the most weight per partition.
+         */
+        for (i = 0; i < groups_count; i++)
+            groups[i].count = 1;
+
+        for (i = groups_count; i < count; i++) {
+            struct group *busiest = NULL;
+
+            for (size_t j = 0; j < groups_count; j++) {
+                struct group *group = &groups[j];
+
+                if (max_per_group && group->count >= max_per_group)
+                    continue;
+
+                if (busiest == NULL || group->weight * busiest->count
+                                     > busiest->weight * group->count)
+                    busiest = group;
+            }
+
+            if (busiest == NULL)
+                /* Every group has as many partitions as it can have */
+                break;
+            busiest->count++;
+        }
+
+        for (i = 0; i < groups_count; i++) {
+            groups[i].first = first;
+            first += groups[i].count;
+        }
+    }
+
+    /* Greedily deal subtrees, the root entry weighs in the first partition */
+    loads[0] = 1;
+    for (i = 0; i < subtrees_count; i++) {
+        struct group *group = NULL;
+        size_t lightest;
+
+        if (subtrees[i].group >= 0)
+            group = group_find(groups, groups_count, subtrees[i].group);
+
+        lightest = group == NULL ? lightest_partition(loads, 0, count) :
+                                   lightest_partition(loads, group->first,
+                                                      group->count);
+        loads[lightest] += subtrees[i].weight;
+        sizes[lightest]++;
+        subtrees[i].partition = lightest;
+    }
+
+    free(groups);
+    free(loads);
+    return 0;
+}
+
+struct partition_iterator {
+    struct rbh_mut_iterator iterator;
+
+    struct posix_iterator *(*iter_new)(const char *, const char *, int);
+    int statx_sync_type;
+    struct rbh_posix_shard shard;
+    char *root;
+    /* The parent of every subtree */
+    struct rbh_id *root_id;
+
+    /* The root itself (only for the first partition) */
+    struct rbh_fsentry *first;
+
+    struct subtree *subtrees;
+    size_t count;
+    size_t index;
+
+    struct posix_iterator *current;
+    bool fresh;
+};
+
+static struct posix_iterator *
+partition_iter_subtree(struct partition_iterator *partition,
+                       const char *entry)
+{
+    struct posix_iterator *posix_iter;
+    FTSENT *roots;
+
+    posix_iter = partition->iter_new(partition->root, entry,
+                                     partition->statx_sync_type);
+    if (posix_iter == NULL)
+        return NULL;
+
+    /* Before the first call to fts_read(), fts_children() lists the roots of
+     * the traversal. This is the only chance to set the ID of their parent.
+     */
+    roots = fts_children(posix_iter->fts_handle, 0);
+    if (roots == NULL) {
+        int save_errno = errno ? : ENOENT;
+
+        rbh_mut_iter_destroy(&posix_iter->iterator);
+        errno = save_errno;
+        return NULL;
+    }
+    /* The content of fts_pointer is only ever read */
+    roots->fts_parent->fts_pointer = partition->root_id;
+    posix_iter->shard = partition->shard;
+
+    return posix_iter;
+}
+
+static void *
+partition_iter_next(void *iterator)
+{
+    struct partition_iterator *partition = iterator;
+    struct rbh_fsentry *fsentry;
+
+    if (partition->first) {
+        fsentry = partition->first;
+        partition->first = NULL;
+        return fsentry;
+    }
+
+    while (true) {
+        struct subtree *subtree = &partition->subtrees[partition->index];
+
+        if (partition->current == NULL) {
+            if (partition->index >= partition->count) {
+                errno = ENODATA;
+                return NULL;
+            }
+
+            /* Subtrees that live on another filesystem are only made of
+             * their root, which may not even belong to the shard
+             */
+            if (subtree->xdev
+             && !in_shard(partition->root_id, &partition->shard)) {
+                partition->index++;
+                continue;
+            }
+
+            partition->current = partition_iter_subtree(partition,
+                                                        subtree->entry);
+            if (partition->current == NULL) {
+                if (errno != ENOENT)
+                    return NULL;
+                /* The subtree moved from under our feet */
+                partition->index++;
+                continue;
+            }
+            partition->fresh = true;
+        }
+
+        fsentry = rbh_mut_iter_next(&partition->current->iterator);
+        if (fsentry != NULL) {
+            FTSENT *ftsent = partition->current->ftsent;
+
+            /* Do not descend into other filesystems */
+            if (partition->fresh && subtree->xdev) {
+                if (ftsent->fts_level != FTS_ROOTLEVEL) {
+                    /* The root moved from under our feet, and fts went past
+                     * it already
+                     */
+                    free(fsentry);
+                    rbh_mut_iter_destroy(&partition->current->iterator);
+                    partition->current = NULL;
+                    partition->index++;
+                    continue;
+                }
+                fts_set(partition->current->fts_handle, ftsent, FTS_SKIP);
+            }
+            partition->fresh = false;
+            return fsentry;
+        }
+
+        if (errno != ENODATA
+         && !(partition->fresh && (errno == ENOENT || errno == ESTALE)))
+            return NULL;
+
+        rbh_mut_iter_destroy(&partition->current->iterator);
+        partition->current = NULL;
+        partition->index++;
+    }
+}
+
+static void
+partition_iter_destroy(void *iterator)
+{
+    struct partition_iterator *partition = iterator;
+
+    if (partition->current)
+        rbh_mut_iter_destroy(&partition->current->iterator);
+    subtrees_free(partition->subtrees, partition->count);
+    free(partition->first);
+    free(partition->root_id);
+    free(partition->root);
+    free(partition);
+}
+
+static const struct rbh_mut_iterator_operations PARTITION_ITER_OPS = {
+    .next = partition_iter_next,
+    .destroy = partition_iter_destroy,
+};
+
+static const struct rbh_mut_iterator PARTITION_ITER = {
+    .ops = &PARTITION_ITER_OPS,
+};
+
+static struct partition_iterator *
+partition_iter_new(struct posix_backend *posix, const struct rbh_id *root_id,
+                   size_t count)
+{
+    struct partition_iterator *partition;
+    int save_errno;
+
+    partition = malloc(sizeof(*partition));
+    if (partition == NULL)
+        return NULL;
+
+    partition->subtrees = reallocarray(NULL, count ? : 1,
+                                       sizeof(*partition->subtrees));
+    if (partition->subtrees == NULL)
+        goto out_free_partition;
+
+    partition->root = strdup(posix->root);
+    if (partition->root == NULL)
+        goto out_free_subtrees;
+
+    partition->root_id = rbh_id_new(root_id->data, root_id->size);
+    if (partition->root_id == NULL)
+        goto out_free_root;
+
+    partition->iterator = PARTITION_ITER;
+    partition->iter_new = posix->iter_new;
+    partition->statx_sync_type = posix->statx_sync_type;
+    partition->shard = posix->shard;
+    partition->first = NULL;
+    partition->count = 0;
+    partition->index = 0;
+    partition->current = NULL;
+    partition->fresh = false;
+
+    return partition;
+
+out_free_root:
+    save_errno = errno;
+    free(partition->root);
+    errno = save_errno;
+out_free_subtrees:
+    save_errno = errno;
+    free(partition->subtrees);
+    errno = save_errno;
+out_free_partition:
+    save_errno = errno;
+    free(partition);
+    errno = save_errno;
+    return NULL;
+}
+
+static int
+posix_backend_filter_partitioned(void *backend, const struct rbh_filter *filter,
+                                 const struct rbh_filter_options *options,
+                                 struct rbh_mut_iterator **partitions,
+                                 size_t count)
+{
+    struct posix_backend *posix = backend;
+    struct subtree *subtrees;
+    struct rbh_fsentry *root;
+    size_t subtrees_count;
+    size_t *sizes;
+    int save_errno;
+    size_t i;
+
+    if (filter != NULL) {
+        errno = ENOTSUP;
+        return -1;
+    }
+
+    if (check_filter_options(options))
+        return -1;
+
+    /* Neither limits nor samples can be split into independent partitions */
+    if (options->limit || options->sample.rate != 0. || options->sample.size) {
+        errno = ENOTSUP;
+        return -1;
+    }
+
+    root = posix_root(backend, &options->projection);
+    if (root == NULL)
+        return -1;
+
+    subtrees = list_subtrees(posix->root, posix->group_of, &subtrees_count);
+    if (subtrees == NULL)
+        goto out_free_root;
+
+    qsort(subtrees, subtrees_count, sizeof(*subtrees), subtree_weight_cmp);
+
+    sizes = calloc(count, sizeof(*sizes));
+    if (sizes == NULL)
+        goto out_free_subtrees;
+
+    if (deal_subtrees(subtrees, subtrees_count, count,
+                      posix->max_partitions_per_group, sizes)) {
+        save_errno = errno;
+        free(sizes);
+        errno = save_errno;
+        goto out_free_subtrees;
+    }
+
+    for (i = 0; i < count; i++) {
+        struct partition_iterator *partition;
+
+        partition = partition_iter_new(posix, &root->id, sizes[i]);
+        if (partition == NULL)
+            goto out_destroy_partitions;
+        partitions[i] = &partition->iterator;
+    }
+
+    for (i = 0; i < subtrees_count; i++) {
+        struct partition_iterator *partition =
+            (struct partition_iterator *)partitions[subtrees[i].partition];
+
+        partition->subtrees[partition->count++] = subtrees[i];
+    }
+    free(subtrees);
+    free(sizes);
+
+    if (in_shard(&ROOT_PARENT_ID, &posix->shard))
+        ((struct partition_iterator *)partitions[0])->first = root;
+    else
+        free(root);
+    return 0;
+
+out_destroy_partitions:
+    save_errno = errno;
+    while (i-- > 0)
+        rbh_mut_iter_destroy(partitions[i]);
+    free(sizes);
+    errno = save_errno;
+out_free_subtrees:
+    save_errno = errno;
+    subtrees_free(subtrees, subtrees_count);
+    errno = save_errno;
+out_free_root:
+    save_errno = errno;
+    free(root);
+    errno = save_errno;
+    return -1;
+}
+
     /*--------------------------------------------------------------------*
      |                             destroy()                              |
      *--------------------------------------------------------------------*/
@@ -897,10 +1715,8 @@ posix_branch_backend_filter(void *backend, const struct rbh_filter *filter,
         return NULL;
     }
 
-    if (options->skip > 0 || options->limit > 0 || options->sort.count > 0) {
-        errno = ENOTSUP;
+    if (check_filter_options(options))
         return NULL;
-    }
 
     root = realpath(branch->posix.root, NULL);
     if (root == NULL)
@@ -920,17 +1736,25 @@ posix_branch_backend_filter(void *backend, const struct rbh_filter *filter,
     save_errno = errno;
     free(path);
     free(root);
-    errno = save_errno;
+    if (posix_iter == NULL) {
+        errno = save_errno;
+        return NULL;
+    }
 
-    return (struct rbh_mut_iterator *)posix_iter;
+    posix_iter->shard = branch->posix.shard;
+    return posix_iter_apply_options(posix_iter, options);
 }
 
 static struct rbh_backend *
 posix_backend_branch(void *backend, const struct rbh_id *id);
 
+static struct rbh_backend *
+posix_branch_backend_clone(void *backend);
+
 static const struct rbh_backend_operations POSIX_BRANCH_BACKEND_OPS = {
     .root = posix_root,
     .branch = posix_backend_branch,
+    .clone = posix_branch_backend_clone,
     .filter = posix_branch_backend_filter,
     .destroy = posix_backend_destroy,
 };
@@ -965,18 +1789,79 @@ posix_backend_branch(void *backend, const struct rbh_id *id)
 
     branch->posix.iter_new = posix_iterator_new;
     branch->posix.statx_sync_type = posix->statx_sync_type;
+    branch->posix.shard = posix->shard;
+    branch->posix.group_of = posix->group_of;
+    branch->posix.max_partitions_per_group = posix->max_partitions_per_group;
     rbh_id_copy(&branch->id, id, &data, &data_size);
     branch->posix.backend = POSIX_BRANCH_BACKEND;
 
     return &branch->posix.backend;
 }
 
+    /*--------------------------------------------------------------------*
+     |                              clone()                               |
+     *--------------------------------------------------------------------*/
+
+/* Clones only share the immutable parts of a backend (its ops, and the
+ * `iter_new' callback). The per-thread buffers this file uses (`handle',
+ * `names', ...) make it safe to use different clones from different threads.
+ */
+
+static struct rbh_backend *
+posix_backend_clone(void *backend)
+{
+    struct posix_backend *posix = backend;
+    struct posix_backend *clone;
+
+    clone = malloc(sizeof(*clone));
+    if (clone == NULL)
+        return NULL;
+
+    clone->root = strdup(posix->root);
+    if (clone->root == NULL) {
+        int save_errno = errno;
+
+        free(clone);
+        errno = save_errno;
+        return NULL;
+    }
+
+    clone->iter_new = posix->iter_new;
+    clone->statx_sync_type = posix->statx_sync_type;
+    clone->shard = posix->shard;
+    clone->group_of = posix->group_of;
+    clone->max_partitions_per_group = posix->max_partitions_per_group;
+    clone->backend = posix->backend;
+
+    return &clone->backend;
+}
+
+static struct rbh_backend *
+posix_branch_backend_clone(void *backend)
+{
+    struct posix_branch_backend *branch = backend;
+    struct posix_branch_backend *clone;
+    struct rbh_backend *tmp;
+
+    tmp = posix_backend_branch(backend, &branch->id);
+    if (tmp == NULL)
+        return NULL;
+
+    clone = (struct posix_branch_backend *)tmp;
+    clone->posix.iter_new = branch->posix.iter_new;
+    clone->posix.backend = branch->posix.backend;
+
+    return &clone->posix.backend;
+}
+
 static const struct rbh_backend_operations POSIX_BACKEND_OPS = {
     .get_option = posix_backend_get_option,
     .set_option = posix_backend_set_option,
     .branch = posix_backend_branch,
+    .clone = posix_backend_clone,
     .root = posix_root,
     .filter = posix_backend_filter,
+    .filter_partitioned = posix_backend_filter_partitioned,
     .destroy = posix_backend_destroy,
 };
 
@@ -1020,6 +1905,9 @@ rbh_posix_backend_new(const char *path)
 
     posix->iter_new = posix_iterator_new;
     posix->statx_sync_type = AT_RBH_STATX_SYNC_AS_STAT;
+    posix->shard = NO_SHARD;
+    posix->group_of = NULL;
+    posix->max_partitions_per_group = 0;
     posix->backend = POSIX_BACKEND;
 
     return &posix->backend;
@@ -0,0 +1,235 @@
+/* This file is part of the RobinHood Library
+ * Copyright (C) 2022 Commissariat a l'energie atomique et aux energies
+ *                    alternatives
+ *
+ * SPDX-License-Identifer: LGPL-3.0-or-later
+ */
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <errno.h>
+#include <stdalign.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "robinhood/broadcast.h"
+#include "robinhood/ring.h"
+#include "ring.h"
+
+#define CACHE_LINE_SIZE 64
+#define SEGMENT_COUNT 64
+
+/* As in struct rbh_spsc_ring, `head', `tail' and the readers' positions are
+ * positions in the stream of bytes that went through the ring, they never wrap
+ * around.
+ *
+ * The ring is split in SEGMENT_COUNT segments, each with a counter of the
+ * readers that went past it, which is never reset: in its n-th lap, a segment
+ * is released by the reader that brings its counter to (n + 1) * reader_count.
+ * That reader moves `head' forward by one segment.
+ *
+ * The threads that release consecutive segments may race with one another,
+ * and move `head' out of order. That is fine: every reader goes past
+ * segments in order, so once a segment is released, every segment before it
+ * was gone past by every reader, even if `head' does not account for it yet.
+ * `head' never gets ahead of the data that is actually released, and the
+ * counter of a segment is only ever incremented for its next lap once every
+ * reader is done with its current one.
+ */
+struct broadcast_reader {
+    alignas(CACHE_LINE_SIZE) uint64_t position;
+};
+
+struct broadcast_segment {
+    alignas(CACHE_LINE_SIZE) atomic_uint_fast64_t acks;
+};
+
+struct rbh_broadcast {
+    struct rbh_ring *ring;
+    size_t segment_size;
+    unsigned int reader_count;
+
+    struct broadcast_segment segments[SEGMENT_COUNT];
+
+    /* Written by the readers, whenever they release a segment */
+    alignas(CACHE_LINE_SIZE) atomic_uint_fast64_t head;
+
+    /* Written by the producer */
+    alignas(CACHE_LINE_SIZE) atomic_uint_fast64_t tail;
+    uint64_t head_cache;
+
+    struct broadcast_reader readers[];
+};
+
+struct rbh_broadcast *
+rbh_broadcast_new(size_t size, unsigned int readers)
+{
+    struct rbh_broadcast *broadcast;
+    struct rbh_ring *ring;
+
+    if (readers == 0) {
+        errno = EINVAL;
+        return NULL;
+    }
+
+    ring = rbh_ring_new(size);
+    if (ring == NULL)
+        return NULL;
+
+    /* Page sizes are multiples of SEGMENT_COUNT */
+    if (size % SEGMENT_COUNT) {
+        rbh_ring_destroy(ring);
+        errno = EINVAL;
+        return NULL;
+    }
+
+    broadcast = aligned_alloc(alignof(*broadcast),
+                              sizeof(*broadcast)
+                            + readers * sizeof(*broadcast->readers));
+    if (broadcast == NULL) {
+        int save_errno = errno;
+
+        rbh_ring_destroy(ring);
+        errno = save_errno;
+        return NULL;
+    }
+
+    broadcast->ring = ring;
+    broadcast->segment_size = size / SEGMENT_COUNT;
+    broadcast->reader_count = readers;
+    for (size_t i = 0; i < SEGMENT_COUNT; i++)
+        atomic_init(&broadcast->segments[i].acks, 0);
+    atomic_init(&broadcast->head, 0);
+    atomic_init(&broadcast->tail, 0);
+    broadcast->head_cache = 0;
+    for (unsigned int i = 0; i < readers; i++)
+        broadcast->readers[i].position = 0;
+
+    return broadcast;
+}
+
+/*----------------------------------------------------------------------------*
+ |                                  producer                                  |
+ *----------------------------------------------------------------------------*/
+
+static size_t
+broadcast_writable(struct rbh_broadcast *broadcast, uint64_t tail, size_t size)
+{
+    size_t writable = broadcast->ring->size - (tail - broadcast->head_cache);
+
+    if (writable < size) {
+        broadcast->head_cache = atomic_load_explicit(&broadcast->head,
+                                                     memory_order_acquire);
+        writable = broadcast->ring->size - (tail - broadcast->head_cache);
+    }
+
+    return writable;
+}
+
+void *
+rbh_broadcast_reserve(struct rbh_broadcast *broadcast, size_t size)
+{
+    uint64_t tail = atomic_load_explicit(&broadcast->tail,
+                                         memory_order_relaxed);
+
+    if (broadcast_writable(broadcast, tail, size) < size) {
+        errno = size > broadcast->ring->size ? EINVAL : ENOBUFS;
+        return NULL;
+    }
+
+    return broadcast->ring->data + tail % broadcast->ring->size;
+}
+
+int
+rbh_broadcast_commit(struct rbh_broadcast *broadcast, size_t size)
+{
+    uint64_t tail = atomic_load_explicit(&broadcast->tail,
+                                         memory_order_relaxed);
+
+    if (broadcast_writable(broadcast, tail, size) < size) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    atomic_store_explicit(&broadcast->tail, tail + size, memory_order_release);
+    return 0;
+}
+
+void *
+rbh_broadcast_push(struct rbh_broadcast *broadcast, const void *data,
+                   size_t size)
+{
+    void *address;
+
+    address = rbh_broadcast_reserve(broadcast, size);
+    if (address == NULL)
+        return NULL;
+
+    memcpy(address, data, size);
+    rbh_broadcast_commit(broadcast, size);
+    return address;
+}
+
+/*----------------------------------------------------------------------------*
+ |                                  readers                                   |
+ *----------------------------------------------------------------------------*/
+
+void *
+rbh_broadcast_peek(struct rbh_broadcast *broadcast, unsigned int reader,
+                   size_t *readable)
+{
+    uint64_t position = broadcast->readers[reader].position;
+
+    *readable = atomic_load_explicit(&broadcast->tail, memory_order_acquire)
+              - position;
+    return broadcast->ring->data + position % broadcast->ring->size;
+}
+
+int
+rbh_broadcast_ack(struct rbh_broadcast *broadcast, unsigned int reader,
+                  size_t count)
+{
+    uint64_t position = broadcast->readers[reader].position;
+    size_t segment_size = broadcast->segment_size;
+    uint64_t tail;
+
+    tail = atomic_load_explicit(&broadcast->tail, memory_order_acquire);
+    if (count > tail - position) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    broadcast->readers[reader].position = position + count;
+
+    /* Count this reader in every segment it went past */
+    for (uint64_t segment = position / segment_size;
+         segment < (position + count) / segment_size; segment++) {
+        struct broadcast_segment *current;
+        uint64_t lap = segment / SEGMENT_COUNT;
+        uint64_t acks;
+
+        current = &broadcast->segments[segment % SEGMENT_COUNT];
+        acks = atomic_fetch_add_explicit(&current->acks, 1,
+                                         memory_order_acq_rel) + 1;
+        /* Wrapping around is fine, both sides wrap the same way */
+        if (acks != (lap + 1) * broadcast->reader_count)
+            continue;
+
+        /* Every reader is done with the segment, release it */
+        atomic_fetch_add_explicit(&broadcast->head, segment_size,
+                                  memory_order_release);
+    }
+
+    return 0;
+}
+
+void
+rbh_broadcast_destroy(struct rbh_broadcast *broadcast)
+{
+    rbh_ring_destroy(broadcast->ring);
+    free(broadcast);
+}
@@ -0,0 +1,1135 @@
+/* This file is part of the RobinHood Library
+ * Copyright (C) 2022 Commissariat a l'energie atomique et aux energies
+ *                    alternatives
+ *
+ * SPDX-License-Identifer: LGPL-3.0-or-later
+ */
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <errno.h>
+#include <limits.h>
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "robinhood/distinct.h"
+#include "robinhood/fsentry.h"
+#include "robinhood/sstack.h"
+
+#include "hash.h"
+#include "value.h"
+
+/*----------------------------------------------------------------------------*
+ |                               blocked bloom                                |
+ *----------------------------------------------------------------------------*/
+
+/* A Bloom filter where every key only sets bits in a single, cache-line sized,
+ * block.
+ */
+
+#define BLOOM_BLOCK_BITS 512
+#define BLOOM_BLOCK_WORDS (BLOOM_BLOCK_BITS / 64)
+
+struct bloom {
+    uint64_t *words;
+    size_t block_count;
+    unsigned int hash_count;
+};
+
+static int
+bloom_init(struct bloom *bloom, size_t capacity, double false_positive_rate)
+{
+    double bits;
+
+    if (capacity == 0)
+        capacity = 1;
+
+    bits = -(double)capacity * log(false_positive_rate) / (M_LN2 * M_LN2);
+    bloom->block_count = ceil(bits / BLOOM_BLOCK_BITS);
+    bloom->hash_count = lround(bits / capacity * M_LN2);
+    if (bloom->hash_count < 1)
+        bloom->hash_count = 1;
+    if (bloom->hash_count > 16)
+        bloom->hash_count = 16;
+
+    bloom->words = calloc(bloom->block_count * BLOOM_BLOCK_WORDS,
+                          sizeof(*bloom->words));
+    return bloom->words == NULL ? -1 : 0;
+}
+
+static void
+bloom_fini(struct bloom *bloom)
+{
+    free(bloom->words);
+}
+
+static uint64_t *
+bloom_block(const struct bloom *bloom, uint64_t hash)
+{
+    return &bloom->words[hash64_mix(hash) % bloom->block_count
+                         * BLOOM_BLOCK_WORDS];
+}
+
+static bool
+bloom_test(const struct bloom *bloom, uint64_t hash)
+{
+    uint64_t *block = bloom_block(bloom, hash);
+    uint32_t h1 = hash;
+    uint32_t h2 = (hash >> 32) | 1;
+
+    for (unsigned int i = 0; i < bloom->hash_count; i++) {
+        uint32_t bit = (h1 + i * h2) % BLOOM_BLOCK_BITS;
+
+        if (!(block[bit / 64] & (UINT64_C(1) << (bit % 64))))
+            return false;
+    }
+    return true;
+}
+
+/* Returns whether or not \p hash was (maybe) already in \p bloom */
+static bool
+bloom_test_and_set(struct bloom *bloom, uint64_t hash)
+{
+    uint64_t *block = bloom_block(bloom, hash);
+    uint32_t h1 = hash;
+    uint32_t h2 = (hash >> 32) | 1;
+    bool found = true;
+
+    for (unsigned int i = 0; i < bloom->hash_count; i++) {
+        uint32_t bit = (h1 + i * h2) % BLOOM_BLOCK_BITS;
+        uint64_t mask = UINT64_C(1) << (bit % 64);
+
+        if (!(block[bit / 64] & mask)) {
+            block[bit / 64] |= mask;
+            found = false;
+        }
+    }
+    return found;
+}
+
+/*----------------------------------------------------------------------------*
+ |                                 exact set                                  |
+ *----------------------------------------------------------------------------*/
+
+/* An open addressing hash set of keys, the keys themselves are stored in an
+ * sstack.
+ *
+ * When the set grows past its memory limit, its keys are sorted and written to
+ * a temporary file, as a "run". Every run is associated with a sparse index
+ * (one entry every RUN_BLOCK_SIZE bytes) and a Bloom filter so that looking a
+ * key up in a run costs, most of the time, no I/O at all.
+ *
+ * The indexes and Bloom filters of runs count towards the memory limit, and
+ * once there are more than RUN_MERGE_COUNT runs, they are merged into a single
+ * one (in a new temporary file), which bounds the number of runs a lookup may
+ * have to go through.
+ */
+
+#define KEYS_CHUNK_SIZE (1 << 16)
+#define INITIAL_SLOT_COUNT 1024
+#define MIN_MEMORY_LIMIT (1 << 20)
+#define RUN_BLOCK_SIZE 4096
+#define RUN_FALSE_POSITIVE_RATE 0.01
+#define RUN_MERGE_COUNT 8
+#define RUN_READ_SIZE (16 * RUN_BLOCK_SIZE)
+
+struct slot {
+    uint64_t hash;
+    const char *key;
+    size_t size;
+};
+
+struct record_header {
+    uint64_t hash;
+    uint32_t size;
+} __attribute__((packed));
+
+struct run {
+    off_t offset;
+    size_t size;
+    size_t count;
+
+    struct {
+        uint64_t hash;
+        off_t offset;
+    } *index;
+    size_t index_count;
+    size_t index_size;
+
+    struct bloom bloom;
+};
+
+struct exact_set {
+    struct slot *slots;
+    size_t slot_count;
+    size_t used;
+
+    struct rbh_sstack *keys;
+    size_t key_bytes;
+    size_t limit;
+
+    const char *directory;
+    int fd;
+    off_t file_size;
+
+    struct run *runs;
+    size_t run_count;
+    size_t run_memory;
+
+    char *buffer;
+    size_t bufsize;
+};
+
+static int
+exact_set_init(struct exact_set *set, size_t limit, const char *directory)
+{
+    set->slots = calloc(INITIAL_SLOT_COUNT, sizeof(*set->slots));
+    if (set->slots == NULL)
+        return -1;
+
+    set->keys = rbh_sstack_new(KEYS_CHUNK_SIZE);
+    if (set->keys == NULL) {
+        int save_errno = errno;
+
+        free(set->slots);
+        errno = save_errno;
+        return -1;
+    }
+
+    set->slot_count = INITIAL_SLOT_COUNT;
+    set->used = 0;
+    set->key_bytes = 0;
+    set->limit = limit && limit < MIN_MEMORY_LIMIT ? MIN_MEMORY_LIMIT : limit;
+    set->directory = directory;
+    set->fd = -1;
+    set->file_size = 0;
+    set->runs = NULL;
+    set->run_count = 0;
+    set->run_memory = 0;
+    set->buffer = NULL;
+    set->bufsize = 0;
+    return 0;
+}
+
+static void
+run_fini(struct run *run)
+{
+    free(run->index);
+    bloom_fini(&run->bloom);
+}
+
+static void
+exact_set_fini(struct exact_set *set)
+{
+    for (size_t i = 0; i < set->run_count; i++)
+        run_fini(&set->runs[i]);
+    free(set->runs);
+    if (set->fd >= 0)
+        close(set->fd);
+    rbh_sstack_destroy(set->keys);
+    free(set->slots);
+    free(set->buffer);
+}
+
+/* The memory used by the hash table and the keys it points at */
+static size_t
+exact_set_table_memory(const struct exact_set *set)
+{
+    return set->slot_count * sizeof(*set->slots) + set->key_bytes;
+}
+
+static size_t
+exact_set_memory(const struct exact_set *set)
+{
+    return exact_set_table_memory(set) + set->run_memory;
+}
+
+static struct slot *
+slots_find(struct slot *slots, size_t count, uint64_t hash, const char *key,
+           size_t size)
+{
+    size_t mask = count - 1;
+
+    for (size_t i = hash & mask; true; i = (i + 1) & mask) {
+        struct slot *slot = &slots[i];
+
+        if (slot->key == NULL)
+            return slot;
+
+        if (slot->hash == hash && slot->size == size
+         && memcmp(slot->key, key, size) == 0)
+            return slot;
+    }
+}
+
+static int
+exact_set_grow(struct exact_set *set)
+{
+    size_t count = set->slot_count * 2;
+    struct slot *slots;
+
+    slots = calloc(count, sizeof(*slots));
+    if (slots == NULL)
+        return -1;
+
+    for (size_t i = 0; i < set->slot_count; i++) {
+        struct slot *slot = &set->slots[i];
+
+        if (slot->key == NULL)
+            continue;
+
+        *slots_find(slots, count, slot->hash, slot->key, slot->size) = *slot;
+    }
+
+    free(set->slots);
+    set->slots = slots;
+    set->slot_count = count;
+    return 0;
+}
+
+static int
+spill_file_open(const char *directory)
+{
+    char *path;
+    int fd;
+
+    if (directory == NULL)
+        directory = getenv("TMPDIR");
+    if (directory == NULL)
+        directory = "/tmp";
+
+    if (asprintf(&path, "%s/rbh-distinct-XXXXXX", directory) < 0)
+        return -1;
+
+    fd = mkstemp(path);
+    if (fd < 0) {
+        int save_errno = errno;
+
+        free(path);
+        errno = save_errno;
+        return -1;
+    }
+
+    unlink(path);
+    free(path);
+    return fd;
+}
+
+static int
+pwrite_all(int fd, const char *data, size_t size, off_t offset)
+{
+    while (size > 0) {
+        ssize_t count = pwrite(fd, data, size, offset);
+
+        if (count < 0)
+            return -1;
+
+        data += count;
+        size -= count;
+        offset += count;
+    }
+    return 0;
+}
+
+static int
+pread_all(int fd, char *data, size_t size, off_t offset)
+{
+    while (size > 0) {
+        ssize_t count = pread(fd, data, size, offset);
+
+        if (count < 0)
+            return -1;
+        if (count == 0) {
+            errno = EIO;
+            return -1;
+        }
+
+        data += count;
+        size -= count;
+        offset += count;
+    }
+    return 0;
+}
+
+static int
+reserve_buffer(struct exact_set *set, size_t size)
+{
+    char *buffer;
+
+    if (size <= set->bufsize)
+        return 0;
+
+    buffer = realloc(set->buffer, size);
+    if (buffer == NULL)
+        return -1;
+
+    set->buffer = buffer;
+    set->bufsize = size;
+    return 0;
+}
+
+/* Records (and slots) are sorted by hash, then by size, then by content */
+static int
+recordcmp(uint64_t lhash, size_t lsize, const char *lkey, uint64_t rhash,
+          size_t rsize, const char *rkey)
+{
+    if (lhash != rhash)
+        return lhash < rhash ? -1 : 1;
+    if (lsize != rsize)
+        return lsize < rsize ? -1 : 1;
+    return memcmp(lkey, rkey, lsize);
+}
+
+static int
+slotcmp(const void *_lhs, const void *_rhs)
+{
+    const struct slot *lhs = _lhs;
+    const struct slot *rhs = _rhs;
+
+    return recordcmp(lhs->hash, lhs->size, lhs->key, rhs->hash, rhs->size,
+                     rhs->key);
+}
+
+    /*--------------------------------------------------------------------*
+     |                             run writing                            |
+     *--------------------------------------------------------------------*/
+
+/* Allocate the index and the Bloom filter of a run of \p count records that
+ * are \p size bytes long in total, and that starts at \p offset
+ */
+static int
+run_init(struct run *run, off_t offset, size_t count, size_t size)
+{
+    /* Every entry of the index but the first one starts a new block */
+    run->index_size = size / RUN_BLOCK_SIZE + 1;
+    run->index = malloc(sizeof(*run->index) * run->index_size);
+    if (run->index == NULL)
+        return -1;
+
+    if (bloom_init(&run->bloom, count, RUN_FALSE_POSITIVE_RATE)) {
+        int save_errno = errno;
+
+        free(run->index);
+        errno = save_errno;
+        return -1;
+    }
+
+    run->offset = offset;
+    run->size = 0;
+    run->count = 0;
+    run->index_count = 0;
+    return 0;
+}
+
+static size_t
+run_memory(const struct run *run)
+{
+    return run->index_size * sizeof(*run->index)
+         + run->bloom.block_count * BLOOM_BLOCK_WORDS
+         * sizeof(*run->bloom.words);
+}
+
+/* Records are buffered in set->buffer, \p filled is the number of bytes it
+ * holds, that still need to be written to \p fd
+ */
+static int
+run_append(struct exact_set *set, int fd, struct run *run, size_t *filled,
+           uint64_t hash, const char *key, size_t size)
+{
+    struct record_header header = {
+        .hash = hash,
+        .size = size,
+    };
+    size_t length = sizeof(header) + size;
+
+    if (*filled + length > set->bufsize) {
+        if (pwrite_all(fd, set->buffer, *filled,
+                       run->offset + run->size - *filled))
+            return -1;
+        *filled = 0;
+
+        /* Keys may be larger than a chunk of the sstack */
+        if (reserve_buffer(set, length))
+            return -1;
+    }
+
+    if (run->index_count == 0
+     || run->offset + run->size - run->index[run->index_count - 1].offset
+            >= RUN_BLOCK_SIZE) {
+        run->index[run->index_count].hash = hash;
+        run->index[run->index_count].offset = run->offset + run->size;
+        run->index_count++;
+    }
+
+    memcpy(set->buffer + *filled, &header, sizeof(header));
+    memcpy(set->buffer + *filled + sizeof(header), key, size);
+    *filled += length;
+    run->size += length;
+    run->count++;
+
+    bloom_test_and_set(&run->bloom, hash);
+    return 0;
+}
+
+static int
+run_flush(struct exact_set *set, int fd, const struct run *run, size_t filled)
+{
+    return pwrite_all(fd, set->buffer, filled, run->offset + run->size - filled);
+}
+
+    /*--------------------------------------------------------------------*
+     |                             run reading                            |
+     *--------------------------------------------------------------------*/
+
+/* Reads the records of a run, in order */
+struct run_reader {
+    const struct run *run;
+    /* The offset of the next bytes to read from the file */
+    off_t offset;
+
+    char *buffer;
+    size_t bufsize;
+    /* The current record spans buffer[start:], buffer[:end] is valid */
+    size_t start;
+    size_t end;
+
+    /* The current record, `key' is NULL once the run is exhausted */
+    struct record_header header;
+    const char *key;
+};
+
+static int
+run_reader_init(struct run_reader *reader, const struct run *run)
+{
+    reader->buffer = malloc(RUN_READ_SIZE);
+    if (reader->buffer == NULL)
+        return -1;
+
+    reader->run = run;
+    reader->offset = run->offset;
+    reader->bufsize = RUN_READ_SIZE;
+    reader->start = 0;
+    reader->end = 0;
+    reader->key = NULL;
+    return 0;
+}
+
+/* Make sure the \p size bytes after reader->start are in reader->buffer */
+static int
+run_reader_fill(struct run_reader *reader, int fd, size_t size)
+{
+    off_t end = reader->run->offset + reader->run->size;
+    size_t length = reader->end - reader->start;
+    size_t count;
+
+    if (length >= size)
+        return 0;
+
+    memmove(reader->buffer, reader->buffer + reader->start, length);
+    reader->start = 0;
+    reader->end = length;
+
+    if (size > reader->bufsize) {
+        char *buffer = realloc(reader->buffer, size);
+
+        if (buffer == NULL)
+            return -1;
+
+        reader->buffer = buffer;
+        reader->bufsize = size;
+    }
+
+    count = reader->bufsize - length;
+    if (count > end - reader->offset)
+        count = end - reader->offset;
+    if (length + count < size) {
+        /* The run is truncated */
+        errno = EIO;
+        return -1;
+    }
+
+    if (pread_all(fd, reader->buffer + length, count, reader->offset))
+        return -1;
+
+    reader->offset += count;
+    reader->end += count;
+    return 0;
+}
+
+static int
+run_reader_next(struct run_reader *reader, int fd)
+{
+    if (reader->key != NULL)
+        reader->start += sizeof(reader->header) + reader->header.size;
+    reader->key = NULL;
+
+    if (reader->start == reader->end
+     && reader->offset == reader->run->offset + reader->run->size)
+        return 0;
+
+    if (run_reader_fill(reader, fd, sizeof(reader->header)))
+        return -1;
+    memcpy(&reader->header, reader->buffer + reader->start,
+           sizeof(reader->header));
+
+    if (run_reader_fill(reader, fd,
+                        sizeof(reader->header) + reader->header.size))
+        return -1;
+    reader->key = reader->buffer + reader->start + sizeof(reader->header);
+    return 0;
+}
+
+    /*--------------------------------------------------------------------*
+     |                          spilling, merging                         |
+     *--------------------------------------------------------------------*/
+
+/* Merge every run into a single one, in a new file */
+static int
+exact_set_merge(struct exact_set *set)
+{
+    struct run_reader *readers;
+    size_t filled = 0;
+    size_t count = 0;
+    size_t size = 0;
+    int save_errno;
+    struct run run;
+    int fd;
+
+    for (size_t i = 0; i < set->run_count; i++) {
+        count += set->runs[i].count;
+        size += set->runs[i].size;
+    }
+
+    readers = calloc(set->run_count, sizeof(*readers));
+    if (readers == NULL)
+        return -1;
+
+    fd = spill_file_open(set->directory);
+    if (fd < 0)
+        goto out_free_readers;
+
+    if (run_init(&run, 0, count, size))
+        goto out_close;
+
+    for (size_t i = 0; i < set->run_count; i++) {
+        if (run_reader_init(&readers[i], &set->runs[i])
+         || run_reader_next(&readers[i], set->fd))
+            goto out_fini_run;
+    }
+
+    /* Keys are unique across runs, there is nothing to deduplicate */
+    while (true) {
+        struct run_reader *next = NULL;
+
+        for (size_t i = 0; i < set->run_count; i++) {
+            struct run_reader *reader = &readers[i];
+
+            if (reader->key == NULL)
+                continue;
+
+            if (next == NULL
+             || recordcmp(reader->header.hash, reader->header.size,
+                          reader->key, next->header.hash, next->header.size,
+                          next->key) < 0)
+                next = reader;
+        }
+
+        if (next == NULL)
+            break;
+
+        if (run_append(set, fd, &run, &filled, next->header.hash, next->key,
+                       next->header.size)
+         || run_reader_next(next, set->fd))
+            goto out_fini_run;
+    }
+
+    if (run_flush(set, fd, &run, filled))
+        goto out_fini_run;
+
+    for (size_t i = 0; i < set->run_count; i++) {
+        free(readers[i].buffer);
+        run_fini(&set->runs[i]);
+    }
+    free(readers);
+
+    close(set->fd);
+    set->fd = fd;
+    set->file_size = run.size;
+    set->runs[0] = run;
+    set->run_count = 1;
+    set->run_memory = run_memory(&run);
+    return 0;
+
+out_fini_run:
+    save_errno = errno;
+    for (size_t i = 0; i < set->run_count; i++)
+        free(readers[i].buffer);
+    run_fini(&run);
+    errno = save_errno;
+out_close:
+    save_errno = errno;
+    close(fd);
+    errno = save_errno;
+out_free_readers:
+    save_errno = errno;
+    free(readers);
+    errno = save_errno;
+    return -1;
+}
+
+static int
+exact_set_spill(struct exact_set *set)
+{
+    struct rbh_sstack *keys;
+    struct slot *sorted;
+    size_t filled = 0;
+    size_t count = 0;
+    struct slot *slots;
+    struct run *runs;
+    struct run *run;
+    int save_errno;
+
+    if (set->fd < 0) {
+        set->fd = spill_file_open(set->directory);
+        if (set->fd < 0)
+            return -1;
+    }
+
+    runs = reallocarray(set->runs, set->run_count + 1, sizeof(*runs));
+    if (runs == NULL)
+        return -1;
+    set->runs = runs;
+    run = &runs[set->run_count];
+
+    sorted = malloc(sizeof(*sorted) * set->used);
+    if (sorted == NULL)
+        return -1;
+
+    for (size_t i = 0; i < set->slot_count; i++) {
+        if (set->slots[i].key != NULL)
+            sorted[count++] = set->slots[i];
+    }
+    qsort(sorted, count, sizeof(*sorted), slotcmp);
+
+    if (run_init(run, set->file_size, count,
+                 count * sizeof(struct record_header) + set->key_bytes))
+        goto out_free_sorted;
+
+    if (reserve_buffer(set, KEYS_CHUNK_SIZE + sizeof(struct record_header)))
+        goto out_fini_run;
+
+    for (size_t i = 0; i < count; i++) {
+        const struct slot *slot = &sorted[i];
+
+        if (run_append(set, set->fd, run, &filled, slot->hash, slot->key,
+                       slot->size))
+            goto out_fini_run;
+    }
+
+    if (run_flush(set, set->fd, run, filled))
+        goto out_fini_run;
+
+    /* Start over with an empty table */
+    keys = rbh_sstack_new(KEYS_CHUNK_SIZE);
+    if (keys == NULL)
+        goto out_fini_run;
+
+    slots = calloc(INITIAL_SLOT_COUNT, sizeof(*slots));
+    if (slots == NULL) {
+        save_errno = errno;
+        rbh_sstack_destroy(keys);
+        errno = save_errno;
+        goto out_fini_run;
+    }
+
+    free(sorted);
+
+    set->file_size += run->size;
+    set->run_memory += run_memory(run);
+    set->run_count++;
+
+    free(set->slots);
+    set->slots = slots;
+    set->slot_count = INITIAL_SLOT_COUNT;
+    set->used = 0;
+    rbh_sstack_destroy(set->keys);
+    set->keys = keys;
+    set->key_bytes = 0;
+
+    if (set->run_count > RUN_MERGE_COUNT)
+        return exact_set_merge(set);
+    return 0;
+
+out_fini_run:
+    save_errno = errno;
+    run_fini(run);
+    errno = save_errno;
+out_free_sorted:
+    save_errno = errno;
+    free(sorted);
+    errno = save_errno;
+    return -1;
+}
+
+    /*--------------------------------------------------------------------*
+     |                               lookups                              |
+     *--------------------------------------------------------------------*/
+
+/* Returns 1 if the key is in \p run, 0 if it is not, and -1 on error */
+static int
+run_contains(struct exact_set *set, const struct run *run, uint64_t hash,
+             const char *key, size_t size)
+{
+    size_t start;
+    size_t lo = 0;
+    size_t hi = run->index_count;
+
+    if (!bloom_test(&run->bloom, hash))
+        return 0;
+
+    /* Find the first block whose first hash is greater or equal to `hash' */
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+
+        if (run->index[mid].hash < hash)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    /* Records with that hash may start in the previous block */
+    start = lo > 0 ? lo - 1 : 0;
+
+    for (size_t block = start; block < run->index_count; block++) {
+        off_t end = block + 1 < run->index_count ?
+            run->index[block + 1].offset : run->offset + run->size;
+        size_t length = end - run->index[block].offset;
+        const char *data;
+
+        if (block > start && run->index[block].hash > hash)
+            return 0;
+
+        if (reserve_buffer(set, length))
+            return -1;
+
+        if (pread_all(set->fd, set->buffer, length, run->index[block].offset))
+            return -1;
+
+        data = set->buffer;
+        while (data < set->buffer + length) {
+            struct record_header header;
+
+            memcpy(&header, data, sizeof(header));
+            data += sizeof(header);
+
+            if (header.hash > hash)
+                return 0;
+
+            if (header.hash == hash && header.size == size
+             && memcmp(data, key, size) == 0)
+                return 1;
+
+            data += header.size;
+        }
+    }
+
+    return 0;
+}
+
+/* Returns 1 if the key was inserted, 0 if it was already there, and -1 on
+ * error
+ */
+static int
+exact_set_insert(struct exact_set *set, const char *key, size_t size)
+{
+    uint64_t hash = hash64(key, size, 0);
+    struct slot *slot;
+    char *copy;
+
+    slot = slots_find(set->slots, set->slot_count, hash, key, size);
+    if (slot->key != NULL)
+        return 0;
+
+    for (size_t i = 0; i < set->run_count; i++) {
+        int rc = run_contains(set, &set->runs[i], hash, key, size);
+
+        if (rc)
+            return rc > 0 ? 0 : -1;
+    }
+
+    copy = rbh_sstack_push(set->keys, key, size);
+    if (copy == NULL)
+        return -1;
+
+    slot->hash = hash;
+    slot->key = copy;
+    slot->size = size;
+    set->key_bytes += size;
+    set->used++;
+
+    /* Leave at least a quarter of the limit to the table, rather than spill
+     * ever smaller runs once the ones on disk use most of it
+     */
+    if (set->limit && exact_set_memory(set) > set->limit
+     && exact_set_table_memory(set) >= set->limit / 4)
+        return exact_set_spill(set) ? -1 : 1;
+
+    if (set->used * 2 > set->slot_count && exact_set_grow(set))
+        return -1;
+
+    return 1;
+}
+
+/*----------------------------------------------------------------------------*
+ |                            rbh_iter_distinct()                             |
+ *----------------------------------------------------------------------------*/
+
+struct distinct_iterator {
+    struct rbh_iterator iterator;
+
+    struct rbh_iterator *fsentries;
+    struct rbh_filter_field field;
+    bool owned;
+
+    enum rbh_distinct_mode mode;
+    union {
+        struct exact_set exact;
+        struct bloom bloom;
+    };
+
+    char *key;
+    size_t keysize;
+};
+
+/* A key is made of a byte that stores the type of the value, followed by the
+ * value itself.
+ */
+static int
+distinct_key(struct distinct_iterator *distinct,
+             const struct rbh_fsentry *fsentry, size_t *_size)
+{
+    struct rbh_value value;
+    const void *data;
+    size_t size;
+
+    if (rbh_fsentry_get_field(fsentry, &distinct->field, &value))
+        return -1;
+
+    if (value_scalar_bytes(&value, &data, &size))
+        return -1;
+
+    if (size + 1 > distinct->keysize) {
+        char *key = realloc(distinct->key, size + 1);
+
+        if (key == NULL)
+            return -1;
+        distinct->key = key;
+        distinct->keysize = size + 1;
+    }
+
+    distinct->key[0] = value.type;
+    memcpy(distinct->key + 1, data, size);
+    *_size = size + 1;
+    return 0;
+}
+
+/* Returns 1 if the key is new, 0 if it was already seen, and -1 on error */
+static int
+distinct_remember(struct distinct_iterator *distinct, size_t size)
+{
+    switch (distinct->mode) {
+    case RBH_DM_EXACT:
+        return exact_set_insert(&distinct->exact, distinct->key, size);
+    case RBH_DM_APPROXIMATE:
+        return bloom_test_and_set(&distinct->bloom,
+                                  hash64(distinct->key, size, 0)) ? 0 : 1;
+    }
+
+    errno = EINVAL;
+    return -1;
+}
+
+static const void *
+distinct_iter_next(void *iterator)
+{
+    struct distinct_iterator *distinct = iterator;
+    const void *fsentry;
+    int save_errno = errno;
+
+    while (true) {
+        size_t size;
+        int rc;
+
+        errno = 0;
+        fsentry = rbh_iter_next(distinct->fsentries);
+        if (fsentry == NULL)
+            return NULL;
+
+        if (distinct_key(distinct, fsentry, &size)) {
+            if (errno == ENODATA)
+                break;
+            rc = -1;
+        } else {
+            rc = distinct_remember(distinct, size);
+            if (rc > 0)
+                break;
+        }
+
+        if (distinct->owned) {
+            int tmp = errno;
+
+            free((void *)fsentry);
+            errno = tmp;
+        }
+
+        if (rc < 0)
+            return NULL;
+    }
+
+    errno = save_errno;
+    return fsentry;
+}
+
+static void
+distinct_iter_destroy(void *iterator)
+{
+    struct distinct_iterator *distinct = iterator;
+
+    switch (distinct->mode) {
+    case RBH_DM_EXACT:
+        exact_set_fini(&distinct->exact);
+        break;
+    case RBH_DM_APPROXIMATE:
+        bloom_fini(&distinct->bloom);
+        break;
+    }
+    rbh_iter_destroy(distinct->fsentries);
+    free(distinct->key);
+    free(distinct);
+}
+
+static const struct rbh_iterator_operations DISTINCT_ITER_OPS = {
+    .next = distinct_iter_next,
+    .destroy = distinct_iter_destroy,
+};
+
+static const struct rbh_iterator DISTINCT_ITER = {
+    .ops = &DISTINCT_ITER_OPS,
+};
+
+static struct distinct_iterator *
+distinct_iter_new(struct rbh_iterator *fsentries,
+                  const struct rbh_filter_field *field,
+                  const struct rbh_distinct_options *options, bool owned)
+{
+    struct distinct_iterator *distinct;
+    size_t directory_size = 0;
+    size_t xattr_size = 0;
+    int save_errno;
+    int rc;
+
+    switch (options->mode) {
+    case RBH_DM_EXACT:
+        break;
+    case RBH_DM_APPROXIMATE:
+        if (options->approximate.false_positive_rate > 0.
+         && options->approximate.false_positive_rate < 1.)
+            break;
+        /* Fallthrough */
+    default:
+        errno = EINVAL;
+        return NULL;
+    }
+
+    if (field && field->fsentry & (RBH_FP_NAMESPACE_XATTRS | RBH_FP_INODE_XATTRS)
+     && field->xattr)
+        xattr_size = strlen(field->xattr) + 1;
+
+    if (options->mode == RBH_DM_EXACT && options->exact.directory)
+        directory_size = strlen(options->exact.directory) + 1;
+
+    distinct = malloc(sizeof(*distinct) + xattr_size + directory_size);
+    if (distinct == NULL)
+        return NULL;
+
+    switch (options->mode) {
+    case RBH_DM_EXACT:
+        rc = exact_set_init(&distinct->exact, options->exact.memory,
+                            options->exact.directory);
+        break;
+    case RBH_DM_APPROXIMATE:
+        rc = bloom_init(&distinct->bloom, options->approximate.capacity,
+                        options->approximate.false_positive_rate);
+        break;
+    default:
+        __builtin_unreachable();
+    }
+    if (rc) {
+        save_errno = errno;
+        free(distinct);
+        errno = save_errno;
+        return NULL;
+    }
+
+    distinct->iterator = DISTINCT_ITER;
+    distinct->fsentries = fsentries;
+    distinct->owned = owned;
+    distinct->mode = options->mode;
+    distinct->key = NULL;
+    distinct->keysize = 0;
+
+    if (field == NULL) {
+        distinct->field.fsentry = RBH_FP_ID;
+    } else {
+        distinct->field = *field;
+        if (xattr_size)
+            distinct->field.xattr = memcpy(distinct + 1, field->xattr,
+                                           xattr_size);
+    }
+
+    if (directory_size)
+        distinct->exact.directory = memcpy((char *)(distinct + 1) + xattr_size,
+                                           options->exact.directory,
+                                           directory_size);
+
+    return distinct;
+}
+
+struct rbh_iterator *
+rbh_iter_distinct(struct rbh_iterator *fsentries,
+                  const struct rbh_filter_field *field,
+                  const struct rbh_distinct_options *options)
+{
+    struct distinct_iterator *distinct;
+
+    distinct = distinct_iter_new(fsentries, field, options, false);
+    if (distinct == NULL)
+        return NULL;
+
+    return &distinct->iterator;
+}
+
+/*----------------------------------------------------------------------------*
+ |                          rbh_mut_iter_distinct()                           |
+ *----------------------------------------------------------------------------*/
+
+struct rbh_mut_iterator *
+rbh_mut_iter_distinct(struct rbh_mut_iterator *fsentries,
+                      const struct rbh_filter_field *field,
+                      const struct rbh_distinct_options *options)
+{
+    struct distinct_iterator *distinct;
+
+    distinct = distinct_iter_new((struct rbh_iterator *)fsentries, field,
+                                 options, true);
+    if (distinct == NULL)
+        return NULL;
+
+    return (struct rbh_mut_iterator *)&distinct->iterator;
+}
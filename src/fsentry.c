@@ -16,9 +16,11 @@
 
 #include <sys/stat.h>
 
+#include "robinhood/filter.h"
 #include "robinhood/fsentry.h"
 #include "robinhood/statx.h"
 
+#include "fsentry.h"
 #include "utils.h"
 #include "value.h"
 
@@ -144,3 +146,203 @@ rbh_fsentry_new(const struct rbh_id *id, const struct rbh_id *parent_id,
 
     return fsentry;
 }
+
+struct rbh_fsentry *
+fsentry_clone(const struct rbh_fsentry *fsentry)
+{
+    unsigned int mask = fsentry->mask;
+
+    return rbh_fsentry_new(mask & RBH_FP_ID ? &fsentry->id : NULL,
+                           mask & RBH_FP_PARENT_ID ? &fsentry->parent_id : NULL,
+                           mask & RBH_FP_NAME ? fsentry->name : NULL,
+                           mask & RBH_FP_STATX ? fsentry->statx : NULL,
+                           mask & RBH_FP_NAMESPACE_XATTRS ?
+                               &fsentry->xattrs.ns : NULL,
+                           mask & RBH_FP_INODE_XATTRS ?
+                               &fsentry->xattrs.inode : NULL,
+                           mask & RBH_FP_SYMLINK ? fsentry->symlink : NULL);
+}
+
+static int
+statx_get_field(const struct rbh_statx *statxbuf, uint32_t field,
+                struct rbh_value *value)
+{
+    if (__builtin_popcount(field) != 1) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    if (!(statxbuf->stx_mask & field)) {
+        errno = ENODATA;
+        return -1;
+    }
+
+    switch (field) {
+    case RBH_STATX_TYPE:
+        value->type = RBH_VT_UINT32;
+        value->uint32 = statxbuf->stx_mode & S_IFMT;
+        break;
+    case RBH_STATX_MODE:
+        value->type = RBH_VT_UINT32;
+        value->uint32 = statxbuf->stx_mode & ~S_IFMT;
+        break;
+    case RBH_STATX_NLINK:
+        value->type = RBH_VT_UINT32;
+        value->uint32 = statxbuf->stx_nlink;
+        break;
+    case RBH_STATX_UID:
+        value->type = RBH_VT_UINT32;
+        value->uint32 = statxbuf->stx_uid;
+        break;
+    case RBH_STATX_GID:
+        value->type = RBH_VT_UINT32;
+        value->uint32 = statxbuf->stx_gid;
+        break;
+    case RBH_STATX_ATIME_SEC:
+        value->type = RBH_VT_INT64;
+        value->int64 = statxbuf->stx_atime.tv_sec;
+        break;
+    case RBH_STATX_MTIME_SEC:
+        value->type = RBH_VT_INT64;
+        value->int64 = statxbuf->stx_mtime.tv_sec;
+        break;
+    case RBH_STATX_CTIME_SEC:
+        value->type = RBH_VT_INT64;
+        value->int64 = statxbuf->stx_ctime.tv_sec;
+        break;
+    case RBH_STATX_BTIME_SEC:
+        value->type = RBH_VT_INT64;
+        value->int64 = statxbuf->stx_btime.tv_sec;
+        break;
+    case RBH_STATX_ATIME_NSEC:
+        value->type = RBH_VT_UINT32;
+        value->uint32 = statxbuf->stx_atime.tv_nsec;
+        break;
+    case RBH_STATX_MTIME_NSEC:
+        value->type = RBH_VT_UINT32;
+        value->uint32 = statxbuf->stx_mtime.tv_nsec;
+        break;
+    case RBH_STATX_CTIME_NSEC:
+        value->type = RBH_VT_UINT32;
+        value->uint32 = statxbuf->stx_ctime.tv_nsec;
+        break;
+    case RBH_STATX_BTIME_NSEC:
+        value->type = RBH_VT_UINT32;
+        value->uint32 = statxbuf->stx_btime.tv_nsec;
+        break;
+    case RBH_STATX_INO:
+        value->type = RBH_VT_UINT64;
+        value->uint64 = statxbuf->stx_ino;
+        break;
+    case RBH_STATX_SIZE:
+        value->type = RBH_VT_UINT64;
+        value->uint64 = statxbuf->stx_size;
+        break;
+    case RBH_STATX_BLOCKS:
+        value->type = RBH_VT_UINT64;
+        value->uint64 = statxbuf->stx_blocks;
+        break;
+    case RBH_STATX_MNT_ID:
+        value->type = RBH_VT_UINT64;
+        value->uint64 = statxbuf->stx_mnt_id;
+        break;
+    case RBH_STATX_BLKSIZE:
+        value->type = RBH_VT_UINT32;
+        value->uint32 = statxbuf->stx_blksize;
+        break;
+    case RBH_STATX_ATTRIBUTES:
+        value->type = RBH_VT_UINT64;
+        value->uint64 = statxbuf->stx_attributes;
+        break;
+    case RBH_STATX_RDEV_MAJOR:
+        value->type = RBH_VT_UINT32;
+        value->uint32 = statxbuf->stx_rdev_major;
+        break;
+    case RBH_STATX_RDEV_MINOR:
+        value->type = RBH_VT_UINT32;
+        value->uint32 = statxbuf->stx_rdev_minor;
+        break;
+    case RBH_STATX_DEV_MAJOR:
+        value->type = RBH_VT_UINT32;
+        value->uint32 = statxbuf->stx_dev_major;
+        break;
+    case RBH_STATX_DEV_MINOR:
+        value->type = RBH_VT_UINT32;
+        value->uint32 = statxbuf->stx_dev_minor;
+        break;
+    default:
+        errno = EINVAL;
+        return -1;
+    }
+
+    return 0;
+}
+
+static int
+xattrs_get_field(const struct rbh_value_map *xattrs, const char *key,
+                 struct rbh_value *value)
+{
+    if (key == NULL) {
+        value->type = RBH_VT_MAP;
+        value->map = *xattrs;
+        return 0;
+    }
+
+    for (size_t i = 0; i < xattrs->count; i++) {
+        const struct rbh_value_pair *pair = &xattrs->pairs[i];
+
+        if (strcmp(pair->key, key))
+            continue;
+
+        if (pair->value == NULL)
+            break;
+
+        *value = *pair->value;
+        return 0;
+    }
+
+    errno = ENODATA;
+    return -1;
+}
+
+int
+rbh_fsentry_get_field(const struct rbh_fsentry *fsentry,
+                      const struct rbh_filter_field *field,
+                      struct rbh_value *value)
+{
+    if (!(fsentry->mask & field->fsentry)) {
+        /* Also catches invalid values of field->fsentry */
+        errno = __builtin_popcount(field->fsentry) == 1 ? ENODATA : EINVAL;
+        return -1;
+    }
+
+    switch (field->fsentry) {
+    case RBH_FP_ID:
+        value->type = RBH_VT_BINARY;
+        value->binary.data = fsentry->id.data;
+        value->binary.size = fsentry->id.size;
+        return 0;
+    case RBH_FP_PARENT_ID:
+        value->type = RBH_VT_BINARY;
+        value->binary.data = fsentry->parent_id.data;
+        value->binary.size = fsentry->parent_id.size;
+        return 0;
+    case RBH_FP_NAME:
+        value->type = RBH_VT_STRING;
+        value->string = fsentry->name;
+        return 0;
+    case RBH_FP_STATX:
+        return statx_get_field(fsentry->statx, field->statx, value);
+    case RBH_FP_SYMLINK:
+        value->type = RBH_VT_STRING;
+        value->string = fsentry->symlink;
+        return 0;
+    case RBH_FP_NAMESPACE_XATTRS:
+        return xattrs_get_field(&fsentry->xattrs.ns, field->xattr, value);
+    case RBH_FP_INODE_XATTRS:
+        return xattrs_get_field(&fsentry->xattrs.inode, field->xattr, value);
+    }
+
+    errno = EINVAL;
+    return -1;
+}
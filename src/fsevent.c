@@ -20,6 +20,7 @@
 #include "robinhood/fsevent.h"
 #include "robinhood/statx.h"
 
+#include "fsevent.h"
 #include "utils.h"
 #include "value.h"
 
@@ -148,7 +149,7 @@ fsevent_data_size(const struct rbh_fsevent *fsevent)
     return size;
 }
 
-static struct rbh_fsevent *
+struct rbh_fsevent *
 fsevent_clone(const struct rbh_fsevent *fsevent)
 {
     struct rbh_fsevent *clone;
@@ -12,11 +12,13 @@
 #include <assert.h>
 #include <errno.h>
 #include <fcntl.h>
+#include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
 
 #include "robinhood/id.h"
 
+#include "hash.h"
 #include "lu_fid.h"
 
 int
@@ -204,3 +206,65 @@ rbh_file_handle_from_id(const struct rbh_id *id)
 
     return handle;
 }
+
+/*----------------------------------------------------------------------------*
+ |                               rbh_compact_id                               |
+ *----------------------------------------------------------------------------*/
+
+int
+rbh_compact_id_init(struct rbh_compact_id *compact, const struct rbh_id *id)
+{
+    uint64_t hash;
+    char *data;
+
+    if (id->size > UINT32_MAX) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    if (id->size > RBH_COMPACT_ID_INLINE_SIZE) {
+        data = malloc(id->size);
+        if (data == NULL)
+            return -1;
+        memcpy(data, id->data, id->size);
+        compact->data = data;
+    } else {
+        memset(compact->bytes, 0, sizeof(compact->bytes));
+        if (id->size > 0)
+            memcpy(compact->bytes, id->data, id->size);
+    }
+
+    compact->size = id->size;
+    hash = hash64(id->data, id->size, 0);
+    compact->hash = hash ^ (hash >> 32);
+    return 0;
+}
+
+int
+rbh_compact_id_copy(struct rbh_compact_id *dest,
+                    const struct rbh_compact_id *src)
+{
+    char *data;
+
+    if (src->size <= RBH_COMPACT_ID_INLINE_SIZE) {
+        *dest = *src;
+        return 0;
+    }
+
+    data = malloc(src->size);
+    if (data == NULL)
+        return -1;
+    memcpy(data, src->data, src->size);
+
+    dest->size = src->size;
+    dest->hash = src->hash;
+    dest->data = data;
+    return 0;
+}
+
+void
+rbh_compact_id_fini(struct rbh_compact_id *compact)
+{
+    if (compact->size > RBH_COMPACT_ID_INLINE_SIZE)
+        free(compact->data);
+}
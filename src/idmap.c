@@ -0,0 +1,619 @@
+/* This file is part of the RobinHood Library
+ * Copyright (C) 2022 Commissariat a l'energie atomique et aux energies
+ *                    alternatives
+ *
+ * SPDX-License-Identifer: LGPL-3.0-or-later
+ */
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <errno.h>
+#include <stdalign.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "robinhood/idmap.h"
+
+#include "hash.h"
+#include "utils.h"
+
+#define INITIAL_SLOT_COUNT 16
+#define INITIAL_ARENA_SIZE 4096
+#define HASH_SEED UINT64_C(0x6964)
+#define NONE SIZE_MAX
+
+/* `distance' is 0 for empty slots, and 1 + the distance between a slot and the
+ * one its key hashes to otherwise.
+ *
+ * `hash' is the upper half of the hash of the key, it filters out most of the
+ * keys that do not match without looking them up in the arena. The lower half
+ * of the hash decides where keys go in the table.
+ */
+struct slot {
+    uint32_t distance;
+    uint32_t hash;
+    size_t entry;
+};
+
+/* Entries are stored in the arena as a header, followed by the value, followed
+ * by the ID.
+ *
+ * Entries are linked together in LRU order, most recently used first. Links
+ * are offsets in the arena, so that the arena can be reallocated.
+ */
+struct entry {
+    size_t prev;
+    size_t next;
+    uint64_t hash;
+    size_t size;
+    alignas(max_align_t) char data[];
+};
+
+struct rbh_idmap {
+    struct slot *slots;
+    size_t slot_count;
+    size_t count;
+
+    char *arena;
+    size_t arena_size;
+    size_t arena_used;
+    size_t garbage;
+
+    size_t value_size;
+    size_t limit;
+
+    size_t head;
+    size_t tail;
+};
+
+struct rbh_idmap *
+rbh_idmap_new(size_t value_size, size_t memory_limit)
+{
+    struct rbh_idmap *map;
+
+    map = malloc(sizeof(*map));
+    if (map == NULL)
+        return NULL;
+
+    map->slots = calloc(INITIAL_SLOT_COUNT, sizeof(*map->slots));
+    if (map->slots == NULL) {
+        int save_errno = errno;
+
+        free(map);
+        errno = save_errno;
+        return NULL;
+    }
+
+    map->arena = malloc(INITIAL_ARENA_SIZE);
+    if (map->arena == NULL) {
+        int save_errno = errno;
+
+        free(map->slots);
+        free(map);
+        errno = save_errno;
+        return NULL;
+    }
+
+    map->slot_count = INITIAL_SLOT_COUNT;
+    map->count = 0;
+    map->arena_size = INITIAL_ARENA_SIZE;
+    map->arena_used = 0;
+    map->garbage = 0;
+    map->value_size = sizealign(value_size, alignof(max_align_t));
+    map->limit = memory_limit;
+    map->head = map->tail = NONE;
+
+    return map;
+}
+
+/*----------------------------------------------------------------------------*
+ |                                  entries                                   |
+ *----------------------------------------------------------------------------*/
+
+static struct entry *
+idmap_entry(const struct rbh_idmap *map, size_t offset)
+{
+    return (struct entry *)(map->arena + offset);
+}
+
+static size_t
+entry_footprint(const struct rbh_idmap *map, size_t id_size)
+{
+    return sizealign(sizeof(struct entry) + map->value_size + id_size,
+                     alignof(struct entry));
+}
+
+static void *
+entry_value(struct entry *entry)
+{
+    return entry->data;
+}
+
+static const char *
+entry_id(const struct rbh_idmap *map, struct entry *entry)
+{
+    return entry->data + map->value_size;
+}
+
+static void
+lru_unlink(struct rbh_idmap *map, size_t offset)
+{
+    struct entry *entry = idmap_entry(map, offset);
+
+    if (entry->prev == NONE)
+        map->head = entry->next;
+    else
+        idmap_entry(map, entry->prev)->next = entry->next;
+
+    if (entry->next == NONE)
+        map->tail = entry->prev;
+    else
+        idmap_entry(map, entry->next)->prev = entry->prev;
+}
+
+static void
+lru_push(struct rbh_idmap *map, size_t offset)
+{
+    struct entry *entry = idmap_entry(map, offset);
+
+    entry->prev = NONE;
+    entry->next = map->head;
+    if (map->head == NONE)
+        map->tail = offset;
+    else
+        idmap_entry(map, map->head)->prev = offset;
+    map->head = offset;
+}
+
+/*----------------------------------------------------------------------------*
+ |                                   table                                    |
+ *----------------------------------------------------------------------------*/
+
+static void
+slots_insert(struct slot *slots, size_t count, uint64_t hash, size_t entry)
+{
+    struct slot slot = {
+        .distance = 1,
+        .hash = hash >> 32,
+        .entry = entry,
+    };
+    size_t mask = count - 1;
+
+    for (size_t i = hash & mask; true; i = (i + 1) & mask, slot.distance++) {
+        struct slot tmp;
+
+        if (slots[i].distance == 0) {
+            slots[i] = slot;
+            return;
+        }
+
+        /* Rob the rich: take the place of keys that are closer to home */
+        if (slots[i].distance < slot.distance) {
+            tmp = slots[i];
+            slots[i] = slot;
+            slot = tmp;
+        }
+    }
+}
+
+/* Returns the index of the slot of `id', or NONE if there is none */
+static size_t
+idmap_find(const struct rbh_idmap *map, const struct rbh_id *id, uint64_t hash)
+{
+    size_t mask = map->slot_count - 1;
+    uint32_t distance = 1;
+
+    for (size_t i = hash & mask; true; i = (i + 1) & mask, distance++) {
+        const struct slot *slot = &map->slots[i];
+        struct entry *entry;
+
+        /* `id' would have robbed this slot */
+        if (slot->distance < distance)
+            return NONE;
+
+        if (slot->hash != hash >> 32)
+            continue;
+
+        entry = idmap_entry(map, slot->entry);
+        if (entry->size == id->size
+         && (id->size == 0
+          || memcmp(entry_id(map, entry), id->data, id->size) == 0))
+            return i;
+    }
+}
+
+/* Returns the index of the slot that points at the entry at `offset' */
+static size_t
+idmap_slot_of(const struct rbh_idmap *map, size_t offset)
+{
+    size_t mask = map->slot_count - 1;
+    size_t i = idmap_entry(map, offset)->hash & mask;
+
+    while (map->slots[i].entry != offset || map->slots[i].distance == 0)
+        i = (i + 1) & mask;
+    return i;
+}
+
+/* Backward shift deletion: move the following keys one slot closer to home,
+ * until one is already home (or there is none)
+ */
+static void
+slots_remove(struct slot *slots, size_t count, size_t index)
+{
+    size_t mask = count - 1;
+    size_t next;
+
+    for (next = (index + 1) & mask; slots[next].distance > 1;
+         index = next, next = (next + 1) & mask) {
+        slots[index] = slots[next];
+        slots[index].distance--;
+    }
+
+    slots[index].distance = 0;
+}
+
+static int
+idmap_resize(struct rbh_idmap *map, size_t count)
+{
+    struct slot *slots;
+
+    slots = calloc(count, sizeof(*slots));
+    if (slots == NULL)
+        return -1;
+
+    for (size_t offset = map->head; offset != NONE;
+         offset = idmap_entry(map, offset)->next)
+        slots_insert(slots, count, idmap_entry(map, offset)->hash, offset);
+
+    free(map->slots);
+    map->slots = slots;
+    map->slot_count = count;
+    return 0;
+}
+
+static uint64_t
+id_hash(const struct rbh_id *id)
+{
+    return hash64(id->data, id->size, HASH_SEED);
+}
+
+/*----------------------------------------------------------------------------*
+ |                                   arena                                    |
+ *----------------------------------------------------------------------------*/
+
+static size_t
+idmap_memory(const struct rbh_idmap *map)
+{
+    return map->slot_count * sizeof(*map->slots) + map->arena_used
+         - map->garbage;
+}
+
+/* Copy live entries into a new arena, in LRU order, and rebuild the table */
+static int
+idmap_compact(struct rbh_idmap *map, size_t size)
+{
+    size_t offset = map->head;
+    size_t used = 0;
+    char *arena;
+
+    arena = malloc(size);
+    if (arena == NULL)
+        return -1;
+
+    map->head = map->tail = NONE;
+    memset(map->slots, 0, map->slot_count * sizeof(*map->slots));
+
+    while (offset != NONE) {
+        struct entry *entry = idmap_entry(map, offset);
+        size_t footprint = entry_footprint(map, entry->size);
+        struct entry *copy = (struct entry *)(arena + used);
+
+        memcpy(copy, entry, footprint);
+        copy->prev = map->tail;
+        copy->next = NONE;
+        if (map->tail == NONE)
+            map->head = used;
+        else
+            ((struct entry *)(arena + map->tail))->next = used;
+        map->tail = used;
+
+        slots_insert(map->slots, map->slot_count, copy->hash, used);
+        offset = entry->next;
+        used += footprint;
+    }
+
+    free(map->arena);
+    map->arena = arena;
+    map->arena_size = size;
+    map->arena_used = used;
+    map->garbage = 0;
+    return 0;
+}
+
+/* Make room for `footprint' more bytes in the arena, without letting the arena
+ * grow past `budget' bytes (live entries and `footprint' must fit in `budget')
+ */
+static int
+idmap_reserve(struct rbh_idmap *map, size_t footprint, size_t budget)
+{
+    size_t live = map->arena_used - map->garbage;
+    /* Mostly garbage? */
+    bool compact = map->garbage > live;
+    size_t needed = (compact ? live : map->arena_used) + footprint;
+    size_t size = map->arena_size;
+    char *arena;
+
+    if (map->arena_size <= budget
+     && map->arena_size - map->arena_used >= footprint)
+        return 0;
+
+    while (size < needed || size - needed < size / 4) {
+        if (size > SIZE_MAX >> 1) {
+            errno = ENOMEM;
+            return -1;
+        }
+        size <<= 1;
+    }
+
+    if (size > budget) {
+        size = budget;
+        if (map->arena_used + footprint > size)
+            compact = true;
+    }
+
+    if (compact)
+        return idmap_compact(map, size);
+
+    arena = realloc(map->arena, size);
+    if (arena == NULL)
+        return -1;
+
+    map->arena = arena;
+    map->arena_size = size;
+    return 0;
+}
+
+static void
+idmap_evict(struct rbh_idmap *map, size_t index)
+{
+    size_t offset = map->slots[index].entry;
+
+    slots_remove(map->slots, map->slot_count, index);
+    lru_unlink(map, offset);
+    map->garbage += entry_footprint(map, idmap_entry(map, offset)->size);
+    map->count--;
+
+    if (map->count == 0) {
+        /* Start over */
+        map->arena_used = 0;
+        map->garbage = 0;
+    }
+}
+
+/* The number of slots the table needs to hold `count' entries */
+static size_t
+idmap_slot_count(const struct rbh_idmap *map, size_t count)
+{
+    size_t slot_count = map->slot_count;
+
+    /* Keep the load factor under 7/8 */
+    while (count * 8 > slot_count * 7)
+        slot_count *= 2;
+    return slot_count;
+}
+
+/* Evict entries until one of `footprint' bytes fits in the memory limit of
+ * `map', along with the table, returns the number of bytes left for the arena
+ */
+static size_t
+idmap_make_room(struct rbh_idmap *map, size_t footprint)
+{
+    size_t budget;
+
+    while (true) {
+        size_t table = idmap_slot_count(map, map->count + 1)
+                     * sizeof(*map->slots);
+        size_t live = map->arena_used - map->garbage;
+
+        budget = table < map->limit ? map->limit - table : 0;
+        if (map->count == 0 || live + footprint <= budget)
+            break;
+
+        idmap_evict(map, idmap_slot_of(map, map->tail));
+    }
+
+    /* Once the arena may not grow anymore, it has to be compacted: evict a
+     * quarter of it, so that this does not happen on every insertion.
+     */
+    if (map->arena_used + footprint > budget) {
+        while (map->count > 0
+            && (map->arena_used - map->garbage + footprint) * 4 > budget * 3)
+            idmap_evict(map, idmap_slot_of(map, map->tail));
+    }
+
+    return budget;
+}
+
+/*----------------------------------------------------------------------------*
+ |                                    API                                     |
+ *----------------------------------------------------------------------------*/
+
+void *
+rbh_idmap_get(struct rbh_idmap *map, const struct rbh_id *id)
+{
+    size_t index;
+    size_t offset;
+
+    index = idmap_find(map, id, id_hash(id));
+    if (index == NONE) {
+        errno = ENOENT;
+        return NULL;
+    }
+
+    offset = map->slots[index].entry;
+    if (map->head != offset) {
+        lru_unlink(map, offset);
+        lru_push(map, offset);
+    }
+
+    return entry_value(idmap_entry(map, offset));
+}
+
+void *
+rbh_idmap_put(struct rbh_idmap *map, const struct rbh_id *id, bool *created)
+{
+    uint64_t hash = id_hash(id);
+    struct entry *entry;
+    size_t slot_count;
+    size_t footprint;
+    size_t budget;
+    size_t index;
+    size_t offset;
+
+    index = idmap_find(map, id, hash);
+    if (index != NONE) {
+        *created = false;
+        offset = map->slots[index].entry;
+        if (map->head != offset) {
+            lru_unlink(map, offset);
+            lru_push(map, offset);
+        }
+        return entry_value(idmap_entry(map, offset));
+    }
+
+    footprint = entry_footprint(map, id->size);
+
+    /* Evict before inserting, so that the returned value is never evicted */
+    budget = map->limit ? idmap_make_room(map, footprint) : SIZE_MAX;
+    if (map->arena_used - map->garbage + footprint > budget) {
+        errno = ENOBUFS;
+        return NULL;
+    }
+
+    slot_count = idmap_slot_count(map, map->count + 1);
+    if (slot_count != map->slot_count && idmap_resize(map, slot_count))
+        return NULL;
+
+    if (idmap_reserve(map, footprint, budget))
+        return NULL;
+
+    offset = map->arena_used;
+    entry = idmap_entry(map, offset);
+    entry->hash = hash;
+    entry->size = id->size;
+    memset(entry_value(entry), 0, map->value_size);
+    if (id->size > 0)
+        memcpy(entry->data + map->value_size, id->data, id->size);
+    map->arena_used += footprint;
+
+    slots_insert(map->slots, map->slot_count, hash, offset);
+    lru_push(map, offset);
+    map->count++;
+
+    *created = true;
+    return entry_value(entry);
+}
+
+int
+rbh_idmap_remove(struct rbh_idmap *map, const struct rbh_id *id)
+{
+    size_t index;
+
+    index = idmap_find(map, id, id_hash(id));
+    if (index == NONE) {
+        errno = ENOENT;
+        return -1;
+    }
+
+    idmap_evict(map, index);
+    return 0;
+}
+
+size_t
+rbh_idmap_count(const struct rbh_idmap *map)
+{
+    return map->count;
+}
+
+void
+rbh_idmap_usage(const struct rbh_idmap *map, struct rbh_memory_usage *usage)
+{
+    usage->allocated = map->slot_count * sizeof(*map->slots) + map->arena_size;
+    usage->used = idmap_memory(map);
+    usage->cached = map->garbage;
+}
+
+void
+rbh_idmap_destroy(struct rbh_idmap *map)
+{
+    free(map->arena);
+    free(map->slots);
+    free(map);
+}
+
+/*----------------------------------------------------------------------------*
+ |                              rbh_idmap_iter()                              |
+ *----------------------------------------------------------------------------*/
+
+struct idmap_iterator {
+    struct rbh_iterator iterator;
+
+    struct rbh_idmap *map;
+    size_t offset;
+    struct rbh_idmap_entry entry;
+};
+
+static const void *
+idmap_iter_next(void *iterator)
+{
+    struct idmap_iterator *iter = iterator;
+    struct entry *entry;
+
+    if (iter->offset == NONE) {
+        errno = ENODATA;
+        return NULL;
+    }
+
+    entry = idmap_entry(iter->map, iter->offset);
+    iter->entry.id.data = entry_id(iter->map, entry);
+    iter->entry.id.size = entry->size;
+    iter->entry.value = entry_value(entry);
+    iter->offset = entry->next;
+
+    return &iter->entry;
+}
+
+static void
+idmap_iter_destroy(void *iterator)
+{
+    free(iterator);
+}
+
+static const struct rbh_iterator_operations IDMAP_ITER_OPS = {
+    .next = idmap_iter_next,
+    .destroy = idmap_iter_destroy,
+};
+
+static const struct rbh_iterator IDMAP_ITERATOR = {
+    .ops = &IDMAP_ITER_OPS,
+};
+
+struct rbh_iterator *
+rbh_idmap_iter(struct rbh_idmap *map)
+{
+    struct idmap_iterator *iter;
+
+    iter = malloc(sizeof(*iter));
+    if (iter == NULL)
+        return NULL;
+
+    iter->iterator = IDMAP_ITERATOR;
+    iter->map = map;
+    iter->offset = map->head;
+
+    return &iter->iterator;
+}
@@ -0,0 +1,454 @@
+/* This file is part of the RobinHood Library
+ * Copyright (C) 2022 Commissariat a l'energie atomique et aux energies
+ *                    alternatives
+ *
+ * SPDX-License-Identifer: LGPL-3.0-or-later
+ */
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "robinhood/instrument.h"
+
+static atomic_bool enabled;
+
+void
+rbh_instrument_enable(bool enable)
+{
+    atomic_store(&enabled, enable);
+}
+
+bool
+rbh_instrument_enabled(void)
+{
+    return atomic_load_explicit(&enabled, memory_order_relaxed);
+}
+
+/*----------------------------------------------------------------------------*
+ |                                 histogram                                  |
+ *----------------------------------------------------------------------------*/
+
+/* Latencies are recorded in a log-linear histogram (a la HdrHistogram):
+ * values below 2^SUB_BUCKET_BITS have a bucket of their own, above that each
+ * power of two is split into SUB_BUCKET_HALF linear buckets.
+ *
+ * The relative error on any value is thus bounded by 1 / SUB_BUCKET_HALF.
+ */
+#define SUB_BUCKET_BITS 6
+#define SUB_BUCKET_COUNT (1 << SUB_BUCKET_BITS)
+#define SUB_BUCKET_HALF (SUB_BUCKET_COUNT / 2)
+#define BUCKET_COUNT ((64 - SUB_BUCKET_BITS + 2) * SUB_BUCKET_HALF)
+
+static size_t
+histogram_index(uint64_t value)
+{
+    unsigned int shift;
+
+    if (value < SUB_BUCKET_COUNT)
+        return value;
+
+    shift = 63 - __builtin_clzll(value) - SUB_BUCKET_BITS + 1;
+    return shift * SUB_BUCKET_HALF + (value >> shift);
+}
+
+static uint64_t
+histogram_upper_bound(size_t index)
+{
+    unsigned int shift;
+
+    if (index < SUB_BUCKET_COUNT)
+        return index;
+
+    shift = index / SUB_BUCKET_HALF - 1;
+    return ((index - shift * SUB_BUCKET_HALF + 1) << shift) - 1;
+}
+
+/*----------------------------------------------------------------------------*
+ |                                   stage                                    |
+ *----------------------------------------------------------------------------*/
+
+struct stage {
+    struct stage *next;
+
+    atomic_uint_least64_t count;
+    atomic_uint_least64_t errors;
+    atomic_uint_least64_t enodata;
+
+    atomic_uint_least64_t total;
+    atomic_uint_least64_t min;
+    atomic_uint_least64_t max;
+
+    /* Timestamps of the first and last calls to `next' */
+    atomic_uint_least64_t first;
+    atomic_uint_least64_t last;
+
+    atomic_uint_least64_t buckets[BUCKET_COUNT];
+
+    char name[];
+};
+
+static pthread_mutex_t stages_lock = PTHREAD_MUTEX_INITIALIZER;
+static struct stage *stages;
+static struct stage **stages_tail = &stages;
+
+static void
+stage_reset(struct stage *stage)
+{
+    atomic_store(&stage->count, 0);
+    atomic_store(&stage->errors, 0);
+    atomic_store(&stage->enodata, 0);
+    atomic_store(&stage->total, 0);
+    atomic_store(&stage->min, UINT64_MAX);
+    atomic_store(&stage->max, 0);
+    atomic_store(&stage->first, 0);
+    atomic_store(&stage->last, 0);
+    for (size_t i = 0; i < BUCKET_COUNT; i++)
+        atomic_store(&stage->buckets[i], 0);
+}
+
+static struct stage *
+stage_lookup(const char *name)
+{
+    for (struct stage *stage = stages; stage != NULL; stage = stage->next) {
+        if (strcmp(stage->name, name) == 0)
+            return stage;
+    }
+    return NULL;
+}
+
+static struct stage *
+stage_get(const char *name)
+{
+    struct stage *stage;
+    size_t length;
+
+    pthread_mutex_lock(&stages_lock);
+    stage = stage_lookup(name);
+    if (stage != NULL)
+        goto out_unlock;
+
+    length = strlen(name);
+    stage = malloc(sizeof(*stage) + length + 1);
+    if (stage == NULL)
+        goto out_unlock;
+
+    stage->next = NULL;
+    stage_reset(stage);
+    memcpy(stage->name, name, length + 1);
+
+    *stages_tail = stage;
+    stages_tail = &stage->next;
+
+out_unlock:
+    pthread_mutex_unlock(&stages_lock);
+    return stage;
+}
+
+static void
+stages_free(void) __attribute__((destructor));
+
+static void
+stages_free(void)
+{
+    struct stage *stage = stages;
+
+    while (stage != NULL) {
+        struct stage *next = stage->next;
+
+        free(stage);
+        stage = next;
+    }
+}
+
+static uint64_t
+timespec2ns(const struct timespec *timespec)
+{
+    return timespec->tv_sec * UINT64_C(1000000000) + timespec->tv_nsec;
+}
+
+static void
+stage_record(struct stage *stage, bool success, int error, uint64_t start,
+             uint64_t end)
+{
+    uint64_t latency = end - start;
+    uint64_t value;
+
+    if (success)
+        atomic_fetch_add_explicit(&stage->count, 1, memory_order_relaxed);
+    else if (error == ENODATA)
+        atomic_fetch_add_explicit(&stage->enodata, 1, memory_order_relaxed);
+    else
+        atomic_fetch_add_explicit(&stage->errors, 1, memory_order_relaxed);
+
+    atomic_fetch_add_explicit(&stage->total, latency, memory_order_relaxed);
+    atomic_fetch_add_explicit(&stage->buckets[histogram_index(latency)], 1,
+                              memory_order_relaxed);
+
+    value = atomic_load_explicit(&stage->min, memory_order_relaxed);
+    while (latency < value
+        && !atomic_compare_exchange_weak(&stage->min, &value, latency));
+
+    value = atomic_load_explicit(&stage->max, memory_order_relaxed);
+    while (latency > value
+        && !atomic_compare_exchange_weak(&stage->max, &value, latency));
+
+    value = 0;
+    atomic_compare_exchange_strong(&stage->first, &value, start);
+
+    value = atomic_load_explicit(&stage->last, memory_order_relaxed);
+    while (end > value
+        && !atomic_compare_exchange_weak(&stage->last, &value, end));
+}
+
+static void
+stage_stats(struct stage *stage, struct rbh_iter_stats *stats)
+{
+    const struct {
+        double quantile;
+        uint64_t *value;
+    } percentiles[] = {
+        { .quantile = 0.5, .value = &stats->latency.p50, },
+        { .quantile = 0.9, .value = &stats->latency.p90, },
+        { .quantile = 0.99, .value = &stats->latency.p99, },
+        { .quantile = 0.999, .value = &stats->latency.p999, },
+    };
+    uint64_t buckets[BUCKET_COUNT];
+    uint64_t calls = 0;
+    uint64_t first;
+    uint64_t last;
+    uint64_t seen;
+    size_t index;
+
+    stats->name = stage->name;
+    stats->count = atomic_load(&stage->count);
+    stats->errors = atomic_load(&stage->errors);
+    stats->enodata = atomic_load(&stage->enodata);
+    stats->latency.total = atomic_load(&stage->total);
+    stats->latency.min = atomic_load(&stage->min);
+    stats->latency.max = atomic_load(&stage->max);
+
+    for (size_t i = 0; i < BUCKET_COUNT; i++) {
+        buckets[i] = atomic_load_explicit(&stage->buckets[i],
+                                          memory_order_relaxed);
+        calls += buckets[i];
+    }
+
+    if (calls == 0)
+        stats->latency.min = 0;
+
+    seen = 0;
+    index = 0;
+    for (size_t i = 0; i < sizeof(percentiles) / sizeof(*percentiles); i++) {
+        uint64_t rank = percentiles[i].quantile * calls;
+        uint64_t value;
+
+        if (rank == 0)
+            rank = 1;
+
+        while (index < BUCKET_COUNT && seen + buckets[index] < rank)
+            seen += buckets[index++];
+
+        value = index < BUCKET_COUNT ? histogram_upper_bound(index) : 0;
+        *percentiles[i].value = value < stats->latency.max ?
+            value : stats->latency.max;
+    }
+
+    first = atomic_load(&stage->first);
+    last = atomic_load(&stage->last);
+    stats->throughput = last > first ?
+        stats->count * 1e9 / (last - first) : 0.;
+}
+
+int
+rbh_instrument_stats(const char *name, struct rbh_iter_stats *stats)
+{
+    struct stage *stage;
+
+    pthread_mutex_lock(&stages_lock);
+    stage = stage_lookup(name);
+    pthread_mutex_unlock(&stages_lock);
+    if (stage == NULL) {
+        errno = ENOENT;
+        return -1;
+    }
+
+    stage_stats(stage, stats);
+    return 0;
+}
+
+void
+rbh_instrument_reset(void)
+{
+    pthread_mutex_lock(&stages_lock);
+    for (struct stage *stage = stages; stage != NULL; stage = stage->next)
+        stage_reset(stage);
+    pthread_mutex_unlock(&stages_lock);
+}
+
+/*----------------------------------------------------------------------------*
+ |                           rbh_iter_instrument()                            |
+ *----------------------------------------------------------------------------*/
+
+struct instrument_iterator {
+    struct rbh_iterator iterator;
+
+    struct rbh_iterator *subiter;
+    struct stage *stage;
+};
+
+static const void *
+instrument_iter_next(void *iterator)
+{
+    struct instrument_iterator *instrument = iterator;
+    struct timespec start, end;
+    const void *element;
+    int save_errno;
+
+    if (!atomic_load_explicit(&enabled, memory_order_relaxed))
+        return _rbh_iter_next(instrument->subiter);
+
+    save_errno = errno;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    errno = 0;
+    element = _rbh_iter_next(instrument->subiter);
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    stage_record(instrument->stage, element != NULL || errno == 0, errno,
+                 timespec2ns(&start), timespec2ns(&end));
+
+    errno = errno ? : save_errno;
+    return element;
+}
+
+static void
+instrument_iter_destroy(void *iterator)
+{
+    struct instrument_iterator *instrument = iterator;
+
+    rbh_iter_destroy(instrument->subiter);
+    free(instrument);
+}
+
+static int
+instrument_iter_fileno(void *iterator)
+{
+    struct instrument_iterator *instrument = iterator;
+
+    return rbh_iter_fileno(instrument->subiter);
+}
+
+static const struct rbh_iterator_operations INSTRUMENT_ITER_OPS = {
+    .next = instrument_iter_next,
+    .destroy = instrument_iter_destroy,
+    .fileno = instrument_iter_fileno,
+};
+
+static const struct rbh_iterator INSTRUMENT_ITER = {
+    .ops = &INSTRUMENT_ITER_OPS,
+};
+
+struct rbh_iterator *
+rbh_iter_instrument(struct rbh_iterator *iterator, const char *name)
+{
+    struct instrument_iterator *instrument;
+    struct stage *stage;
+
+    if (!rbh_instrument_enabled())
+        return iterator;
+
+    stage = stage_get(name);
+    if (stage == NULL)
+        return NULL;
+
+    instrument = malloc(sizeof(*instrument));
+    if (instrument == NULL)
+        return NULL;
+
+    instrument->iterator = INSTRUMENT_ITER;
+    instrument->subiter = iterator;
+    instrument->stage = stage;
+
+    return &instrument->iterator;
+}
+
+/*----------------------------------------------------------------------------*
+ |                         rbh_mut_iter_instrument()                          |
+ *----------------------------------------------------------------------------*/
+
+struct rbh_mut_iterator *
+rbh_mut_iter_instrument(struct rbh_mut_iterator *iterator, const char *name)
+{
+    return (struct rbh_mut_iterator *)rbh_iter_instrument(
+            (struct rbh_iterator *)iterator, name
+            );
+}
+
+/*----------------------------------------------------------------------------*
+ |                           rbh_instrument_dump()                            |
+ *----------------------------------------------------------------------------*/
+
+struct dump_iterator {
+    struct rbh_mut_iterator iterator;
+
+    struct stage *stage;
+    bool started;
+};
+
+static void *
+dump_iter_next(void *iterator)
+{
+    struct dump_iterator *dump = iterator;
+    struct rbh_iter_stats *stats;
+    struct stage *stage;
+
+    pthread_mutex_lock(&stages_lock);
+    stage = dump->started ? dump->stage->next : stages;
+    pthread_mutex_unlock(&stages_lock);
+
+    if (stage == NULL) {
+        errno = ENODATA;
+        return NULL;
+    }
+
+    stats = malloc(sizeof(*stats));
+    if (stats == NULL)
+        return NULL;
+
+    stage_stats(stage, stats);
+    dump->stage = stage;
+    dump->started = true;
+    return stats;
+}
+
+static const struct rbh_mut_iterator_operations DUMP_ITER_OPS = {
+    .next = dump_iter_next,
+    .destroy = free,
+};
+
+static const struct rbh_mut_iterator DUMP_ITER = {
+    .ops = &DUMP_ITER_OPS,
+};
+
+struct rbh_mut_iterator *
+rbh_instrument_dump(void)
+{
+    struct dump_iterator *dump;
+
+    dump = malloc(sizeof(*dump));
+    if (dump == NULL)
+        return NULL;
+
+    dump->iterator = DUMP_ITER;
+    dump->stage = NULL;
+    dump->started = false;
+
+    return &dump->iterator;
+}
@@ -0,0 +1,389 @@
+/* This file is part of the RobinHood Library
+ * Copyright (C) 2022 Commissariat a l'energie atomique et aux energies
+ *                    alternatives
+ *
+ * SPDX-License-Identifer: LGPL-3.0-or-later
+ */
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <sys/mman.h>
+
+#include "robinhood/memory.h"
+#include "budget.h"
+#include "hugepages.h"
+#include "pool.h"
+
+static atomic_int huge_pages = RBH_HP_NONE;
+
+void
+rbh_memory_set_huge_pages(enum rbh_huge_pages policy)
+{
+    atomic_store(&huge_pages, policy);
+    /* Cached mappings were allocated with the previous policy */
+    rbh_memory_trim(0);
+}
+
+enum rbh_huge_pages
+rbh_memory_huge_pages(void)
+{
+    return atomic_load_explicit(&huge_pages, memory_order_relaxed);
+}
+
+/*----------------------------------------------------------------------------*
+ |                                 huge pages                                 |
+ *----------------------------------------------------------------------------*/
+
+static pthread_once_t huge_page_size_once = PTHREAD_ONCE_INIT;
+static size_t _huge_page_size;
+
+static void
+huge_page_size_init(void)
+{
+    char line[128];
+    FILE *meminfo;
+
+    meminfo = fopen("/proc/meminfo", "r");
+    if (meminfo == NULL)
+        return;
+
+    while (fgets(line, sizeof(line), meminfo)) {
+        unsigned long kib;
+
+        if (sscanf(line, "Hugepagesize: %lu kB", &kib) == 1) {
+            _huge_page_size = kib << 10;
+            break;
+        }
+    }
+
+    fclose(meminfo);
+}
+
+size_t
+huge_page_size(void)
+{
+    pthread_once(&huge_page_size_once, huge_page_size_init);
+    return _huge_page_size;
+}
+
+/* Is a buffer of `size' bytes large enough to use huge pages? */
+static bool
+huge_pages_eligible(size_t size)
+{
+    size_t page_size;
+
+    if (rbh_memory_huge_pages() == RBH_HP_NONE)
+        return false;
+
+    page_size = huge_page_size();
+    return page_size != 0 && size >= page_size;
+}
+
+bool
+huge_pages_explicit(size_t size)
+{
+    return rbh_memory_huge_pages() == RBH_HP_EXPLICIT
+        && huge_pages_eligible(size) && size % huge_page_size() == 0;
+}
+
+void
+huge_pages_advise(void *address, size_t size)
+{
+    if (huge_pages_eligible(size))
+        madvise(address, size, MADV_HUGEPAGE);
+}
+
+static void *
+buffer_alloc(size_t size, bool *mapped)
+{
+    void *buffer;
+
+    if (!huge_pages_eligible(size)) {
+        *mapped = false;
+        return malloc(size);
+    }
+
+    if (huge_pages_explicit(size)) {
+        buffer = mmap(NULL, size, PROT_READ | PROT_WRITE,
+                      MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        if (buffer != MAP_FAILED) {
+            *mapped = true;
+            return buffer;
+        }
+        /* The hugetlb pool is most likely empty, fall back to THP */
+    }
+
+    buffer = mmap(NULL, size, PROT_READ | PROT_WRITE,
+                  MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (buffer == MAP_FAILED)
+        return NULL;
+
+    huge_pages_advise(buffer, size);
+    *mapped = true;
+    return buffer;
+}
+
+void *
+huge_pages_alloc(size_t size, bool *mapped)
+{
+    void *buffer;
+
+    if (huge_pages_eligible(size)) {
+        /* Cached mappings are already accounted for */
+        buffer = pool_get(POOL_STACK, size);
+        if (buffer != NULL) {
+            *mapped = true;
+            return buffer;
+        }
+    }
+
+    if (memory_charge(size))
+        return NULL;
+
+    buffer = buffer_alloc(size, mapped);
+    if (buffer == NULL) {
+        int save_errno = errno;
+
+        memory_discharge(size);
+        errno = save_errno;
+    }
+
+    return buffer;
+}
+
+void
+huge_pages_free(void *buffer, size_t size, bool mapped)
+{
+    if (!mapped) {
+        free(buffer);
+    } else if (!pool_put(POOL_STACK, buffer, size)) {
+        munmap(buffer, size);
+    } else {
+        return;
+    }
+
+    memory_discharge(size);
+}
+
+/*----------------------------------------------------------------------------*
+ |                                    pool                                    |
+ *----------------------------------------------------------------------------*/
+
+#define POOL_CLASS_COUNT 16
+
+/* Cached mappings are linked through their first bytes */
+struct cached_mapping {
+    struct cached_mapping *next;
+};
+
+struct pool_class {
+    enum pool_kind kind;
+    size_t size;
+    struct cached_mapping *mappings;
+};
+
+static struct {
+    pthread_mutex_t lock;
+    size_t limit;
+    size_t cached;
+    struct pool_class classes[POOL_CLASS_COUNT];
+} pool = {
+    .lock = PTHREAD_MUTEX_INITIALIZER,
+    .limit = 64 << 20,
+};
+
+/* The number of bytes of address space a mapping spans
+ *
+ * The cache itself is accounted for in bytes of memory.
+ */
+static size_t
+mapping_length(enum pool_kind kind, size_t size)
+{
+    return kind == POOL_RING ? size << 1 : size;
+}
+
+static struct pool_class *
+pool_class(enum pool_kind kind, size_t size)
+{
+    for (size_t i = 0; i < POOL_CLASS_COUNT; i++) {
+        struct pool_class *class = &pool.classes[i];
+
+        if (class->kind == kind && class->size == size)
+            return class;
+    }
+
+    return NULL;
+}
+
+void *
+pool_get(enum pool_kind kind, size_t size)
+{
+    struct cached_mapping *mapping = NULL;
+    struct pool_class *class;
+
+    pthread_mutex_lock(&pool.lock);
+    class = pool_class(kind, size);
+    if (class != NULL && class->mappings != NULL) {
+        mapping = class->mappings;
+        class->mappings = mapping->next;
+        pool.cached -= size;
+    }
+    pthread_mutex_unlock(&pool.lock);
+
+    return mapping;
+}
+
+bool
+pool_put(enum pool_kind kind, void *mapping, size_t size)
+{
+    struct cached_mapping *cached = mapping;
+    struct pool_class *class;
+
+    pthread_mutex_lock(&pool.lock);
+    if (pool.cached + size > pool.limit) {
+        pthread_mutex_unlock(&pool.lock);
+        return false;
+    }
+
+    class = pool_class(kind, size);
+    /* Otherwise, recycle a class that is not in use */
+    for (size_t i = 0; class == NULL && i < POOL_CLASS_COUNT; i++) {
+        if (pool.classes[i].mappings == NULL) {
+            class = &pool.classes[i];
+            class->kind = kind;
+            class->size = size;
+        }
+    }
+
+    if (class == NULL) {
+        pthread_mutex_unlock(&pool.lock);
+        return false;
+    }
+
+    cached->next = class->mappings;
+    class->mappings = cached;
+    pool.cached += size;
+    pthread_mutex_unlock(&pool.lock);
+
+    return true;
+}
+
+void
+rbh_memory_set_cache_limit(size_t limit)
+{
+    pthread_mutex_lock(&pool.lock);
+    pool.limit = limit;
+    pthread_mutex_unlock(&pool.lock);
+
+    rbh_memory_trim(limit);
+}
+
+void
+rbh_memory_trim(size_t keep)
+{
+    pthread_mutex_lock(&pool.lock);
+    for (size_t i = 0; i < POOL_CLASS_COUNT && pool.cached > keep; i++) {
+        struct pool_class *class = &pool.classes[i];
+        size_t length = mapping_length(class->kind, class->size);
+
+        while (class->mappings != NULL && pool.cached > keep) {
+            struct cached_mapping *mapping = class->mappings;
+
+            class->mappings = mapping->next;
+            munmap(mapping, length);
+            pool.cached -= class->size;
+            memory_discharge(class->size);
+        }
+    }
+    pthread_mutex_unlock(&pool.lock);
+}
+
+/*----------------------------------------------------------------------------*
+ |                                 accounting                                 |
+ *----------------------------------------------------------------------------*/
+
+static atomic_size_t allocated;
+static atomic_size_t peak;
+static atomic_size_t budget;
+static atomic_size_t failures;
+
+static bool
+memory_try_charge(size_t size)
+{
+    size_t limit = atomic_load_explicit(&budget, memory_order_relaxed);
+    size_t total, max;
+
+    total = atomic_fetch_add_explicit(&allocated, size, memory_order_relaxed)
+          + size;
+    if (limit != 0 && total > limit) {
+        atomic_fetch_sub_explicit(&allocated, size, memory_order_relaxed);
+        return false;
+    }
+
+    max = atomic_load_explicit(&peak, memory_order_relaxed);
+    while (total > max
+        && !atomic_compare_exchange_weak_explicit(&peak, &max, total,
+                                                  memory_order_relaxed,
+                                                  memory_order_relaxed))
+        ;
+
+    return true;
+}
+
+int
+memory_charge(size_t size)
+{
+    size_t cached, excess;
+
+    if (memory_try_charge(size))
+        return 0;
+
+    /* Make room by releasing cached mappings (they are part of `allocated') */
+    pthread_mutex_lock(&pool.lock);
+    cached = pool.cached;
+    pthread_mutex_unlock(&pool.lock);
+
+    excess = atomic_load(&allocated) + size - atomic_load(&budget);
+    if (cached > 0) {
+        rbh_memory_trim(cached > excess ? cached - excess : 0);
+        if (memory_try_charge(size))
+            return 0;
+    }
+
+    atomic_fetch_add_explicit(&failures, 1, memory_order_relaxed);
+    errno = ENOBUFS;
+    return -1;
+}
+
+void
+memory_discharge(size_t size)
+{
+    atomic_fetch_sub_explicit(&allocated, size, memory_order_relaxed);
+}
+
+void
+rbh_memory_set_budget(size_t _budget)
+{
+    atomic_store(&budget, _budget);
+}
+
+void
+rbh_memory_stats(struct rbh_memory_stats *stats)
+{
+    stats->allocated = atomic_load(&allocated);
+    stats->peak = atomic_load(&peak);
+    stats->budget = atomic_load(&budget);
+    stats->failures = atomic_load(&failures);
+
+    pthread_mutex_lock(&pool.lock);
+    stats->cached = pool.cached;
+    pthread_mutex_unlock(&pool.lock);
+}
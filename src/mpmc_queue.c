@@ -0,0 +1,514 @@
+/* This file is part of the RobinHood Library
+ * Copyright (C) 2022 Commissariat a l'energie atomique et aux energies
+ *                    alternatives
+ *
+ * SPDX-License-Identifer: LGPL-3.0-or-later
+ */
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <errno.h>
+#include <limits.h>
+#include <stdalign.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <linux/futex.h>
+#include <sys/syscall.h>
+
+#include "robinhood/mpmc_queue.h"
+
+#define CACHE_LINE_SIZE 64
+
+/* The queue is made of a fixed number of chunks, each of them is used over
+ * and over again, once per "lap". The n-th chunk the queue ever uses is
+ * chunks[n % count], and it is used for the (n / count)-th time.
+ *
+ * Chunk sequence numbers (the `n' above) are 64 bits wide, but only their 32
+ * least significant bits are stored along with offsets, which is enough to
+ * tell whether a chunk is being used for the current lap or not.
+ */
+
+    /*--------------------------------------------------------------------*
+     |                               events                               |
+     *--------------------------------------------------------------------*/
+
+/* A futex-based event that threads may wait on for a queue to be (or to stop
+ * being) full or empty. Signaling an event without any waiter is a fence and
+ * a (mostly) uncontended load.
+ */
+struct event {
+    atomic_uint sequence;
+    atomic_uint waiters;
+};
+
+static unsigned int
+event_prepare(struct event *event)
+{
+    unsigned int sequence;
+
+    atomic_fetch_add(&event->waiters, 1);
+    sequence = atomic_load(&event->sequence);
+    /* Order the registration of the waiter before the caller's next check */
+    atomic_thread_fence(memory_order_seq_cst);
+    return sequence;
+}
+
+static void
+event_wait(struct event *event, unsigned int sequence)
+{
+    /* Errors (EAGAIN, EINTR) are fine, callers re-check their condition */
+    syscall(SYS_futex, &event->sequence, FUTEX_WAIT_PRIVATE, sequence, NULL,
+            NULL, 0);
+}
+
+static void
+event_finish(struct event *event)
+{
+    atomic_fetch_sub(&event->waiters, 1);
+}
+
+static void
+event_signal(struct event *event)
+{
+    /* Order the caller's last update before the check for waiters */
+    atomic_thread_fence(memory_order_seq_cst);
+    if (atomic_load_explicit(&event->waiters, memory_order_relaxed) == 0)
+        return;
+
+    atomic_fetch_add(&event->sequence, 1);
+    syscall(SYS_futex, &event->sequence, FUTEX_WAKE_PRIVATE, INT_MAX, NULL,
+            NULL, 0);
+}
+
+    /*--------------------------------------------------------------------*
+     |                               chunks                               |
+     *--------------------------------------------------------------------*/
+
+/* Both `reserve' and `claim' pack a lap (in their 32 most significant bits)
+ * and an offset in the chunk (in their 31 least significant bits).
+ *
+ * Producers reserve records by moving `reserve' forward. Once a record does
+ * not fit in the remaining space, the chunk is sealed and producers move on
+ * to the next one.
+ *
+ * Consumers claim records by moving `claim' forward, and account for the
+ * records they release in `released'. Sealing a chunk also accounts for the
+ * unused space at its end (and one extra byte, so that a chunk that is not
+ * sealed yet cannot appear to be fully released). Once every byte is
+ * released, the chunk is reset for its next lap.
+ */
+struct mpmc_chunk {
+    alignas(CACHE_LINE_SIZE) _Atomic uint64_t reserve;
+    alignas(CACHE_LINE_SIZE) _Atomic uint64_t claim;
+    atomic_size_t released;
+};
+
+#define SEALED (UINT32_C(1) << 31)
+
+#define LAP(word) ((uint32_t)((word) >> 32))
+#define OFFSET(word) ((uint32_t)(word) & ~SEALED)
+#define WORD(lap, low) ((uint64_t)(lap) << 32 | (low))
+
+/* How far ahead of `lap' `word' is, in laps */
+static int32_t
+lap_distance(uint64_t word, uint64_t lap)
+{
+    return (int32_t)(LAP(word) - (uint32_t)lap);
+}
+
+/* Records are prefixed with a header that holds the lap they were reserved in,
+ * whether they were committed, and their size.
+ */
+#define READY SEALED
+#define HEADER_SIZE sizeof(uint64_t)
+
+/* How many times consumers read the header of an uncommitted record before
+ * they give up
+ */
+#define COMMIT_SPIN_COUNT 128
+
+static bool
+record_is_ready(uint64_t word, uint64_t lap)
+{
+    return lap_distance(word, lap) == 0 && (word & READY);
+}
+
+#define ALIGN(size, alignment) \
+    (((size) + (alignment) - 1) / (alignment) * (alignment))
+
+static size_t
+record_footprint(size_t size)
+{
+    return ALIGN(HEADER_SIZE + size, HEADER_SIZE);
+}
+
+struct rbh_mpmc_queue {
+    struct mpmc_chunk *chunks;
+    char *data;
+    size_t count;
+    size_t stride;
+    size_t record_size;
+    atomic_bool closed;
+
+    alignas(CACHE_LINE_SIZE) _Atomic uint64_t tail;
+    alignas(CACHE_LINE_SIZE) _Atomic uint64_t head;
+
+    alignas(CACHE_LINE_SIZE) struct event not_full;
+    alignas(CACHE_LINE_SIZE) struct event not_empty;
+};
+
+static _Atomic uint64_t *
+chunk_header(struct rbh_mpmc_queue *queue, uint64_t sequence, uint32_t offset)
+{
+    return (void *)(queue->data + (sequence % queue->count) * queue->stride
+                    + offset);
+}
+
+static void
+chunk_recycle(struct rbh_mpmc_queue *queue, struct mpmc_chunk *chunk,
+              uint32_t lap)
+{
+    uint32_t next = lap + queue->count;
+
+    /* Consumers may read a header before the producer that reserved it gets
+     * to write it: stale bytes from the previous lap must not look like a
+     * committed record.
+     */
+    memset(queue->data + (chunk - queue->chunks) * queue->stride, 0,
+           queue->stride);
+
+    atomic_store_explicit(&chunk->released, 0, memory_order_relaxed);
+    atomic_store_explicit(&chunk->claim, WORD(next, 0), memory_order_relaxed);
+    /* Consumers load `reserve' before `claim' */
+    atomic_store_explicit(&chunk->reserve, WORD(next, 0),
+                          memory_order_release);
+
+    event_signal(&queue->not_full);
+}
+
+static void
+chunk_release(struct rbh_mpmc_queue *queue, struct mpmc_chunk *chunk,
+              uint32_t lap, size_t size)
+{
+    size_t released;
+
+    released = atomic_fetch_add_explicit(&chunk->released, size,
+                                         memory_order_acq_rel);
+    if (released + size == queue->stride + 1)
+        chunk_recycle(queue, chunk, lap);
+}
+
+    /*--------------------------------------------------------------------*
+     |                          rbh_mpmc_queue                            |
+     *--------------------------------------------------------------------*/
+
+struct rbh_mpmc_queue *
+rbh_mpmc_queue_new(size_t record_size, size_t capacity)
+{
+    struct rbh_mpmc_queue *queue;
+    size_t stride;
+    size_t count;
+
+    if (record_size > (1 << 30)) {
+        errno = EINVAL;
+        return NULL;
+    }
+
+    stride = ALIGN(record_footprint(record_size), CACHE_LINE_SIZE);
+    count = capacity / stride + (capacity % stride != 0);
+    if (count < 2)
+        count = 2;
+    /* Laps are compared as 32 bit signed integers */
+    if (count > INT32_MAX || count > SIZE_MAX / stride) {
+        errno = ENOMEM;
+        return NULL;
+    }
+
+    queue = aligned_alloc(alignof(*queue), sizeof(*queue));
+    if (queue == NULL)
+        return NULL;
+
+    queue->chunks = aligned_alloc(alignof(*queue->chunks),
+                                  count * sizeof(*queue->chunks));
+    if (queue->chunks == NULL) {
+        int save_errno = errno;
+
+        free(queue);
+        errno = save_errno;
+        return NULL;
+    }
+
+    queue->data = aligned_alloc(CACHE_LINE_SIZE, count * stride);
+    if (queue->data == NULL) {
+        int save_errno = errno;
+
+        free(queue->chunks);
+        free(queue);
+        errno = save_errno;
+        return NULL;
+    }
+    /* Refer to chunk_recycle() */
+    memset(queue->data, 0, count * stride);
+
+    for (size_t i = 0; i < count; i++) {
+        atomic_init(&queue->chunks[i].reserve, WORD(i, 0));
+        atomic_init(&queue->chunks[i].claim, WORD(i, 0));
+        atomic_init(&queue->chunks[i].released, 0);
+    }
+
+    queue->count = count;
+    queue->stride = stride;
+    queue->record_size = record_size;
+    atomic_init(&queue->closed, false);
+    atomic_init(&queue->tail, 0);
+    atomic_init(&queue->head, 0);
+    atomic_init(&queue->not_full.sequence, 0);
+    atomic_init(&queue->not_full.waiters, 0);
+    atomic_init(&queue->not_empty.sequence, 0);
+    atomic_init(&queue->not_empty.waiters, 0);
+
+    return queue;
+}
+
+/* Returns 0 on success, an error number otherwise */
+static int
+mpmc_queue_reserve(struct rbh_mpmc_queue *queue, size_t size, void **record)
+{
+    size_t footprint = record_footprint(size);
+
+    do {
+        uint64_t tail = atomic_load_explicit(&queue->tail,
+                                             memory_order_acquire);
+        struct mpmc_chunk *chunk = &queue->chunks[tail % queue->count];
+        uint64_t word = atomic_load_explicit(&chunk->reserve,
+                                             memory_order_acquire);
+        _Atomic uint64_t *header;
+        uint32_t offset;
+
+        if (atomic_load_explicit(&queue->closed, memory_order_relaxed))
+            return EPIPE;
+
+        /* The chunk is still in use for a previous lap */
+        if (lap_distance(word, tail) < 0)
+            return EAGAIN;
+
+        /* The chunk is full (and maybe even recycled already) */
+        if (lap_distance(word, tail) > 0 || (word & SEALED)) {
+            atomic_compare_exchange_strong(&queue->tail, &tail, tail + 1);
+            continue;
+        }
+
+        offset = OFFSET(word);
+        if (offset + footprint > queue->stride) {
+            if (!atomic_compare_exchange_strong(&chunk->reserve, &word,
+                                                word | SEALED))
+                continue;
+
+            chunk_release(queue, chunk, tail, queue->stride - offset + 1);
+            atomic_compare_exchange_strong(&queue->tail, &tail, tail + 1);
+            /* Consumers may be waiting at the end of the chunk */
+            event_signal(&queue->not_empty);
+            continue;
+        }
+
+        if (!atomic_compare_exchange_weak(&chunk->reserve, &word,
+                                          word + footprint))
+            continue;
+
+        header = chunk_header(queue, tail, offset);
+        atomic_store_explicit(header, WORD(tail, size), memory_order_relaxed);
+        *record = (char *)header + HEADER_SIZE;
+        return 0;
+    } while (true);
+}
+
+void *
+rbh_mpmc_queue_reserve(struct rbh_mpmc_queue *queue, size_t size, bool block)
+{
+    void *record;
+    int rc;
+
+    if (size > queue->record_size) {
+        errno = EINVAL;
+        return NULL;
+    }
+
+    rc = mpmc_queue_reserve(queue, size, &record);
+    while (rc == EAGAIN && block) {
+        unsigned int sequence = event_prepare(&queue->not_full);
+
+        rc = mpmc_queue_reserve(queue, size, &record);
+        if (rc == EAGAIN)
+            event_wait(&queue->not_full, sequence);
+        event_finish(&queue->not_full);
+    }
+
+    if (rc) {
+        errno = rc;
+        return NULL;
+    }
+    return record;
+}
+
+void
+rbh_mpmc_queue_commit(struct rbh_mpmc_queue *queue, void *record)
+{
+    _Atomic uint64_t *header = (void *)((char *)record - HEADER_SIZE);
+    uint64_t word = atomic_load_explicit(header, memory_order_relaxed);
+
+    atomic_store_explicit(header, word | READY, memory_order_release);
+    event_signal(&queue->not_empty);
+}
+
+int
+rbh_mpmc_queue_push(struct rbh_mpmc_queue *queue, const void *data,
+                    size_t size, bool block)
+{
+    void *record;
+
+    record = rbh_mpmc_queue_reserve(queue, size, block);
+    if (record == NULL)
+        return -1;
+
+    memcpy(record, data, size);
+    rbh_mpmc_queue_commit(queue, record);
+    return 0;
+}
+
+/* Returns 0 on success, an error number otherwise */
+static int
+mpmc_queue_acquire(struct rbh_mpmc_queue *queue, void **record, size_t *size)
+{
+    /* If the queue was closed before we look at it, everything that was
+     * pushed into it is visible.
+     */
+    bool closed = atomic_load_explicit(&queue->closed, memory_order_acquire);
+
+    do {
+        uint64_t head = atomic_load_explicit(&queue->head,
+                                             memory_order_acquire);
+        struct mpmc_chunk *chunk = &queue->chunks[head % queue->count];
+        uint64_t reserve = atomic_load_explicit(&chunk->reserve,
+                                                memory_order_acquire);
+        uint64_t claim = atomic_load_explicit(&chunk->claim,
+                                              memory_order_acquire);
+        _Atomic uint64_t *header;
+        uint64_t word;
+
+        /* The chunk was consumed and recycled already */
+        if (lap_distance(claim, head) > 0) {
+            atomic_compare_exchange_strong(&queue->head, &head, head + 1);
+            continue;
+        }
+
+        /* Producers have not reached this chunk yet */
+        if (lap_distance(claim, head) < 0)
+            return closed ? ENODATA : EAGAIN;
+
+        /* The chunk was recycled between the two loads */
+        if (LAP(reserve) != LAP(claim))
+            continue;
+
+        /* `reserve' is stale */
+        if (OFFSET(claim) > OFFSET(reserve))
+            continue;
+
+        if (OFFSET(claim) == OFFSET(reserve)) {
+            if (!(reserve & SEALED))
+                return closed ? ENODATA : EAGAIN;
+
+            atomic_compare_exchange_strong(&queue->head, &head, head + 1);
+            continue;
+        }
+
+        /* If `claim' is stale, the chunk may already be in use for another
+         * lap and `header' may be overwritten concurrently: whatever is read
+         * is then discarded, as `claim' cannot be updated.
+         */
+        header = chunk_header(queue, head, OFFSET(claim));
+        word = atomic_load_explicit(header, memory_order_acquire);
+        for (unsigned int i = 0; !record_is_ready(word, head); i++) {
+            /* `claim' was stale, start over */
+            if (atomic_load_explicit(&chunk->claim, memory_order_acquire)
+                    != claim)
+                break;
+
+            /* The oldest record is not committed yet. Producers commit right
+             * after they fill their record: rather than let blocking callers
+             * go to sleep, wait for it a little.
+             */
+            if (i == COMMIT_SPIN_COUNT)
+                return EAGAIN;
+
+            word = atomic_load_explicit(header, memory_order_acquire);
+        }
+        if (!record_is_ready(word, head))
+            continue;
+
+        *size = OFFSET(word);
+        if (!atomic_compare_exchange_weak(&chunk->claim, &claim,
+                                          claim + record_footprint(*size)))
+            continue;
+
+        *record = (char *)header + HEADER_SIZE;
+        return 0;
+    } while (true);
+}
+
+void *
+rbh_mpmc_queue_acquire(struct rbh_mpmc_queue *queue, size_t *size, bool block)
+{
+    void *record;
+    int rc;
+
+    rc = mpmc_queue_acquire(queue, &record, size);
+    while (rc == EAGAIN && block) {
+        unsigned int sequence = event_prepare(&queue->not_empty);
+
+        rc = mpmc_queue_acquire(queue, &record, size);
+        if (rc == EAGAIN)
+            event_wait(&queue->not_empty, sequence);
+        event_finish(&queue->not_empty);
+    }
+
+    if (rc) {
+        errno = rc;
+        return NULL;
+    }
+    return record;
+}
+
+void
+rbh_mpmc_queue_release(struct rbh_mpmc_queue *queue, void *record)
+{
+    char *header = (char *)record - HEADER_SIZE;
+    uint64_t word = atomic_load_explicit((_Atomic uint64_t *)header,
+                                         memory_order_relaxed);
+    size_t index = (header - queue->data) / queue->stride;
+
+    chunk_release(queue, &queue->chunks[index], LAP(word),
+                  record_footprint(OFFSET(word)));
+}
+
+void
+rbh_mpmc_queue_close(struct rbh_mpmc_queue *queue)
+{
+    atomic_store(&queue->closed, true);
+    event_signal(&queue->not_full);
+    event_signal(&queue->not_empty);
+}
+
+void
+rbh_mpmc_queue_destroy(struct rbh_mpmc_queue *queue)
+{
+    free(queue->data);
+    free(queue->chunks);
+    free(queue);
+}
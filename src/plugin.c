@@ -11,11 +11,92 @@
 
 #include <dlfcn.h>
 #include <errno.h>
+#include <pthread.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include "robinhood/plugin.h"
 
+/*----------------------------------------------------------------------------*
+ |                                  registry                                  |
+ *----------------------------------------------------------------------------*/
+
+/* Every symbol ever imported (or registered), so that importing a plugin
+ * twice does not go through dlopen() twice
+ */
+struct plugin_symbol {
+    struct plugin_symbol *next;
+    const char *name;
+    const char *symbol;
+    void *address;
+};
+
+static pthread_mutex_t registry_mutex = PTHREAD_MUTEX_INITIALIZER;
+static struct plugin_symbol *registry;
+
+static struct plugin_symbol *
+registry_lookup(const char *name, const char *symbol)
+{
+    for (struct plugin_symbol *entry = registry; entry != NULL;
+         entry = entry->next) {
+        if (strcmp(entry->name, name) == 0
+         && strcmp(entry->symbol, symbol) == 0)
+            return entry;
+    }
+
+    return NULL;
+}
+
+int
+rbh_plugin_register(const char *name, const char *symbol, void *address)
+{
+    size_t name_size = strlen(name) + 1;
+    size_t symbol_size = strlen(symbol) + 1;
+    struct plugin_symbol *entry;
+    char *data;
+
+    entry = malloc(sizeof(*entry) + name_size + symbol_size);
+    if (entry == NULL)
+        return -1;
+    data = (char *)entry + sizeof(*entry);
+
+    entry->name = memcpy(data, name, name_size);
+    entry->symbol = memcpy(data + name_size, symbol, symbol_size);
+    entry->address = address;
+
+    pthread_mutex_lock(&registry_mutex);
+    if (registry_lookup(name, symbol) != NULL) {
+        pthread_mutex_unlock(&registry_mutex);
+        free(entry);
+        errno = EEXIST;
+        return -1;
+    }
+    entry->next = registry;
+    registry = entry;
+    pthread_mutex_unlock(&registry_mutex);
+
+    return 0;
+}
+
+static void
+registry_clear(void) __attribute__((destructor));
+
+static void
+registry_clear(void)
+{
+    while (registry != NULL) {
+        struct plugin_symbol *next = registry->next;
+
+        free(registry);
+        registry = next;
+    }
+}
+
+/*----------------------------------------------------------------------------*
+ |                                   import                                   |
+ *----------------------------------------------------------------------------*/
+
 static char *
 rbh_plugin_library(const char *name)
 {
@@ -28,8 +109,8 @@ rbh_plugin_library(const char *name)
     return library;
 }
 
-void *
-rbh_plugin_import(const char *name, const char *symbol)
+static void *
+plugin_dlsym(const char *name, const char *symbol)
 {
     void *dlhandle;
     char *libname;
@@ -50,3 +131,35 @@ rbh_plugin_import(const char *name, const char *symbol)
 
     return sym;
 }
+
+void *
+rbh_plugin_import(const char *name, const char *symbol)
+{
+    struct plugin_symbol *entry;
+    int save_errno = errno;
+    void *sym;
+
+    pthread_mutex_lock(&registry_mutex);
+    entry = registry_lookup(name, symbol);
+    pthread_mutex_unlock(&registry_mutex);
+    if (entry != NULL)
+        return entry->address;
+
+    sym = plugin_dlsym(name, symbol);
+    if (sym == NULL)
+        return NULL;
+
+    /* Failing to cache the symbol is not an error, neither is losing the race
+     * to cache it (RTLD_NODELETE ensures both threads got the same address)
+     */
+    rbh_plugin_register(name, symbol, sym);
+    errno = save_errno;
+
+    return sym;
+}
+
+int
+rbh_plugin_preload(const char *name, const char *symbol)
+{
+    return rbh_plugin_import(name, symbol) == NULL ? -1 : 0;
+}
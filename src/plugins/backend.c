@@ -42,15 +42,78 @@ rbh_backend_plugin_import(const char *name)
 {
     const struct rbh_backend_plugin *plugin;
     int save_errno = errno;
+    char buffer[64];
     char *symbol;
 
-    symbol = rbh_backend_plugin_symbol(name);
-    if (symbol == NULL)
-        return NULL;
+    /* Avoid allocating the symbol every time a backend is created */
+    if ((size_t)snprintf(buffer, sizeof(buffer), "_RBH_%s_BACKEND_PLUGIN",
+                         name) < sizeof(buffer)) {
+        symbol = strtoupper(buffer);
+    } else {
+        symbol = rbh_backend_plugin_symbol(name);
+        if (symbol == NULL)
+            return NULL;
+    }
 
     plugin = rbh_plugin_import(name, symbol);
-    free(symbol);
+    if (symbol != buffer)
+        free(symbol);
     errno = save_errno;
 
     return plugin;
 }
+
+int
+rbh_backend_plugin_preload(const char *name)
+{
+    return rbh_backend_plugin_import(name) == NULL ? -1 : 0;
+}
+
+/*----------------------------------------------------------------------------*
+ |                               static plugins                               |
+ *----------------------------------------------------------------------------*/
+
+#ifdef HAVE_STATIC_POSIX_PLUGIN
+extern const struct rbh_backend_plugin RBH_BACKEND_PLUGIN_SYMBOL(POSIX);
+#endif
+#ifdef HAVE_STATIC_MONGO_PLUGIN
+extern const struct rbh_backend_plugin RBH_BACKEND_PLUGIN_SYMBOL(MONGO);
+#endif
+#ifdef HAVE_STATIC_LUSTRE_PLUGIN
+extern const struct rbh_backend_plugin RBH_BACKEND_PLUGIN_SYMBOL(LUSTRE);
+#endif
+
+#define STATIC_PLUGIN(name, NAME) { \
+    #name, "_RBH_" #NAME "_BACKEND_PLUGIN", &RBH_BACKEND_PLUGIN_SYMBOL(NAME) \
+}
+
+static const struct {
+    const char *name;
+    const char *symbol;
+    const struct rbh_backend_plugin *plugin;
+} STATIC_PLUGINS[] = {
+#ifdef HAVE_STATIC_POSIX_PLUGIN
+    STATIC_PLUGIN(posix, POSIX),
+#endif
+#ifdef HAVE_STATIC_MONGO_PLUGIN
+    STATIC_PLUGIN(mongo, MONGO),
+#endif
+#ifdef HAVE_STATIC_LUSTRE_PLUGIN
+    STATIC_PLUGIN(lustre, LUSTRE),
+#endif
+    { NULL, NULL, NULL }, /* avoid empty initializers */
+};
+
+static void
+register_static_plugins(void) __attribute__((constructor));
+
+/* Plugins linked into the library are registered before anyone can import
+ * them: importing them never involves dlopen()
+ */
+static void
+register_static_plugins(void)
+{
+    for (size_t i = 0; STATIC_PLUGINS[i].name != NULL; i++)
+        rbh_plugin_register(STATIC_PLUGINS[i].name, STATIC_PLUGINS[i].symbol,
+                            (void *)STATIC_PLUGINS[i].plugin);
+}
@@ -25,6 +25,7 @@ struct rbh_queue {
     size_t chunk_size;
 
     struct rbh_sstack *pool;
+    size_t pooled;
 
     size_t head;
     size_t tail;
@@ -75,6 +76,7 @@ rbh_queue_new(size_t chunk_size)
 
     queue->rings[0] = ring;
     queue->chunk_size = chunk_size;
+    queue->pooled = 0;
     queue->head = queue->tail = 0;
     queue->count = 1;
 
@@ -124,6 +126,7 @@ retry:
         assert(readable % sizeof(struct rbh_ring *) == 0);
         queue->rings[queue->tail] = *ring_ptr;
         rbh_sstack_pop(queue->pool, sizeof(struct rbh_ring *));
+        queue->pooled--;
     } else {
         queue->rings[queue->tail] = rbh_ring_new(queue->chunk_size);
         if (queue->rings[queue->tail] == NULL) {
@@ -155,6 +158,8 @@ rbh_queue_pop(struct rbh_queue *queue, size_t count)
         if (rbh_sstack_push(queue->pool, &ring, sizeof(ring)) == NULL)
             /* Better waste resources than fail here */
             rbh_ring_destroy(ring);
+        else
+            queue->pooled++;
         queue->head++;
     }
 
@@ -179,11 +184,28 @@ rbh_queue_shrink(struct rbh_queue *queue)
 
         rbh_sstack_pop(queue->pool, readable);
     } while (true);
+    queue->pooled = 0;
 
     /* And shrink the pool itself */
     return rbh_sstack_shrink(queue->pool);
 }
 
+void
+rbh_queue_usage(struct rbh_queue *queue, struct rbh_memory_usage *usage)
+{
+    usage->cached = queue->pooled * queue->chunk_size;
+    usage->allocated = usage->cached;
+    usage->used = 0;
+
+    for (size_t i = queue->head; i <= queue->tail; i++) {
+        struct rbh_memory_usage ring;
+
+        rbh_ring_usage(queue->rings[i], &ring);
+        usage->allocated += ring.allocated;
+        usage->used += ring.used;
+    }
+}
+
 void
 rbh_queue_destroy(struct rbh_queue *queue)
 {
@@ -0,0 +1,606 @@
+/* This file is part of the RobinHood Library
+ * Copyright (C) 2022 Commissariat a l'energie atomique et aux energies
+ *                    alternatives
+ *
+ * SPDX-License-Identifer: LGPL-3.0-or-later
+ */
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "robinhood/resolver.h"
+#include "robinhood/idmap.h"
+
+struct resolver_operations {
+    ssize_t (*resolve)(struct rbh_resolver *resolver, const struct rbh_id *ids,
+                       size_t count, char **paths);
+    void (*destroy)(struct rbh_resolver *resolver);
+};
+
+/*----------------------------------------------------------------------------*
+ |                                 path cache                                 |
+ *----------------------------------------------------------------------------*/
+
+/* IDs are mapped to a pointer to their (malloc'ed) path.
+ *
+ * The cache is flushed whenever it is full: hot directories quickly make it
+ * back in, and it is a lot simpler than evicting paths one by one.
+ */
+struct path_cache {
+    pthread_mutex_t mutex;
+    struct rbh_idmap *paths;
+    size_t capacity;
+};
+
+static int
+path_cache_init(struct path_cache *cache, size_t capacity)
+{
+    cache->capacity = capacity;
+    cache->paths = rbh_idmap_new(sizeof(char *), 0);
+    if (cache->paths == NULL)
+        return -1;
+
+    pthread_mutex_init(&cache->mutex, NULL);
+    return 0;
+}
+
+static void
+path_cache_flush(struct path_cache *cache)
+{
+    const struct rbh_idmap_entry *entry;
+    struct rbh_iterator *entries;
+    struct rbh_idmap *paths;
+
+    paths = rbh_idmap_new(sizeof(char *), 0);
+    if (paths == NULL)
+        /* Keep the current cache, it just will not grow */
+        return;
+
+    entries = rbh_idmap_iter(cache->paths);
+    if (entries == NULL) {
+        rbh_idmap_destroy(paths);
+        return;
+    }
+
+    while ((entry = rbh_iter_next(entries)) != NULL)
+        free(*(char **)entry->value);
+    rbh_iter_destroy(entries);
+
+    rbh_idmap_destroy(cache->paths);
+    cache->paths = paths;
+}
+
+/* The returned path is only valid until the next call to path_cache_insert() */
+static const char *
+path_cache_lookup(struct path_cache *cache, const struct rbh_id *id)
+{
+    char **path;
+
+    path = rbh_idmap_get(cache->paths, id);
+    return path == NULL ? NULL : *path;
+}
+
+/* Failing to cache a path is not an error */
+static void
+path_cache_insert(struct path_cache *cache, const struct rbh_id *id,
+                  const char *path)
+{
+    char **value;
+    bool created;
+    char *copy;
+
+    if (cache->capacity == 0)
+        return;
+
+    if (rbh_idmap_count(cache->paths) >= cache->capacity)
+        path_cache_flush(cache);
+
+    copy = strdup(path);
+    if (copy == NULL)
+        return;
+
+    value = rbh_idmap_put(cache->paths, id, &created);
+    if (value == NULL) {
+        free(copy);
+        return;
+    }
+
+    if (!created)
+        free(*value);
+    *value = copy;
+}
+
+static void
+path_cache_fini(struct path_cache *cache)
+{
+    path_cache_flush(cache);
+    rbh_idmap_destroy(cache->paths);
+    pthread_mutex_destroy(&cache->mutex);
+}
+
+struct rbh_resolver {
+    const struct resolver_operations *ops;
+    struct path_cache cache;
+};
+
+static void
+resolver_reset(char **paths, size_t count)
+{
+    for (size_t i = 0; i < count; i++) {
+        free(paths[i]);
+        paths[i] = NULL;
+    }
+}
+
+/*----------------------------------------------------------------------------*
+ |                               posix resolver                               |
+ *----------------------------------------------------------------------------*/
+
+struct posix_resolver {
+    struct rbh_resolver resolver;
+    size_t threads;
+    int mount_fd;
+    /* The prefix to strip from the paths the kernel returns */
+    char *root;
+    size_t root_length;
+};
+
+/* Returns NULL and sets errno to ENOMEM on fatal errors, returns NULL and sets
+ * errno to anything else for IDs that cannot be resolved.
+ */
+static char *
+posix_resolve_one(struct posix_resolver *posix, const struct rbh_id *id)
+{
+    struct path_cache *cache = &posix->resolver.cache;
+    char proc_fd_path[sizeof("/proc/self/fd/") + 16];
+    struct file_handle *handle;
+    char buffer[PATH_MAX];
+    const char *cached;
+    const char *path;
+    int save_errno;
+    ssize_t length;
+    char *result;
+    int fd;
+
+    pthread_mutex_lock(&cache->mutex);
+    cached = path_cache_lookup(cache, id);
+    result = cached ? strdup(cached) : NULL;
+    pthread_mutex_unlock(&cache->mutex);
+    if (cached)
+        return result;
+
+    handle = rbh_file_handle_from_id(id);
+    if (handle == NULL)
+        return NULL;
+
+    fd = open_by_handle_at(posix->mount_fd, handle,
+                           O_RDONLY | O_CLOEXEC | O_NOFOLLOW | O_PATH);
+    save_errno = errno;
+    free(handle);
+    if (fd < 0) {
+        errno = save_errno;
+        return NULL;
+    }
+
+    /* Readlink the magic link directly, rather than opening it first */
+    sprintf(proc_fd_path, "/proc/self/fd/%d", fd);
+    length = readlink(proc_fd_path, buffer, sizeof(buffer));
+    save_errno = errno;
+
+    /* Ignore errors on close */
+    close(fd);
+
+    if (length < 0 || (size_t)length >= sizeof(buffer)) {
+        errno = length < 0 ? save_errno : ENAMETOOLONG;
+        return NULL;
+    }
+    buffer[length] = '\0';
+
+    if (strncmp(buffer, posix->root, posix->root_length)
+     || (buffer[posix->root_length] != '/'
+      && buffer[posix->root_length] != '\0')) {
+        /* Outside of root */
+        errno = EXDEV;
+        return NULL;
+    }
+
+    path = buffer + posix->root_length;
+    if (*path == '\0')
+        path = "/";
+
+    result = strdup(path);
+    if (result == NULL)
+        return NULL;
+
+    pthread_mutex_lock(&cache->mutex);
+    path_cache_insert(cache, id, result);
+    pthread_mutex_unlock(&cache->mutex);
+
+    return result;
+}
+
+struct posix_batch {
+    struct posix_resolver *posix;
+    const struct rbh_id *ids;
+    size_t count;
+    char **paths;
+
+    atomic_size_t next;
+    atomic_size_t resolved;
+    atomic_bool failed;
+};
+
+static void *
+posix_batch_work(void *data)
+{
+    struct posix_batch *batch = data;
+    size_t i;
+
+    while (!atomic_load_explicit(&batch->failed, memory_order_relaxed)
+        && (i = atomic_fetch_add(&batch->next, 1)) < batch->count) {
+        char *path;
+
+        path = posix_resolve_one(batch->posix, &batch->ids[i]);
+        batch->paths[i] = path;
+        if (path != NULL)
+            atomic_fetch_add(&batch->resolved, 1);
+        else if (errno == ENOMEM)
+            atomic_store(&batch->failed, true);
+    }
+
+    return NULL;
+}
+
+static ssize_t
+posix_resolver_resolve(struct rbh_resolver *resolver, const struct rbh_id *ids,
+                       size_t count, char **paths)
+{
+    struct posix_resolver *posix = (struct posix_resolver *)resolver;
+    struct posix_batch batch = {
+        .posix = posix,
+        .ids = ids,
+        .count = count,
+        .paths = paths,
+    };
+    size_t threads = posix->threads < count ? posix->threads : count;
+    pthread_t *workers = NULL;
+    size_t spawned = 0;
+
+    for (size_t i = 0; i < count; i++)
+        paths[i] = NULL;
+
+    if (threads > 1)
+        /* On error, the calling thread does all the work */
+        workers = malloc((threads - 1) * sizeof(*workers));
+
+    /* The calling thread is one of the workers */
+    for (; workers != NULL && spawned + 1 < threads; spawned++) {
+        if (pthread_create(&workers[spawned], NULL, posix_batch_work, &batch))
+            /* Make do with fewer threads */
+            break;
+    }
+
+    posix_batch_work(&batch);
+
+    for (size_t i = 0; i < spawned; i++)
+        pthread_join(workers[i], NULL);
+    free(workers);
+
+    if (atomic_load(&batch.failed)) {
+        resolver_reset(paths, count);
+        errno = ENOMEM;
+        return -1;
+    }
+
+    return atomic_load(&batch.resolved);
+}
+
+static void
+posix_resolver_destroy(struct rbh_resolver *resolver)
+{
+    struct posix_resolver *posix = (struct posix_resolver *)resolver;
+
+    close(posix->mount_fd);
+    free(posix->root);
+}
+
+static const struct resolver_operations POSIX_RESOLVER_OPS = {
+    .resolve = posix_resolver_resolve,
+    .destroy = posix_resolver_destroy,
+};
+
+struct rbh_resolver *
+rbh_resolver_new(const char *root, size_t threads, size_t capacity)
+{
+    struct posix_resolver *posix;
+    int save_errno;
+
+    posix = malloc(sizeof(*posix));
+    if (posix == NULL)
+        return NULL;
+
+    posix->root = realpath(root, NULL);
+    if (posix->root == NULL)
+        goto out_free_posix;
+
+    /* The paths of the root's children should keep their leading '/' */
+    posix->root_length = strcmp(posix->root, "/") ? strlen(posix->root) : 0;
+
+    posix->mount_fd = open(posix->root, O_RDONLY | O_CLOEXEC | O_DIRECTORY);
+    if (posix->mount_fd < 0)
+        goto out_free_root;
+
+    if (path_cache_init(&posix->resolver.cache, capacity))
+        goto out_close_mount_fd;
+
+    if (threads == 0) {
+        long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+
+        threads = cpus > 0 ? cpus : 1;
+    }
+
+    posix->threads = threads;
+    posix->resolver.ops = &POSIX_RESOLVER_OPS;
+    return &posix->resolver;
+
+out_close_mount_fd:
+    save_errno = errno;
+    close(posix->mount_fd);
+    errno = save_errno;
+out_free_root:
+    save_errno = errno;
+    free(posix->root);
+    errno = save_errno;
+out_free_posix:
+    save_errno = errno;
+    free(posix);
+    errno = save_errno;
+    return NULL;
+}
+
+/*----------------------------------------------------------------------------*
+ |                              backend resolver                              |
+ *----------------------------------------------------------------------------*/
+
+/* Entries further than that from the root are assumed to be part of a loop
+ * (which the eventual consistency of backends may create)
+ */
+#define MAX_DEPTH (PATH_MAX / 2)
+
+struct backend_resolver {
+    struct rbh_resolver resolver;
+    struct rbh_backend *backend;
+};
+
+static struct rbh_fsentry *
+fsentry_from_id(struct rbh_backend *backend, const struct rbh_id *id)
+{
+    const struct rbh_filter ID_FILTER = {
+        .op = RBH_FOP_EQUAL,
+        .compare = {
+            .field = {
+                .fsentry = RBH_FP_ID,
+            },
+            .value = {
+                .type = RBH_VT_BINARY,
+                .binary = {
+                    .data = id->data,
+                    .size = id->size,
+                },
+            },
+        },
+    };
+    const struct rbh_filter_projection PARENT_AND_NAME = {
+        .fsentry_mask = RBH_FP_ID | RBH_FP_PARENT_ID | RBH_FP_NAME,
+    };
+
+    return rbh_backend_filter_one(backend, &ID_FILTER, &PARENT_AND_NAME);
+}
+
+static char *
+path_join(const char *dirname, const char *basename)
+{
+    size_t length = strlen(dirname);
+    char *path;
+
+    /* Do not double the root's '/' */
+    if (length > 0 && dirname[length - 1] == '/')
+        length--;
+
+    path = malloc(length + 1 + strlen(basename) + 1);
+    if (path == NULL)
+        return NULL;
+
+    memcpy(path, dirname, length);
+    path[length] = '/';
+    strcpy(path + length + 1, basename);
+    return path;
+}
+
+/* Returns NULL and sets errno to ENOENT or ENODATA for IDs that cannot be
+ * resolved, to anything else on fatal errors.
+ */
+static char *
+backend_resolve_one(struct backend_resolver *resolver, const struct rbh_id *id)
+{
+    struct path_cache *cache = &resolver->resolver.cache;
+    struct rbh_fsentry *ancestors[MAX_DEPTH];
+    const struct rbh_id *current = id;
+    char *path = NULL;
+    size_t depth = 0;
+    const char *base;
+    int save_errno;
+
+    base = path_cache_lookup(cache, id);
+    if (base != NULL)
+        return strdup(base);
+
+    /* Walk up to the root, or to a directory whose path is known */
+    while (true) {
+        struct rbh_fsentry *fsentry;
+
+        if (depth == MAX_DEPTH) {
+            errno = ENOENT;
+            goto out_free_ancestors;
+        }
+
+        fsentry = fsentry_from_id(resolver->backend, current);
+        if (fsentry == NULL)
+            goto out_free_ancestors;
+
+        ancestors[depth++] = fsentry;
+
+        if (!(fsentry->mask & RBH_FP_PARENT_ID)) {
+            /* Not linked in the namespace (yet) */
+            errno = ENODATA;
+            goto out_free_ancestors;
+        }
+
+        if (fsentry->parent_id.size == 0) {
+            path = strdup("/");
+            break;
+        }
+
+        base = path_cache_lookup(cache, &fsentry->parent_id);
+        if (base != NULL) {
+            path = strdup(base);
+            break;
+        }
+
+        current = &fsentry->parent_id;
+    }
+
+    if (path == NULL)
+        goto out_free_ancestors;
+
+    /* Walk back down, remembering the path of every directory on the way */
+    while (depth > 0) {
+        struct rbh_fsentry *fsentry = ancestors[--depth];
+
+        if (fsentry->parent_id.size > 0) {
+            char *tmp;
+
+            if (!(fsentry->mask & RBH_FP_NAME)) {
+                errno = ENODATA;
+                goto out_free_path;
+            }
+
+            tmp = path_join(path, fsentry->name);
+            if (tmp == NULL)
+                goto out_free_path;
+            free(path);
+            path = tmp;
+        }
+
+        path_cache_insert(cache, &fsentry->id, path);
+        free(fsentry);
+    }
+
+    return path;
+
+out_free_path:
+    /* The current fsentry was popped, but not freed */
+    depth++;
+    save_errno = errno;
+    free(path);
+    errno = save_errno;
+out_free_ancestors:
+    save_errno = errno;
+    while (depth > 0)
+        free(ancestors[--depth]);
+    errno = save_errno;
+    return NULL;
+}
+
+static ssize_t
+backend_resolver_resolve(struct rbh_resolver *resolver,
+                         const struct rbh_id *ids, size_t count, char **paths)
+{
+    struct backend_resolver *backend = (struct backend_resolver *)resolver;
+    size_t resolved = 0;
+
+    for (size_t i = 0; i < count; i++)
+        paths[i] = NULL;
+
+    for (size_t i = 0; i < count; i++) {
+        paths[i] = backend_resolve_one(backend, &ids[i]);
+        if (paths[i] != NULL) {
+            resolved++;
+            continue;
+        }
+
+        if (errno != ENOENT && errno != ENODATA) {
+            int save_errno = errno;
+
+            resolver_reset(paths, count);
+            errno = save_errno;
+            return -1;
+        }
+    }
+
+    return resolved;
+}
+
+static void
+backend_resolver_destroy(struct rbh_resolver *resolver)
+{
+    (void)resolver;
+}
+
+static const struct resolver_operations BACKEND_RESOLVER_OPS = {
+    .resolve = backend_resolver_resolve,
+    .destroy = backend_resolver_destroy,
+};
+
+struct rbh_resolver *
+rbh_resolver_from_backend(struct rbh_backend *backend, size_t capacity)
+{
+    struct backend_resolver *resolver;
+
+    resolver = malloc(sizeof(*resolver));
+    if (resolver == NULL)
+        return NULL;
+
+    if (path_cache_init(&resolver->resolver.cache, capacity)) {
+        int save_errno = errno;
+
+        free(resolver);
+        errno = save_errno;
+        return NULL;
+    }
+
+    resolver->backend = backend;
+    resolver->resolver.ops = &BACKEND_RESOLVER_OPS;
+    return &resolver->resolver;
+}
+
+/*----------------------------------------------------------------------------*
+ |                                    API                                     |
+ *----------------------------------------------------------------------------*/
+
+ssize_t
+rbh_resolver_resolve(struct rbh_resolver *resolver, const struct rbh_id *ids,
+                     size_t count, char **paths)
+{
+    return resolver->ops->resolve(resolver, ids, count, paths);
+}
+
+void
+rbh_resolver_destroy(struct rbh_resolver *resolver)
+{
+    resolver->ops->destroy(resolver);
+    path_cache_fini(&resolver->cache);
+    free(resolver);
+}
@@ -10,90 +10,265 @@
 #endif
 
 #include <errno.h>
+#include <stdalign.h>
+#include <stdatomic.h>
+#include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
 
+#include <linux/memfd.h>
 #include <sys/mman.h>
 #include <sys/syscall.h>
 
 #include "robinhood/ring.h"
+#include "budget.h"
+#include "hugepages.h"
+#include "pool.h"
 #include "ring.h"
+#include "utils.h"
 
-struct rbh_ring *
-rbh_ring_new(size_t size)
+/* Reserve `size' bytes of the process' address space, aligned on `alignment'
+ * bytes (a power of 2, at least as large as a page)
+ */
+static char *
+reserve(size_t size, size_t alignment)
+{
+    size_t page_size = sysconf(_SC_PAGESIZE);
+    char *buffer, *aligned;
+    size_t padding;
+
+    padding = alignment > page_size ? alignment : 0;
+    buffer = mmap(NULL, size + padding, PROT_NONE,
+                  MAP_ANONYMOUS | MAP_PRIVATE | MAP_NORESERVE, -1, 0);
+    if (buffer == MAP_FAILED)
+        return NULL;
+
+    if (padding == 0)
+        return buffer;
+
+    aligned = buffer + alignoffset(buffer, alignment);
+    if (aligned > buffer)
+        munmap(buffer, aligned - buffer);
+    if (buffer + padding > aligned)
+        munmap(aligned + size, buffer + padding - aligned);
+
+    return aligned;
+}
+
+/* Map a memory file twice, contiguously, so that any range of `size' bytes
+ * starting in the first mapping can be accessed linearly
+ *
+ * Enough address space is reserved for the mappings to grow up to `max_size'
+ * bytes each, in place. If `fd' is not NULL, the memory file is not closed
+ * and its file descriptor is stored in `fd'.
+ *
+ * `flags' are passed to memfd_create().
+ */
+static char *
+ring_map_memfd(size_t size, size_t max_size, int *fd, unsigned int flags)
 {
-    struct rbh_ring *ring;
     void *buffer;
-    int fd;
+    int memfd;
 
-    fd = syscall(SYS_memfd_create, "ring", 0);
-    if (fd < 0)
+    memfd = syscall(SYS_memfd_create, "ring", flags);
+    if (memfd < 0)
         return NULL;
 
-    if (ftruncate(fd, size)) {
+    if (ftruncate(memfd, size)) {
         int save_errno = errno;
 
-        close(fd);
+        close(memfd);
         errno = save_errno;
         return NULL;
     }
 
-    /* Reserve a range in the process' address space */
-    buffer = mmap(NULL, size << 1, PROT_READ | PROT_WRITE,
-                  MAP_ANONYMOUS | MAP_PRIVATE, -1, 0);
-    if (buffer == MAP_FAILED) {
+    buffer = reserve(max_size << 1,
+                     flags & MFD_HUGETLB ? huge_page_size() : 0);
+    if (buffer == NULL) {
         int save_errno = errno;
 
-        close(fd);
+        close(memfd);
         errno = save_errno;
         return NULL;
     }
 
     if (mmap(buffer, size, PROT_READ | PROT_WRITE,
-             MAP_SHARED | MAP_FIXED, fd, 0) == MAP_FAILED) {
+             MAP_SHARED | MAP_FIXED, memfd, 0) == MAP_FAILED) {
         int save_errno = errno;
 
-        munmap(buffer, size << 1);
-        close(fd);
+        munmap(buffer, max_size << 1);
+        close(memfd);
         errno = save_errno;
         return NULL;
     }
 
     if (mmap(buffer + size, size, PROT_READ | PROT_WRITE,
-             MAP_SHARED | MAP_FIXED, fd, 0) == MAP_FAILED) {
+             MAP_SHARED | MAP_FIXED, memfd, 0) == MAP_FAILED) {
+        int save_errno = errno;
+
+        munmap(buffer, max_size << 1);
+        close(memfd);
+        errno = save_errno;
+        return NULL;
+    }
+
+    if (fd != NULL) {
+        *fd = memfd;
+        return buffer;
+    }
+
+    if (close(memfd)) {
         int save_errno = errno;
 
-        munmap(buffer, size << 1);
-        close(fd);
+        munmap(buffer, max_size << 1);
         errno = save_errno;
         return NULL;
     }
 
-    if (close(fd)) {
+    return buffer;
+}
+
+static char *
+ring_map(size_t size, size_t max_size, int *fd)
+{
+    char *buffer;
+
+    if (fd == NULL) {
+        /* Cached mappings are already accounted for */
+        buffer = pool_get(POOL_RING, size);
+        if (buffer != NULL)
+            return buffer;
+    }
+
+    if (memory_charge(size))
+        return NULL;
+
+    if (huge_pages_explicit(size)) {
+        buffer = ring_map_memfd(size, max_size, fd, MFD_HUGETLB);
+        if (buffer != NULL)
+            return buffer;
+        /* The hugetlb pool is most likely empty, fall back to THP */
+    }
+
+    buffer = ring_map_memfd(size, max_size, fd, 0);
+    if (buffer == NULL) {
         int save_errno = errno;
 
-        munmap(buffer, size << 1);
+        memory_discharge(size);
         errno = save_errno;
         return NULL;
     }
 
+    huge_pages_advise(buffer, size << 1);
+    return buffer;
+}
+
+/* Release a mapping made by ring_map() with a NULL `fd' */
+static void
+ring_unmap(char *buffer, size_t size)
+{
+    if (pool_put(POOL_RING, buffer, size))
+        return;
+
+    munmap(buffer, size << 1);
+    memory_discharge(size);
+}
+
+struct rbh_ring *
+rbh_ring_new(size_t size)
+{
+    return rbh_ring_new_growable(size, size);
+}
+
+struct rbh_ring *
+rbh_ring_new_growable(size_t size, size_t max_size)
+{
+    struct rbh_ring *ring;
+    size_t growth;
+    char *buffer;
+    int fd = -1;
+
+    if (size == 0 || max_size < size || max_size > SIZE_MAX >> 2) {
+        errno = EINVAL;
+        return NULL;
+    }
+
+    /* Rings grow by doubling their size */
+    for (growth = size; growth <= max_size >> 1; growth <<= 1)
+        ;
+    max_size = growth;
+
+    buffer = ring_map(size, max_size, max_size > size ? &fd : NULL);
+    if (buffer == NULL)
+        return NULL;
+
     ring = malloc(sizeof(*ring));
     if (ring == NULL) {
         int save_errno = errno;
 
-        munmap(buffer, size << 1);
+        if (fd >= 0) {
+            munmap(buffer, max_size << 1);
+            close(fd);
+            memory_discharge(size);
+        } else {
+            ring_unmap(buffer, size);
+        }
         errno = save_errno;
         return NULL;
     }
 
     ring->size = size;
+    ring->max_size = max_size;
+    ring->fd = fd;
     ring->used = 0;
     ring->head = ring->data = buffer;
 
     return ring;
 }
 
+/* Double the size of a ring, in place
+ *
+ * Once the memory file is twice as large, the second half of the ring's
+ * address space is remapped onto its second half (instead of being an alias of
+ * its first half), and the content of the first half is copied there. This
+ * way, any address in the ring that was valid before still is, and still
+ * points at the same data.
+ */
+static int
+ring_double(struct rbh_ring *ring)
+{
+    size_t size = ring->size;
+    int save_errno;
+
+    if (memory_charge(size))
+        return -1;
+
+    if (ftruncate(ring->fd, size << 1))
+        goto out_discharge;
+
+    /* The new alias of the whole memory file */
+    if (mmap(ring->data + (size << 1), size << 1, PROT_READ | PROT_WRITE,
+             MAP_SHARED | MAP_FIXED, ring->fd, 0) == MAP_FAILED)
+        goto out_discharge;
+
+    memcpy(ring->data + (size << 1) + size, ring->data, size);
+
+    if (mmap(ring->data + size, size, PROT_READ | PROT_WRITE,
+             MAP_SHARED | MAP_FIXED, ring->fd, size) == MAP_FAILED)
+        goto out_discharge;
+
+    huge_pages_advise(ring->data, size << 2);
+    ring->size = size << 1;
+    return 0;
+
+out_discharge:
+    save_errno = errno;
+    memory_discharge(size);
+    errno = save_errno;
+    return -1;
+}
+
 void *
 rbh_ring_push(struct rbh_ring *ring, const void *data, size_t size)
 {
@@ -102,11 +277,21 @@ rbh_ring_push(struct rbh_ring *ring, const void *data, size_t size)
     if (size == 0)
         return tail;
 
-    if (ring->size - ring->used < size) {
-        errno = size > ring->size ? EINVAL : ENOBUFS;
+    if (size > ring->max_size) {
+        errno = EINVAL;
         return NULL;
     }
 
+    while (ring->size - ring->used < size) {
+        if (ring->size == ring->max_size) {
+            errno = ENOBUFS;
+            return NULL;
+        }
+
+        if (ring_double(ring))
+            return NULL;
+    }
+
     ring->used += size;
     if (data != NULL)
         memcpy(tail, data, size);
@@ -137,9 +322,175 @@ rbh_ring_pop(struct rbh_ring *ring, size_t count)
     return 0;
 }
 
+void
+rbh_ring_usage(struct rbh_ring *ring, struct rbh_memory_usage *usage)
+{
+    usage->allocated = ring->size;
+    usage->used = ring->used;
+    usage->cached = 0;
+}
+
 void
 rbh_ring_destroy(struct rbh_ring *ring)
 {
-    munmap(ring->data, ring->size << 1);
+    if (ring->fd >= 0) {
+        munmap(ring->data, ring->max_size << 1);
+        close(ring->fd);
+        memory_discharge(ring->size);
+    } else {
+        ring_unmap(ring->data, ring->size);
+    }
+    free(ring);
+}
+
+/*----------------------------------------------------------------------------*
+ |                                rbh_spsc_ring                               |
+ *----------------------------------------------------------------------------*/
+
+#define CACHE_LINE_SIZE 64
+
+/* `head' and `tail' are positions in the stream of bytes that went through
+ * the ring, they never wrap around (it would take years of pushing data at
+ * hundreds of GB/s to overflow them).
+ *
+ * Each side owns one of them, and keeps a cached copy of the other that it
+ * only refreshes when it appears to run out of space (or data). This keeps
+ * the cache line of each index in its owner's cache most of the time.
+ */
+struct rbh_spsc_ring {
+    size_t size;
+    char *data;
+
+    /* Written by the consumer */
+    alignas(CACHE_LINE_SIZE) atomic_uint_fast64_t head;
+    uint64_t tail_cache;
+
+    /* Written by the producer */
+    alignas(CACHE_LINE_SIZE) atomic_uint_fast64_t tail;
+    uint64_t head_cache;
+};
+
+struct rbh_spsc_ring *
+rbh_spsc_ring_new(size_t size)
+{
+    struct rbh_spsc_ring *ring;
+    char *buffer;
+
+    buffer = ring_map(size, size, NULL);
+    if (buffer == NULL)
+        return NULL;
+
+    ring = aligned_alloc(alignof(*ring), sizeof(*ring));
+    if (ring == NULL) {
+        int save_errno = errno;
+
+        ring_unmap(buffer, size);
+        errno = save_errno;
+        return NULL;
+    }
+
+    ring->size = size;
+    ring->data = buffer;
+    atomic_init(&ring->head, 0);
+    ring->tail_cache = 0;
+    atomic_init(&ring->tail, 0);
+    ring->head_cache = 0;
+
+    return ring;
+}
+
+/* Producer side: the number of bytes that can be written in the ring */
+static size_t
+spsc_ring_writable(struct rbh_spsc_ring *ring, uint64_t tail, size_t size)
+{
+    size_t writable = ring->size - (tail - ring->head_cache);
+
+    if (writable < size) {
+        ring->head_cache = atomic_load_explicit(&ring->head,
+                                                memory_order_acquire);
+        writable = ring->size - (tail - ring->head_cache);
+    }
+
+    return writable;
+}
+
+void *
+rbh_spsc_ring_reserve(struct rbh_spsc_ring *ring, size_t size)
+{
+    uint64_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+
+    if (spsc_ring_writable(ring, tail, size) < size) {
+        errno = size > ring->size ? EINVAL : ENOBUFS;
+        return NULL;
+    }
+
+    return ring->data + tail % ring->size;
+}
+
+int
+rbh_spsc_ring_commit(struct rbh_spsc_ring *ring, size_t size)
+{
+    uint64_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+
+    if (spsc_ring_writable(ring, tail, size) < size) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    /* Publish the data written in the reserved space */
+    atomic_store_explicit(&ring->tail, tail + size, memory_order_release);
+    return 0;
+}
+
+void *
+rbh_spsc_ring_push(struct rbh_spsc_ring *ring, const void *data, size_t size)
+{
+    void *address;
+
+    address = rbh_spsc_ring_reserve(ring, size);
+    if (address == NULL)
+        return NULL;
+
+    memcpy(address, data, size);
+    rbh_spsc_ring_commit(ring, size);
+    return address;
+}
+
+void *
+rbh_spsc_ring_peek(struct rbh_spsc_ring *ring, size_t count, size_t *readable)
+{
+    uint64_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+
+    /* Only touch the producer's cache line when we have to */
+    if (ring->tail_cache - head < count || ring->tail_cache == head)
+        ring->tail_cache = atomic_load_explicit(&ring->tail,
+                                                memory_order_acquire);
+    *readable = ring->tail_cache - head;
+    return ring->data + head % ring->size;
+}
+
+int
+rbh_spsc_ring_pop(struct rbh_spsc_ring *ring, size_t count)
+{
+    uint64_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+
+    if (count > ring->tail_cache - head) {
+        ring->tail_cache = atomic_load_explicit(&ring->tail,
+                                                memory_order_acquire);
+        if (count > ring->tail_cache - head) {
+            errno = EINVAL;
+            return -1;
+        }
+    }
+
+    /* Hand the space back to the producer, once we are done reading it */
+    atomic_store_explicit(&ring->head, head + count, memory_order_release);
+    return 0;
+}
+
+void
+rbh_spsc_ring_destroy(struct rbh_spsc_ring *ring)
+{
+    ring_unmap(ring->data, ring->size);
     free(ring);
 }
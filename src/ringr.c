@@ -15,6 +15,7 @@
 #include <stdlib.h>
 
 #include "robinhood/ring.h"
+#include "robinhood/ringr.h"
 #include "ring.h"
 
 struct rbh_ringr {
@@ -26,11 +27,17 @@ struct rbh_ringr {
 
 struct rbh_ringr *
 rbh_ringr_new(size_t size)
+{
+    return rbh_ringr_new_growable(size, size);
+}
+
+struct rbh_ringr *
+rbh_ringr_new_growable(size_t size, size_t max_size)
 {
     struct rbh_ringr *ringr;
     struct rbh_ring *ring;
 
-    ring = rbh_ring_new(size);
+    ring = rbh_ring_new_growable(size, max_size);
     if (ring == NULL)
         return NULL;
 
@@ -69,13 +76,40 @@ rbh_ringr_dup(struct rbh_ringr *ringr)
     return duplicate;
 }
 
+/* Move the readers of a ring that just grew so that they keep pointing at the
+ * same data
+ *
+ * The content of the ring is stored in place, and its head did not move, but
+ * readers that had wrapped around the ring's end are now lagging behind its
+ * head, by exactly `old_size' bytes.
+ */
+static void
+ringr_grown(struct rbh_ringr *ringr, size_t old_size)
+{
+    struct rbh_ring *ring = ringr->ring;
+    struct rbh_ringr *head = ringr;
+
+    do {
+        if (ringr->head < ring->head
+                || (ringr->head == ring->head && ringr->starved)) {
+            ringr->head += old_size;
+            ringr->starved = false;
+        }
+        ringr = ringr->next;
+    } while (ringr != head);
+}
+
 void *
 rbh_ringr_push(struct rbh_ringr *ringr, const void *data, size_t size)
 {
     struct rbh_ringr *head = ringr;
+    size_t old_size = ringr->ring->size;
     void *address;
 
     address = rbh_ring_push(ringr->ring, data, size);
+    /* The ring may have grown, even if it failed to grow enough */
+    if (ringr->ring->size != old_size)
+        ringr_grown(ringr, old_size);
     if (address == NULL)
         return NULL;
 
@@ -0,0 +1,532 @@
+/* This file is part of the RobinHood Library
+ * Copyright (C) 2022 Commissariat a l'energie atomique et aux energies
+ *                    alternatives
+ *
+ * SPDX-License-Identifer: LGPL-3.0-or-later
+ */
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <errno.h>
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "robinhood/sampling.h"
+
+#include "random.h"
+
+/*----------------------------------------------------------------------------*
+ |                            rbh_iter_bernoulli()                            |
+ *----------------------------------------------------------------------------*/
+
+struct bernoulli_iterator {
+    struct rbh_iterator iterator;
+
+    struct rbh_iterator *elements;
+    struct rand64 rand;
+    double rate;
+    /* The number of elements to skip before the next one to keep */
+    size_t skip;
+    bool owned;
+};
+
+static const void *
+bernoulli_iter_next(void *iterator)
+{
+    struct bernoulli_iterator *bernoulli = iterator;
+    const void *element;
+
+    while (true) {
+        element = rbh_iter_next(bernoulli->elements);
+        if (element == NULL)
+            return NULL;
+
+        if (bernoulli->skip == 0)
+            break;
+
+        bernoulli->skip--;
+        if (bernoulli->owned)
+            free((void *)element);
+    }
+
+    bernoulli->skip = rand64_geometric(&bernoulli->rand, bernoulli->rate);
+    return element;
+}
+
+static void
+bernoulli_iter_destroy(void *iterator)
+{
+    struct bernoulli_iterator *bernoulli = iterator;
+
+    rbh_iter_destroy(bernoulli->elements);
+    free(bernoulli);
+}
+
+static const struct rbh_iterator_operations BERNOULLI_ITER_OPS = {
+    .next = bernoulli_iter_next,
+    .destroy = bernoulli_iter_destroy,
+};
+
+static const struct rbh_iterator BERNOULLI_ITER = {
+    .ops = &BERNOULLI_ITER_OPS,
+};
+
+static struct bernoulli_iterator *
+bernoulli_iter_new(struct rbh_iterator *elements, double rate, bool owned)
+{
+    struct bernoulli_iterator *bernoulli;
+
+    /* Written this way so that NaNs are rejected too */
+    if (!(rate > 0. && rate <= 1.)) {
+        errno = EINVAL;
+        return NULL;
+    }
+
+    bernoulli = malloc(sizeof(*bernoulli));
+    if (bernoulli == NULL)
+        return NULL;
+
+    bernoulli->iterator = BERNOULLI_ITER;
+    bernoulli->elements = elements;
+    bernoulli->rate = rate;
+    bernoulli->owned = owned;
+    rand64_init(&bernoulli->rand);
+    bernoulli->skip = rand64_geometric(&bernoulli->rand, rate);
+
+    return bernoulli;
+}
+
+struct rbh_iterator *
+rbh_iter_bernoulli(struct rbh_iterator *iterator, double rate)
+{
+    struct bernoulli_iterator *bernoulli;
+
+    bernoulli = bernoulli_iter_new(iterator, rate, false);
+    if (bernoulli == NULL)
+        return NULL;
+
+    return &bernoulli->iterator;
+}
+
+/*----------------------------------------------------------------------------*
+ |                          rbh_mut_iter_bernoulli()                          |
+ *----------------------------------------------------------------------------*/
+
+struct rbh_mut_iterator *
+rbh_mut_iter_bernoulli(struct rbh_mut_iterator *iterator, double rate)
+{
+    struct bernoulli_iterator *bernoulli;
+
+    bernoulli = bernoulli_iter_new((struct rbh_iterator *)iterator, rate, true);
+    if (bernoulli == NULL)
+        return NULL;
+
+    return (struct rbh_mut_iterator *)&bernoulli->iterator;
+}
+
+/*----------------------------------------------------------------------------*
+ |                          rbh_mut_iter_reservoir()                          |
+ *----------------------------------------------------------------------------*/
+
+struct reservoir_iterator {
+    struct rbh_mut_iterator iterator;
+
+    struct rbh_mut_iterator *elements;
+    size_t *population;
+    struct rand64 rand;
+
+    /* Algorithm L's state, kept here so that filling can be resumed after a
+     * temporary failure of `elements'
+     */
+    double weight;
+    size_t seen;
+    size_t next;
+
+    bool filled;
+    size_t size;
+    size_t count;
+    size_t index;
+    void *reservoir[];
+};
+
+static void
+reservoir_next_index(struct reservoir_iterator *reservoir)
+{
+    double skip;
+
+    skip = floor(log(rand64_open01(&reservoir->rand))
+               / log1p(-reservoir->weight));
+    reservoir->next = skip < (double)(SIZE_MAX - reservoir->seen) ?
+        reservoir->seen + (size_t)skip : SIZE_MAX;
+}
+
+static void
+reservoir_update_weight(struct reservoir_iterator *reservoir)
+{
+    reservoir->weight *= exp(log(rand64_open01(&reservoir->rand))
+                           / reservoir->size);
+}
+
+static int
+reservoir_fill(struct reservoir_iterator *reservoir)
+{
+    while (true) {
+        void *element;
+
+        element = rbh_mut_iter_next(reservoir->elements);
+        if (element == NULL)
+            break;
+
+        if (reservoir->count < reservoir->size) {
+            reservoir->reservoir[reservoir->count++] = element;
+            reservoir->seen++;
+            if (reservoir->count == reservoir->size) {
+                reservoir_update_weight(reservoir);
+                reservoir_next_index(reservoir);
+            }
+            continue;
+        }
+
+        if (reservoir->seen++ == reservoir->next) {
+            size_t slot = rand64_below(&reservoir->rand, reservoir->size);
+
+            free(reservoir->reservoir[slot]);
+            reservoir->reservoir[slot] = element;
+            reservoir_update_weight(reservoir);
+            reservoir_next_index(reservoir);
+        } else {
+            free(element);
+        }
+    }
+
+    if (errno != ENODATA)
+        return -1;
+
+    if (reservoir->population)
+        *reservoir->population = reservoir->seen;
+    reservoir->filled = true;
+    return 0;
+}
+
+static void *
+reservoir_iter_next(void *iterator)
+{
+    struct reservoir_iterator *reservoir = iterator;
+    int save_errno = errno;
+
+    if (!reservoir->filled && reservoir_fill(reservoir))
+        return NULL;
+
+    if (reservoir->index >= reservoir->count) {
+        errno = ENODATA;
+        return NULL;
+    }
+
+    errno = save_errno;
+    return reservoir->reservoir[reservoir->index++];
+}
+
+static void
+reservoir_iter_destroy(void *iterator)
+{
+    struct reservoir_iterator *reservoir = iterator;
+
+    for (size_t i = reservoir->index; i < reservoir->count; i++)
+        free(reservoir->reservoir[i]);
+    rbh_mut_iter_destroy(reservoir->elements);
+    free(reservoir);
+}
+
+static const struct rbh_mut_iterator_operations RESERVOIR_ITER_OPS = {
+    .next = reservoir_iter_next,
+    .destroy = reservoir_iter_destroy,
+};
+
+static const struct rbh_mut_iterator RESERVOIR_ITER = {
+    .ops = &RESERVOIR_ITER_OPS,
+};
+
+struct rbh_mut_iterator *
+rbh_mut_iter_reservoir(struct rbh_mut_iterator *iterator, size_t size,
+                       size_t *population)
+{
+    struct reservoir_iterator *reservoir;
+
+    if (size == 0) {
+        errno = EINVAL;
+        return NULL;
+    }
+
+    if (size > (SIZE_MAX - sizeof(*reservoir)) / sizeof(void *)) {
+        errno = ENOMEM;
+        return NULL;
+    }
+
+    reservoir = malloc(sizeof(*reservoir) + size * sizeof(void *));
+    if (reservoir == NULL)
+        return NULL;
+
+    reservoir->iterator = RESERVOIR_ITER;
+    reservoir->elements = iterator;
+    reservoir->population = population;
+    rand64_init(&reservoir->rand);
+    reservoir->weight = 1.;
+    reservoir->seen = 0;
+    reservoir->next = SIZE_MAX;
+    reservoir->filled = false;
+    reservoir->size = size;
+    reservoir->count = 0;
+    reservoir->index = 0;
+
+    return &reservoir->iterator;
+}
+
+/*----------------------------------------------------------------------------*
+ |                                 estimators                                 |
+ *----------------------------------------------------------------------------*/
+
+void
+rbh_sample_stats_add(struct rbh_sample_stats *stats, double value)
+{
+    double delta = value - stats->mean;
+
+    /* Welford's online algorithm */
+    stats->count++;
+    stats->mean += delta / stats->count;
+    stats->m2 += delta * (value - stats->mean);
+}
+
+/* Inverse of the standard normal cumulative distribution function
+ *
+ * Peter J. Acklam's rational approximation (relative error < 1.15e-9).
+ */
+static double
+normal_quantile(double p)
+{
+    static const double a[] = {
+        -3.969683028665376e+01,  2.209460984245205e+02,
+        -2.759285104469687e+02,  1.383577518672690e+02,
+        -3.066479806614716e+01,  2.506628277459239e+00,
+    };
+    static const double b[] = {
+        -5.447609879822406e+01,  1.615858368580409e+02,
+        -1.556989798598866e+02,  6.680131188771972e+01,
+        -1.328068155288572e+01,
+    };
+    static const double c[] = {
+        -7.784894002430293e-03, -3.223964580411365e-01,
+        -2.400758277161838e+00, -2.549732539343734e+00,
+         4.374664141464968e+00,  2.938163982698783e+00,
+    };
+    static const double d[] = {
+         7.784695709041462e-03,  3.224671290700398e-01,
+         2.445134137142996e+00,  3.754408661907416e+00,
+    };
+    const double low = 0.02425;
+    double q, r;
+
+    if (p < low) {
+        q = sqrt(-2 * log(p));
+        return (((((c[0] * q + c[1]) * q + c[2]) * q + c[3]) * q + c[4]) * q
+                + c[5])
+             / ((((d[0] * q + d[1]) * q + d[2]) * q + d[3]) * q + 1);
+    }
+
+    if (p > 1 - low) {
+        q = sqrt(-2 * log1p(-p));
+        return -(((((c[0] * q + c[1]) * q + c[2]) * q + c[3]) * q + c[4]) * q
+                 + c[5])
+              / ((((d[0] * q + d[1]) * q + d[2]) * q + d[3]) * q + 1);
+    }
+
+    q = p - 0.5;
+    r = q * q;
+    return (((((a[0] * r + a[1]) * r + a[2]) * r + a[3]) * r + a[4]) * r + a[5])
+         * q
+         / (((((b[0] * r + b[1]) * r + b[2]) * r + b[3]) * r + b[4]) * r + 1);
+}
+
+/* The critical value of a two-sided interval of confidence `confidence' */
+static int
+critical_value(double confidence, double *z)
+{
+    if (!(confidence > 0. && confidence < 1.)) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    *z = normal_quantile((1. + confidence) / 2.);
+    return 0;
+}
+
+static void
+estimate_set(struct rbh_estimate *estimate, double value, double margin)
+{
+    estimate->value = value;
+    estimate->lower = value - margin;
+    estimate->upper = value + margin;
+}
+
+int
+rbh_estimate_mean(const struct rbh_sample_stats *stats, size_t population,
+                  double confidence, struct rbh_estimate *estimate)
+{
+    double variance;
+    double z;
+
+    if (critical_value(confidence, &z))
+        return -1;
+
+    if (stats->count < 2) {
+        errno = ENODATA;
+        return -1;
+    }
+
+    variance = stats->m2 / (stats->count - 1) / stats->count;
+    if (population > 0 && population >= stats->count)
+        variance *= 1. - (double)stats->count / population;
+
+    estimate_set(estimate, stats->mean, z * sqrt(variance));
+    return 0;
+}
+
+int
+rbh_estimate_total(const struct rbh_sample_stats *stats, size_t population,
+                   double confidence, struct rbh_estimate *estimate)
+{
+    if (population == 0) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    if (rbh_estimate_mean(stats, population, confidence, estimate))
+        return -1;
+
+    estimate->value *= population;
+    estimate->lower *= population;
+    estimate->upper *= population;
+    return 0;
+}
+
+int
+rbh_estimate_bernoulli_total(const struct rbh_sample_stats *stats, double rate,
+                             double confidence, struct rbh_estimate *estimate)
+{
+    double sum_of_squares;
+    double z;
+
+    if (!(rate > 0. && rate <= 1.)) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    if (critical_value(confidence, &z))
+        return -1;
+
+    /* Horvitz-Thompson: every element of the sample stands for 1 / rate
+     * elements of the population.
+     */
+    sum_of_squares = stats->m2 + stats->count * stats->mean * stats->mean;
+    estimate_set(estimate, stats->count * stats->mean / rate,
+                 z * sqrt((1. - rate) * sum_of_squares) / rate);
+    return 0;
+}
+
+int
+rbh_estimate_bernoulli_count(size_t count, double rate, double confidence,
+                             struct rbh_estimate *estimate)
+{
+    const struct rbh_sample_stats stats = {
+        .count = count,
+        .mean = 1.,
+        .m2 = 0.,
+    };
+
+    return rbh_estimate_bernoulli_total(&stats, rate, confidence, estimate);
+}
+
+int
+rbh_estimate_proportion(size_t matches, size_t count, double confidence,
+                        struct rbh_estimate *estimate)
+{
+    double center, margin, p, z;
+
+    if (matches > count) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    if (critical_value(confidence, &z))
+        return -1;
+
+    if (count == 0) {
+        errno = ENODATA;
+        return -1;
+    }
+
+    p = (double)matches / count;
+    center = (p + z * z / (2. * count)) / (1. + z * z / count);
+    margin = z / (1. + z * z / count)
+           * sqrt(p * (1. - p) / count + z * z / (4. * count * count));
+
+    estimate->value = p;
+    estimate->lower = center - margin;
+    estimate->upper = center + margin;
+    return 0;
+}
+
+static int
+double_compare(const void *_x, const void *_y)
+{
+    const double *x = _x;
+    const double *y = _y;
+
+    return *x < *y ? -1 : *x > *y;
+}
+
+static size_t
+clamp_rank(double rank, size_t count)
+{
+    if (rank < 0.)
+        return 0;
+    if (rank >= count - 1)
+        return count - 1;
+    return rank;
+}
+
+int
+rbh_estimate_quantile(double *values, size_t count, double quantile,
+                      double confidence, struct rbh_estimate *estimate)
+{
+    double margin, rank, z;
+
+    if (!(quantile >= 0. && quantile <= 1.)) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    if (critical_value(confidence, &z))
+        return -1;
+
+    if (count == 0) {
+        errno = ENODATA;
+        return -1;
+    }
+
+    qsort(values, count, sizeof(*values), double_compare);
+
+    /* The number of sampled values below the actual quantile follows a
+     * binomial distribution B(count, quantile).
+     */
+    rank = quantile * count;
+    margin = z * sqrt(count * quantile * (1. - quantile));
+
+    estimate->value = values[clamp_rank(ceil(rank) - 1., count)];
+    estimate->lower = values[clamp_rank(floor(rank - margin) - 1., count)];
+    estimate->upper = values[clamp_rank(ceil(rank + margin), count)];
+    return 0;
+}
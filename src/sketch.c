@@ -0,0 +1,1605 @@
+/* This file is part of the RobinHood Library
+ * Copyright (C) 2022 Commissariat a l'energie atomique et aux energies
+ *                    alternatives
+ *
+ * SPDX-License-Identifer: LGPL-3.0-or-later
+ */
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <errno.h>
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <endian.h>
+
+#include "robinhood/sketch.h"
+
+#include "hash.h"
+#include "random.h"
+#include "value.h"
+
+/*----------------------------------------------------------------------------*
+ |                                    keys                                    |
+ *----------------------------------------------------------------------------*/
+
+/* Values are hashed (and stored, for heavy hitters) as their type followed by
+ * their bytes. The type is used as the seed of the hash.
+ */
+
+static int
+value_hash(const struct rbh_value *value, uint64_t *hash)
+{
+    const void *data;
+    size_t size;
+
+    if (value_scalar_bytes(value, &data, &size))
+        return -1;
+
+    *hash = hash64(data, size, value->type);
+    return 0;
+}
+
+static int
+value_to_double(const struct rbh_value *value, double *number)
+{
+    switch (value->type) {
+    case RBH_VT_INT32:
+        *number = value->int32;
+        return 0;
+    case RBH_VT_UINT32:
+        *number = value->uint32;
+        return 0;
+    case RBH_VT_INT64:
+        *number = value->int64;
+        return 0;
+    case RBH_VT_UINT64:
+        *number = value->uint64;
+        return 0;
+    default:
+        errno = ENOTSUP;
+        return -1;
+    }
+}
+
+/*----------------------------------------------------------------------------*
+ |                               serialization                                |
+ *----------------------------------------------------------------------------*/
+
+/* Everything is serialized in little endian */
+
+struct writer {
+    unsigned char *data;
+    size_t size;
+    size_t offset;
+};
+
+static void
+write_bytes(struct writer *writer, const void *data, size_t size)
+{
+    if (writer->offset <= writer->size
+     && size <= writer->size - writer->offset)
+        memcpy(writer->data + writer->offset, data, size);
+    writer->offset += size;
+}
+
+static void
+write_uint(struct writer *writer, uint64_t integer, size_t size)
+{
+    unsigned char bytes[sizeof(integer)];
+
+    for (size_t i = 0; i < size; i++)
+        bytes[i] = integer >> (8 * i);
+    write_bytes(writer, bytes, size);
+}
+
+static void
+write_u8(struct writer *writer, uint8_t integer)
+{
+    write_uint(writer, integer, sizeof(integer));
+}
+
+static void
+write_u32(struct writer *writer, uint32_t integer)
+{
+    write_uint(writer, integer, sizeof(integer));
+}
+
+static void
+write_u64(struct writer *writer, uint64_t integer)
+{
+    write_uint(writer, integer, sizeof(integer));
+}
+
+static void
+write_double(struct writer *writer, double number)
+{
+    uint64_t integer;
+
+    memcpy(&integer, &number, sizeof(integer));
+    write_u64(writer, integer);
+}
+
+struct reader {
+    const unsigned char *data;
+    size_t size;
+    size_t offset;
+};
+
+static const void *
+read_bytes(struct reader *reader, size_t size)
+{
+    const void *bytes;
+
+    if (size > reader->size - reader->offset)
+        return NULL;
+
+    bytes = reader->data + reader->offset;
+    reader->offset += size;
+    return bytes;
+}
+
+static bool
+read_uint(struct reader *reader, uint64_t *integer, size_t size)
+{
+    const unsigned char *bytes = read_bytes(reader, size);
+
+    if (bytes == NULL)
+        return false;
+
+    *integer = 0;
+    for (size_t i = 0; i < size; i++)
+        *integer |= (uint64_t)bytes[i] << (8 * i);
+    return true;
+}
+
+static bool
+read_u8(struct reader *reader, uint8_t *integer)
+{
+    uint64_t tmp;
+
+    if (!read_uint(reader, &tmp, sizeof(*integer)))
+        return false;
+    *integer = tmp;
+    return true;
+}
+
+static bool
+read_u32(struct reader *reader, uint32_t *integer)
+{
+    uint64_t tmp;
+
+    if (!read_uint(reader, &tmp, sizeof(*integer)))
+        return false;
+    *integer = tmp;
+    return true;
+}
+
+static bool
+read_u64(struct reader *reader, uint64_t *integer)
+{
+    return read_uint(reader, integer, sizeof(*integer));
+}
+
+static bool
+read_double(struct reader *reader, double *number)
+{
+    uint64_t integer;
+
+    if (!read_u64(reader, &integer))
+        return false;
+    memcpy(number, &integer, sizeof(*number));
+    return true;
+}
+
+/*----------------------------------------------------------------------------*
+ |                                hyperloglog                                 |
+ *----------------------------------------------------------------------------*/
+
+#define HLL_MIN_PRECISION 4
+#define HLL_MAX_PRECISION 18
+#define HLL_DEFAULT_PRECISION 14
+
+struct hyperloglog {
+    unsigned int precision;
+    uint8_t *registers;
+};
+
+static int
+hll_init(struct hyperloglog *hll, unsigned int precision)
+{
+    if (precision == 0)
+        precision = HLL_DEFAULT_PRECISION;
+
+    if (precision < HLL_MIN_PRECISION || precision > HLL_MAX_PRECISION) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    hll->precision = precision;
+    hll->registers = calloc(1 << precision, sizeof(*hll->registers));
+    return hll->registers == NULL ? -1 : 0;
+}
+
+static void
+hll_fini(struct hyperloglog *hll)
+{
+    free(hll->registers);
+}
+
+static void
+hll_add(struct hyperloglog *hll, uint64_t hash)
+{
+    uint64_t index = hash >> (64 - hll->precision);
+    /* The sentinel bit bounds the rank */
+    uint64_t rest = (hash << hll->precision)
+                  | (UINT64_C(1) << (hll->precision - 1));
+    uint8_t rank = __builtin_clzll(rest) + 1;
+
+    if (rank > hll->registers[index])
+        hll->registers[index] = rank;
+}
+
+static double
+hll_estimate(const struct hyperloglog *hll)
+{
+    const size_t m = 1 << hll->precision;
+    size_t zeros = 0;
+    double estimate;
+    double alpha;
+    double sum = 0.;
+
+    switch (m) {
+    case 16:
+        alpha = 0.673;
+        break;
+    case 32:
+        alpha = 0.697;
+        break;
+    case 64:
+        alpha = 0.709;
+        break;
+    default:
+        alpha = 0.7213 / (1. + 1.079 / m);
+    }
+
+    for (size_t i = 0; i < m; i++) {
+        sum += ldexp(1., -hll->registers[i]);
+        if (hll->registers[i] == 0)
+            zeros++;
+    }
+
+    estimate = alpha * m * m / sum;
+    if (estimate <= 2.5 * m && zeros > 0)
+        /* Linear counting, which behaves better for small cardinalities */
+        estimate = m * log((double)m / zeros);
+
+    return estimate;
+}
+
+static int
+hll_merge(struct hyperloglog *dest, const struct hyperloglog *src)
+{
+    if (dest->precision != src->precision) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    for (size_t i = 0; i < (size_t)1 << dest->precision; i++) {
+        if (src->registers[i] > dest->registers[i])
+            dest->registers[i] = src->registers[i];
+    }
+    return 0;
+}
+
+static void
+hll_serialize(const struct hyperloglog *hll, struct writer *writer)
+{
+    write_u8(writer, hll->precision);
+    write_bytes(writer, hll->registers, (size_t)1 << hll->precision);
+}
+
+static int
+hll_deserialize(struct hyperloglog *hll, struct reader *reader)
+{
+    const void *registers;
+    uint8_t precision;
+
+    if (!read_u8(reader, &precision) || precision < HLL_MIN_PRECISION
+     || precision > HLL_MAX_PRECISION) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    registers = read_bytes(reader, (size_t)1 << precision);
+    if (registers == NULL) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    if (hll_init(hll, precision))
+        return -1;
+
+    memcpy(hll->registers, registers, (size_t)1 << precision);
+    return 0;
+}
+
+/*----------------------------------------------------------------------------*
+ |                                    kll                                     |
+ *----------------------------------------------------------------------------*/
+
+/* Karnin, Lang and Liberty's quantile sketch
+ *
+ * Values are stored in a hierarchy of "compactors". A value at level `h' stands
+ * for 2^h values of the stream. When a compactor is full, it is sorted and
+ * every other value in it is promoted to the next level (starting at a random
+ * offset), the others are discarded. Lower levels have exponentially smaller
+ * capacities than higher ones.
+ */
+
+#define KLL_MIN_K 8
+#define KLL_MAX_K UINT16_MAX
+#define KLL_DEFAULT_K 200
+#define KLL_MAX_LEVELS 64
+
+struct kll_level {
+    double *values;
+    size_t count;
+    size_t size;
+};
+
+struct kll {
+    unsigned int k;
+    size_t level_count;
+    struct kll_level levels[KLL_MAX_LEVELS];
+    /* The capacity of each level, and their sum, for the current level_count */
+    size_t capacities[KLL_MAX_LEVELS];
+    size_t capacity;
+    double min;
+    double max;
+    struct rand64 rand;
+};
+
+static void
+kll_set_level_count(struct kll *kll, size_t level_count)
+{
+    kll->level_count = level_count;
+    kll->capacity = 0;
+    for (size_t h = 0; h < level_count; h++) {
+        double capacity = ceil(kll->k * pow(2. / 3., level_count - 1 - h));
+
+        kll->capacities[h] = capacity < 2. ? 2 : capacity;
+        kll->capacity += kll->capacities[h];
+    }
+}
+
+static int
+kll_init(struct kll *kll, unsigned int k)
+{
+    if (k == 0)
+        k = KLL_DEFAULT_K;
+
+    if (k < KLL_MIN_K || k > KLL_MAX_K) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    kll->k = k;
+    kll_set_level_count(kll, 1);
+    memset(kll->levels, 0, sizeof(kll->levels));
+    kll->min = INFINITY;
+    kll->max = -INFINITY;
+    rand64_init(&kll->rand);
+    return 0;
+}
+
+static void
+kll_fini(struct kll *kll)
+{
+    for (size_t i = 0; i < KLL_MAX_LEVELS; i++)
+        free(kll->levels[i].values);
+}
+
+static int
+kll_level_push(struct kll_level *level, const double *values, size_t count)
+{
+    if (count == 0)
+        return 0;
+
+    if (level->count + count > level->size) {
+        size_t size = level->size ? level->size : 8;
+        double *tmp;
+
+        while (size < level->count + count)
+            size *= 2;
+
+        tmp = reallocarray(level->values, size, sizeof(*tmp));
+        if (tmp == NULL)
+            return -1;
+
+        level->values = tmp;
+        level->size = size;
+    }
+
+    memcpy(&level->values[level->count], values, count * sizeof(*values));
+    level->count += count;
+    return 0;
+}
+
+static int
+double_compare(const void *_x, const void *_y)
+{
+    const double *x = _x;
+    const double *y = _y;
+
+    return *x < *y ? -1 : *x > *y;
+}
+
+static int
+kll_compact(struct kll *kll, size_t h)
+{
+    struct kll_level *level = &kll->levels[h];
+    size_t start = level->count % 2;
+    size_t offset;
+
+    if (h + 1 == kll->level_count) {
+        if (kll->level_count == KLL_MAX_LEVELS) {
+            errno = EOVERFLOW;
+            return -1;
+        }
+        kll_set_level_count(kll, kll->level_count + 1);
+    }
+
+    qsort(level->values, level->count, sizeof(*level->values), double_compare);
+
+    /* An odd value out stays at this level */
+    offset = rand64_next(&kll->rand) & 1;
+    for (size_t i = start + offset; i < level->count; i += 2) {
+        if (kll_level_push(&kll->levels[h + 1], &level->values[i], 1))
+            return -1;
+    }
+    level->count = start;
+    return 0;
+}
+
+/* Compact levels until the sketch fits in its capacity */
+static int
+kll_shrink(struct kll *kll)
+{
+    while (true) {
+        size_t count = 0;
+        size_t h;
+
+        for (h = 0; h < kll->level_count; h++)
+            count += kll->levels[h].count;
+
+        if (count < kll->capacity)
+            return 0;
+
+        for (h = 0; h < kll->level_count; h++) {
+            if (kll->levels[h].count >= kll->capacities[h])
+                break;
+        }
+        /* When the total exceeds the capacity, at least one level does too */
+        if (h == kll->level_count)
+            h = kll->level_count - 1;
+
+        if (kll_compact(kll, h))
+            return -1;
+    }
+}
+
+static int
+kll_add(struct kll *kll, double value)
+{
+    if (kll_level_push(&kll->levels[0], &value, 1))
+        return -1;
+
+    if (value < kll->min)
+        kll->min = value;
+    if (value > kll->max)
+        kll->max = value;
+
+    return kll_shrink(kll);
+}
+
+static int
+kll_merge(struct kll *dest, const struct kll *src)
+{
+    if (dest->k != src->k) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    if (src->level_count > dest->level_count)
+        kll_set_level_count(dest, src->level_count);
+
+    for (size_t h = 0; h < src->level_count; h++) {
+        if (kll_level_push(&dest->levels[h], src->levels[h].values,
+                           src->levels[h].count))
+            return -1;
+    }
+
+    if (src->min < dest->min)
+        dest->min = src->min;
+    if (src->max > dest->max)
+        dest->max = src->max;
+
+    return kll_shrink(dest);
+}
+
+struct weighted_value {
+    double value;
+    uint64_t weight;
+};
+
+static int
+weighted_value_compare(const void *_x, const void *_y)
+{
+    const struct weighted_value *x = _x;
+    const struct weighted_value *y = _y;
+
+    return x->value < y->value ? -1 : x->value > y->value;
+}
+
+static int
+kll_quantile(const struct kll *kll, double quantile, double *value)
+{
+    struct weighted_value *values;
+    uint64_t total = 0;
+    uint64_t cumulated;
+    size_t count = 0;
+    double target;
+    size_t i;
+
+    if (quantile == 0.) {
+        *value = kll->min;
+        return 0;
+    }
+    if (quantile == 1.) {
+        *value = kll->max;
+        return 0;
+    }
+
+    for (size_t h = 0; h < kll->level_count; h++)
+        count += kll->levels[h].count;
+
+    if (count == 0) {
+        errno = ENODATA;
+        return -1;
+    }
+
+    values = reallocarray(NULL, count, sizeof(*values));
+    if (values == NULL)
+        return -1;
+
+    count = 0;
+    for (size_t h = 0; h < kll->level_count; h++) {
+        for (i = 0; i < kll->levels[h].count; i++) {
+            values[count].value = kll->levels[h].values[i];
+            values[count++].weight = UINT64_C(1) << h;
+        }
+        total += kll->levels[h].count << h;
+    }
+
+    qsort(values, count, sizeof(*values), weighted_value_compare);
+
+    target = quantile * total;
+    cumulated = 0;
+    for (i = 0; i < count - 1; i++) {
+        cumulated += values[i].weight;
+        if (cumulated >= target)
+            break;
+    }
+
+    *value = values[i].value;
+    free(values);
+    return 0;
+}
+
+static int
+kll_rank(const struct kll *kll, double value, double *rank)
+{
+    uint64_t total = 0;
+    uint64_t below = 0;
+
+    for (size_t h = 0; h < kll->level_count; h++) {
+        for (size_t i = 0; i < kll->levels[h].count; i++) {
+            if (kll->levels[h].values[i] <= value)
+                below += UINT64_C(1) << h;
+        }
+        total += kll->levels[h].count << h;
+    }
+
+    if (total == 0) {
+        errno = ENODATA;
+        return -1;
+    }
+
+    *rank = (double)below / total;
+    return 0;
+}
+
+static void
+kll_serialize(const struct kll *kll, struct writer *writer)
+{
+    write_u32(writer, kll->k);
+    write_double(writer, kll->min);
+    write_double(writer, kll->max);
+    write_u32(writer, kll->level_count);
+    for (size_t h = 0; h < kll->level_count; h++) {
+        write_u64(writer, kll->levels[h].count);
+        for (size_t i = 0; i < kll->levels[h].count; i++)
+            write_double(writer, kll->levels[h].values[i]);
+    }
+}
+
+static int
+kll_deserialize(struct kll *kll, struct reader *reader)
+{
+    uint32_t level_count;
+    uint32_t k;
+
+    if (!read_u32(reader, &k) || k < KLL_MIN_K || k > KLL_MAX_K) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    if (kll_init(kll, k))
+        return -1;
+
+    if (!read_double(reader, &kll->min) || !read_double(reader, &kll->max)
+     || !read_u32(reader, &level_count) || level_count == 0
+     || level_count > KLL_MAX_LEVELS)
+        goto out_einval;
+
+    kll_set_level_count(kll, level_count);
+    for (size_t h = 0; h < level_count; h++) {
+        uint64_t count;
+
+        if (!read_u64(reader, &count)
+         || count > (reader->size - reader->offset) / sizeof(double))
+            goto out_einval;
+
+        for (uint64_t i = 0; i < count; i++) {
+            double value;
+
+            if (!read_double(reader, &value))
+                goto out_einval;
+
+            if (kll_level_push(&kll->levels[h], &value, 1)) {
+                kll_fini(kll);
+                return -1;
+            }
+        }
+    }
+
+    return 0;
+
+out_einval:
+    kll_fini(kll);
+    errno = EINVAL;
+    return -1;
+}
+
+/*----------------------------------------------------------------------------*
+ |                                 count-min                                  |
+ *----------------------------------------------------------------------------*/
+
+struct heavy_hitter {
+    /* The value's type, followed by its bytes, followed by a null byte */
+    char *key;
+    size_t size;
+    uint64_t frequency;
+};
+
+struct count_min {
+    size_t width;
+    size_t depth;
+    uint64_t *counters;
+
+    size_t capacity;
+    size_t count;
+    struct heavy_hitter *heavy_hitters;
+};
+
+static int
+count_min_init(struct count_min *cms, size_t width, size_t depth,
+               size_t capacity)
+{
+    if (width == 0 || depth == 0 || width > SIZE_MAX / depth) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    cms->width = width;
+    cms->depth = depth;
+    cms->counters = calloc(width * depth, sizeof(*cms->counters));
+    if (cms->counters == NULL)
+        return -1;
+
+    cms->capacity = capacity;
+    cms->count = 0;
+    cms->heavy_hitters = NULL;
+    if (capacity == 0)
+        return 0;
+
+    cms->heavy_hitters = calloc(capacity, sizeof(*cms->heavy_hitters));
+    if (cms->heavy_hitters == NULL) {
+        int save_errno = errno;
+
+        free(cms->counters);
+        errno = save_errno;
+        return -1;
+    }
+
+    return 0;
+}
+
+static void
+count_min_fini(struct count_min *cms)
+{
+    for (size_t i = 0; i < cms->count; i++)
+        free(cms->heavy_hitters[i].key);
+    free(cms->heavy_hitters);
+    free(cms->counters);
+}
+
+/* Kirsch and Mitzenmacher: two hashes are enough to simulate `depth' ones */
+static size_t
+count_min_index(const struct count_min *cms, uint64_t hash, size_t row)
+{
+    uint64_t step = hash64_mix(hash) | 1;
+
+    return row * cms->width + (hash + row * step) % cms->width;
+}
+
+static uint64_t
+count_min_estimate(const struct count_min *cms, uint64_t hash)
+{
+    uint64_t estimate = UINT64_MAX;
+
+    for (size_t row = 0; row < cms->depth; row++) {
+        uint64_t counter = cms->counters[count_min_index(cms, hash, row)];
+
+        if (counter < estimate)
+            estimate = counter;
+    }
+    return estimate;
+}
+
+static struct heavy_hitter *
+heavy_hitter_find(struct count_min *cms, const char *key, size_t size)
+{
+    for (size_t i = 0; i < cms->count; i++) {
+        struct heavy_hitter *heavy_hitter = &cms->heavy_hitters[i];
+
+        if (heavy_hitter->size == size
+         && memcmp(heavy_hitter->key, key, size) == 0)
+            return heavy_hitter;
+    }
+    return NULL;
+}
+
+/* Record that the value `key' was seen about `frequency' times */
+static int
+heavy_hitter_update(struct count_min *cms, const char *key, size_t size,
+                    uint64_t frequency)
+{
+    struct heavy_hitter *heavy_hitter;
+    char *copy;
+
+    if (cms->capacity == 0)
+        return 0;
+
+    heavy_hitter = heavy_hitter_find(cms, key, size);
+    if (heavy_hitter != NULL) {
+        heavy_hitter->frequency = frequency;
+        return 0;
+    }
+
+    if (cms->count < cms->capacity) {
+        heavy_hitter = &cms->heavy_hitters[cms->count];
+    } else {
+        heavy_hitter = &cms->heavy_hitters[0];
+        for (size_t i = 1; i < cms->count; i++) {
+            if (cms->heavy_hitters[i].frequency < heavy_hitter->frequency)
+                heavy_hitter = &cms->heavy_hitters[i];
+        }
+
+        if (frequency <= heavy_hitter->frequency)
+            return 0;
+    }
+
+    copy = malloc(size + 1);
+    if (copy == NULL)
+        return -1;
+    memcpy(copy, key, size);
+    copy[size] = '\0';
+
+    if (cms->count < cms->capacity)
+        cms->count++;
+    else
+        free(heavy_hitter->key);
+
+    heavy_hitter->key = copy;
+    heavy_hitter->size = size;
+    heavy_hitter->frequency = frequency;
+    return 0;
+}
+
+static int
+count_min_add(struct count_min *cms, const struct rbh_value *value)
+{
+    const void *data;
+    uint64_t hash;
+    size_t size;
+    char *key;
+    int rc;
+
+    if (value_scalar_bytes(value, &data, &size))
+        return -1;
+
+    hash = hash64(data, size, value->type);
+    for (size_t row = 0; row < cms->depth; row++)
+        cms->counters[count_min_index(cms, hash, row)]++;
+
+    if (cms->capacity == 0)
+        return 0;
+
+    key = malloc(size + 1);
+    if (key == NULL)
+        return -1;
+    key[0] = value->type;
+    memcpy(key + 1, data, size);
+
+    rc = heavy_hitter_update(cms, key, size + 1, count_min_estimate(cms, hash));
+    free(key);
+    return rc;
+}
+
+static uint64_t
+key_hash(const char *key, size_t size)
+{
+    return hash64(key + 1, size - 1, (unsigned char)key[0]);
+}
+
+static int
+count_min_merge(struct count_min *dest, const struct count_min *src)
+{
+    if (dest->width != src->width || dest->depth != src->depth
+     || dest->capacity != src->capacity) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    for (size_t i = 0; i < dest->width * dest->depth; i++)
+        dest->counters[i] += src->counters[i];
+
+    /* Refresh the estimates of existing heavy hitters, then consider the ones
+     * of `src'
+     */
+    for (size_t i = 0; i < dest->count; i++) {
+        struct heavy_hitter *heavy_hitter = &dest->heavy_hitters[i];
+
+        heavy_hitter->frequency =
+            count_min_estimate(dest, key_hash(heavy_hitter->key,
+                                              heavy_hitter->size));
+    }
+
+    for (size_t i = 0; i < src->count; i++) {
+        const struct heavy_hitter *heavy_hitter = &src->heavy_hitters[i];
+        uint64_t hash = key_hash(heavy_hitter->key, heavy_hitter->size);
+
+        if (heavy_hitter_update(dest, heavy_hitter->key, heavy_hitter->size,
+                                count_min_estimate(dest, hash)))
+            return -1;
+    }
+
+    return 0;
+}
+
+static void
+key_to_value(const char *key, size_t size, struct rbh_value *value)
+{
+    const char *data = key + 1;
+
+    value->type = (unsigned char)key[0];
+    size--;
+
+    switch (value->type) {
+    case RBH_VT_BOOLEAN:
+        memcpy(&value->boolean, data, sizeof(value->boolean));
+        break;
+    case RBH_VT_INT32:
+        memcpy(&value->int32, data, sizeof(value->int32));
+        break;
+    case RBH_VT_UINT32:
+        memcpy(&value->uint32, data, sizeof(value->uint32));
+        break;
+    case RBH_VT_INT64:
+        memcpy(&value->int64, data, sizeof(value->int64));
+        break;
+    case RBH_VT_UINT64:
+        memcpy(&value->uint64, data, sizeof(value->uint64));
+        break;
+    case RBH_VT_STRING:
+        /* Keys are null terminated */
+        value->string = data;
+        break;
+    case RBH_VT_BINARY:
+        value->binary.data = data;
+        value->binary.size = size;
+        break;
+    case RBH_VT_REGEX:
+        value->regex.string = data;
+        value->regex.options = 0;
+        break;
+    default:
+        __builtin_unreachable();
+    }
+}
+
+static int
+heavy_hitter_compare(const void *_x, const void *_y)
+{
+    const struct rbh_sketch_item *x = _x;
+    const struct rbh_sketch_item *y = _y;
+
+    return x->frequency > y->frequency ? -1 : x->frequency < y->frequency;
+}
+
+/* Keys hold integers in native byte order */
+static void
+write_key(struct writer *writer, const char *key, size_t size)
+{
+    uint32_t u32;
+    uint64_t u64;
+
+    write_u8(writer, key[0]);
+    switch ((unsigned char)key[0]) {
+    case RBH_VT_INT32:
+    case RBH_VT_UINT32:
+        memcpy(&u32, key + 1, sizeof(u32));
+        write_u32(writer, u32);
+        break;
+    case RBH_VT_INT64:
+    case RBH_VT_UINT64:
+        memcpy(&u64, key + 1, sizeof(u64));
+        write_u64(writer, u64);
+        break;
+    default:
+        write_bytes(writer, key + 1, size - 1);
+    }
+}
+
+static void
+count_min_serialize(const struct count_min *cms, struct writer *writer)
+{
+    write_u64(writer, cms->width);
+    write_u64(writer, cms->depth);
+    for (size_t i = 0; i < cms->width * cms->depth; i++)
+        write_u64(writer, cms->counters[i]);
+
+    write_u64(writer, cms->capacity);
+    write_u64(writer, cms->count);
+    for (size_t i = 0; i < cms->count; i++) {
+        write_u64(writer, cms->heavy_hitters[i].frequency);
+        write_u64(writer, cms->heavy_hitters[i].size);
+        write_key(writer, cms->heavy_hitters[i].key,
+                  cms->heavy_hitters[i].size);
+    }
+}
+
+/* Check that a key read from a serialized sketch is one we could have built */
+static bool
+key_is_valid(const char *key, size_t size)
+{
+    if (size == 0)
+        return false;
+
+    switch ((unsigned char)key[0]) {
+    case RBH_VT_BOOLEAN:
+        return size == 1 + sizeof(bool);
+    case RBH_VT_INT32:
+    case RBH_VT_UINT32:
+        return size == 1 + sizeof(uint32_t);
+    case RBH_VT_INT64:
+    case RBH_VT_UINT64:
+        return size == 1 + sizeof(uint64_t);
+    case RBH_VT_STRING:
+    case RBH_VT_REGEX:
+        return memchr(key + 1, '\0', size - 1) == NULL;
+    case RBH_VT_BINARY:
+        return true;
+    }
+    return false;
+}
+
+/* Convert a valid key read from a serialized sketch to native byte order, in
+ * \p buffer if need be
+ */
+static const char *
+key_to_native(const char *key, char buffer[1 + sizeof(uint64_t)])
+{
+    uint32_t u32;
+    uint64_t u64;
+
+    switch ((unsigned char)key[0]) {
+    case RBH_VT_INT32:
+    case RBH_VT_UINT32:
+        memcpy(&u32, key + 1, sizeof(u32));
+        u32 = le32toh(u32);
+        memcpy(buffer + 1, &u32, sizeof(u32));
+        break;
+    case RBH_VT_INT64:
+    case RBH_VT_UINT64:
+        memcpy(&u64, key + 1, sizeof(u64));
+        u64 = le64toh(u64);
+        memcpy(buffer + 1, &u64, sizeof(u64));
+        break;
+    default:
+        return key;
+    }
+
+    buffer[0] = key[0];
+    return buffer;
+}
+
+static int
+count_min_deserialize(struct count_min *cms, struct reader *reader)
+{
+    uint64_t width, depth, capacity, count;
+    size_t counters;
+
+    if (!read_u64(reader, &width) || !read_u64(reader, &depth)
+     || width == 0 || depth == 0 || width > SIZE_MAX / depth
+     || width * depth > (reader->size - reader->offset) / sizeof(uint64_t)) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    /* Read the number of heavy hitters before allocating anything */
+    counters = reader->offset;
+    reader->offset += width * depth * sizeof(uint64_t);
+    if (!read_u64(reader, &capacity) || !read_u64(reader, &count)
+     || count > capacity) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    if (count_min_init(cms, width, depth, capacity))
+        return -1;
+
+    for (size_t i = 0; i < width * depth; i++) {
+        memcpy(&cms->counters[i], &reader->data[counters], sizeof(uint64_t));
+        cms->counters[i] = le64toh(cms->counters[i]);
+        counters += sizeof(uint64_t);
+    }
+
+    for (size_t i = 0; i < count; i++) {
+        char buffer[1 + sizeof(uint64_t)];
+        uint64_t frequency, size;
+        const char *key;
+
+        if (!read_u64(reader, &frequency) || !read_u64(reader, &size))
+            goto out_einval;
+
+        key = read_bytes(reader, size);
+        if (key == NULL || !key_is_valid(key, size))
+            goto out_einval;
+
+        key = key_to_native(key, buffer);
+        if (heavy_hitter_find(cms, key, size) != NULL)
+            goto out_einval;
+
+        if (heavy_hitter_update(cms, key, size, frequency)) {
+            count_min_fini(cms);
+            return -1;
+        }
+    }
+
+    return 0;
+
+out_einval:
+    count_min_fini(cms);
+    errno = EINVAL;
+    return -1;
+}
+
+/*----------------------------------------------------------------------------*
+ |                                 rbh_sketch                                 |
+ *----------------------------------------------------------------------------*/
+
+struct rbh_sketch {
+    enum rbh_sketch_type type;
+    struct rbh_filter_field field;
+    uint64_t count;
+
+    union {
+        struct hyperloglog hll;
+        struct kll kll;
+        struct count_min cms;
+    };
+};
+
+static bool
+field_has_xattr(const struct rbh_filter_field *field)
+{
+    return field->fsentry & (RBH_FP_NAMESPACE_XATTRS | RBH_FP_INODE_XATTRS)
+        && field->xattr != NULL;
+}
+
+/* Allocate a sketch, and copy `field' in it */
+static struct rbh_sketch *
+sketch_alloc(enum rbh_sketch_type type, const struct rbh_filter_field *field)
+{
+    const struct rbh_filter_field ID = {
+        .fsentry = RBH_FP_ID,
+    };
+    struct rbh_sketch *sketch;
+    size_t xattr_size = 0;
+
+    if (field == NULL)
+        field = &ID;
+
+    if (field_has_xattr(field))
+        xattr_size = strlen(field->xattr) + 1;
+
+    sketch = malloc(sizeof(*sketch) + xattr_size);
+    if (sketch == NULL)
+        return NULL;
+
+    sketch->type = type;
+    sketch->count = 0;
+    sketch->field = *field;
+    if (xattr_size)
+        sketch->field.xattr = memcpy(sketch + 1, field->xattr, xattr_size);
+
+    return sketch;
+}
+
+static int
+count_min_dimensions(double epsilon, double delta, size_t *width,
+                     size_t *depth)
+{
+    /* Written this way so that NaNs are rejected too */
+    if (!(epsilon > 0. && epsilon < 1.) || !(delta > 0. && delta < 1.)) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    *width = ceil(M_E / epsilon);
+    *depth = ceil(log(1. / delta));
+    return 0;
+}
+
+struct rbh_sketch *
+rbh_sketch_new(const struct rbh_filter_field *field,
+               const struct rbh_sketch_options *options)
+{
+    struct rbh_sketch *sketch;
+    size_t width = 0, depth = 0;
+    int save_errno;
+    int rc;
+
+    switch (options->type) {
+    case RBH_SKT_HYPERLOGLOG:
+    case RBH_SKT_KLL:
+        break;
+    case RBH_SKT_COUNT_MIN:
+        if (count_min_dimensions(options->count_min.epsilon,
+                                 options->count_min.delta, &width, &depth))
+            return NULL;
+        break;
+    default:
+        errno = EINVAL;
+        return NULL;
+    }
+
+    sketch = sketch_alloc(options->type, field);
+    if (sketch == NULL)
+        return NULL;
+
+    switch (options->type) {
+    case RBH_SKT_HYPERLOGLOG:
+        rc = hll_init(&sketch->hll, options->hyperloglog.precision);
+        break;
+    case RBH_SKT_KLL:
+        rc = kll_init(&sketch->kll, options->kll.k);
+        break;
+    case RBH_SKT_COUNT_MIN:
+        rc = count_min_init(&sketch->cms, width, depth,
+                            options->count_min.heavy_hitters);
+        break;
+    default:
+        __builtin_unreachable();
+    }
+
+    if (rc) {
+        save_errno = errno;
+        free(sketch);
+        errno = save_errno;
+        return NULL;
+    }
+
+    return sketch;
+}
+
+int
+rbh_sketch_add_value(struct rbh_sketch *sketch, const struct rbh_value *value)
+{
+    double number;
+    uint64_t hash;
+
+    switch (sketch->type) {
+    case RBH_SKT_HYPERLOGLOG:
+        if (value_hash(value, &hash))
+            return -1;
+        hll_add(&sketch->hll, hash);
+        break;
+    case RBH_SKT_KLL:
+        if (value_to_double(value, &number) || kll_add(&sketch->kll, number))
+            return -1;
+        break;
+    case RBH_SKT_COUNT_MIN:
+        if (count_min_add(&sketch->cms, value))
+            return -1;
+        break;
+    }
+
+    sketch->count++;
+    return 0;
+}
+
+int
+rbh_sketch_add(struct rbh_sketch *sketch, const struct rbh_fsentry *fsentry)
+{
+    struct rbh_value value;
+
+    if (rbh_fsentry_get_field(fsentry, &sketch->field, &value))
+        return errno == ENODATA ? 0 : -1;
+
+    return rbh_sketch_add_value(sketch, &value);
+}
+
+int
+rbh_sketch_feed(struct rbh_sketch *sketch, struct rbh_iterator *fsentries)
+{
+    const struct rbh_fsentry *fsentry;
+    int save_errno = errno;
+
+    while ((fsentry = rbh_iter_next(fsentries)) != NULL) {
+        if (rbh_sketch_add(sketch, fsentry))
+            return -1;
+    }
+
+    if (errno != ENODATA)
+        return -1;
+
+    errno = save_errno;
+    return 0;
+}
+
+int
+rbh_sketch_merge(struct rbh_sketch *dest, const struct rbh_sketch *src)
+{
+    int rc;
+
+    if (dest->type != src->type) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    switch (dest->type) {
+    case RBH_SKT_HYPERLOGLOG:
+        rc = hll_merge(&dest->hll, &src->hll);
+        break;
+    case RBH_SKT_KLL:
+        rc = kll_merge(&dest->kll, &src->kll);
+        break;
+    case RBH_SKT_COUNT_MIN:
+        rc = count_min_merge(&dest->cms, &src->cms);
+        break;
+    default:
+        __builtin_unreachable();
+    }
+
+    if (rc)
+        return -1;
+
+    dest->count += src->count;
+    return 0;
+}
+
+uint64_t
+rbh_sketch_count(const struct rbh_sketch *sketch)
+{
+    return sketch->count;
+}
+
+int
+rbh_sketch_cardinality(const struct rbh_sketch *sketch, double *cardinality)
+{
+    if (sketch->type != RBH_SKT_HYPERLOGLOG) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    *cardinality = hll_estimate(&sketch->hll);
+    return 0;
+}
+
+int
+rbh_sketch_quantile(const struct rbh_sketch *sketch, double quantile,
+                    double *value)
+{
+    /* Written this way so that NaNs are rejected too */
+    if (sketch->type != RBH_SKT_KLL || !(quantile >= 0. && quantile <= 1.)) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    if (sketch->count == 0) {
+        errno = ENODATA;
+        return -1;
+    }
+
+    return kll_quantile(&sketch->kll, quantile, value);
+}
+
+int
+rbh_sketch_rank(const struct rbh_sketch *sketch, double value, double *rank)
+{
+    if (sketch->type != RBH_SKT_KLL) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    if (sketch->count == 0) {
+        errno = ENODATA;
+        return -1;
+    }
+
+    return kll_rank(&sketch->kll, value, rank);
+}
+
+int
+rbh_sketch_frequency(const struct rbh_sketch *sketch,
+                     const struct rbh_value *value, uint64_t *frequency)
+{
+    uint64_t hash;
+
+    if (sketch->type != RBH_SKT_COUNT_MIN) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    if (value_hash(value, &hash))
+        return -1;
+
+    *frequency = count_min_estimate(&sketch->cms, hash);
+    return 0;
+}
+
+int
+rbh_sketch_heavy_hitters(const struct rbh_sketch *sketch,
+                         struct rbh_sketch_item *items, size_t *count)
+{
+    const struct count_min *cms = &sketch->cms;
+
+    if (sketch->type != RBH_SKT_COUNT_MIN) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    if (*count < cms->count) {
+        *count = cms->count;
+        errno = EOVERFLOW;
+        return -1;
+    }
+
+    for (size_t i = 0; i < cms->count; i++) {
+        key_to_value(cms->heavy_hitters[i].key, cms->heavy_hitters[i].size,
+                     &items[i].value);
+        items[i].frequency = cms->heavy_hitters[i].frequency;
+    }
+    qsort(items, cms->count, sizeof(*items), heavy_hitter_compare);
+
+    *count = cms->count;
+    return 0;
+}
+
+    /*--------------------------------------------------------------------*
+     |                           serialization                            |
+     *--------------------------------------------------------------------*/
+
+static const char SKETCH_MAGIC[4] = "RBHS";
+#define SKETCH_VERSION 1
+
+static void
+field_serialize(const struct rbh_filter_field *field, struct writer *writer)
+{
+    write_u32(writer, field->fsentry);
+    switch (field->fsentry) {
+    case RBH_FP_STATX:
+        write_u32(writer, field->statx);
+        break;
+    case RBH_FP_NAMESPACE_XATTRS:
+    case RBH_FP_INODE_XATTRS:
+        /* The length + 1, 0 means NULL */
+        if (field->xattr == NULL) {
+            write_u32(writer, 0);
+            break;
+        }
+        write_u32(writer, strlen(field->xattr) + 1);
+        write_bytes(writer, field->xattr, strlen(field->xattr));
+        break;
+    default:
+        break;
+    }
+}
+
+int
+rbh_sketch_serialize(const struct rbh_sketch *sketch, void *data,
+                     size_t *size)
+{
+    struct writer writer = {
+        .data = data,
+        .size = *size,
+        .offset = 0,
+    };
+
+    write_bytes(&writer, SKETCH_MAGIC, sizeof(SKETCH_MAGIC));
+    write_u8(&writer, SKETCH_VERSION);
+    write_u8(&writer, sketch->type);
+    field_serialize(&sketch->field, &writer);
+    write_u64(&writer, sketch->count);
+
+    switch (sketch->type) {
+    case RBH_SKT_HYPERLOGLOG:
+        hll_serialize(&sketch->hll, &writer);
+        break;
+    case RBH_SKT_KLL:
+        kll_serialize(&sketch->kll, &writer);
+        break;
+    case RBH_SKT_COUNT_MIN:
+        count_min_serialize(&sketch->cms, &writer);
+        break;
+    }
+
+    if (writer.offset > writer.size) {
+        *size = writer.offset;
+        errno = EOVERFLOW;
+        return -1;
+    }
+
+    *size = writer.offset;
+    return 0;
+}
+
+struct rbh_sketch *
+rbh_sketch_deserialize(const void *data, size_t size)
+{
+    struct rbh_filter_field field = {};
+    struct reader reader = {
+        .data = data,
+        .size = size,
+        .offset = 0,
+    };
+    struct rbh_sketch *sketch;
+    char *xattr = NULL;
+    uint32_t fsentry;
+    const void *magic;
+    uint8_t version;
+    uint8_t type;
+    uint64_t count;
+    int save_errno;
+    int rc;
+
+    magic = read_bytes(&reader, sizeof(SKETCH_MAGIC));
+    if (magic == NULL || memcmp(magic, SKETCH_MAGIC, sizeof(SKETCH_MAGIC))
+     || !read_u8(&reader, &version) || version != SKETCH_VERSION
+     || !read_u8(&reader, &type) || type > RBH_SKT_COUNT_MIN
+     || !read_u32(&reader, &fsentry))
+        goto out_einval;
+
+    field.fsentry = fsentry;
+    switch (field.fsentry) {
+    case RBH_FP_STATX:
+        if (!read_u32(&reader, &field.statx))
+            goto out_einval;
+        break;
+    case RBH_FP_NAMESPACE_XATTRS:
+    case RBH_FP_INODE_XATTRS: {
+        const void *bytes;
+        uint32_t length;
+
+        field.xattr = NULL;
+        if (!read_u32(&reader, &length))
+            goto out_einval;
+        if (length == 0)
+            break;
+
+        bytes = read_bytes(&reader, length - 1);
+        if (bytes == NULL || memchr(bytes, '\0', length - 1))
+            goto out_einval;
+
+        xattr = strndup(bytes, length - 1);
+        if (xattr == NULL)
+            return NULL;
+        field.xattr = xattr;
+        break;
+    }
+    default:
+        break;
+    }
+
+    if (!read_u64(&reader, &count))
+        goto out_einval;
+
+    sketch = sketch_alloc(type, &field);
+    save_errno = errno;
+    free(xattr);
+    if (sketch == NULL) {
+        errno = save_errno;
+        return NULL;
+    }
+    sketch->count = count;
+
+    switch (sketch->type) {
+    case RBH_SKT_HYPERLOGLOG:
+        rc = hll_deserialize(&sketch->hll, &reader);
+        break;
+    case RBH_SKT_KLL:
+        rc = kll_deserialize(&sketch->kll, &reader);
+        break;
+    case RBH_SKT_COUNT_MIN:
+        rc = count_min_deserialize(&sketch->cms, &reader);
+        break;
+    default:
+        __builtin_unreachable();
+    }
+
+    if (rc == 0 && reader.offset != reader.size) {
+        rbh_sketch_destroy(sketch);
+        errno = EINVAL;
+        return NULL;
+    }
+
+    if (rc) {
+        save_errno = errno;
+        free(sketch);
+        errno = save_errno;
+        return NULL;
+    }
+
+    return sketch;
+
+out_einval:
+    free(xattr);
+    errno = EINVAL;
+    return NULL;
+}
+
+void
+rbh_sketch_destroy(struct rbh_sketch *sketch)
+{
+    switch (sketch->type) {
+    case RBH_SKT_HYPERLOGLOG:
+        hll_fini(&sketch->hll);
+        break;
+    case RBH_SKT_KLL:
+        kll_fini(&sketch->kll);
+        break;
+    case RBH_SKT_COUNT_MIN:
+        count_min_fini(&sketch->cms);
+        break;
+    }
+    free(sketch);
+}
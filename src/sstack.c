@@ -11,7 +11,9 @@
 
 #include <assert.h>
 #include <errno.h>
+#include <stdint.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include "robinhood/stack.h"
 #include "robinhood/sstack.h"
@@ -63,18 +65,62 @@ rbh_sstack_new(size_t chunk_size)
     return sstack;
 }
 
+/* Create a chunk large enough to hold `size' bytes
+ *
+ * Chunks are `chunk_size' bytes long, unless that is not enough, in which case
+ * their size is doubled as many times as needed.
+ */
+static struct rbh_stack *
+sstack_chunk_new(struct rbh_sstack *sstack, size_t size)
+{
+    size_t chunk_size = sstack->chunk_size ? sstack->chunk_size : 1;
+
+    while (chunk_size < size) {
+        if (chunk_size > SIZE_MAX >> 1) {
+            errno = ENOMEM;
+            return NULL;
+        }
+        chunk_size <<= 1;
+    }
+
+    return rbh_stack_new(chunk_size);
+}
+
 void *
-rbh_sstack_push(struct rbh_sstack *sstack, const void *data, size_t size)
+rbh_sstack_alloc(struct rbh_sstack *sstack, size_t size, size_t alignment)
 {
+    struct rbh_stack *stack;
+    size_t readable;
     void *ret;
 
+    if (alignment == 0 || (alignment & (alignment - 1))) {
+        errno = EINVAL;
+        return NULL;
+    }
+
+    /* Enough space for `size' bytes, whatever the alignment of a chunk */
+    if (size > SIZE_MAX - (alignment - 1)) {
+        errno = ENOMEM;
+        return NULL;
+    }
+
 retry:
-    ret = rbh_stack_push(sstack->stacks[sstack->current], data, size);
+    stack = sstack->stacks[sstack->current];
+    ret = rbh_stack_alloc(stack, size, alignment);
     if (ret != NULL)
         return ret;
 
-    if (errno != ENOBUFS)
-        return NULL;
+    rbh_stack_peek(stack, &readable);
+    if (readable == 0) {
+        /* The chunk is too small, replace it with a larger one */
+        stack = sstack_chunk_new(sstack, size + alignment - 1);
+        if (stack == NULL)
+            return NULL;
+
+        rbh_stack_destroy(sstack->stacks[sstack->current]);
+        sstack->stacks[sstack->current] = stack;
+        goto retry;
+    }
 
     if (++sstack->current >= sstack->count) {
         struct rbh_stack **tmp = sstack->stacks;
@@ -90,12 +136,18 @@ retry:
         sstack->count = new_count;
     }
 
-    if (sstack->current < sstack->initialized)
+    if (sstack->current < sstack->initialized) {
+        /* The chunk may still hold data that was rewound over */
+        stack = sstack->stacks[sstack->current];
+        rbh_stack_peek(stack, &readable);
+        rbh_stack_pop(stack, readable);
         goto retry;
+    }
 
     assert(sstack->current == sstack->initialized);
 
-    sstack->stacks[sstack->current] = rbh_stack_new(sstack->chunk_size);
+    sstack->stacks[sstack->current] = sstack_chunk_new(sstack,
+                                                       size + alignment - 1);
     if (sstack->stacks[sstack->current] == NULL) {
         sstack->current--;
         return NULL;
@@ -105,6 +157,18 @@ retry:
     goto retry;
 }
 
+void *
+rbh_sstack_push(struct rbh_sstack *sstack, const void *data, size_t size)
+{
+    void *ret;
+
+    ret = rbh_sstack_alloc(sstack, size, 1);
+    if (ret != NULL && data != NULL)
+        memcpy(ret, data, size);
+
+    return ret;
+}
+
 void *
 rbh_sstack_peek(struct rbh_sstack *sstack, size_t *readable)
 {
@@ -126,6 +190,34 @@ rbh_sstack_pop(struct rbh_sstack *sstack, size_t count)
     return 0;
 }
 
+struct rbh_sstack_mark
+rbh_sstack_mark(struct rbh_sstack *sstack)
+{
+    struct rbh_sstack_mark mark = {
+        .chunk = sstack->current,
+    };
+
+    rbh_stack_peek(sstack->stacks[sstack->current], &mark.used);
+    return mark;
+}
+
+void
+rbh_sstack_rewind(struct rbh_sstack *sstack, struct rbh_sstack_mark mark)
+{
+    struct rbh_stack *stack;
+    size_t readable;
+
+    assert(mark.chunk <= sstack->current);
+
+    /* Chunks above `mark.chunk' are emptied lazily, in rbh_sstack_alloc() */
+    sstack->current = mark.chunk;
+    stack = sstack->stacks[sstack->current];
+
+    rbh_stack_peek(stack, &readable);
+    assert(readable >= mark.used);
+    rbh_stack_pop(stack, readable - mark.used);
+}
+
 void
 rbh_sstack_shrink(struct rbh_sstack *sstack)
 {
@@ -134,6 +226,24 @@ rbh_sstack_shrink(struct rbh_sstack *sstack)
     sstack->initialized = sstack->current + 1;
 }
 
+void
+rbh_sstack_usage(struct rbh_sstack *sstack, struct rbh_memory_usage *usage)
+{
+    *usage = (struct rbh_memory_usage){ 0 };
+
+    for (size_t i = 0; i < sstack->initialized; i++) {
+        struct rbh_memory_usage chunk;
+
+        rbh_stack_usage(sstack->stacks[i], &chunk);
+        usage->allocated += chunk.allocated;
+        /* Chunks above the current one are only kept for later */
+        if (i <= sstack->current)
+            usage->used += chunk.used;
+        else
+            usage->cached += chunk.allocated;
+    }
+}
+
 void
 rbh_sstack_destroy(struct rbh_sstack *sstack)
 {
@@ -10,24 +10,29 @@
 #endif
 
 #include <errno.h>
+#include <stdbool.h>
+#include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
 
 #include "robinhood/stack.h"
+#include "hugepages.h"
 
 struct rbh_stack {
     size_t size;
     size_t used;
     char *buffer;
+    bool mapped;
 };
 
 struct rbh_stack *
 rbh_stack_new(size_t size)
 {
     struct rbh_stack *stack;
+    bool mapped;
     char *buffer;
 
-    buffer = malloc(size);
+    buffer = huge_pages_alloc(size, &mapped);
     if (buffer == NULL)
         return NULL;
 
@@ -35,12 +40,13 @@ rbh_stack_new(size_t size)
     if (stack == NULL) {
         int save_errno = errno;
 
-        free(buffer);
+        huge_pages_free(buffer, size, mapped);
         errno = save_errno;
         return NULL;
     }
 
     stack->buffer = buffer;
+    stack->mapped = mapped;
     stack->used = 0;
     stack->size = size;
 
@@ -67,6 +73,33 @@ rbh_stack_push(struct rbh_stack *stack, const void *data, size_t size)
     return rbh_stack_top(stack);
 }
 
+void *
+rbh_stack_alloc(struct rbh_stack *stack, size_t size, size_t alignment)
+{
+    size_t available = stack->size - stack->used;
+    size_t padding;
+
+    if (alignment == 0 || (alignment & (alignment - 1)) || size > stack->size) {
+        errno = EINVAL;
+        return NULL;
+    }
+
+    if (size > available) {
+        errno = ENOBUFS;
+        return NULL;
+    }
+
+    /* The stack grows downwards, padding goes above the allocated bytes */
+    padding = (uintptr_t)(rbh_stack_top(stack) - size) & (alignment - 1);
+    if (padding > available - size) {
+        errno = ENOBUFS;
+        return NULL;
+    }
+
+    stack->used += size + padding;
+    return rbh_stack_top(stack);
+}
+
 void *
 rbh_stack_peek(struct rbh_stack *stack, size_t *readable)
 {
@@ -86,9 +119,17 @@ rbh_stack_pop(struct rbh_stack *stack, size_t count)
     return 0;
 }
 
+void
+rbh_stack_usage(struct rbh_stack *stack, struct rbh_memory_usage *usage)
+{
+    usage->allocated = stack->size;
+    usage->used = stack->used;
+    usage->cached = 0;
+}
+
 void
 rbh_stack_destroy(struct rbh_stack *stack)
 {
-    free(stack->buffer);
+    huge_pages_free(stack->buffer, stack->size, stack->mapped);
     free(stack);
 }
@@ -21,6 +21,8 @@
 #include "robinhood/utils.h"
 #include "robinhood/uri.h"
 
+#include "utils.h"
+
 static const struct rbh_backend_plugin *
 backend_plugin_import(const char *name)
 {
@@ -52,43 +54,42 @@ backend_new(const char *type, const char *fsname)
     return backend;
 }
 
-static struct file_handle *
-path2handle_at(int dirfd, const char *path, int flags)
+static struct rbh_id *
+path2id_at(int dirfd, const char *path, int flags)
 {
     struct file_handle *handle;
+    struct rbh_id *id;
+    int save_errno;
     int mount_id;
 
     handle = malloc(MAX_HANDLE_SZ);
     if (handle == NULL)
-        error(EXIT_FAILURE, errno, "malloc");
+        return NULL;
     handle->handle_bytes = MAX_HANDLE_SZ - sizeof(*handle);
 
     while (name_to_handle_at(dirfd, path, handle, &mount_id, flags)) {
+        struct file_handle *tmp;
+
         if (errno != EOVERFLOW)
-            error(EXIT_FAILURE, errno, "name_to_handle_at: %s", path);
+            goto out_free_handle;
 
-        handle = realloc(handle, sizeof(*handle) + handle->handle_bytes);
-        if (handle == NULL)
-            error(EXIT_FAILURE, errno, "realloc");
+        tmp = realloc(handle, sizeof(*handle) + handle->handle_bytes);
+        if (tmp == NULL)
+            goto out_free_handle;
+        handle = tmp;
     }
 
-    return handle;
-}
-
-static struct rbh_id *
-path2id_at(int dirfd, const char *path, int flags)
-{
-    struct file_handle *handle;
-    struct rbh_id *id;
-
-    handle = path2handle_at(dirfd, path, flags);
-
     id = rbh_id_from_file_handle(handle);
-    if (id == NULL)
-        error(EXIT_FAILURE, errno, "rbh_id_from_file_handle");
-
+    save_errno = errno;
     free(handle);
+    errno = save_errno;
     return id;
+
+out_free_handle:
+    save_errno = errno;
+    free(handle);
+    errno = save_errno;
+    return NULL;
 }
 
 static struct rbh_backend *
@@ -100,9 +101,9 @@ posix_backend_branch_from_path(struct rbh_backend *backend, const char *fsname,
     int save_errno;
     int dirfd;
 
-    dirfd = open(fsname, O_RDONLY);
+    dirfd = open(fsname, O_RDONLY | O_CLOEXEC | O_DIRECTORY);
     if (dirfd < 0)
-        error(EXIT_FAILURE, errno, "open: %s", fsname);
+        return NULL;
 
     /* Discard every leading '/' in `path' */
     while (*path == '/')
@@ -110,8 +111,13 @@ posix_backend_branch_from_path(struct rbh_backend *backend, const char *fsname,
 
     /* AT_EMPTY_PATH is required as `path' may be empty */
     id = path2id_at(dirfd, path, AT_EMPTY_PATH);
+    save_errno = errno;
     /* Ignore errors on close */
     close(dirfd);
+    if (id == NULL) {
+        errno = save_errno;
+        return NULL;
+    }
 
     branch = rbh_backend_branch(backend, id);
     save_errno = errno;
@@ -120,8 +126,9 @@ posix_backend_branch_from_path(struct rbh_backend *backend, const char *fsname,
     return branch;
 }
 
-static struct rbh_backend *
-backend_branch_from_path(struct rbh_backend *backend, const char *path)
+struct rbh_backend *
+backend_branch_from_path(struct rbh_backend *backend, const char *fsname,
+                         const char *path)
 {
     const struct rbh_filter_projection ID_ONLY = {
         .fsentry_mask = RBH_FP_ID,
@@ -130,12 +137,19 @@ backend_branch_from_path(struct rbh_backend *backend, const char *path)
     struct rbh_backend *branch;
     int save_errno;
 
+    /* The posix backend does not support filtering, treat it differently */
+    if (backend->id == RBH_BI_POSIX)
+        return posix_backend_branch_from_path(backend, fsname, path);
+
     fsentry = rbh_backend_fsentry_from_path(backend, path, &ID_ONLY);
     if (fsentry == NULL)
-        error(EXIT_FAILURE, errno, "rbh_backend_fsentry_from_path");
+        return NULL;
 
-    if (!(fsentry->mask & RBH_FP_ID))
-        error(EXIT_FAILURE, ENODATA, "rbh_backend_fsentry_from_path");
+    if (!(fsentry->mask & RBH_FP_ID)) {
+        free(fsentry);
+        errno = ENODATA;
+        return NULL;
+    }
 
     branch = rbh_backend_branch(backend, &fsentry->id);
     save_errno = errno;
@@ -158,12 +172,7 @@ backend_from_uri(const struct rbh_uri *uri)
         branch = rbh_backend_branch(backend, uri->id);
         break;
     case RBH_UT_PATH:
-        /* The posix backend does not support filtering, treat it differently */
-        if (backend->id == RBH_BI_POSIX)
-            branch = posix_backend_branch_from_path(backend, uri->fsname,
-                                                    uri->path);
-        else
-            branch = backend_branch_from_path(backend, uri->path);
+        branch = backend_branch_from_path(backend, uri->fsname, uri->path);
         break;
     }
 
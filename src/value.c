@@ -262,6 +262,53 @@ value_map_copy(struct rbh_value_map *dest, const struct rbh_value_map *src,
     return 0;
 }
 
+int
+value_scalar_bytes(const struct rbh_value *value, const void **data,
+                   size_t *size)
+{
+    switch (value->type) {
+    case RBH_VT_BOOLEAN:
+        *data = &value->boolean;
+        *size = sizeof(value->boolean);
+        return 0;
+    case RBH_VT_INT32:
+        *data = &value->int32;
+        *size = sizeof(value->int32);
+        return 0;
+    case RBH_VT_UINT32:
+        *data = &value->uint32;
+        *size = sizeof(value->uint32);
+        return 0;
+    case RBH_VT_INT64:
+        *data = &value->int64;
+        *size = sizeof(value->int64);
+        return 0;
+    case RBH_VT_UINT64:
+        *data = &value->uint64;
+        *size = sizeof(value->uint64);
+        return 0;
+    case RBH_VT_STRING:
+        *data = value->string;
+        *size = strlen(value->string);
+        return 0;
+    case RBH_VT_BINARY:
+        *data = value->binary.data;
+        *size = value->binary.size;
+        return 0;
+    case RBH_VT_REGEX:
+        *data = value->regex.string;
+        *size = strlen(value->regex.string);
+        return 0;
+    case RBH_VT_SEQUENCE:
+    case RBH_VT_MAP:
+        errno = ENOTSUP;
+        return -1;
+    }
+
+    errno = EINVAL;
+    return -1;
+}
+
 static struct rbh_value *
 value_clone(const struct rbh_value *value)
 {
@@ -0,0 +1,155 @@
+/* This file is part of the RobinHood Library
+ * Copyright (C) 2022 Commissariat a l'energie atomique et aux energies
+ *                    alternatives
+ *
+ * SPDX-License-Identifer: LGPL-3.0-or-later
+ */
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+/* TLB misses and access times of rings and stacks, under each huge page policy
+ *
+ * Buffers are accessed at random (page-sized strides apart), which is the
+ * worst case for the TLB. dTLB misses are counted with perf_event_open(2),
+ * if the kernel lets us.
+ */
+
+#include <errno.h>
+#include <error.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sysexits.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+
+#include "robinhood/memory.h"
+#include "robinhood/ring.h"
+#include "robinhood/stack.h"
+
+#define BUFFER_SIZE (1UL << 28)
+#define ACCESSES (1 << 24)
+
+static double
+now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static int
+dtlb_counter(void)
+{
+    struct perf_event_attr attr = {
+        .type = PERF_TYPE_HW_CACHE,
+        .size = sizeof(attr),
+        .config = PERF_COUNT_HW_CACHE_DTLB
+                | PERF_COUNT_HW_CACHE_OP_READ << 8
+                | PERF_COUNT_HW_CACHE_RESULT_MISS << 16,
+        .disabled = 1,
+        .exclude_kernel = 1,
+        .exclude_hv = 1,
+    };
+
+    return syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+}
+
+/* xorshift64, to keep the generator out of the way */
+static uint64_t
+next(uint64_t *state)
+{
+    *state ^= *state << 13;
+    *state ^= *state >> 7;
+    *state ^= *state << 17;
+    return *state;
+}
+
+static void
+walk(const char *name, volatile char *buffer)
+{
+    uint64_t misses = 0;
+    uint64_t state = 42;
+    double start, elapsed;
+    char sum = 0;
+    int counter;
+
+    /* Fault every page in first */
+    memset((char *)buffer, 1, BUFFER_SIZE);
+
+    counter = dtlb_counter();
+    if (counter >= 0) {
+        ioctl(counter, PERF_EVENT_IOC_RESET, 0);
+        ioctl(counter, PERF_EVENT_IOC_ENABLE, 0);
+    }
+
+    start = now();
+    for (size_t i = 0; i < ACCESSES; i++)
+        sum += buffer[next(&state) % BUFFER_SIZE];
+    elapsed = now() - start;
+
+    if (counter >= 0) {
+        ioctl(counter, PERF_EVENT_IOC_DISABLE, 0);
+        if (read(counter, &misses, sizeof(misses)) != sizeof(misses))
+            misses = 0;
+        close(counter);
+    }
+
+    (void)sum;
+    printf("%-28s %6.2f ns/access", name, elapsed / ACCESSES * 1e9);
+    if (counter >= 0)
+        printf(", %5.3f dTLB misses/access", (double)misses / ACCESSES);
+    printf("\n");
+}
+
+static const struct {
+    enum rbh_huge_pages policy;
+    const char *name;
+} POLICIES[] = {
+    { RBH_HP_NONE, "none" },
+    { RBH_HP_TRANSPARENT, "transparent" },
+    { RBH_HP_EXPLICIT, "explicit" },
+};
+
+int
+main(void)
+{
+    if (dtlb_counter() < 0)
+        fprintf(stderr, "cannot count dTLB misses: %s\n", strerror(errno));
+
+    for (size_t i = 0; i < sizeof(POLICIES) / sizeof(*POLICIES); i++) {
+        struct rbh_stack *stack;
+        struct rbh_ring *ring;
+        char name[64];
+        size_t size;
+
+        rbh_memory_set_huge_pages(POLICIES[i].policy);
+
+        ring = rbh_ring_new(BUFFER_SIZE);
+        if (ring == NULL)
+            error(EXIT_FAILURE, errno, "rbh_ring_new");
+
+        snprintf(name, sizeof(name), "ring (%s):", POLICIES[i].name);
+        walk(name, rbh_ring_push(ring, NULL, BUFFER_SIZE));
+        rbh_ring_destroy(ring);
+
+        stack = rbh_stack_new(BUFFER_SIZE);
+        if (stack == NULL)
+            error(EXIT_FAILURE, errno, "rbh_stack_new");
+
+        rbh_stack_push(stack, NULL, BUFFER_SIZE);
+        snprintf(name, sizeof(name), "stack (%s):", POLICIES[i].name);
+        walk(name, rbh_stack_peek(stack, &size));
+        rbh_stack_destroy(stack);
+    }
+
+    return EX_OK;
+}
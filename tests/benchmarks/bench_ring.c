@@ -0,0 +1,251 @@
+/* This file is part of the RobinHood Library
+ * Copyright (C) 2022 Commissariat a l'energie atomique et aux energies
+ *                    alternatives
+ *
+ * SPDX-License-Identifer: LGPL-3.0-or-later
+ */
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+/* Cross-core throughput and latency of struct rbh_spsc_ring
+ *
+ * The producer and the consumer are pinned to the first two CPUs the process
+ * is allowed to run on (if there are at least two).
+ */
+
+#include <errno.h>
+#include <error.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sysexits.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "robinhood/ring.h"
+
+#define RING_SIZE (1 << 20)
+#define THROUGHPUT_BYTES (1UL << 30)
+#define ROUND_TRIPS (1 << 20)
+
+static int cpus[2] = { -1, -1 };
+
+static void
+find_cpus(void)
+{
+    cpu_set_t set;
+    int count = 0;
+
+    if (sched_getaffinity(0, sizeof(set), &set))
+        return;
+
+    for (int cpu = 0; cpu < CPU_SETSIZE && count < 2; cpu++) {
+        if (CPU_ISSET(cpu, &set))
+            cpus[count++] = cpu;
+    }
+
+    if (count < 2)
+        cpus[0] = cpus[1] = -1;
+}
+
+static void
+pin(int index)
+{
+    cpu_set_t set;
+    int rc;
+
+    if (cpus[index] < 0)
+        return;
+
+    CPU_ZERO(&set);
+    CPU_SET(cpus[index], &set);
+    rc = pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+    if (rc)
+        error(EXIT_FAILURE, rc, "pthread_setaffinity_np");
+}
+
+/* Busy waiting only makes sense if both threads run concurrently */
+static void
+relax(void)
+{
+    if (cpus[0] < 0)
+        sched_yield();
+}
+
+static double
+now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/*----------------------------------------------------------------------------*
+ |                                 throughput                                 |
+ *----------------------------------------------------------------------------*/
+
+struct throughput {
+    struct rbh_spsc_ring *ring;
+    size_t message_size;
+};
+
+static void *
+produce(void *arg)
+{
+    struct throughput *throughput = arg;
+    size_t size = throughput->message_size;
+
+    pin(0);
+    for (size_t sent = 0; sent < THROUGHPUT_BYTES; sent += size) {
+        void *address;
+
+        while ((address = rbh_spsc_ring_reserve(throughput->ring, size))
+                == NULL)
+            relax();
+        memset(address, sent, size);
+        rbh_spsc_ring_commit(throughput->ring, size);
+    }
+
+    return NULL;
+}
+
+static void
+bench_throughput(size_t message_size)
+{
+    struct throughput throughput = {
+        .message_size = message_size,
+    };
+    size_t received = 0;
+    pthread_t producer;
+    double start, elapsed;
+    int rc;
+
+    throughput.ring = rbh_spsc_ring_new(RING_SIZE);
+    if (throughput.ring == NULL)
+        error(EXIT_FAILURE, errno, "rbh_spsc_ring_new");
+
+    pin(1);
+    start = now();
+    rc = pthread_create(&producer, NULL, produce, &throughput);
+    if (rc)
+        error(EXIT_FAILURE, rc, "pthread_create");
+
+    while (received < THROUGHPUT_BYTES) {
+        size_t readable;
+
+        rbh_spsc_ring_peek(throughput.ring, 0, &readable);
+        /* Consume whole batches, as a real consumer would */
+        if (readable == 0) {
+            relax();
+            continue;
+        }
+
+        rbh_spsc_ring_pop(throughput.ring, readable);
+        received += readable;
+    }
+
+    pthread_join(producer, NULL);
+    elapsed = now() - start;
+
+    printf("throughput: %4zu B messages: %8.2f Mmsg/s, %6.2f GB/s\n",
+           message_size, THROUGHPUT_BYTES / message_size / elapsed / 1e6,
+           THROUGHPUT_BYTES / elapsed / 1e9);
+
+    rbh_spsc_ring_destroy(throughput.ring);
+}
+
+/*----------------------------------------------------------------------------*
+ |                                  latency                                   |
+ *----------------------------------------------------------------------------*/
+
+struct ping_pong {
+    struct rbh_spsc_ring *ping;
+    struct rbh_spsc_ring *pong;
+};
+
+static uint64_t
+receive(struct rbh_spsc_ring *ring)
+{
+    uint64_t value;
+    size_t readable;
+    void *data;
+
+    while (data = rbh_spsc_ring_peek(ring, sizeof(value), &readable),
+           readable < sizeof(value))
+        relax();
+
+    memcpy(&value, data, sizeof(value));
+    rbh_spsc_ring_pop(ring, sizeof(value));
+    return value;
+}
+
+static void
+send(struct rbh_spsc_ring *ring, uint64_t value)
+{
+    while (rbh_spsc_ring_push(ring, &value, sizeof(value)) == NULL)
+        relax();
+}
+
+static void *
+ponger(void *arg)
+{
+    struct ping_pong *ping_pong = arg;
+
+    pin(0);
+    for (size_t i = 0; i < ROUND_TRIPS; i++)
+        send(ping_pong->pong, receive(ping_pong->ping));
+
+    return NULL;
+}
+
+static void
+bench_latency(void)
+{
+    struct ping_pong ping_pong;
+    pthread_t thread;
+    uint64_t value = 0;
+    double start;
+    int rc;
+
+    ping_pong.ping = rbh_spsc_ring_new(sysconf(_SC_PAGESIZE));
+    ping_pong.pong = rbh_spsc_ring_new(sysconf(_SC_PAGESIZE));
+    if (ping_pong.ping == NULL || ping_pong.pong == NULL)
+        error(EXIT_FAILURE, errno, "rbh_spsc_ring_new");
+
+    pin(1);
+    rc = pthread_create(&thread, NULL, ponger, &ping_pong);
+    if (rc)
+        error(EXIT_FAILURE, rc, "pthread_create");
+
+    start = now();
+    for (size_t i = 0; i < ROUND_TRIPS; i++) {
+        send(ping_pong.ping, value);
+        value = receive(ping_pong.pong) + 1;
+    }
+    printf("latency: %.1f ns (one way)\n",
+           (now() - start) / ROUND_TRIPS / 2 * 1e9);
+
+    pthread_join(thread, NULL);
+    rbh_spsc_ring_destroy(ping_pong.pong);
+    rbh_spsc_ring_destroy(ping_pong.ping);
+}
+
+int
+main(void)
+{
+    find_cpus();
+    if (cpus[0] < 0)
+        fprintf(stderr, "less than 2 CPUs available, threads are not pinned\n");
+
+    for (size_t size = 8; size <= 4096; size *= 8)
+        bench_throughput(size);
+    bench_latency();
+
+    return EX_OK;
+}
@@ -0,0 +1,291 @@
+/* This file is part of the RobinHood Library
+ * Copyright (C) 2022 Commissariat a l'energie atomique et aux energies
+ *                    alternatives
+ *
+ * SPDX-License-Identifer: LGPL-3.0-or-later
+ */
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <errno.h>
+#include <poll.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "check-compat.h"
+#include "robinhood/async.h"
+#include "robinhood/itertools.h"
+
+static void
+wait_readable(int fd)
+{
+    struct pollfd pollfd = {
+        .fd = fd,
+        .events = POLLIN,
+    };
+
+    ck_assert_int_eq(poll(&pollfd, 1, 10000), 1);
+    ck_assert_int_eq(pollfd.revents & POLLIN, POLLIN);
+}
+
+/*----------------------------------------------------------------------------*
+ |                              rbh_iter_async()                              |
+ *----------------------------------------------------------------------------*/
+
+START_TEST(ria_not_pollable)
+{
+    const char STRING[] = "abcdefghijklmno";
+    struct rbh_iterator *letters;
+
+    letters = rbh_iter_array(STRING, sizeof(*STRING), sizeof(STRING));
+    ck_assert_ptr_nonnull(letters);
+
+    errno = 0;
+    ck_assert_int_eq(rbh_iter_fileno(letters), -1);
+    ck_assert_int_eq(errno, ENOTSUP);
+
+    rbh_iter_destroy(letters);
+}
+END_TEST
+
+START_TEST(ria_basic)
+{
+    const char STRING[] = "abcdefghijklmno";
+    struct rbh_iterator *letters;
+    size_t i = 0;
+    int fd;
+
+    letters = rbh_iter_array(STRING, sizeof(*STRING), sizeof(STRING));
+    ck_assert_ptr_nonnull(letters);
+
+    letters = rbh_iter_async(letters);
+    ck_assert_ptr_nonnull(letters);
+
+    fd = rbh_iter_fileno(letters);
+    ck_assert_int_ge(fd, 0);
+
+    while (true) {
+        const char *letter;
+
+        errno = 0;
+        letter = rbh_iter_try_next(letters);
+        if (letter == NULL && errno == EAGAIN) {
+            wait_readable(fd);
+            continue;
+        }
+        if (letter == NULL)
+            break;
+
+        ck_assert_uint_lt(i, sizeof(STRING));
+        ck_assert_int_eq(*letter, STRING[i++]);
+    }
+    ck_assert_int_eq(errno, ENODATA);
+    ck_assert_uint_eq(i, sizeof(STRING));
+
+    /* Once exhausted, the iterator stays exhausted */
+    errno = 0;
+    ck_assert_ptr_null(rbh_iter_try_next(letters));
+    ck_assert_int_eq(errno, ENODATA);
+
+    rbh_iter_destroy(letters);
+}
+END_TEST
+
+START_TEST(ria_blocking)
+{
+    const int INTEGERS[] = { 0, 1, 2, 3, 4, 5, 6, 7, 8, 9 };
+    struct rbh_iterator *integers;
+
+    integers = rbh_iter_array(INTEGERS, sizeof(*INTEGERS),
+                              sizeof(INTEGERS) / sizeof(*INTEGERS));
+    ck_assert_ptr_nonnull(integers);
+
+    integers = rbh_iter_async(integers);
+    ck_assert_ptr_nonnull(integers);
+
+    /* rbh_iter_next() simply busy-waits on asynchronous iterators */
+    for (size_t i = 0; i < sizeof(INTEGERS) / sizeof(*INTEGERS); i++)
+        ck_assert_mem_eq(rbh_iter_next(integers), &INTEGERS[i],
+                         sizeof(*INTEGERS));
+
+    errno = 0;
+    ck_assert_ptr_null(rbh_iter_next(integers));
+    ck_assert_int_eq(errno, ENODATA);
+
+    rbh_iter_destroy(integers);
+}
+END_TEST
+
+static void *
+slow_iter_next(void *iterator)
+{
+    int *integer;
+
+    usleep(10000);
+
+    integer = malloc(sizeof(*integer));
+    if (integer == NULL)
+        return NULL;
+
+    *integer = 0;
+    return integer;
+}
+
+static const struct rbh_mut_iterator_operations SLOW_ITER_OPS = {
+    .next = slow_iter_next,
+    .destroy = free,
+};
+
+START_TEST(rmia_destroy_while_fetching)
+{
+    struct rbh_mut_iterator *slow;
+
+    for (int i = 0; i < 16; i++) {
+        slow = malloc(sizeof(*slow));
+        ck_assert_ptr_nonnull(slow);
+        slow->ops = &SLOW_ITER_OPS;
+
+        slow = rbh_mut_iter_async(slow);
+        ck_assert_ptr_nonnull(slow);
+
+        errno = 0;
+        ck_assert_ptr_null(rbh_mut_iter_try_next(slow));
+        ck_assert_int_eq(errno, EAGAIN);
+
+        rbh_mut_iter_destroy(slow);
+    }
+}
+END_TEST
+
+START_TEST(rmia_many)
+{
+    const int INTEGERS[] = { 0, 1, 2, 3, 4, 5, 6, 7, 8, 9 };
+    const size_t COUNT = sizeof(INTEGERS) / sizeof(*INTEGERS);
+    struct rbh_mut_iterator *iterators[64];
+    struct pollfd pollfds[64];
+    size_t yielded[64] = {};
+    size_t active = 64;
+
+    for (size_t i = 0; i < 64; i++) {
+        iterators[i] = rbh_mut_iter_array((void *)INTEGERS, sizeof(*INTEGERS),
+                                          COUNT);
+        ck_assert_ptr_nonnull(iterators[i]);
+
+        iterators[i] = rbh_mut_iter_async(iterators[i]);
+        ck_assert_ptr_nonnull(iterators[i]);
+
+        pollfds[i].fd = rbh_mut_iter_fileno(iterators[i]);
+        pollfds[i].events = POLLIN;
+    }
+
+    while (active) {
+        ck_assert_int_gt(poll(pollfds, 64, 10000), 0);
+
+        for (size_t i = 0; i < 64; i++) {
+            int *integer;
+
+            if (!(pollfds[i].revents & POLLIN))
+                continue;
+
+            errno = 0;
+            integer = rbh_mut_iter_try_next(iterators[i]);
+            if (integer != NULL) {
+                ck_assert_int_eq(*integer, INTEGERS[yielded[i]++]);
+                continue;
+            }
+            if (errno == EAGAIN)
+                continue;
+
+            ck_assert_int_eq(errno, ENODATA);
+            ck_assert_uint_eq(yielded[i], COUNT);
+            pollfds[i].fd = -1;
+            active--;
+        }
+    }
+
+    for (size_t i = 0; i < 64; i++)
+        rbh_mut_iter_destroy(iterators[i]);
+}
+END_TEST
+
+/*----------------------------------------------------------------------------*
+ |                          rbh_async_set_workers()                           |
+ *----------------------------------------------------------------------------*/
+
+START_TEST(rasw_zero)
+{
+    errno = 0;
+    ck_assert_int_eq(rbh_async_set_workers(0), -1);
+    ck_assert_int_eq(errno, EINVAL);
+}
+END_TEST
+
+START_TEST(rasw_started)
+{
+    struct rbh_iterator *empty;
+
+    /* Workers may already be running if tests do not run in a subprocess */
+    rbh_async_set_workers(2);
+
+    empty = rbh_iter_array(NULL, 1, 0);
+    ck_assert_ptr_nonnull(empty);
+
+    empty = rbh_iter_async(empty);
+    ck_assert_ptr_nonnull(empty);
+
+    errno = 0;
+    ck_assert_int_eq(rbh_async_set_workers(2), -1);
+    ck_assert_int_eq(errno, EBUSY);
+
+    rbh_iter_destroy(empty);
+}
+END_TEST
+
+static Suite *
+unit_suite(void)
+{
+    Suite *suite;
+    TCase *tests;
+
+    suite = suite_create("async");
+    tests = tcase_create("rbh_iter_async()");
+    tcase_add_test(tests, ria_not_pollable);
+    tcase_add_test(tests, ria_basic);
+    tcase_add_test(tests, ria_blocking);
+
+    suite_add_tcase(suite, tests);
+
+    tests = tcase_create("rbh_mut_iter_async()");
+    tcase_add_test(tests, rmia_destroy_while_fetching);
+    tcase_add_test(tests, rmia_many);
+
+    suite_add_tcase(suite, tests);
+
+    tests = tcase_create("rbh_async_set_workers()");
+    tcase_add_test(tests, rasw_zero);
+    tcase_add_test(tests, rasw_started);
+
+    suite_add_tcase(suite, tests);
+
+    return suite;
+}
+
+int
+main(void)
+{
+    int number_failed;
+    Suite *suite;
+    SRunner *runner;
+
+    suite = unit_suite();
+    runner = srunner_create(suite);
+
+    srunner_run_all(runner, CK_NORMAL);
+    number_failed = srunner_ntests_failed(runner);
+    srunner_free(runner);
+
+    return (number_failed == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -9,11 +9,15 @@
 # include "config.h"
 #endif
 
+#include <stdbool.h>
 #include <stdlib.h>
 #include <signal.h>
 
 #include "check-compat.h"
 #include "robinhood/backend.h"
+#include "robinhood/itertools.h"
+
+#include "utils.h"
 
 static const struct rbh_backend_operations TEST_BACKEND_OPS = {
     .destroy = free,
@@ -164,6 +168,107 @@ START_TEST(rbb_unsupported)
 }
 END_TEST
 
+/*----------------------------------------------------------------------------*
+ |                             rbh_backend_clone                              |
+ *----------------------------------------------------------------------------*/
+
+START_TEST(rbc_unsupported)
+{
+    struct rbh_backend *backend = test_backend_new();
+
+    ck_assert_ptr_null(rbh_backend_clone(backend));
+    ck_assert_int_eq(errno, ENOTSUP);
+
+    rbh_backend_destroy(backend);
+}
+END_TEST
+
+/*----------------------------------------------------------------------------*
+ |                       rbh_backend_filter_partitioned                       |
+ *----------------------------------------------------------------------------*/
+
+static int VALUES[8];
+
+static struct rbh_mut_iterator *
+array_backend_filter(void *backend, const struct rbh_filter *filter,
+                     const struct rbh_filter_options *options)
+{
+    return rbh_mut_iter_array(VALUES, sizeof(*VALUES), ARRAY_SIZE(VALUES));
+}
+
+static const struct rbh_backend_operations ARRAY_BACKEND_OPS = {
+    .filter = array_backend_filter,
+    .destroy = free,
+};
+
+START_TEST(rbfp_unsupported)
+{
+    const struct rbh_filter_options OPTIONS = {};
+    struct rbh_backend *backend = test_backend_new();
+    struct rbh_mut_iterator *partitions[2];
+
+    ck_assert_int_eq(rbh_backend_filter_partitioned(backend, NULL, &OPTIONS,
+                                                    partitions, 2), -1);
+    ck_assert_int_eq(errno, ENOTSUP);
+
+    rbh_backend_destroy(backend);
+}
+END_TEST
+
+START_TEST(rbfp_zero)
+{
+    const struct rbh_filter_options OPTIONS = {};
+    struct rbh_backend *backend = test_backend_new();
+
+    backend->ops = &ARRAY_BACKEND_OPS;
+    ck_assert_int_eq(rbh_backend_filter_partitioned(backend, NULL, &OPTIONS,
+                                                    NULL, 0), -1);
+    ck_assert_int_eq(errno, EINVAL);
+
+    rbh_backend_destroy(backend);
+}
+END_TEST
+
+START_TEST(rbfp_generic)
+{
+    const struct rbh_filter_options OPTIONS = {};
+    struct rbh_backend *backend = test_backend_new();
+    struct rbh_mut_iterator *partitions[3];
+    bool seen[ARRAY_SIZE(VALUES)] = {};
+    size_t done = 0;
+
+    backend->ops = &ARRAY_BACKEND_OPS;
+    ck_assert_int_eq(rbh_backend_filter_partitioned(backend, NULL, &OPTIONS,
+                                                    partitions, 3), 0);
+
+    for (size_t i = 0; done < ARRAY_SIZE(partitions); i++) {
+        struct rbh_mut_iterator *partition =
+            partitions[i % ARRAY_SIZE(partitions)];
+        int *value;
+
+        if (partition == NULL)
+            continue;
+
+        value = rbh_mut_iter_next(partition);
+        if (value == NULL) {
+            ck_assert_int_eq(errno, ENODATA);
+            rbh_mut_iter_destroy(partition);
+            partitions[i % ARRAY_SIZE(partitions)] = NULL;
+            done++;
+            continue;
+        }
+
+        ck_assert(!seen[value - VALUES]);
+        seen[value - VALUES] = true;
+    }
+
+    for (size_t i = 0; i < ARRAY_SIZE(seen); i++)
+        ck_assert(seen[i]);
+
+    rbh_backend_destroy(backend);
+}
+END_TEST
+
 static Suite *
 unit_suite(void)
 {
@@ -175,6 +280,8 @@ unit_suite(void)
     tests = tcase_create("unsupported operations");
     tcase_add_test(tests, rbgo_unsupported);
     tcase_add_test(tests, rbso_unsupported);
+    tcase_add_test(tests, rbc_unsupported);
+    tcase_add_test(tests, rbfp_unsupported);
 
     suite_add_tcase(suite, tests);
 
@@ -185,6 +292,12 @@ unit_suite(void)
 
     suite_add_tcase(suite, tests);
 
+    tests = tcase_create("partitioned filter");
+    tcase_add_test(tests, rbfp_zero);
+    tcase_add_test(tests, rbfp_generic);
+
+    suite_add_tcase(suite, tests);
+
     tests = tcase_create("options");
     tcase_add_test(tests, rbgo_wrong_option);
     tcase_add_test(tests, rbgo_generic_deprecated);
@@ -0,0 +1,591 @@
+/* This file is part of the RobinHood Library
+ * Copyright (C) 2022 Commissariat a l'energie atomique et aux energies
+ *                    alternatives
+ *
+ * SPDX-License-Identifer: LGPL-3.0-or-later
+ */
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <errno.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#include "check-compat.h"
+#include "robinhood/backend_cache.h"
+#include "robinhood/fsevent.h"
+#include "robinhood/itertools.h"
+#include "robinhood/statx.h"
+
+#include "utils.h"
+
+/*----------------------------------------------------------------------------*
+ |                               table backend                                |
+ *----------------------------------------------------------------------------*/
+
+/* A backend that serves a fixed namespace, and counts the queries it gets:
+ *
+ *     /            (directory)
+ *     /dir         (directory)
+ *     /dir/file    (regular file)
+ *     /dir/link    (regular file, also known as /link)
+ */
+
+static const struct rbh_id ROOT_PARENT_ID = {
+    .data = NULL,
+    .size = 0,
+};
+static const struct rbh_id ROOT_ID = {
+    .data = "root",
+    .size = 4,
+};
+static const struct rbh_id DIR_ID = {
+    .data = "dir",
+    .size = 3,
+};
+static const struct rbh_id FILE_ID = {
+    .data = "file",
+    .size = 4,
+};
+static const struct rbh_id LINK_ID = {
+    .data = "link",
+    .size = 4,
+};
+
+static const struct {
+    const struct rbh_id *id;
+    const struct rbh_id *parent_id;
+    const char *name;
+    mode_t mode;
+    uint32_t nlink;
+} TABLE[] = {
+    { &ROOT_ID, &ROOT_PARENT_ID, "", S_IFDIR, 3 },
+    { &DIR_ID, &ROOT_ID, "dir", S_IFDIR, 2 },
+    { &FILE_ID, &DIR_ID, "file", S_IFREG, 1 },
+    { &LINK_ID, &DIR_ID, "link", S_IFREG, 2 },
+    { &LINK_ID, &ROOT_ID, "link", S_IFREG, 2 },
+};
+
+struct table_backend {
+    struct rbh_backend backend;
+    size_t queries;
+    size_t updates;
+};
+
+static struct rbh_fsentry *
+table_fsentry(size_t index)
+{
+    struct rbh_statx statxbuf = {
+        .stx_mask = RBH_STATX_TYPE | RBH_STATX_NLINK,
+        .stx_mode = TABLE[index].mode,
+        .stx_nlink = TABLE[index].nlink,
+    };
+    struct rbh_fsentry *fsentry;
+
+    fsentry = rbh_fsentry_new(TABLE[index].id, TABLE[index].parent_id,
+                              TABLE[index].name, &statxbuf, NULL, NULL, NULL);
+    ck_assert_ptr_nonnull(fsentry);
+    return fsentry;
+}
+
+static bool
+id_eq(const struct rbh_id *id, const struct rbh_value *value)
+{
+    return value->type == RBH_VT_BINARY && id->size == value->binary.size
+        && (id->size == 0
+         || memcmp(id->data, value->binary.data, id->size) == 0);
+}
+
+/* Only lookups by ID, and by parent ID and name, are supported */
+static bool
+table_match(size_t index, const struct rbh_filter *filter)
+{
+    if (filter->op == RBH_FOP_AND) {
+        for (size_t i = 0; i < filter->logical.count; i++) {
+            if (!table_match(index, filter->logical.filters[i]))
+                return false;
+        }
+        return true;
+    }
+
+    ck_assert_int_eq(filter->op, RBH_FOP_EQUAL);
+    switch (filter->compare.field.fsentry) {
+    case RBH_FP_ID:
+        return id_eq(TABLE[index].id, &filter->compare.value);
+    case RBH_FP_PARENT_ID:
+        return id_eq(TABLE[index].parent_id, &filter->compare.value);
+    case RBH_FP_NAME:
+        return strcmp(TABLE[index].name, filter->compare.value.string) == 0;
+    default:
+        ck_abort_msg("unexpected filter");
+    }
+    return false;
+}
+
+struct table_iterator {
+    struct rbh_mut_iterator iterator;
+    struct rbh_fsentry *fsentries[ARRAY_SIZE(TABLE)];
+    size_t index;
+    size_t count;
+};
+
+static void *
+table_iter_next(void *iterator)
+{
+    struct table_iterator *table_iter = iterator;
+
+    if (table_iter->index == table_iter->count) {
+        errno = ENODATA;
+        return NULL;
+    }
+    return table_iter->fsentries[table_iter->index++];
+}
+
+static void
+table_iter_destroy(void *iterator)
+{
+    struct table_iterator *table_iter = iterator;
+
+    while (table_iter->index < table_iter->count)
+        free(table_iter->fsentries[table_iter->index++]);
+    free(table_iter);
+}
+
+static const struct rbh_mut_iterator_operations TABLE_ITER_OPS = {
+    .next = table_iter_next,
+    .destroy = table_iter_destroy,
+};
+
+static struct rbh_mut_iterator *
+table_backend_filter(void *backend, const struct rbh_filter *filter,
+                     const struct rbh_filter_options *options)
+{
+    struct table_backend *table = backend;
+    struct table_iterator *table_iter;
+
+    table_iter = malloc(sizeof(*table_iter));
+    ck_assert_ptr_nonnull(table_iter);
+
+    table_iter->iterator.ops = &TABLE_ITER_OPS;
+    table_iter->index = 0;
+    table_iter->count = 0;
+    for (size_t i = 0; i < ARRAY_SIZE(TABLE); i++) {
+        if (filter == NULL || table_match(i, filter))
+            table_iter->fsentries[table_iter->count++] = table_fsentry(i);
+    }
+
+    table->queries++;
+    return &table_iter->iterator;
+}
+
+static struct rbh_fsentry *
+table_backend_root(void *backend,
+                   const struct rbh_filter_projection *projection)
+{
+    struct table_backend *table = backend;
+
+    table->queries++;
+    return table_fsentry(0);
+}
+
+static ssize_t
+table_backend_update(void *backend, struct rbh_iterator *fsevents)
+{
+    struct table_backend *table = backend;
+    ssize_t count = 0;
+
+    while (rbh_iter_next(fsevents) != NULL)
+        count++;
+    ck_assert_int_eq(errno, ENODATA);
+
+    table->updates += count;
+    return count;
+}
+
+static int
+table_backend_set_option(void *backend, unsigned int option, const void *data,
+                         size_t data_size)
+{
+    return 0;
+}
+
+static const struct rbh_backend_operations TABLE_BACKEND_OPS = {
+    .set_option = table_backend_set_option,
+    .update = table_backend_update,
+    .root = table_backend_root,
+    .filter = table_backend_filter,
+    .destroy = free,
+};
+
+static struct table_backend *table;
+
+static struct rbh_backend *
+cache_new(size_t capacity)
+{
+    struct rbh_backend *cache;
+
+    table = malloc(sizeof(*table));
+    ck_assert_ptr_nonnull(table);
+
+    table->backend.id = UINT8_MAX;
+    table->backend.name = "table";
+    table->backend.ops = &TABLE_BACKEND_OPS;
+    table->queries = 0;
+    table->updates = 0;
+
+    cache = rbh_backend_cache_new(&table->backend, capacity);
+    ck_assert_ptr_nonnull(cache);
+    return cache;
+}
+
+static struct rbh_backend_cache_stats
+cache_stats(struct rbh_backend *cache)
+{
+    struct rbh_backend_cache_stats stats;
+    size_t size = sizeof(stats);
+
+    ck_assert_int_eq(rbh_backend_get_option(cache, RBH_GBO_CACHE_STATS, &stats,
+                                            &size), 0);
+    ck_assert_uint_eq(size, sizeof(stats));
+    return stats;
+}
+
+static const struct rbh_filter_projection ALL = {
+    .fsentry_mask = RBH_FP_ALL,
+    .statx_mask = RBH_STATX_ALL,
+};
+
+static struct rbh_fsentry *
+lookup_id(struct rbh_backend *cache, const struct rbh_id *id)
+{
+    const struct rbh_filter ID_FILTER = {
+        .op = RBH_FOP_EQUAL,
+        .compare = {
+            .field = {
+                .fsentry = RBH_FP_ID,
+            },
+            .value = {
+                .type = RBH_VT_BINARY,
+                .binary = {
+                    .data = id->data,
+                    .size = id->size,
+                },
+            },
+        },
+    };
+
+    return rbh_backend_filter_one(cache, &ID_FILTER, &ALL);
+}
+
+/*----------------------------------------------------------------------------*
+ |                          rbh_backend_cache_new()                           |
+ *----------------------------------------------------------------------------*/
+
+START_TEST(rbcn_no_capacity)
+{
+    struct rbh_backend backend = {
+        .id = UINT8_MAX,
+        .ops = &TABLE_BACKEND_OPS,
+    };
+
+    errno = 0;
+    ck_assert_ptr_null(rbh_backend_cache_new(&backend, 0));
+    ck_assert_int_eq(errno, EINVAL);
+}
+END_TEST
+
+START_TEST(rbcn_root)
+{
+    struct rbh_backend *cache = cache_new(8);
+    struct rbh_backend_cache_stats stats;
+
+    for (size_t i = 0; i < 2; i++) {
+        struct rbh_fsentry *root = rbh_backend_root(cache, &ALL);
+
+        ck_assert_ptr_nonnull(root);
+        ck_assert_uint_eq(root->id.size, ROOT_ID.size);
+        ck_assert_mem_eq(root->id.data, ROOT_ID.data, ROOT_ID.size);
+        free(root);
+    }
+    ck_assert_uint_eq(table->queries, 1);
+
+    stats = cache_stats(cache);
+    ck_assert_uint_eq(stats.count, 1);
+    ck_assert_uint_eq(stats.capacity, 8);
+    ck_assert_uint_eq(stats.hits, 1);
+    ck_assert_uint_eq(stats.misses, 1);
+
+    rbh_backend_destroy(cache);
+}
+END_TEST
+
+START_TEST(rbcn_path)
+{
+    struct rbh_backend *cache = cache_new(8);
+    struct rbh_fsentry *fsentry;
+    size_t queries;
+
+    fsentry = rbh_backend_fsentry_from_path(cache, "/dir/file", &ALL);
+    ck_assert_ptr_nonnull(fsentry);
+    ck_assert_str_eq(fsentry->name, "file");
+    free(fsentry);
+    queries = table->queries;
+
+    /* Every component is cached */
+    fsentry = rbh_backend_fsentry_from_path(cache, "/dir/file", &ALL);
+    ck_assert_ptr_nonnull(fsentry);
+    ck_assert_str_eq(fsentry->name, "file");
+    free(fsentry);
+    ck_assert_uint_eq(table->queries, queries);
+
+    /* So are missing fsentries' parents */
+    errno = 0;
+    ck_assert_ptr_null(rbh_backend_fsentry_from_path(cache, "/dir/missing",
+                                                     &ALL));
+    ck_assert_int_eq(errno, ENOENT);
+    ck_assert_uint_eq(table->queries, queries + 1);
+
+    rbh_backend_destroy(cache);
+}
+END_TEST
+
+START_TEST(rbcn_id)
+{
+    struct rbh_backend *cache = cache_new(8);
+    struct rbh_fsentry *fsentry;
+
+    /* Directories cannot be hardlinked, they are served by ID right away */
+    fsentry = rbh_backend_fsentry_from_path(cache, "/dir", &ALL);
+    ck_assert_ptr_nonnull(fsentry);
+    free(fsentry);
+    ck_assert_uint_eq(table->queries, 2);
+
+    fsentry = lookup_id(cache, &DIR_ID);
+    ck_assert_ptr_nonnull(fsentry);
+    ck_assert_str_eq(fsentry->name, "dir");
+    free(fsentry);
+    ck_assert_uint_eq(table->queries, 2);
+
+    /* Lookups by ID that yield a single link are cached */
+    for (size_t i = 0; i < 2; i++) {
+        fsentry = lookup_id(cache, &FILE_ID);
+        ck_assert_ptr_nonnull(fsentry);
+        ck_assert_str_eq(fsentry->name, "file");
+        free(fsentry);
+    }
+    ck_assert_uint_eq(table->queries, 3);
+
+    /* Those that yield several links are not */
+    for (size_t i = 0; i < 2; i++) {
+        fsentry = lookup_id(cache, &LINK_ID);
+        ck_assert_ptr_nonnull(fsentry);
+        free(fsentry);
+    }
+    ck_assert_uint_eq(table->queries, 5);
+
+    rbh_backend_destroy(cache);
+}
+END_TEST
+
+START_TEST(rbcn_projection)
+{
+    const struct rbh_filter_projection ID_ONLY = {
+        .fsentry_mask = RBH_FP_ID,
+    };
+    struct rbh_backend *cache = cache_new(8);
+    struct rbh_fsentry *root;
+
+    root = rbh_backend_root(cache, &ID_ONLY);
+    ck_assert_ptr_nonnull(root);
+    free(root);
+
+    /* The statx attributes of the root were not fetched */
+    root = rbh_backend_root(cache, &ALL);
+    ck_assert_ptr_nonnull(root);
+    free(root);
+    ck_assert_uint_eq(table->queries, 2);
+
+    /* They are now */
+    root = rbh_backend_root(cache, &ID_ONLY);
+    ck_assert_ptr_nonnull(root);
+    free(root);
+    ck_assert_uint_eq(table->queries, 2);
+
+    ck_assert_uint_eq(cache_stats(cache).count, 1);
+    rbh_backend_destroy(cache);
+}
+END_TEST
+
+START_TEST(rbcn_eviction)
+{
+    struct rbh_backend *cache = cache_new(2);
+    struct rbh_backend_cache_stats stats;
+    struct rbh_fsentry *fsentry;
+
+    /* The root, /dir, and /dir/file */
+    fsentry = rbh_backend_fsentry_from_path(cache, "/dir/file", &ALL);
+    ck_assert_ptr_nonnull(fsentry);
+    free(fsentry);
+
+    stats = cache_stats(cache);
+    ck_assert_uint_eq(stats.count, 2);
+    ck_assert_uint_eq(stats.evictions, 1);
+
+    /* The root was the least recently used */
+    fsentry = rbh_backend_root(cache, &ALL);
+    ck_assert_ptr_nonnull(fsentry);
+    free(fsentry);
+    ck_assert_uint_eq(cache_stats(cache).misses, 4);
+
+    rbh_backend_destroy(cache);
+}
+END_TEST
+
+START_TEST(rbcn_update)
+{
+    const struct rbh_fsevent FSEVENTS[] = {
+        {
+            .type = RBH_FET_DELETE,
+            .id = FILE_ID,
+        },
+    };
+    struct rbh_backend *cache = cache_new(8);
+    struct rbh_iterator *fsevents;
+    struct rbh_fsentry *fsentry;
+
+    fsentry = lookup_id(cache, &FILE_ID);
+    ck_assert_ptr_nonnull(fsentry);
+    free(fsentry);
+    fsentry = lookup_id(cache, &DIR_ID);
+    ck_assert_ptr_nonnull(fsentry);
+    free(fsentry);
+
+    fsevents = rbh_iter_array(FSEVENTS, sizeof(*FSEVENTS),
+                              ARRAY_SIZE(FSEVENTS));
+    ck_assert_ptr_nonnull(fsevents);
+    ck_assert_int_eq(rbh_backend_update(cache, fsevents), 1);
+    rbh_iter_destroy(fsevents);
+    ck_assert_uint_eq(table->updates, 1);
+
+    ck_assert_uint_eq(cache_stats(cache).count, 1);
+    ck_assert_uint_eq(cache_stats(cache).invalidations, 1);
+
+    fsentry = lookup_id(cache, &FILE_ID);
+    ck_assert_ptr_nonnull(fsentry);
+    free(fsentry);
+    ck_assert_uint_eq(table->queries, 3);
+
+    rbh_backend_destroy(cache);
+}
+END_TEST
+
+START_TEST(rbcn_update_link)
+{
+    const struct rbh_fsevent FSEVENTS[] = {
+        {
+            .type = RBH_FET_LINK,
+            .id = LINK_ID,
+            .link = {
+                .parent_id = &DIR_ID,
+                .name = "file",
+            },
+        },
+    };
+    struct rbh_backend *cache = cache_new(8);
+    struct rbh_iterator *fsevents;
+    struct rbh_fsentry *fsentry;
+
+    fsentry = rbh_backend_fsentry_from_path(cache, "/dir/file", &ALL);
+    ck_assert_ptr_nonnull(fsentry);
+    free(fsentry);
+
+    /* /dir/file now refers to another inode */
+    fsevents = rbh_iter_array(FSEVENTS, sizeof(*FSEVENTS),
+                              ARRAY_SIZE(FSEVENTS));
+    ck_assert_ptr_nonnull(fsevents);
+    ck_assert_int_eq(rbh_backend_update(cache, fsevents), 1);
+    rbh_iter_destroy(fsevents);
+
+    ck_assert_uint_eq(cache_stats(cache).invalidations, 1);
+    ck_assert_uint_eq(cache_stats(cache).count, 2);
+
+    rbh_backend_destroy(cache);
+}
+END_TEST
+
+START_TEST(rbcn_options)
+{
+    struct rbh_backend *cache = cache_new(8);
+    struct rbh_backend_cache_stats stats;
+    struct rbh_fsentry *root;
+    size_t size = 0;
+    int value = 0;
+
+    errno = 0;
+    ck_assert_int_eq(rbh_backend_get_option(cache, RBH_GBO_CACHE_STATS, &stats,
+                                            &size), -1);
+    ck_assert_int_eq(errno, EOVERFLOW);
+    ck_assert_uint_eq(size, sizeof(stats));
+
+    errno = 0;
+    ck_assert_int_eq(rbh_backend_set_option(cache, RBH_GBO_CACHE_STATS, &stats,
+                                            sizeof(stats)), -1);
+    ck_assert_int_eq(errno, ENOTSUP);
+
+    root = rbh_backend_root(cache, &ALL);
+    ck_assert_ptr_nonnull(root);
+    free(root);
+
+    /* Options of the wrapped backend go through, and flush the cache */
+    ck_assert_int_eq(rbh_backend_set_option(cache, RBH_BO_FIRST(UINT8_MAX),
+                                            &value, sizeof(value)), 0);
+    ck_assert_uint_eq(cache_stats(cache).count, 0);
+
+    rbh_backend_destroy(cache);
+}
+END_TEST
+
+static Suite *
+unit_suite(void)
+{
+    Suite *suite;
+    TCase *tests;
+
+    suite = suite_create("backend cache");
+
+    tests = tcase_create("rbh_backend_cache_new");
+    tcase_add_test(tests, rbcn_no_capacity);
+    tcase_add_test(tests, rbcn_root);
+    tcase_add_test(tests, rbcn_path);
+    tcase_add_test(tests, rbcn_id);
+    tcase_add_test(tests, rbcn_projection);
+    tcase_add_test(tests, rbcn_eviction);
+    tcase_add_test(tests, rbcn_update);
+    tcase_add_test(tests, rbcn_update_link);
+    tcase_add_test(tests, rbcn_options);
+
+    suite_add_tcase(suite, tests);
+
+    return suite;
+}
+
+int
+main(void)
+{
+    int number_failed;
+    Suite *suite;
+    SRunner *runner;
+
+    suite = unit_suite();
+    runner = srunner_create(suite);
+
+    srunner_run_all(runner, CK_NORMAL);
+    number_failed = srunner_ntests_failed(runner);
+    srunner_free(runner);
+
+    return (number_failed == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,250 @@
+/* This file is part of the RobinHood Library
+ * Copyright (C) 2022 Commissariat a l'energie atomique et aux energies
+ *                    alternatives
+ *
+ * SPDX-License-Identifer: LGPL-3.0-or-later
+ */
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <errno.h>
+#include <ftw.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "check-compat.h"
+#include "robinhood/backend_pool.h"
+
+/*----------------------------------------------------------------------------*
+ |                     fixtures to run tests in isolation                     |
+ *----------------------------------------------------------------------------*/
+
+static const char TMPDIR[] = "/tmp/tmp.d.XXXXXX";
+static __thread char tmpdir[sizeof(TMPDIR)];
+static __thread char uri[sizeof("rbh:posix:") + sizeof(TMPDIR)];
+
+static void
+unchecked_setup_tmpdir(void)
+{
+    memcpy(tmpdir, TMPDIR, sizeof(tmpdir));
+    ck_assert_ptr_nonnull(mkdtemp(tmpdir));
+    ck_assert_int_eq(chdir(tmpdir), 0);
+    ck_assert_int_eq(mkdir("branch", S_IRWXU), 0);
+    sprintf(uri, "rbh:posix:%s", tmpdir);
+}
+
+static int
+delete(const char *fpath, const struct stat *sb, int typeflags,
+       struct FTW * ftwbuf)
+{
+    ck_assert_int_eq(remove(fpath), 0);
+    return 0;
+}
+
+#ifndef NOPENFD
+#define NOPENFD (16)
+#endif
+
+static void
+unchecked_teardown_tmpdir(void)
+{
+    ck_assert_int_eq(
+            nftw(tmpdir, delete, NOPENFD, FTW_DEPTH | FTW_MOUNT | FTW_PHYS), 0
+            );
+}
+
+/*----------------------------------------------------------------------------*
+ |                         rbh_backend_pool_checkout()                        |
+ *----------------------------------------------------------------------------*/
+
+START_TEST(rbpc_reuse)
+{
+    struct rbh_backend_pool *pool;
+    struct rbh_backend *backend;
+
+    pool = rbh_backend_pool_new(1, 0);
+    ck_assert_ptr_nonnull(pool);
+
+    backend = rbh_backend_pool_checkout(pool, uri);
+    ck_assert_ptr_nonnull(backend);
+    rbh_backend_pool_checkin(pool, backend);
+
+    ck_assert_ptr_eq(rbh_backend_pool_checkout(pool, uri), backend);
+    rbh_backend_pool_checkin(pool, backend);
+
+    rbh_backend_pool_destroy(pool);
+}
+END_TEST
+
+START_TEST(rbpc_exclusive)
+{
+    struct rbh_backend *backends[2];
+    struct rbh_backend_pool *pool;
+
+    pool = rbh_backend_pool_new(2, 0);
+    ck_assert_ptr_nonnull(pool);
+
+    backends[0] = rbh_backend_pool_checkout(pool, uri);
+    ck_assert_ptr_nonnull(backends[0]);
+    backends[1] = rbh_backend_pool_checkout(pool, uri);
+    ck_assert_ptr_nonnull(backends[1]);
+    ck_assert_ptr_ne(backends[0], backends[1]);
+
+    rbh_backend_pool_checkin(pool, backends[0]);
+    rbh_backend_pool_checkin(pool, backends[1]);
+    ck_assert_uint_eq(rbh_backend_pool_evict(pool, 0), 2);
+
+    rbh_backend_pool_destroy(pool);
+}
+END_TEST
+
+START_TEST(rbpc_max_idle)
+{
+    struct rbh_backend *backends[3];
+    struct rbh_backend_pool *pool;
+
+    pool = rbh_backend_pool_new(1, 0);
+    ck_assert_ptr_nonnull(pool);
+
+    for (size_t i = 0; i < 3; i++) {
+        backends[i] = rbh_backend_pool_checkout(pool, uri);
+        ck_assert_ptr_nonnull(backends[i]);
+    }
+
+    for (size_t i = 0; i < 3; i++)
+        rbh_backend_pool_checkin(pool, backends[i]);
+    ck_assert_uint_eq(rbh_backend_pool_evict(pool, 0), 1);
+
+    rbh_backend_pool_destroy(pool);
+}
+END_TEST
+
+START_TEST(rbpc_branch)
+{
+    char branch_uri[sizeof(uri) + sizeof("#branch")];
+    struct rbh_backend *branches[2];
+    struct rbh_backend_pool *pool;
+
+    sprintf(branch_uri, "%s#branch", uri);
+
+    pool = rbh_backend_pool_new(2, 0);
+    ck_assert_ptr_nonnull(pool);
+
+    branches[0] = rbh_backend_pool_checkout(pool, branch_uri);
+    ck_assert_ptr_nonnull(branches[0]);
+    branches[1] = rbh_backend_pool_checkout(pool, branch_uri);
+    ck_assert_ptr_nonnull(branches[1]);
+
+    rbh_backend_pool_checkin(pool, branches[0]);
+    rbh_backend_pool_checkin(pool, branches[1]);
+
+    /* Both branches, and the root they were branched from */
+    ck_assert_uint_eq(rbh_backend_pool_evict(pool, 0), 3);
+
+    rbh_backend_pool_destroy(pool);
+}
+END_TEST
+
+START_TEST(rbpc_invalid_uri)
+{
+    struct rbh_backend_pool *pool;
+
+    pool = rbh_backend_pool_new(1, 0);
+    ck_assert_ptr_nonnull(pool);
+
+    errno = 0;
+    ck_assert_ptr_null(rbh_backend_pool_checkout(pool, "not a uri"));
+    ck_assert_int_eq(errno, EINVAL);
+
+    rbh_backend_pool_destroy(pool);
+}
+END_TEST
+
+START_TEST(rbpc_missing_plugin)
+{
+    struct rbh_backend_pool *pool;
+
+    pool = rbh_backend_pool_new(1, 0);
+    ck_assert_ptr_nonnull(pool);
+
+    errno = 0;
+    ck_assert_ptr_null(rbh_backend_pool_checkout(pool, "rbh:missing:test"));
+    ck_assert_int_eq(errno, ENOENT);
+
+    rbh_backend_pool_destroy(pool);
+}
+END_TEST
+
+/*----------------------------------------------------------------------------*
+ |                          rbh_backend_pool_evict()                          |
+ *----------------------------------------------------------------------------*/
+
+START_TEST(rbpe_recent)
+{
+    struct rbh_backend_pool *pool;
+    struct rbh_backend *backend;
+
+    pool = rbh_backend_pool_new(1, 3600);
+    ck_assert_ptr_nonnull(pool);
+
+    backend = rbh_backend_pool_checkout(pool, uri);
+    ck_assert_ptr_nonnull(backend);
+    rbh_backend_pool_checkin(pool, backend);
+
+    ck_assert_uint_eq(rbh_backend_pool_evict(pool, 3600), 0);
+    ck_assert_uint_eq(rbh_backend_pool_evict(pool, 0), 1);
+
+    rbh_backend_pool_destroy(pool);
+}
+END_TEST
+
+static Suite *
+unit_suite(void)
+{
+    Suite *suite;
+    TCase *tests;
+
+    suite = suite_create("backend pool");
+    tests = tcase_create("rbh_backend_pool_checkout()");
+    tcase_add_unchecked_fixture(tests, unchecked_setup_tmpdir,
+                                unchecked_teardown_tmpdir);
+    tcase_add_test(tests, rbpc_reuse);
+    tcase_add_test(tests, rbpc_exclusive);
+    tcase_add_test(tests, rbpc_max_idle);
+    tcase_add_test(tests, rbpc_branch);
+    tcase_add_test(tests, rbpc_invalid_uri);
+    tcase_add_test(tests, rbpc_missing_plugin);
+
+    suite_add_tcase(suite, tests);
+
+    tests = tcase_create("rbh_backend_pool_evict()");
+    tcase_add_unchecked_fixture(tests, unchecked_setup_tmpdir,
+                                unchecked_teardown_tmpdir);
+    tcase_add_test(tests, rbpe_recent);
+
+    suite_add_tcase(suite, tests);
+
+    return suite;
+}
+
+int
+main(void)
+{
+    int number_failed;
+    Suite *suite;
+    SRunner *runner;
+
+    suite = unit_suite();
+    runner = srunner_create(suite);
+
+    srunner_run_all(runner, CK_NORMAL);
+    number_failed = srunner_ntests_failed(runner);
+    srunner_free(runner);
+
+    return (number_failed == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,595 @@
+/* This file is part of the RobinHood Library
+ * Copyright (C) 2022 Commissariat a l'energie atomique et aux energies
+ *                    alternatives
+ *
+ * SPDX-License-Identifer: LGPL-3.0-or-later
+ */
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "check-compat.h"
+#include "robinhood/backend_result_cache.h"
+#include "robinhood/fsevent.h"
+#include "robinhood/itertools.h"
+#include "robinhood/statx.h"
+
+#include "utils.h"
+
+/*----------------------------------------------------------------------------*
+ |                               count backend                                |
+ *----------------------------------------------------------------------------*/
+
+/* A backend that yields fsentries named "0", "1", ... up to the limit of a
+ * query (or COUNT), whatever the filter, and counts the queries it gets.
+ * Skipped fsentries are not yielded.
+ */
+
+#define COUNT 4
+
+struct count_backend {
+    struct rbh_backend backend;
+    size_t queries;
+};
+
+struct count_iterator {
+    struct rbh_mut_iterator iterator;
+    size_t index;
+    size_t count;
+};
+
+static void *
+count_iter_next(void *iterator)
+{
+    struct count_iterator *count = iterator;
+    struct rbh_fsentry *fsentry;
+    struct rbh_id id;
+    char name[16];
+
+    if (count->index == count->count) {
+        errno = ENODATA;
+        return NULL;
+    }
+
+    snprintf(name, sizeof(name), "%zu", count->index++);
+    id.data = name;
+    id.size = strlen(name);
+
+    fsentry = rbh_fsentry_new(&id, NULL, name, NULL, NULL, NULL, NULL);
+    ck_assert_ptr_nonnull(fsentry);
+    return fsentry;
+}
+
+static const struct rbh_mut_iterator_operations COUNT_ITER_OPS = {
+    .next = count_iter_next,
+    .destroy = free,
+};
+
+static struct rbh_mut_iterator *
+count_backend_filter(void *backend, const struct rbh_filter *filter,
+                     const struct rbh_filter_options *options)
+{
+    struct count_backend *count = backend;
+    struct count_iterator *count_iter;
+
+    count_iter = malloc(sizeof(*count_iter));
+    ck_assert_ptr_nonnull(count_iter);
+
+    count_iter->iterator.ops = &COUNT_ITER_OPS;
+    count_iter->count = options->limit ? options->limit : COUNT;
+    count_iter->index = options->skip < count_iter->count ?
+        options->skip : count_iter->count;
+
+    count->queries++;
+    return &count_iter->iterator;
+}
+
+static ssize_t
+count_backend_update(void *backend, struct rbh_iterator *fsevents)
+{
+    ssize_t count = 0;
+
+    while (rbh_iter_next(fsevents) != NULL)
+        count++;
+    ck_assert_int_eq(errno, ENODATA);
+
+    return count;
+}
+
+static int
+count_backend_set_option(void *backend, unsigned int option, const void *data,
+                         size_t data_size)
+{
+    return 0;
+}
+
+static const struct rbh_backend_operations COUNT_BACKEND_OPS = {
+    .set_option = count_backend_set_option,
+    .update = count_backend_update,
+    .filter = count_backend_filter,
+    .destroy = free,
+};
+
+static struct count_backend *count;
+
+static struct rbh_backend *
+result_cache_new(size_t max_size, unsigned int ttl)
+{
+    struct rbh_backend *cache;
+
+    count = malloc(sizeof(*count));
+    ck_assert_ptr_nonnull(count);
+
+    count->backend.id = UINT8_MAX;
+    count->backend.name = "count";
+    count->backend.ops = &COUNT_BACKEND_OPS;
+    count->queries = 0;
+
+    cache = rbh_backend_result_cache_new(&count->backend, max_size, ttl);
+    ck_assert_ptr_nonnull(cache);
+    return cache;
+}
+
+static struct rbh_backend_result_cache_stats
+result_cache_stats(struct rbh_backend *cache)
+{
+    struct rbh_backend_result_cache_stats stats;
+    size_t size = sizeof(stats);
+
+    ck_assert_int_eq(rbh_backend_get_option(cache, RBH_GBO_RESULT_CACHE_STATS,
+                                            &stats, &size), 0);
+    ck_assert_uint_eq(size, sizeof(stats));
+    return stats;
+}
+
+static const struct rbh_filter_options OPTIONS = {
+    .projection = {
+        .fsentry_mask = RBH_FP_ID | RBH_FP_NAME,
+    },
+};
+
+static struct rbh_filter
+name_filter(const char *name)
+{
+    const struct rbh_filter filter = {
+        .op = RBH_FOP_EQUAL,
+        .compare = {
+            .field = {
+                .fsentry = RBH_FP_NAME,
+            },
+            .value = {
+                .type = RBH_VT_STRING,
+                .string = name,
+            },
+        },
+    };
+
+    return filter;
+}
+
+/* Run a query to the end, and check the fsentries it yields */
+static void
+query(struct rbh_backend *cache, const struct rbh_filter *filter,
+      const struct rbh_filter_options *options)
+{
+    size_t expected = options->limit ? options->limit : COUNT;
+    struct rbh_mut_iterator *fsentries;
+    struct rbh_fsentry *fsentry;
+    size_t index = 0;
+
+    fsentries = rbh_backend_filter(cache, filter, options);
+    ck_assert_ptr_nonnull(fsentries);
+
+    while ((fsentry = rbh_mut_iter_next(fsentries)) != NULL) {
+        char name[16];
+
+        snprintf(name, sizeof(name), "%zu", index++);
+        ck_assert_str_eq(fsentry->name, name);
+        free(fsentry);
+    }
+    ck_assert_int_eq(errno, ENODATA);
+    ck_assert_uint_eq(index, expected);
+
+    rbh_mut_iter_destroy(fsentries);
+}
+
+static void
+update(struct rbh_backend *cache)
+{
+    const struct rbh_id ID = {
+        .data = "0",
+        .size = 1,
+    };
+    const struct rbh_fsevent FSEVENTS[] = {
+        {
+            .type = RBH_FET_DELETE,
+            .id = ID,
+        },
+    };
+    struct rbh_iterator *fsevents;
+
+    fsevents = rbh_iter_array(FSEVENTS, sizeof(*FSEVENTS),
+                              ARRAY_SIZE(FSEVENTS));
+    ck_assert_ptr_nonnull(fsevents);
+    ck_assert_int_eq(rbh_backend_update(cache, fsevents), 1);
+    rbh_iter_destroy(fsevents);
+}
+
+/*----------------------------------------------------------------------------*
+ |                       rbh_backend_result_cache_new()                       |
+ *----------------------------------------------------------------------------*/
+
+START_TEST(rbrcn_no_size)
+{
+    struct rbh_backend backend = {
+        .id = UINT8_MAX,
+        .ops = &COUNT_BACKEND_OPS,
+    };
+
+    errno = 0;
+    ck_assert_ptr_null(rbh_backend_result_cache_new(&backend, 0, 0));
+    ck_assert_int_eq(errno, EINVAL);
+}
+END_TEST
+
+START_TEST(rbrcn_hit)
+{
+    struct rbh_backend *cache = result_cache_new(1 << 20, 0);
+    const struct rbh_filter filter = name_filter("a");
+    struct rbh_backend_result_cache_stats stats;
+    struct rbh_filter copy;
+
+    for (size_t i = 0; i < 3; i++)
+        query(cache, &filter, &OPTIONS);
+    ck_assert_uint_eq(count->queries, 1);
+
+    /* Equal filters need not be the same object */
+    copy = name_filter("a");
+    query(cache, &copy, &OPTIONS);
+    ck_assert_uint_eq(count->queries, 1);
+
+    stats = result_cache_stats(cache);
+    ck_assert_uint_eq(stats.count, 1);
+    ck_assert_uint_gt(stats.size, 0);
+    ck_assert_uint_eq(stats.max_size, 1 << 20);
+    ck_assert_uint_eq(stats.hits, 3);
+    ck_assert_uint_eq(stats.misses, 1);
+
+    rbh_backend_destroy(cache);
+}
+END_TEST
+
+START_TEST(rbrcn_key)
+{
+    const struct rbh_filter_sort SORT = {
+        .field = {
+            .fsentry = RBH_FP_NAME,
+        },
+        .ascending = true,
+    };
+    struct rbh_backend *cache = result_cache_new(1 << 20, 0);
+    const struct rbh_filter a = name_filter("a");
+    const struct rbh_filter b = name_filter("b");
+    struct rbh_filter_options options = OPTIONS;
+
+    query(cache, NULL, &options);
+    query(cache, &a, &options);
+    query(cache, &b, &options);
+    ck_assert_uint_eq(count->queries, 3);
+
+    options.limit = 2;
+    query(cache, &a, &options);
+    ck_assert_uint_eq(count->queries, 4);
+
+    options.projection.fsentry_mask |= RBH_FP_PARENT_ID;
+    query(cache, &a, &options);
+    ck_assert_uint_eq(count->queries, 5);
+
+    options.sort.items = &SORT;
+    options.sort.count = 1;
+    query(cache, &a, &options);
+    ck_assert_uint_eq(count->queries, 6);
+
+    /* The statx mask is irrelevant when statx attributes are not projected */
+    options.projection.statx_mask = RBH_STATX_ALL;
+    query(cache, &a, &options);
+    ck_assert_uint_eq(count->queries, 6);
+
+    ck_assert_uint_eq(result_cache_stats(cache).count, 6);
+    rbh_backend_destroy(cache);
+}
+END_TEST
+
+START_TEST(rbrcn_partial)
+{
+    struct rbh_backend *cache = result_cache_new(1 << 20, 0);
+    const struct rbh_filter filter = name_filter("a");
+    struct rbh_mut_iterator *fsentries;
+
+    /* Queries are only cached once they were iterated over in full */
+    fsentries = rbh_backend_filter(cache, &filter, &OPTIONS);
+    ck_assert_ptr_nonnull(fsentries);
+    free(rbh_mut_iter_next(fsentries));
+    rbh_mut_iter_destroy(fsentries);
+    ck_assert_uint_eq(result_cache_stats(cache).count, 0);
+
+    query(cache, &filter, &OPTIONS);
+    ck_assert_uint_eq(count->queries, 2);
+    ck_assert_uint_eq(result_cache_stats(cache).count, 1);
+
+    rbh_backend_destroy(cache);
+}
+END_TEST
+
+START_TEST(rbrcn_sample)
+{
+    struct rbh_backend *cache = result_cache_new(1 << 20, 0);
+    struct rbh_filter_options options = OPTIONS;
+
+    options.sample.size = COUNT;
+    query(cache, NULL, &options);
+    query(cache, NULL, &options);
+    ck_assert_uint_eq(count->queries, 2);
+    ck_assert_uint_eq(result_cache_stats(cache).count, 0);
+
+    rbh_backend_destroy(cache);
+}
+END_TEST
+
+START_TEST(rbrcn_update)
+{
+    struct rbh_backend *cache = result_cache_new(1 << 20, 0);
+    const struct rbh_filter filter = name_filter("a");
+    struct rbh_backend_result_cache_stats stats;
+    struct rbh_mut_iterator *fsentries;
+
+    query(cache, &filter, &OPTIONS);
+    update(cache);
+
+    stats = result_cache_stats(cache);
+    ck_assert_uint_eq(stats.count, 0);
+    ck_assert_uint_eq(stats.size, 0);
+    ck_assert_uint_eq(stats.invalidations, 1);
+
+    /* Queries that were in flight during an update are not cached */
+    fsentries = rbh_backend_filter(cache, &filter, &OPTIONS);
+    ck_assert_ptr_nonnull(fsentries);
+    update(cache);
+    for (size_t i = 0; i < COUNT; i++)
+        free(rbh_mut_iter_next(fsentries));
+    ck_assert_ptr_null(rbh_mut_iter_next(fsentries));
+    ck_assert_int_eq(errno, ENODATA);
+    rbh_mut_iter_destroy(fsentries);
+    ck_assert_uint_eq(result_cache_stats(cache).count, 0);
+
+    query(cache, &filter, &OPTIONS);
+    ck_assert_uint_eq(count->queries, 3);
+
+    rbh_backend_destroy(cache);
+}
+END_TEST
+
+START_TEST(rbrcn_replay)
+{
+    struct rbh_backend *cache = result_cache_new(1 << 20, 0);
+    const struct rbh_filter filter = name_filter("a");
+    struct rbh_mut_iterator *fsentries;
+    struct rbh_fsentry *fsentry;
+
+    query(cache, &filter, &OPTIONS);
+
+    /* Replays survive the invalidation of the results they serve */
+    fsentries = rbh_backend_filter(cache, &filter, &OPTIONS);
+    ck_assert_ptr_nonnull(fsentries);
+    update(cache);
+
+    for (size_t i = 0; i < COUNT; i++) {
+        char name[16];
+
+        fsentry = rbh_mut_iter_next(fsentries);
+        ck_assert_ptr_nonnull(fsentry);
+        snprintf(name, sizeof(name), "%zu", i);
+        ck_assert_str_eq(fsentry->name, name);
+        free(fsentry);
+    }
+    ck_assert_ptr_null(rbh_mut_iter_next(fsentries));
+    ck_assert_int_eq(errno, ENODATA);
+    rbh_mut_iter_destroy(fsentries);
+
+    ck_assert_uint_eq(count->queries, 1);
+    rbh_backend_destroy(cache);
+}
+END_TEST
+
+START_TEST(rbrcn_record_outlives_backend)
+{
+    struct rbh_backend *cache = result_cache_new(1 << 20, 0);
+    const struct rbh_filter filter = name_filter("a");
+    struct rbh_mut_iterator *fsentries;
+    struct rbh_fsentry *fsentry;
+    size_t index = 0;
+
+    /* Misses are recorded, and committed once they are exhausted */
+    fsentries = rbh_backend_filter(cache, &filter, &OPTIONS);
+    ck_assert_ptr_nonnull(fsentries);
+    rbh_backend_destroy(cache);
+
+    while ((fsentry = rbh_mut_iter_next(fsentries)) != NULL) {
+        char name[16];
+
+        snprintf(name, sizeof(name), "%zu", index++);
+        ck_assert_str_eq(fsentry->name, name);
+        free(fsentry);
+    }
+    ck_assert_int_eq(errno, ENODATA);
+    ck_assert_uint_eq(index, COUNT);
+
+    rbh_mut_iter_destroy(fsentries);
+}
+END_TEST
+
+START_TEST(rbrcn_ttl)
+{
+    struct rbh_backend *cache = result_cache_new(1 << 20, 1);
+    const struct rbh_filter filter = name_filter("a");
+    struct rbh_backend_result_cache_stats stats;
+
+    query(cache, &filter, &OPTIONS);
+    query(cache, &filter, &OPTIONS);
+    ck_assert_uint_eq(count->queries, 1);
+
+    usleep(1100000);
+
+    query(cache, &filter, &OPTIONS);
+    ck_assert_uint_eq(count->queries, 2);
+
+    stats = result_cache_stats(cache);
+    ck_assert_uint_eq(stats.count, 1);
+    ck_assert_uint_eq(stats.expirations, 1);
+
+    rbh_backend_destroy(cache);
+}
+END_TEST
+
+START_TEST(rbrcn_max_size)
+{
+    const struct rbh_filter_options SKIP_ALL = {
+        .skip = COUNT,
+    };
+    struct rbh_backend *cache = result_cache_new(1 << 20, 0);
+    const struct rbh_filter a = name_filter("a");
+    const struct rbh_filter b = name_filter("b");
+    struct rbh_backend_result_cache_stats stats;
+    struct rbh_mut_iterator *fsentries;
+    struct rbh_filter large;
+    size_t size;
+    char *name;
+
+    query(cache, &a, &OPTIONS);
+    size = result_cache_stats(cache).size;
+    rbh_backend_destroy(cache);
+
+    /* Results too big for the cache are not cached */
+    cache = result_cache_new(size - 1, 0);
+    query(cache, &a, &OPTIONS);
+    ck_assert_uint_eq(result_cache_stats(cache).count, 0);
+    rbh_backend_destroy(cache);
+
+    /* The least recently used results make room for the others */
+    cache = result_cache_new(size + size / 2, 0);
+    query(cache, &a, &OPTIONS);
+    query(cache, &b, &OPTIONS);
+
+    stats = result_cache_stats(cache);
+    ck_assert_uint_eq(stats.count, 1);
+    ck_assert_uint_eq(stats.size, size);
+    ck_assert_uint_eq(stats.evictions, 1);
+
+    query(cache, &b, &OPTIONS);
+    ck_assert_uint_eq(count->queries, 2);
+    query(cache, &a, &OPTIONS);
+    ck_assert_uint_eq(count->queries, 3);
+
+    /* Keys count too: even empty results may not fit */
+    name = malloc(size + size / 2);
+    ck_assert_ptr_nonnull(name);
+    memset(name, 'a', size + size / 2 - 1);
+    name[size + size / 2 - 1] = '\0';
+    large = name_filter(name);
+
+    fsentries = rbh_backend_filter(cache, &large, &SKIP_ALL);
+    ck_assert_ptr_nonnull(fsentries);
+    errno = 0;
+    ck_assert_ptr_null(rbh_mut_iter_next(fsentries));
+    ck_assert_int_eq(errno, ENODATA);
+    rbh_mut_iter_destroy(fsentries);
+    free(name);
+
+    stats = result_cache_stats(cache);
+    ck_assert_uint_eq(stats.count, 1);
+    ck_assert_uint_eq(stats.evictions, 2);
+    query(cache, &a, &OPTIONS);
+    ck_assert_uint_eq(count->queries, 4);
+
+    rbh_backend_destroy(cache);
+}
+END_TEST
+
+START_TEST(rbrcn_options)
+{
+    struct rbh_backend *cache = result_cache_new(1 << 20, 0);
+    struct rbh_backend_result_cache_stats stats;
+    size_t size = 0;
+    int value = 0;
+
+    errno = 0;
+    ck_assert_int_eq(rbh_backend_get_option(cache, RBH_GBO_RESULT_CACHE_STATS,
+                                            &stats, &size), -1);
+    ck_assert_int_eq(errno, EOVERFLOW);
+    ck_assert_uint_eq(size, sizeof(stats));
+
+    errno = 0;
+    ck_assert_int_eq(rbh_backend_set_option(cache, RBH_GBO_RESULT_CACHE_STATS,
+                                            &stats, sizeof(stats)), -1);
+    ck_assert_int_eq(errno, ENOTSUP);
+
+    query(cache, NULL, &OPTIONS);
+
+    /* Options of the wrapped backend go through, and flush the cache */
+    ck_assert_int_eq(rbh_backend_set_option(cache, RBH_BO_FIRST(UINT8_MAX),
+                                            &value, sizeof(value)), 0);
+    ck_assert_uint_eq(result_cache_stats(cache).count, 0);
+
+    rbh_backend_destroy(cache);
+}
+END_TEST
+
+static Suite *
+unit_suite(void)
+{
+    Suite *suite;
+    TCase *tests;
+
+    suite = suite_create("backend result cache");
+
+    tests = tcase_create("rbh_backend_result_cache_new");
+    tcase_add_test(tests, rbrcn_no_size);
+    tcase_add_test(tests, rbrcn_hit);
+    tcase_add_test(tests, rbrcn_key);
+    tcase_add_test(tests, rbrcn_partial);
+    tcase_add_test(tests, rbrcn_sample);
+    tcase_add_test(tests, rbrcn_update);
+    tcase_add_test(tests, rbrcn_replay);
+    tcase_add_test(tests, rbrcn_record_outlives_backend);
+    tcase_add_test(tests, rbrcn_ttl);
+    tcase_add_test(tests, rbrcn_max_size);
+    tcase_add_test(tests, rbrcn_options);
+
+    suite_add_tcase(suite, tests);
+
+    return suite;
+}
+
+int
+main(void)
+{
+    int number_failed;
+    Suite *suite;
+    SRunner *runner;
+
+    suite = unit_suite();
+    runner = srunner_create(suite);
+
+    srunner_run_all(runner, CK_NORMAL);
+    number_failed = srunner_ntests_failed(runner);
+    srunner_free(runner);
+
+    return (number_failed == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,414 @@
+/* This file is part of the RobinHood Library
+ * Copyright (C) 2022 Commissariat a l'energie atomique et aux energies
+ *                    alternatives
+ *
+ * SPDX-License-Identifer: LGPL-3.0-or-later
+ */
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "check-compat.h"
+#include "robinhood/backend_tee.h"
+#include "robinhood/fsevent.h"
+#include "robinhood/itertools.h"
+
+#include "utils.h"
+
+/*----------------------------------------------------------------------------*
+ |                                log backend                                 |
+ *----------------------------------------------------------------------------*/
+
+/* A backend that checks it is updated with FSEVENTS, in order, and counts the
+ * fsevents and the queries it gets
+ */
+
+#define FSEVENT_COUNT 256
+
+static size_t INDICES[FSEVENT_COUNT];
+static struct rbh_fsevent FSEVENTS[FSEVENT_COUNT];
+
+static void
+fsevents_init(void)
+{
+    for (size_t i = 0; i < FSEVENT_COUNT; i++) {
+        INDICES[i] = i;
+        FSEVENTS[i].type = RBH_FET_DELETE;
+        FSEVENTS[i].id.data = (const char *)&INDICES[i];
+        FSEVENTS[i].id.size = sizeof(INDICES[i]);
+    }
+}
+
+struct log_backend {
+    struct rbh_backend backend;
+    size_t updated;
+    size_t queries;
+    size_t options;
+
+    /* Fail with `errnum' after that many fsevents (if `errnum' is not 0) */
+    size_t fail_after;
+    int errnum;
+    /* The message to report when `errnum' is RBH_BACKEND_ERROR */
+    const char *error;
+    /* How long to take to apply each fsevent (in microseconds) */
+    useconds_t delay;
+};
+
+static ssize_t
+log_backend_update(void *backend, struct rbh_iterator *fsevents)
+{
+    struct log_backend *log = backend;
+    const struct rbh_fsevent *fsevent;
+    ssize_t count = 0;
+
+    while ((fsevent = rbh_iter_next(fsevents)) != NULL) {
+        ck_assert_uint_eq(fsevent->id.size, sizeof(size_t));
+        ck_assert_mem_eq(fsevent->id.data, &INDICES[log->updated],
+                         sizeof(size_t));
+
+        if (log->errnum && log->updated == log->fail_after) {
+            if (log->errnum == RBH_BACKEND_ERROR)
+                snprintf(rbh_backend_error, sizeof(rbh_backend_error), "%s",
+                         log->error);
+            errno = log->errnum;
+            return -1;
+        }
+
+        if (log->delay)
+            usleep(log->delay);
+        log->updated++;
+        count++;
+    }
+    ck_assert_int_eq(errno, ENODATA);
+
+    return count;
+}
+
+static struct rbh_mut_iterator *
+log_backend_filter(void *backend, const struct rbh_filter *filter,
+                   const struct rbh_filter_options *options)
+{
+    struct log_backend *log = backend;
+
+    log->queries++;
+    return rbh_mut_iter_array(NULL, 0, 0);
+}
+
+static int
+log_backend_set_option(void *backend, unsigned int option, const void *data,
+                       size_t data_size)
+{
+    struct log_backend *log = backend;
+
+    log->options++;
+    return 0;
+}
+
+static struct rbh_backend *
+log_backend_clone(void *backend);
+
+static const struct rbh_backend_operations LOG_BACKEND_OPS = {
+    .set_option = log_backend_set_option,
+    .update = log_backend_update,
+    .clone = log_backend_clone,
+    .filter = log_backend_filter,
+    .destroy = free,
+};
+
+static struct log_backend *
+log_backend_new(void)
+{
+    struct log_backend *log;
+
+    log = calloc(1, sizeof(*log));
+    ck_assert_ptr_nonnull(log);
+
+    log->backend.id = UINT8_MAX;
+    log->backend.name = "log";
+    log->backend.ops = &LOG_BACKEND_OPS;
+    return log;
+}
+
+static struct rbh_backend *
+log_backend_clone(void *backend)
+{
+    return &log_backend_new()->backend;
+}
+
+#define LOG_COUNT 3
+
+static struct log_backend *logs[LOG_COUNT];
+
+static struct rbh_backend *
+tee_new(size_t buffer)
+{
+    struct rbh_backend *backends[LOG_COUNT];
+    struct rbh_backend *tee;
+
+    fsevents_init();
+    for (size_t i = 0; i < LOG_COUNT; i++) {
+        logs[i] = log_backend_new();
+        backends[i] = &logs[i]->backend;
+    }
+
+    tee = rbh_backend_tee_new(backends, LOG_COUNT, buffer);
+    ck_assert_ptr_nonnull(tee);
+    return tee;
+}
+
+static void
+tee_stats(struct rbh_backend *tee, struct rbh_backend_tee_stats *stats)
+{
+    size_t size = LOG_COUNT * sizeof(*stats);
+
+    ck_assert_int_eq(rbh_backend_get_option(tee, RBH_GBO_TEE_STATS, stats,
+                                            &size), 0);
+    ck_assert_uint_eq(size, LOG_COUNT * sizeof(*stats));
+}
+
+static ssize_t
+update(struct rbh_backend *tee)
+{
+    struct rbh_iterator *fsevents;
+    ssize_t count;
+    int save_errno;
+
+    fsevents = rbh_iter_array(FSEVENTS, sizeof(*FSEVENTS), FSEVENT_COUNT);
+    ck_assert_ptr_nonnull(fsevents);
+
+    count = rbh_backend_update(tee, fsevents);
+    save_errno = errno;
+    rbh_iter_destroy(fsevents);
+    errno = save_errno;
+
+    return count;
+}
+
+/*----------------------------------------------------------------------------*
+ |                           rbh_backend_tee_new()                            |
+ *----------------------------------------------------------------------------*/
+
+START_TEST(rbtn_invalid)
+{
+    struct rbh_backend backend = {
+        .id = UINT8_MAX,
+        .ops = &LOG_BACKEND_OPS,
+    };
+    struct rbh_backend *backends[] = { &backend };
+
+    errno = 0;
+    ck_assert_ptr_null(rbh_backend_tee_new(backends, 0, 1));
+    ck_assert_int_eq(errno, EINVAL);
+
+    errno = 0;
+    ck_assert_ptr_null(rbh_backend_tee_new(backends, 1, 0));
+    ck_assert_int_eq(errno, EINVAL);
+}
+END_TEST
+
+START_TEST(rbtn_update)
+{
+    struct rbh_backend_tee_stats stats[LOG_COUNT];
+    struct rbh_backend *tee = tee_new(16);
+
+    ck_assert_int_eq(update(tee), FSEVENT_COUNT);
+    for (size_t i = 0; i < LOG_COUNT; i++)
+        ck_assert_uint_eq(logs[i]->updated, FSEVENT_COUNT);
+
+    tee_stats(tee, stats);
+    for (size_t i = 0; i < LOG_COUNT; i++) {
+        ck_assert_uint_eq(stats[i].updated, FSEVENT_COUNT);
+        ck_assert_uint_eq(stats[i].lag, 0);
+        ck_assert_uint_eq(stats[i].failures, 0);
+    }
+
+    rbh_backend_destroy(tee);
+}
+END_TEST
+
+START_TEST(rbtn_lag)
+{
+    struct rbh_backend_tee_stats stats[LOG_COUNT];
+    struct rbh_backend *tee = tee_new(16);
+
+    /* The other backends are not held back by a slow one... */
+    logs[2]->delay = 100;
+    ck_assert_int_eq(update(tee), FSEVENT_COUNT);
+    ck_assert_uint_eq(logs[2]->updated, FSEVENT_COUNT);
+
+    /* ... until its buffer is full */
+    tee_stats(tee, stats);
+    ck_assert_uint_gt(stats[2].max_lag, 0);
+    ck_assert_uint_lt(stats[2].max_lag, FSEVENT_COUNT);
+    ck_assert_uint_eq(stats[2].lag, 0);
+
+    rbh_backend_destroy(tee);
+}
+END_TEST
+
+START_TEST(rbtn_failure)
+{
+    struct rbh_backend_tee_stats stats[LOG_COUNT];
+    struct rbh_backend *tee = tee_new(16);
+
+    logs[1]->errnum = ENOSPC;
+    logs[1]->fail_after = 10;
+
+    errno = 0;
+    ck_assert_int_eq(update(tee), -1);
+    ck_assert_int_eq(errno, ENOSPC);
+
+    /* The others still receive every fsevent */
+    ck_assert_uint_eq(logs[0]->updated, FSEVENT_COUNT);
+    ck_assert_uint_eq(logs[1]->updated, 10);
+    ck_assert_uint_eq(logs[2]->updated, FSEVENT_COUNT);
+
+    tee_stats(tee, stats);
+    ck_assert_uint_eq(stats[0].failures, 0);
+    ck_assert_uint_eq(stats[1].failures, 1);
+    ck_assert_uint_eq(stats[1].updated, 0);
+    ck_assert_uint_eq(stats[1].lag, 0);
+
+    /* The primary's errors come first */
+    logs[0]->errnum = EIO;
+    logs[0]->fail_after = 0;
+    for (size_t i = 0; i < LOG_COUNT; i++)
+        logs[i]->updated = 0;
+
+    errno = 0;
+    ck_assert_int_eq(update(tee), -1);
+    ck_assert_int_eq(errno, EIO);
+
+    rbh_backend_destroy(tee);
+}
+END_TEST
+
+START_TEST(rbtn_backend_error)
+{
+    struct rbh_backend *tee = tee_new(16);
+
+    logs[1]->errnum = RBH_BACKEND_ERROR;
+    logs[1]->error = "log: out of fsevents";
+    logs[1]->fail_after = 10;
+
+    rbh_backend_error[0] = '\0';
+    errno = 0;
+    ck_assert_int_eq(update(tee), -1);
+    ck_assert_int_eq(errno, RBH_BACKEND_ERROR);
+    ck_assert_str_eq(rbh_backend_error, "log: out of fsevents");
+
+    rbh_backend_destroy(tee);
+}
+END_TEST
+
+START_TEST(rbtn_primary)
+{
+    const struct rbh_filter_options OPTIONS = { 0 };
+    struct rbh_backend *tee = tee_new(16);
+    struct rbh_mut_iterator *fsentries;
+    int value = 0;
+
+    fsentries = rbh_backend_filter(tee, NULL, &OPTIONS);
+    ck_assert_ptr_nonnull(fsentries);
+    rbh_mut_iter_destroy(fsentries);
+
+    ck_assert_int_eq(rbh_backend_set_option(tee, RBH_BO_FIRST(UINT8_MAX),
+                                            &value, sizeof(value)), 0);
+
+    ck_assert_uint_eq(logs[0]->queries, 1);
+    ck_assert_uint_eq(logs[0]->options, 1);
+    for (size_t i = 1; i < LOG_COUNT; i++) {
+        ck_assert_uint_eq(logs[i]->queries, 0);
+        ck_assert_uint_eq(logs[i]->options, 0);
+    }
+
+    rbh_backend_destroy(tee);
+}
+END_TEST
+
+START_TEST(rbtn_clone)
+{
+    struct rbh_backend_tee_stats stats[LOG_COUNT];
+    struct rbh_backend *tee = tee_new(16);
+    struct rbh_backend *clone;
+
+    clone = rbh_backend_clone(tee);
+    ck_assert_ptr_nonnull(clone);
+
+    ck_assert_int_eq(update(clone), FSEVENT_COUNT);
+    tee_stats(clone, stats);
+    for (size_t i = 0; i < LOG_COUNT; i++)
+        ck_assert_uint_eq(stats[i].updated, FSEVENT_COUNT);
+
+    rbh_backend_destroy(clone);
+    rbh_backend_destroy(tee);
+}
+END_TEST
+
+START_TEST(rbtn_options)
+{
+    struct rbh_backend_tee_stats stats[LOG_COUNT];
+    struct rbh_backend *tee = tee_new(16);
+    size_t size = sizeof(*stats);
+
+    errno = 0;
+    ck_assert_int_eq(rbh_backend_get_option(tee, RBH_GBO_TEE_STATS, stats,
+                                            &size), -1);
+    ck_assert_int_eq(errno, EOVERFLOW);
+    ck_assert_uint_eq(size, sizeof(stats));
+
+    errno = 0;
+    ck_assert_int_eq(rbh_backend_set_option(tee, RBH_GBO_TEE_STATS, stats,
+                                            sizeof(stats)), -1);
+    ck_assert_int_eq(errno, ENOTSUP);
+
+    rbh_backend_destroy(tee);
+}
+END_TEST
+
+static Suite *
+unit_suite(void)
+{
+    Suite *suite;
+    TCase *tests;
+
+    suite = suite_create("backend tee");
+
+    tests = tcase_create("rbh_backend_tee_new");
+    tcase_add_test(tests, rbtn_invalid);
+    tcase_add_test(tests, rbtn_update);
+    tcase_add_test(tests, rbtn_lag);
+    tcase_add_test(tests, rbtn_failure);
+    tcase_add_test(tests, rbtn_backend_error);
+    tcase_add_test(tests, rbtn_primary);
+    tcase_add_test(tests, rbtn_clone);
+    tcase_add_test(tests, rbtn_options);
+
+    suite_add_tcase(suite, tests);
+
+    return suite;
+}
+
+int
+main(void)
+{
+    int number_failed;
+    Suite *suite;
+    SRunner *runner;
+
+    suite = unit_suite();
+    runner = srunner_create(suite);
+
+    srunner_run_all(runner, CK_NORMAL);
+    number_failed = srunner_ntests_failed(runner);
+    srunner_free(runner);
+
+    return (number_failed == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,355 @@
+/* This file is part of the RobinHood Library
+ * Copyright (C) 2022 Commissariat a l'energie atomique et aux energies
+ *                    alternatives
+ *
+ * SPDX-License-Identifer: LGPL-3.0-or-later
+ */
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <errno.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "robinhood/broadcast.h"
+
+#include "check-compat.h"
+
+static void
+get_page_size(void) __attribute__((constructor));
+
+static long page_size;
+static void
+get_page_size(void)
+{
+    page_size = sysconf(_SC_PAGESIZE);
+}
+
+/*----------------------------------------------------------------------------*
+ |                                 unit tests                                 |
+ *----------------------------------------------------------------------------*/
+
+START_TEST(rbn_no_reader)
+{
+    errno = 0;
+    ck_assert_ptr_null(rbh_broadcast_new(page_size, 0));
+    ck_assert_int_eq(errno, EINVAL);
+}
+END_TEST
+
+START_TEST(rbr_too_big)
+{
+    struct rbh_broadcast *broadcast;
+
+    broadcast = rbh_broadcast_new(page_size, 1);
+    ck_assert_ptr_nonnull(broadcast);
+
+    errno = 0;
+    ck_assert_ptr_null(rbh_broadcast_reserve(broadcast, page_size + 1));
+    ck_assert_int_eq(errno, EINVAL);
+
+    rbh_broadcast_destroy(broadcast);
+}
+END_TEST
+
+START_TEST(rbc_too_big)
+{
+    struct rbh_broadcast *broadcast;
+
+    broadcast = rbh_broadcast_new(page_size, 1);
+    ck_assert_ptr_nonnull(broadcast);
+
+    errno = 0;
+    ck_assert_int_eq(rbh_broadcast_commit(broadcast, page_size + 1), -1);
+    ck_assert_int_eq(errno, EINVAL);
+
+    rbh_broadcast_destroy(broadcast);
+}
+END_TEST
+
+START_TEST(rba_too_many)
+{
+    struct rbh_broadcast *broadcast;
+
+    broadcast = rbh_broadcast_new(page_size, 2);
+    ck_assert_ptr_nonnull(broadcast);
+
+    ck_assert_ptr_nonnull(rbh_broadcast_push(broadcast, "abc", 3));
+
+    errno = 0;
+    ck_assert_int_eq(rbh_broadcast_ack(broadcast, 1, 4), -1);
+    ck_assert_int_eq(errno, EINVAL);
+
+    rbh_broadcast_destroy(broadcast);
+}
+END_TEST
+
+START_TEST(rb_readers)
+{
+    struct rbh_broadcast *broadcast;
+    size_t readable;
+    char *data;
+
+    broadcast = rbh_broadcast_new(page_size, 2);
+    ck_assert_ptr_nonnull(broadcast);
+
+    ck_assert_ptr_nonnull(rbh_broadcast_push(broadcast, "abcdef", 6));
+
+    /* Readers do not interfere with one another */
+    data = rbh_broadcast_peek(broadcast, 0, &readable);
+    ck_assert_uint_eq(readable, 6);
+    ck_assert_mem_eq(data, "abcdef", 6);
+    ck_assert_int_eq(rbh_broadcast_ack(broadcast, 0, 4), 0);
+
+    data = rbh_broadcast_peek(broadcast, 0, &readable);
+    ck_assert_uint_eq(readable, 2);
+    ck_assert_mem_eq(data, "ef", 2);
+
+    data = rbh_broadcast_peek(broadcast, 1, &readable);
+    ck_assert_uint_eq(readable, 6);
+    ck_assert_mem_eq(data, "abcdef", 6);
+
+    rbh_broadcast_destroy(broadcast);
+}
+END_TEST
+
+START_TEST(rb_slowest_reader)
+{
+    struct rbh_broadcast *broadcast;
+    size_t readable;
+    char *buffer;
+
+    broadcast = rbh_broadcast_new(page_size, 2);
+    ck_assert_ptr_nonnull(broadcast);
+
+    buffer = malloc(page_size);
+    ck_assert_ptr_nonnull(buffer);
+    memset(buffer, 'x', page_size);
+
+    ck_assert_ptr_nonnull(rbh_broadcast_push(broadcast, buffer, page_size));
+
+    errno = 0;
+    ck_assert_ptr_null(rbh_broadcast_push(broadcast, "a", 1));
+    ck_assert_int_eq(errno, ENOBUFS);
+
+    /* Space is only released once every reader is done with it... */
+    ck_assert_int_eq(rbh_broadcast_ack(broadcast, 0, page_size), 0);
+    errno = 0;
+    ck_assert_ptr_null(rbh_broadcast_push(broadcast, "a", 1));
+    ck_assert_int_eq(errno, ENOBUFS);
+
+    /* ... one segment at a time */
+    ck_assert_int_eq(rbh_broadcast_ack(broadcast, 1, 1), 0);
+    errno = 0;
+    ck_assert_ptr_null(rbh_broadcast_push(broadcast, "a", 1));
+    ck_assert_int_eq(errno, ENOBUFS);
+
+    ck_assert_int_eq(rbh_broadcast_ack(broadcast, 1, page_size - 1), 0);
+    ck_assert_ptr_nonnull(rbh_broadcast_push(broadcast, buffer, page_size));
+
+    rbh_broadcast_peek(broadcast, 0, &readable);
+    ck_assert_uint_eq(readable, page_size);
+    rbh_broadcast_peek(broadcast, 1, &readable);
+    ck_assert_uint_eq(readable, page_size);
+
+    free(buffer);
+    rbh_broadcast_destroy(broadcast);
+}
+END_TEST
+
+static Suite *
+unit_suite(void)
+{
+    Suite *suite;
+    TCase *tests;
+
+    suite = suite_create("unit tests");
+
+    tests = tcase_create("rbh_broadcast_new");
+    tcase_add_test(tests, rbn_no_reader);
+
+    suite_add_tcase(suite, tests);
+
+    tests = tcase_create("rbh_broadcast_reserve");
+    tcase_add_test(tests, rbr_too_big);
+
+    suite_add_tcase(suite, tests);
+
+    tests = tcase_create("rbh_broadcast_commit");
+    tcase_add_test(tests, rbc_too_big);
+
+    suite_add_tcase(suite, tests);
+
+    tests = tcase_create("rbh_broadcast_ack");
+    tcase_add_test(tests, rba_too_many);
+
+    suite_add_tcase(suite, tests);
+
+    tests = tcase_create("rbh_broadcast");
+    tcase_add_test(tests, rb_readers);
+    tcase_add_test(tests, rb_slowest_reader);
+
+    suite_add_tcase(suite, tests);
+
+    return suite;
+}
+
+/*----------------------------------------------------------------------------*
+ |                             integration tests                              |
+ *----------------------------------------------------------------------------*/
+
+#define READERS 4
+#define VALUES (1 << 20)
+
+static struct rbh_broadcast *broadcast;
+
+static void *
+read_values(void *arg)
+{
+    unsigned int reader = (uintptr_t)arg;
+    uint64_t expected = 0;
+
+    while (expected < VALUES) {
+        size_t readable;
+        uint64_t *values;
+
+        values = rbh_broadcast_peek(broadcast, reader, &readable);
+        if (readable == 0) {
+            sched_yield();
+            continue;
+        }
+
+        /* Readers go at different paces */
+        if (readable > (reader + 1) * sizeof(*values))
+            readable = (reader + 1) * sizeof(*values);
+
+        for (size_t i = 0; i < readable / sizeof(*values); i++)
+            ck_assert_uint_eq(values[i], expected++);
+        ck_assert_int_eq(rbh_broadcast_ack(broadcast, reader, readable), 0);
+    }
+
+    return NULL;
+}
+
+START_TEST(fan_out)
+{
+    pthread_t readers[READERS];
+
+    broadcast = rbh_broadcast_new(page_size, READERS);
+    ck_assert_ptr_nonnull(broadcast);
+
+    for (uintptr_t i = 0; i < READERS; i++)
+        ck_assert_int_eq(pthread_create(&readers[i], NULL, read_values,
+                                        (void *)i), 0);
+
+    for (uint64_t value = 0; value < VALUES; value++) {
+        while (rbh_broadcast_push(broadcast, &value, sizeof(value)) == NULL) {
+            ck_assert_int_eq(errno, ENOBUFS);
+            sched_yield();
+        }
+    }
+
+    for (size_t i = 0; i < READERS; i++)
+        ck_assert_int_eq(pthread_join(readers[i], NULL), 0);
+
+    rbh_broadcast_destroy(broadcast);
+}
+END_TEST
+
+/* Many readers that acknowledge one value at a time, so that consecutive
+ * segments are released by different threads, which race with one another
+ */
+
+#define LOCKSTEP_READERS 16
+#define LOCKSTEP_VALUES (1 << 16)
+
+static void *
+read_values_lockstep(void *arg)
+{
+    unsigned int reader = (uintptr_t)arg;
+    uint64_t expected = 0;
+
+    while (expected < LOCKSTEP_VALUES) {
+        size_t readable;
+        uint64_t *values;
+
+        values = rbh_broadcast_peek(broadcast, reader, &readable);
+        if (readable == 0) {
+            sched_yield();
+            continue;
+        }
+
+        ck_assert_uint_eq(values[0], expected++);
+        ck_assert_int_eq(rbh_broadcast_ack(broadcast, reader, sizeof(*values)),
+                         0);
+        if (expected % (reader + 2) == 0)
+            sched_yield();
+    }
+
+    return NULL;
+}
+
+START_TEST(fan_out_lockstep)
+{
+    pthread_t readers[LOCKSTEP_READERS];
+
+    broadcast = rbh_broadcast_new(page_size, LOCKSTEP_READERS);
+    ck_assert_ptr_nonnull(broadcast);
+
+    for (uintptr_t i = 0; i < LOCKSTEP_READERS; i++)
+        ck_assert_int_eq(pthread_create(&readers[i], NULL,
+                                        read_values_lockstep, (void *)i), 0);
+
+    for (uint64_t value = 0; value < LOCKSTEP_VALUES; value++) {
+        while (rbh_broadcast_push(broadcast, &value, sizeof(value)) == NULL) {
+            ck_assert_int_eq(errno, ENOBUFS);
+            sched_yield();
+        }
+    }
+
+    for (size_t i = 0; i < LOCKSTEP_READERS; i++)
+        ck_assert_int_eq(pthread_join(readers[i], NULL), 0);
+
+    rbh_broadcast_destroy(broadcast);
+}
+END_TEST
+
+static Suite *
+integration_suite(void)
+{
+    Suite *suite;
+    TCase *tests;
+
+    suite = suite_create("integration tests");
+
+    tests = tcase_create("threads");
+    tcase_add_test(tests, fan_out);
+    tcase_add_test(tests, fan_out_lockstep);
+    tcase_set_timeout(tests, 60);
+
+    suite_add_tcase(suite, tests);
+
+    return suite;
+}
+
+int
+main(void)
+{
+    int number_failed;
+    SRunner *runner;
+
+    runner = srunner_create(unit_suite());
+    srunner_add_suite(runner, integration_suite());
+
+    srunner_run_all(runner, CK_NORMAL);
+    number_failed = srunner_ntests_failed(runner);
+    srunner_free(runner);
+
+    return (number_failed == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
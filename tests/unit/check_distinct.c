@@ -0,0 +1,365 @@
+/* This file is part of the RobinHood Library
+ * Copyright (C) 2022 Commissariat a l'energie atomique et aux energies
+ *                    alternatives
+ *
+ * SPDX-License-Identifer: LGPL-3.0-or-later
+ */
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <errno.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "check-compat.h"
+#include "robinhood/distinct.h"
+#include "robinhood/fsentry.h"
+
+/* An iterator that yields `count' fsentries whose ID is `index % modulo' */
+struct modulo_iterator {
+    struct rbh_mut_iterator iterator;
+    size_t index;
+    size_t count;
+    size_t modulo;
+};
+
+static void *
+modulo_iter_next(void *iterator)
+{
+    struct modulo_iterator *modulo = iterator;
+    uint64_t value;
+    struct rbh_id id = {
+        .data = (const char *)&value,
+        .size = sizeof(value),
+    };
+
+    if (modulo->index >= modulo->count) {
+        errno = ENODATA;
+        return NULL;
+    }
+
+    value = modulo->index++ % modulo->modulo;
+    return rbh_fsentry_new(&id, NULL, NULL, NULL, NULL, NULL, NULL);
+}
+
+static const struct rbh_mut_iterator_operations MODULO_ITER_OPS = {
+    .next = modulo_iter_next,
+    .destroy = free,
+};
+
+static struct rbh_mut_iterator *
+modulo_iter_new(size_t count, size_t modulo)
+{
+    struct modulo_iterator *iterator;
+
+    iterator = malloc(sizeof(*iterator));
+    ck_assert_ptr_nonnull(iterator);
+
+    iterator->iterator.ops = &MODULO_ITER_OPS;
+    iterator->index = 0;
+    iterator->count = count;
+    iterator->modulo = modulo;
+    return &iterator->iterator;
+}
+
+static size_t
+drain(struct rbh_mut_iterator *fsentries)
+{
+    struct rbh_fsentry *fsentry;
+    size_t count = 0;
+
+    while ((fsentry = rbh_mut_iter_next(fsentries)) != NULL) {
+        free(fsentry);
+        count++;
+    }
+    ck_assert_int_eq(errno, ENODATA);
+    return count;
+}
+
+/* An iterator over an array of pointers to fsentries */
+struct list_iterator {
+    struct rbh_iterator iterator;
+    struct rbh_fsentry **fsentries;
+    size_t count;
+    size_t index;
+};
+
+static const void *
+list_iter_next(void *iterator)
+{
+    struct list_iterator *list = iterator;
+
+    if (list->index >= list->count) {
+        errno = ENODATA;
+        return NULL;
+    }
+
+    return list->fsentries[list->index++];
+}
+
+static const struct rbh_iterator_operations LIST_ITER_OPS = {
+    .next = list_iter_next,
+    .destroy = free,
+};
+
+static struct rbh_iterator *
+list_iter_new(struct rbh_fsentry **fsentries, size_t count)
+{
+    struct list_iterator *iterator;
+
+    iterator = malloc(sizeof(*iterator));
+    ck_assert_ptr_nonnull(iterator);
+
+    iterator->iterator.ops = &LIST_ITER_OPS;
+    iterator->fsentries = fsentries;
+    iterator->count = count;
+    iterator->index = 0;
+    return &iterator->iterator;
+}
+
+/*----------------------------------------------------------------------------*
+ |                            rbh_iter_distinct()                             |
+ *----------------------------------------------------------------------------*/
+
+START_TEST(rid_field)
+{
+    const struct rbh_distinct_options OPTIONS = {
+        .mode = RBH_DM_EXACT,
+    };
+    const struct rbh_filter_field FIELD = {
+        .fsentry = RBH_FP_NAME,
+    };
+    const char *NAMES[] = { "a", "b", "a", NULL, "c", "b", NULL, };
+    const char *EXPECTED[] = { "a", "b", NULL, "c", NULL, };
+    const size_t COUNT = sizeof(NAMES) / sizeof(*NAMES);
+    struct rbh_fsentry *fsentries[sizeof(NAMES) / sizeof(*NAMES)];
+    const struct rbh_fsentry *fsentry;
+    struct rbh_iterator *iterator;
+
+    for (size_t i = 0; i < COUNT; i++) {
+        fsentries[i] = rbh_fsentry_new(NULL, NULL, NAMES[i], NULL, NULL, NULL,
+                                       NULL);
+        ck_assert_ptr_nonnull(fsentries[i]);
+    }
+
+    iterator = rbh_iter_distinct(list_iter_new(fsentries, COUNT), &FIELD,
+                                 &OPTIONS);
+    ck_assert_ptr_nonnull(iterator);
+
+    for (size_t i = 0; i < sizeof(EXPECTED) / sizeof(*EXPECTED); i++) {
+        fsentry = rbh_iter_next(iterator);
+        ck_assert_ptr_nonnull(fsentry);
+
+        if (EXPECTED[i] == NULL) {
+            /* fsentries without a key are never filtered out */
+            ck_assert_uint_eq(fsentry->mask & RBH_FP_NAME, 0);
+        } else {
+            ck_assert_str_eq(fsentry->name, EXPECTED[i]);
+        }
+    }
+
+    errno = 0;
+    ck_assert_ptr_null(rbh_iter_next(iterator));
+    ck_assert_int_eq(errno, ENODATA);
+
+    rbh_iter_destroy(iterator);
+
+    for (size_t i = 0; i < COUNT; i++)
+        free(fsentries[i]);
+}
+END_TEST
+
+#define LARGE_DISTINCT 32
+
+START_TEST(rid_exact_spill_large)
+{
+    const struct rbh_distinct_options OPTIONS = {
+        .mode = RBH_DM_EXACT,
+        .exact = {
+            .memory = 1, /* rounded up to 1 MiB */
+        },
+    };
+    const struct rbh_filter_field FIELD = {
+        .fsentry = RBH_FP_NAME,
+    };
+    /* Names that do not fit in a chunk of the set's sstack (64 KiB) */
+    const size_t NAME_SIZE = 100 * 1024;
+    struct rbh_fsentry *fsentries[2 * LARGE_DISTINCT];
+    const struct rbh_fsentry *fsentry;
+    struct rbh_iterator *iterator;
+    size_t count = 0;
+    char *name;
+
+    name = malloc(NAME_SIZE + 1);
+    ck_assert_ptr_nonnull(name);
+    memset(name, 'a', NAME_SIZE);
+    name[NAME_SIZE] = '\0';
+
+    for (size_t i = 0; i < 2 * LARGE_DISTINCT; i++) {
+        /* Names only differ by their first character */
+        name[0] = 'A' + i % LARGE_DISTINCT;
+        fsentries[i] = rbh_fsentry_new(NULL, NULL, name, NULL, NULL, NULL,
+                                       NULL);
+        ck_assert_ptr_nonnull(fsentries[i]);
+    }
+    free(name);
+
+    /* The set spills to disk several times */
+    iterator = rbh_iter_distinct(list_iter_new(fsentries, 2 * LARGE_DISTINCT),
+                                 &FIELD, &OPTIONS);
+    ck_assert_ptr_nonnull(iterator);
+
+    while ((fsentry = rbh_iter_next(iterator)) != NULL)
+        count++;
+    ck_assert_int_eq(errno, ENODATA);
+    ck_assert_uint_eq(count, LARGE_DISTINCT);
+
+    rbh_iter_destroy(iterator);
+
+    for (size_t i = 0; i < 2 * LARGE_DISTINCT; i++)
+        free(fsentries[i]);
+}
+END_TEST
+
+/*----------------------------------------------------------------------------*
+ |                          rbh_mut_iter_distinct()                           |
+ *----------------------------------------------------------------------------*/
+
+START_TEST(rmid_exact)
+{
+    const struct rbh_distinct_options OPTIONS = {
+        .mode = RBH_DM_EXACT,
+    };
+    struct rbh_mut_iterator *fsentries;
+    struct rbh_fsentry *fsentry;
+
+    fsentries = rbh_mut_iter_distinct(modulo_iter_new(30, 10), NULL, &OPTIONS);
+    ck_assert_ptr_nonnull(fsentries);
+
+    for (uint64_t i = 0; i < 10; i++) {
+        fsentry = rbh_mut_iter_next(fsentries);
+        ck_assert_ptr_nonnull(fsentry);
+        ck_assert_uint_eq(fsentry->id.size, sizeof(i));
+        ck_assert_mem_eq(fsentry->id.data, &i, sizeof(i));
+        free(fsentry);
+    }
+
+    errno = 0;
+    ck_assert_ptr_null(rbh_mut_iter_next(fsentries));
+    ck_assert_int_eq(errno, ENODATA);
+
+    rbh_mut_iter_destroy(fsentries);
+}
+END_TEST
+
+START_TEST(rmid_exact_spill)
+{
+    const struct rbh_distinct_options OPTIONS = {
+        .mode = RBH_DM_EXACT,
+        .exact = {
+            .memory = 1, /* rounded up to 1 MiB */
+        },
+    };
+    const size_t DISTINCT = 200000;
+    struct rbh_mut_iterator *fsentries;
+
+    fsentries = rbh_mut_iter_distinct(modulo_iter_new(3 * DISTINCT, DISTINCT),
+                                      NULL, &OPTIONS);
+    ck_assert_ptr_nonnull(fsentries);
+
+    ck_assert_uint_eq(drain(fsentries), DISTINCT);
+
+    rbh_mut_iter_destroy(fsentries);
+}
+END_TEST
+
+START_TEST(rmid_approximate)
+{
+    const struct rbh_distinct_options OPTIONS = {
+        .mode = RBH_DM_APPROXIMATE,
+        .approximate = {
+            .capacity = 10000,
+            .false_positive_rate = 0.01,
+        },
+    };
+    struct rbh_mut_iterator *fsentries;
+    size_t count;
+
+    fsentries = rbh_mut_iter_distinct(modulo_iter_new(20000, 10000), NULL,
+                                      &OPTIONS);
+    ck_assert_ptr_nonnull(fsentries);
+
+    count = drain(fsentries);
+    /* Leave some room for the looser false positive rate of blocked filters */
+    ck_assert_uint_le(count, 10000);
+    ck_assert_uint_ge(count, 9700);
+
+    rbh_mut_iter_destroy(fsentries);
+}
+END_TEST
+
+START_TEST(rmid_invalid)
+{
+    struct rbh_distinct_options options = {
+        .mode = RBH_DM_APPROXIMATE,
+        .approximate = {
+            .capacity = 10000,
+            .false_positive_rate = 1.,
+        },
+    };
+
+    errno = 0;
+    ck_assert_ptr_null(rbh_mut_iter_distinct(NULL, NULL, &options));
+    ck_assert_int_eq(errno, EINVAL);
+
+    options.mode = -1;
+    errno = 0;
+    ck_assert_ptr_null(rbh_mut_iter_distinct(NULL, NULL, &options));
+    ck_assert_int_eq(errno, EINVAL);
+}
+END_TEST
+
+static Suite *
+unit_suite(void)
+{
+    Suite *suite;
+    TCase *tests;
+
+    suite = suite_create("distinct");
+    tests = tcase_create("rbh_iter_distinct()");
+    tcase_add_test(tests, rid_field);
+    tcase_add_test(tests, rid_exact_spill_large);
+
+    suite_add_tcase(suite, tests);
+
+    tests = tcase_create("rbh_mut_iter_distinct()");
+    tcase_add_test(tests, rmid_exact);
+    tcase_add_test(tests, rmid_exact_spill);
+    tcase_add_test(tests, rmid_approximate);
+    tcase_add_test(tests, rmid_invalid);
+
+    suite_add_tcase(suite, tests);
+
+    return suite;
+}
+
+int
+main(void)
+{
+    int number_failed;
+    Suite *suite;
+    SRunner *runner;
+
+    suite = unit_suite();
+    runner = srunner_create(suite);
+
+    srunner_run_all(runner, CK_NORMAL);
+    number_failed = srunner_ntests_failed(runner);
+    srunner_free(runner);
+
+    return (number_failed == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
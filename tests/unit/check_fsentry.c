@@ -14,6 +14,7 @@
 
 #include <sys/stat.h>
 
+#include "robinhood/filter.h"
 #include "robinhood/fsentry.h"
 #include "robinhood/statx.h"
 
@@ -334,6 +335,149 @@ START_TEST(rfn_all)
 }
 END_TEST
 
+/*----------------------------------------------------------------------------*
+ |                          rbh_fsentry_get_field()                           |
+ *----------------------------------------------------------------------------*/
+
+START_TEST(rfgf_id)
+{
+    static const struct rbh_id ID = {
+        .data = "abcdefg",
+        .size = 8,
+    };
+    static const struct rbh_filter_field FIELD = {
+        .fsentry = RBH_FP_ID,
+    };
+    struct rbh_fsentry *fsentry;
+    struct rbh_value value;
+
+    fsentry = rbh_fsentry_new(&ID, NULL, NULL, NULL, NULL, NULL, NULL);
+    ck_assert_ptr_nonnull(fsentry);
+
+    ck_assert_int_eq(rbh_fsentry_get_field(fsentry, &FIELD, &value), 0);
+    ck_assert_int_eq(value.type, RBH_VT_BINARY);
+    ck_assert_uint_eq(value.binary.size, ID.size);
+    ck_assert_mem_eq(value.binary.data, ID.data, ID.size);
+
+    free(fsentry);
+}
+END_TEST
+
+START_TEST(rfgf_missing)
+{
+    static const struct rbh_filter_field FIELD = {
+        .fsentry = RBH_FP_NAME,
+    };
+    struct rbh_fsentry *fsentry;
+    struct rbh_value value;
+
+    fsentry = rbh_fsentry_new(NULL, NULL, NULL, NULL, NULL, NULL, NULL);
+    ck_assert_ptr_nonnull(fsentry);
+
+    errno = 0;
+    ck_assert_int_eq(rbh_fsentry_get_field(fsentry, &FIELD, &value), -1);
+    ck_assert_int_eq(errno, ENODATA);
+
+    free(fsentry);
+}
+END_TEST
+
+START_TEST(rfgf_statx)
+{
+    static const struct rbh_statx STATX = {
+        .stx_mask = RBH_STATX_TYPE | RBH_STATX_MODE | RBH_STATX_SIZE
+                  | RBH_STATX_MTIME_SEC,
+        .stx_mode = S_IFREG | 0644,
+        .stx_size = 1234,
+        .stx_mtime = {
+            .tv_sec = -1,
+        },
+    };
+    struct rbh_filter_field field = {
+        .fsentry = RBH_FP_STATX,
+    };
+    struct rbh_fsentry *fsentry;
+    struct rbh_value value;
+
+    fsentry = rbh_fsentry_new(NULL, NULL, NULL, &STATX, NULL, NULL, NULL);
+    ck_assert_ptr_nonnull(fsentry);
+
+    field.statx = RBH_STATX_TYPE;
+    ck_assert_int_eq(rbh_fsentry_get_field(fsentry, &field, &value), 0);
+    ck_assert_int_eq(value.type, RBH_VT_UINT32);
+    ck_assert_uint_eq(value.uint32, S_IFREG);
+
+    field.statx = RBH_STATX_MODE;
+    ck_assert_int_eq(rbh_fsentry_get_field(fsentry, &field, &value), 0);
+    ck_assert_int_eq(value.type, RBH_VT_UINT32);
+    ck_assert_uint_eq(value.uint32, 0644);
+
+    field.statx = RBH_STATX_SIZE;
+    ck_assert_int_eq(rbh_fsentry_get_field(fsentry, &field, &value), 0);
+    ck_assert_int_eq(value.type, RBH_VT_UINT64);
+    ck_assert_uint_eq(value.uint64, 1234);
+
+    field.statx = RBH_STATX_MTIME_SEC;
+    ck_assert_int_eq(rbh_fsentry_get_field(fsentry, &field, &value), 0);
+    ck_assert_int_eq(value.type, RBH_VT_INT64);
+    ck_assert_int_eq(value.int64, -1);
+
+    field.statx = RBH_STATX_UID;
+    errno = 0;
+    ck_assert_int_eq(rbh_fsentry_get_field(fsentry, &field, &value), -1);
+    ck_assert_int_eq(errno, ENODATA);
+
+    field.statx = RBH_STATX_MTIME;
+    errno = 0;
+    ck_assert_int_eq(rbh_fsentry_get_field(fsentry, &field, &value), -1);
+    ck_assert_int_eq(errno, EINVAL);
+
+    free(fsentry);
+}
+END_TEST
+
+START_TEST(rfgf_xattr)
+{
+    static const struct rbh_value VALUE = {
+        .type = RBH_VT_STRING,
+        .string = "hijklmn",
+    };
+    static const struct rbh_value_pair PAIR = {
+        .key = "abcdefg",
+        .value = &VALUE,
+    };
+    static const struct rbh_value_map XATTRS = {
+        .pairs = &PAIR,
+        .count = 1,
+    };
+    struct rbh_filter_field field = {
+        .fsentry = RBH_FP_INODE_XATTRS,
+        .xattr = "abcdefg",
+    };
+    struct rbh_fsentry *fsentry;
+    struct rbh_value value;
+
+    fsentry = rbh_fsentry_new(NULL, NULL, NULL, NULL, NULL, &XATTRS, NULL);
+    ck_assert_ptr_nonnull(fsentry);
+
+    ck_assert_int_eq(rbh_fsentry_get_field(fsentry, &field, &value), 0);
+    ck_assert_int_eq(value.type, RBH_VT_STRING);
+    ck_assert_str_eq(value.string, VALUE.string);
+
+    field.xattr = "hijklmn";
+    errno = 0;
+    ck_assert_int_eq(rbh_fsentry_get_field(fsentry, &field, &value), -1);
+    ck_assert_int_eq(errno, ENODATA);
+
+    field.xattr = NULL;
+    ck_assert_int_eq(rbh_fsentry_get_field(fsentry, &field, &value), 0);
+    ck_assert_int_eq(value.type, RBH_VT_MAP);
+    ck_assert_uint_eq(value.map.count, 1);
+
+    free(fsentry);
+}
+END_TEST
+
 static Suite *
 unit_suite(void)
 {
@@ -359,6 +503,14 @@ unit_suite(void)
 
     suite_add_tcase(suite, tests);
 
+    tests = tcase_create("rbh_fsentry_get_field()");
+    tcase_add_test(tests, rfgf_id);
+    tcase_add_test(tests, rfgf_missing);
+    tcase_add_test(tests, rfgf_statx);
+    tcase_add_test(tests, rfgf_xattr);
+
+    suite_add_tcase(suite, tests);
+
     return suite;
 }
 
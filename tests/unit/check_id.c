@@ -12,12 +12,14 @@
 #include <errno.h>
 #include <fcntl.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include "check-compat.h"
 #include "check_macros.h"
 #include "robinhood/id.h"
 
 #include "lu_fid.h"
+#include "utils.h"
 
 /*----------------------------------------------------------------------------*
  |                               rbh_id_copy()                                |
@@ -250,6 +252,114 @@ START_TEST(rfhfi_not_a_file_handle)
 }
 END_TEST
 
+/*----------------------------------------------------------------------------*
+ |                               rbh_compact_id                               |
+ *----------------------------------------------------------------------------*/
+
+START_TEST(rci_inline)
+{
+    const char DATA[] = "abcdefg";
+    const struct rbh_id ID = {
+        .data = DATA,
+        .size = sizeof(DATA),
+    };
+    struct rbh_compact_id compact;
+    struct rbh_id id;
+
+    ck_assert_int_eq(rbh_compact_id_init(&compact, &ID), 0);
+
+    id = rbh_compact_id_view(&compact);
+    ck_assert_ptr_eq(id.data, compact.bytes);
+    ck_assert_id_eq(&id, &ID);
+
+    rbh_compact_id_fini(&compact);
+}
+END_TEST
+
+START_TEST(rci_heap)
+{
+    char data[RBH_COMPACT_ID_INLINE_SIZE + 1];
+    const struct rbh_id ID = {
+        .data = data,
+        .size = sizeof(data),
+    };
+    struct rbh_compact_id compact;
+    struct rbh_compact_id copy;
+    struct rbh_id id;
+
+    memset(data, 'x', sizeof(data));
+    ck_assert_int_eq(rbh_compact_id_init(&compact, &ID), 0);
+
+    id = rbh_compact_id_view(&compact);
+    ck_assert_ptr_ne(id.data, data);
+    ck_assert_id_eq(&id, &ID);
+
+    ck_assert_int_eq(rbh_compact_id_copy(&copy, &compact), 0);
+    ck_assert(rbh_compact_id_equal(&copy, &compact));
+    id = rbh_compact_id_view(&copy);
+    ck_assert_ptr_ne(id.data, compact.data);
+    ck_assert_id_eq(&id, &ID);
+
+    rbh_compact_id_fini(&copy);
+    rbh_compact_id_fini(&compact);
+}
+END_TEST
+
+START_TEST(rci_equal)
+{
+    char data[RBH_COMPACT_ID_INLINE_SIZE + 2];
+    struct rbh_compact_id compacts[6];
+    struct rbh_compact_id copy;
+
+    memset(data, 'x', sizeof(data));
+    /* Same prefix, different sizes, across the inline/heap threshold */
+    for (size_t i = 0; i < ARRAY_SIZE(compacts) - 1; i++) {
+        const struct rbh_id ID = {
+            .data = data,
+            .size = RBH_COMPACT_ID_INLINE_SIZE - 2 + i,
+        };
+
+        ck_assert_int_eq(rbh_compact_id_init(&compacts[i], &ID), 0);
+    }
+    /* Same size, different data */
+    data[0] = 'y';
+    ck_assert_int_eq(rbh_compact_id_init(&compacts[5], &(struct rbh_id){
+            .data = data,
+            .size = RBH_COMPACT_ID_INLINE_SIZE + 1,
+        }), 0);
+
+    for (size_t i = 0; i < ARRAY_SIZE(compacts); i++) {
+        ck_assert_int_eq(rbh_compact_id_copy(&copy, &compacts[i]), 0);
+        for (size_t j = 0; j < ARRAY_SIZE(compacts); j++)
+            ck_assert(rbh_compact_id_equal(&copy, &compacts[j]) == (i == j));
+        ck_assert_uint_eq(rbh_compact_id_hash(&copy),
+                          rbh_compact_id_hash(&compacts[i]));
+        rbh_compact_id_fini(&copy);
+    }
+
+    for (size_t i = 0; i < ARRAY_SIZE(compacts); i++)
+        rbh_compact_id_fini(&compacts[i]);
+}
+END_TEST
+
+START_TEST(rci_empty)
+{
+    const struct rbh_id ID = {
+        .data = NULL,
+        .size = 0,
+    };
+    struct rbh_compact_id compact;
+    struct rbh_id id;
+
+    ck_assert_int_eq(rbh_compact_id_init(&compact, &ID), 0);
+
+    id = rbh_compact_id_view(&compact);
+    ck_assert_uint_eq(id.size, 0);
+
+    rbh_compact_id_fini(&compact);
+}
+END_TEST
+
 static Suite *
 unit_suite(void)
 {
@@ -287,6 +397,14 @@ unit_suite(void)
 
     suite_add_tcase(suite, tests);
 
+    tests = tcase_create("rbh_compact_id");
+    tcase_add_test(tests, rci_inline);
+    tcase_add_test(tests, rci_heap);
+    tcase_add_test(tests, rci_equal);
+    tcase_add_test(tests, rci_empty);
+
+    suite_add_tcase(suite, tests);
+
     return suite;
 }
 
@@ -0,0 +1,355 @@
+/* This file is part of the RobinHood Library
+ * Copyright (C) 2022 Commissariat a l'energie atomique et aux energies
+ *                    alternatives
+ *
+ * SPDX-License-Identifer: LGPL-3.0-or-later
+ */
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <errno.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "check-compat.h"
+#include "check_macros.h"
+#include "robinhood/idmap.h"
+
+static struct rbh_id *
+id_of(uint64_t i, char buffer[sizeof(uint64_t)])
+{
+    static struct rbh_id id;
+
+    memcpy(buffer, &i, sizeof(i));
+    id.data = buffer;
+    id.size = sizeof(i);
+    return &id;
+}
+
+/*----------------------------------------------------------------------------*
+ |                               rbh_idmap_put()                              |
+ *----------------------------------------------------------------------------*/
+
+START_TEST(rip_basic)
+{
+    const struct rbh_id ID = {
+        .data = "abcdefg",
+        .size = 8,
+    };
+    struct rbh_idmap *map;
+    bool created;
+    int *value;
+
+    map = rbh_idmap_new(sizeof(int), 0);
+    ck_assert_ptr_nonnull(map);
+
+    value = rbh_idmap_put(map, &ID, &created);
+    ck_assert_ptr_nonnull(value);
+    ck_assert(created);
+    ck_assert_int_eq(*value, 0);
+    *value = 42;
+
+    value = rbh_idmap_put(map, &ID, &created);
+    ck_assert_ptr_nonnull(value);
+    ck_assert(!created);
+    ck_assert_int_eq(*value, 42);
+    ck_assert_uint_eq(rbh_idmap_count(map), 1);
+
+    rbh_idmap_destroy(map);
+}
+END_TEST
+
+START_TEST(rip_empty_id)
+{
+    const struct rbh_id ID = {
+        .data = NULL,
+        .size = 0,
+    };
+    struct rbh_idmap *map;
+    bool created;
+
+    map = rbh_idmap_new(sizeof(int), 0);
+    ck_assert_ptr_nonnull(map);
+
+    ck_assert_ptr_nonnull(rbh_idmap_put(map, &ID, &created));
+    ck_assert(created);
+    ck_assert_ptr_nonnull(rbh_idmap_get(map, &ID));
+
+    rbh_idmap_destroy(map);
+}
+END_TEST
+
+START_TEST(rip_many)
+{
+    const uint64_t COUNT = 1 << 16;
+    struct rbh_idmap *map;
+    char buffer[8];
+
+    map = rbh_idmap_new(sizeof(uint64_t), 0);
+    ck_assert_ptr_nonnull(map);
+
+    for (uint64_t i = 0; i < COUNT; i++) {
+        uint64_t *value;
+        bool created;
+
+        value = rbh_idmap_put(map, id_of(i, buffer), &created);
+        ck_assert_ptr_nonnull(value);
+        ck_assert(created);
+        *value = ~i;
+    }
+    ck_assert_uint_eq(rbh_idmap_count(map), COUNT);
+
+    for (uint64_t i = 0; i < COUNT; i++) {
+        uint64_t *value = rbh_idmap_get(map, id_of(i, buffer));
+
+        ck_assert_ptr_nonnull(value);
+        ck_assert_uint_eq(*value, ~i);
+    }
+
+    rbh_idmap_destroy(map);
+}
+END_TEST
+
+START_TEST(rip_evict)
+{
+    const size_t LIMIT = 1 << 14;
+    struct rbh_memory_usage usage;
+    struct rbh_idmap *map;
+    char buffer[8];
+    bool created;
+
+    map = rbh_idmap_new(sizeof(uint64_t), LIMIT);
+    ck_assert_ptr_nonnull(map);
+
+    for (uint64_t i = 0; i < 4096; i++) {
+        ck_assert_ptr_nonnull(rbh_idmap_put(map, id_of(i, buffer), &created));
+        ck_assert(created);
+
+        /* Keep the very first entry alive */
+        ck_assert_ptr_nonnull(rbh_idmap_get(map, id_of(0, buffer)));
+
+        rbh_idmap_usage(map, &usage);
+        ck_assert_uint_le(usage.allocated, LIMIT);
+    }
+    ck_assert_uint_lt(rbh_idmap_count(map), 4096);
+
+    ck_assert_ptr_nonnull(rbh_idmap_get(map, id_of(0, buffer)));
+    ck_assert_ptr_nonnull(rbh_idmap_get(map, id_of(4095, buffer)));
+    errno = 0;
+    ck_assert_ptr_null(rbh_idmap_get(map, id_of(1, buffer)));
+    ck_assert_int_eq(errno, ENOENT);
+
+    rbh_idmap_destroy(map);
+}
+END_TEST
+
+START_TEST(rip_too_big)
+{
+    struct rbh_idmap *map;
+    char buffer[8];
+    bool created;
+
+    map = rbh_idmap_new(1 << 12, 1 << 10);
+    ck_assert_ptr_nonnull(map);
+
+    errno = 0;
+    ck_assert_ptr_null(rbh_idmap_put(map, id_of(0, buffer), &created));
+    ck_assert_int_eq(errno, ENOBUFS);
+
+    rbh_idmap_destroy(map);
+}
+END_TEST
+
+/*----------------------------------------------------------------------------*
+ |                               rbh_idmap_get()                              |
+ *----------------------------------------------------------------------------*/
+
+START_TEST(rig_missing)
+{
+    struct rbh_idmap *map;
+    char buffer[8];
+    bool created;
+
+    map = rbh_idmap_new(sizeof(int), 0);
+    ck_assert_ptr_nonnull(map);
+
+    errno = 0;
+    ck_assert_ptr_null(rbh_idmap_get(map, id_of(0, buffer)));
+    ck_assert_int_eq(errno, ENOENT);
+
+    ck_assert_ptr_nonnull(rbh_idmap_put(map, id_of(0, buffer), &created));
+
+    errno = 0;
+    ck_assert_ptr_null(rbh_idmap_get(map, id_of(1, buffer)));
+    ck_assert_int_eq(errno, ENOENT);
+
+    rbh_idmap_destroy(map);
+}
+END_TEST
+
+/*----------------------------------------------------------------------------*
+ |                             rbh_idmap_remove()                             |
+ *----------------------------------------------------------------------------*/
+
+START_TEST(rir_basic)
+{
+    struct rbh_idmap *map;
+    char buffer[8];
+    bool created;
+
+    map = rbh_idmap_new(sizeof(int), 0);
+    ck_assert_ptr_nonnull(map);
+
+    ck_assert_ptr_nonnull(rbh_idmap_put(map, id_of(0, buffer), &created));
+    ck_assert_int_eq(rbh_idmap_remove(map, id_of(0, buffer)), 0);
+    ck_assert_uint_eq(rbh_idmap_count(map), 0);
+
+    errno = 0;
+    ck_assert_ptr_null(rbh_idmap_get(map, id_of(0, buffer)));
+    ck_assert_int_eq(errno, ENOENT);
+
+    errno = 0;
+    ck_assert_int_eq(rbh_idmap_remove(map, id_of(0, buffer)), -1);
+    ck_assert_int_eq(errno, ENOENT);
+
+    rbh_idmap_destroy(map);
+}
+END_TEST
+
+START_TEST(rir_interleaved)
+{
+    const uint64_t COUNT = 1 << 14;
+    struct rbh_memory_usage usage;
+    struct rbh_idmap *map;
+    char buffer[8];
+
+    map = rbh_idmap_new(sizeof(uint64_t), 0);
+    ck_assert_ptr_nonnull(map);
+
+    /* Keep a few entries around while most of them come and go, so that the
+     * arena is compacted rather than grown
+     */
+    for (uint64_t i = 0; i < COUNT; i++) {
+        uint64_t *value;
+        bool created;
+
+        value = rbh_idmap_put(map, id_of(i, buffer), &created);
+        ck_assert_ptr_nonnull(value);
+        *value = i;
+
+        if (i % 16 != 0 && i > 0)
+            ck_assert_int_eq(rbh_idmap_remove(map, id_of(i - 1, buffer)), 0);
+    }
+
+    rbh_idmap_usage(map, &usage);
+    ck_assert_uint_lt(usage.allocated, COUNT * 16);
+
+    for (uint64_t i = 0; i < COUNT; i++) {
+        uint64_t *value = rbh_idmap_get(map, id_of(i, buffer));
+
+        if ((i + 1) % 16 == 0 || i == COUNT - 1) {
+            ck_assert_ptr_nonnull(value);
+            ck_assert_uint_eq(*value, i);
+        } else {
+            ck_assert_ptr_null(value);
+        }
+    }
+
+    rbh_idmap_destroy(map);
+}
+END_TEST
+
+/*----------------------------------------------------------------------------*
+ |                              rbh_idmap_iter()                              |
+ *----------------------------------------------------------------------------*/
+
+START_TEST(rii_lru_order)
+{
+    const struct rbh_idmap_entry *entry;
+    struct rbh_iterator *entries;
+    struct rbh_idmap *map;
+    char buffer[8];
+    bool created;
+
+    map = rbh_idmap_new(sizeof(uint64_t), 0);
+    ck_assert_ptr_nonnull(map);
+
+    for (uint64_t i = 0; i < 4; i++)
+        *(uint64_t *)rbh_idmap_put(map, id_of(i, buffer), &created) = i;
+    ck_assert_ptr_nonnull(rbh_idmap_get(map, id_of(1, buffer)));
+
+    entries = rbh_idmap_iter(map);
+    ck_assert_ptr_nonnull(entries);
+
+    for (uint64_t i = 0; i < 4; i++) {
+        const uint64_t EXPECTED[] = { 1, 3, 2, 0 };
+
+        entry = rbh_iter_next(entries);
+        ck_assert_ptr_nonnull(entry);
+        ck_assert_id_eq(&entry->id, id_of(EXPECTED[i], buffer));
+        ck_assert_uint_eq(*(uint64_t *)entry->value, EXPECTED[i]);
+    }
+
+    errno = 0;
+    ck_assert_ptr_null(rbh_iter_next(entries));
+    ck_assert_int_eq(errno, ENODATA);
+
+    rbh_iter_destroy(entries);
+    rbh_idmap_destroy(map);
+}
+END_TEST
+
+static Suite *
+unit_suite(void)
+{
+    Suite *suite;
+    TCase *tests;
+
+    suite = suite_create("ID map");
+    tests = tcase_create("rbh_idmap_put()");
+    tcase_add_test(tests, rip_basic);
+    tcase_add_test(tests, rip_empty_id);
+    tcase_add_test(tests, rip_many);
+    tcase_add_test(tests, rip_evict);
+    tcase_add_test(tests, rip_too_big);
+
+    suite_add_tcase(suite, tests);
+
+    tests = tcase_create("rbh_idmap_get()");
+    tcase_add_test(tests, rig_missing);
+
+    suite_add_tcase(suite, tests);
+
+    tests = tcase_create("rbh_idmap_remove()");
+    tcase_add_test(tests, rir_basic);
+    tcase_add_test(tests, rir_interleaved);
+
+    suite_add_tcase(suite, tests);
+
+    tests = tcase_create("rbh_idmap_iter()");
+    tcase_add_test(tests, rii_lru_order);
+
+    suite_add_tcase(suite, tests);
+
+    return suite;
+}
+
+int
+main(void)
+{
+    int number_failed;
+    Suite *suite;
+    SRunner *runner;
+
+    suite = unit_suite();
+    runner = srunner_create(suite);
+
+    srunner_run_all(runner, CK_NORMAL);
+    number_failed = srunner_ntests_failed(runner);
+    srunner_free(runner);
+
+    return (number_failed == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,269 @@
+/* This file is part of the RobinHood Library
+ * Copyright (C) 2022 Commissariat a l'energie atomique et aux energies
+ *                    alternatives
+ *
+ * SPDX-License-Identifer: LGPL-3.0-or-later
+ */
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <errno.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "check-compat.h"
+#include "robinhood/instrument.h"
+#include "robinhood/itertools.h"
+
+/*----------------------------------------------------------------------------*
+ |                           rbh_iter_instrument()                            |
+ *----------------------------------------------------------------------------*/
+
+START_TEST(rii_disabled)
+{
+    const char STRING[] = "abcdefghijklmno";
+    struct rbh_iterator *instrumented;
+    struct rbh_iterator *letters;
+
+    rbh_instrument_enable(false);
+
+    letters = rbh_iter_array(STRING, sizeof(*STRING), sizeof(STRING));
+    ck_assert_ptr_nonnull(letters);
+
+    instrumented = rbh_iter_instrument(letters, "rii_disabled");
+    ck_assert_ptr_eq(instrumented, letters);
+
+    rbh_iter_destroy(instrumented);
+}
+END_TEST
+
+START_TEST(rii_basic)
+{
+    const char STRING[] = "abcdefghijklmno";
+    struct rbh_iterator *letters;
+    struct rbh_iter_stats stats;
+
+    rbh_instrument_enable(true);
+
+    letters = rbh_iter_array(STRING, sizeof(*STRING), sizeof(STRING));
+    ck_assert_ptr_nonnull(letters);
+
+    letters = rbh_iter_instrument(letters, "rii_basic");
+    ck_assert_ptr_nonnull(letters);
+
+    for (size_t i = 0; i < sizeof(STRING); i++)
+        ck_assert_mem_eq(rbh_iter_next(letters), &STRING[i], sizeof(*STRING));
+
+    errno = 0;
+    ck_assert_ptr_null(rbh_iter_next(letters));
+    ck_assert_int_eq(errno, ENODATA);
+
+    rbh_iter_destroy(letters);
+
+    ck_assert_int_eq(rbh_instrument_stats("rii_basic", &stats), 0);
+    ck_assert_str_eq(stats.name, "rii_basic");
+    ck_assert_uint_eq(stats.count, sizeof(STRING));
+    ck_assert_uint_eq(stats.errors, 0);
+    ck_assert_uint_eq(stats.enodata, 1);
+    ck_assert_uint_le(stats.latency.min, stats.latency.p50);
+    ck_assert_uint_le(stats.latency.p50, stats.latency.p90);
+    ck_assert_uint_le(stats.latency.p90, stats.latency.p99);
+    ck_assert_uint_le(stats.latency.p99, stats.latency.p999);
+    ck_assert_uint_le(stats.latency.p999, stats.latency.max);
+    ck_assert_uint_le(stats.latency.max, stats.latency.total);
+
+    rbh_instrument_enable(false);
+}
+END_TEST
+
+static const void *
+failing_iter_next(void *iterator)
+{
+    errno = EIO;
+    return NULL;
+}
+
+static const struct rbh_iterator_operations FAILING_ITER_OPS = {
+    .next = failing_iter_next,
+    .destroy = free,
+};
+
+START_TEST(rii_errors)
+{
+    struct rbh_iterator *failing;
+    struct rbh_iter_stats stats;
+
+    rbh_instrument_enable(true);
+
+    failing = malloc(sizeof(*failing));
+    ck_assert_ptr_nonnull(failing);
+    failing->ops = &FAILING_ITER_OPS;
+
+    failing = rbh_iter_instrument(failing, "rii_errors");
+    ck_assert_ptr_nonnull(failing);
+
+    for (int i = 0; i < 3; i++) {
+        errno = 0;
+        ck_assert_ptr_null(rbh_iter_next(failing));
+        ck_assert_int_eq(errno, EIO);
+    }
+
+    rbh_iter_destroy(failing);
+
+    ck_assert_int_eq(rbh_instrument_stats("rii_errors", &stats), 0);
+    ck_assert_uint_eq(stats.count, 0);
+    ck_assert_uint_eq(stats.errors, 3);
+    ck_assert_uint_eq(stats.enodata, 0);
+
+    rbh_instrument_enable(false);
+}
+END_TEST
+
+START_TEST(rii_shared_stage)
+{
+    const int INTEGERS[] = { 0, 1, 2, 3, 4, 5, 6, 7, 8, 9 };
+    struct rbh_iter_stats stats;
+
+    rbh_instrument_enable(true);
+
+    for (int i = 0; i < 2; i++) {
+        struct rbh_iterator *integers;
+
+        integers = rbh_iter_array(INTEGERS, sizeof(*INTEGERS),
+                                  sizeof(INTEGERS) / sizeof(*INTEGERS));
+        ck_assert_ptr_nonnull(integers);
+
+        integers = rbh_iter_instrument(integers, "rii_shared_stage");
+        ck_assert_ptr_nonnull(integers);
+
+        while (rbh_iter_next(integers) != NULL);
+        ck_assert_int_eq(errno, ENODATA);
+
+        rbh_iter_destroy(integers);
+    }
+
+    ck_assert_int_eq(rbh_instrument_stats("rii_shared_stage", &stats), 0);
+    ck_assert_uint_eq(stats.count, 2 * sizeof(INTEGERS) / sizeof(*INTEGERS));
+    ck_assert_uint_eq(stats.enodata, 2);
+
+    rbh_instrument_enable(false);
+}
+END_TEST
+
+/*----------------------------------------------------------------------------*
+ |                          rbh_instrument_stats()                            |
+ *----------------------------------------------------------------------------*/
+
+START_TEST(ris_unknown)
+{
+    struct rbh_iter_stats stats;
+
+    errno = 0;
+    ck_assert_int_eq(rbh_instrument_stats("ris_unknown", &stats), -1);
+    ck_assert_int_eq(errno, ENOENT);
+}
+END_TEST
+
+/*----------------------------------------------------------------------------*
+ |                           rbh_instrument_dump()                            |
+ *----------------------------------------------------------------------------*/
+
+START_TEST(rid_basic)
+{
+    const char *NAMES[] = { "rid_basic_first", "rid_basic_second", };
+    const char STRING[] = "abcdefghijklmno";
+    struct rbh_mut_iterator *dump;
+    struct rbh_iter_stats *stats;
+    struct rbh_iter_stats reset;
+    size_t found = 0;
+
+    rbh_instrument_enable(true);
+
+    for (size_t i = 0; i < sizeof(NAMES) / sizeof(*NAMES); i++) {
+        struct rbh_iterator *letters;
+
+        letters = rbh_iter_array(STRING, sizeof(*STRING), i + 1);
+        ck_assert_ptr_nonnull(letters);
+
+        letters = rbh_iter_instrument(letters, NAMES[i]);
+        ck_assert_ptr_nonnull(letters);
+
+        while (rbh_iter_next(letters) != NULL);
+        rbh_iter_destroy(letters);
+    }
+
+    dump = rbh_instrument_dump();
+    ck_assert_ptr_nonnull(dump);
+
+    while ((stats = rbh_mut_iter_next(dump)) != NULL) {
+        for (size_t i = 0; i < sizeof(NAMES) / sizeof(*NAMES); i++) {
+            if (strcmp(stats->name, NAMES[i]))
+                continue;
+
+            ck_assert_uint_eq(i, found++);
+            ck_assert_uint_eq(stats->count, i + 1);
+        }
+        free(stats);
+    }
+    ck_assert_int_eq(errno, ENODATA);
+    ck_assert_uint_eq(found, sizeof(NAMES) / sizeof(*NAMES));
+
+    rbh_mut_iter_destroy(dump);
+
+    rbh_instrument_reset();
+    ck_assert_int_eq(rbh_instrument_stats(NAMES[0], &reset), 0);
+    ck_assert_uint_eq(reset.count, 0);
+    ck_assert_uint_eq(reset.enodata, 0);
+    ck_assert_uint_eq(reset.latency.max, 0);
+
+    rbh_instrument_enable(false);
+}
+END_TEST
+
+static Suite *
+unit_suite(void)
+{
+    Suite *suite;
+    TCase *tests;
+
+    suite = suite_create("instrument");
+    tests = tcase_create("rbh_iter_instrument()");
+    tcase_add_test(tests, rii_disabled);
+    tcase_add_test(tests, rii_basic);
+    tcase_add_test(tests, rii_errors);
+    tcase_add_test(tests, rii_shared_stage);
+
+    suite_add_tcase(suite, tests);
+
+    tests = tcase_create("rbh_instrument_stats()");
+    tcase_add_test(tests, ris_unknown);
+
+    suite_add_tcase(suite, tests);
+
+    tests = tcase_create("rbh_instrument_dump()");
+    tcase_add_test(tests, rid_basic);
+
+    suite_add_tcase(suite, tests);
+
+    return suite;
+}
+
+int
+main(void)
+{
+    int number_failed;
+    Suite *suite;
+    SRunner *runner;
+
+    suite = unit_suite();
+    runner = srunner_create(suite);
+
+    srunner_run_all(runner, CK_NORMAL);
+    number_failed = srunner_ntests_failed(runner);
+    srunner_free(runner);
+
+    return (number_failed == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,470 @@
+/* This file is part of the RobinHood Library
+ * Copyright (C) 2022 Commissariat a l'energie atomique et aux energies
+ *                    alternatives
+ *
+ * SPDX-License-Identifer: LGPL-3.0-or-later
+ */
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "robinhood/memory.h"
+#include "robinhood/queue.h"
+#include "robinhood/ring.h"
+#include "robinhood/sstack.h"
+#include "robinhood/stack.h"
+
+#include "check-compat.h"
+#include "utils.h"
+
+/* Larger than any huge page size we know of on x86_64 and aarch64 (except for
+ * 1GiB pages), and a multiple of all of them
+ */
+#define SIZE (1 << 25)
+
+static void
+reset_policy(void)
+{
+    rbh_memory_set_huge_pages(RBH_HP_NONE);
+}
+
+/*----------------------------------------------------------------------------*
+ |                         rbh_memory_set_huge_pages()                        |
+ *----------------------------------------------------------------------------*/
+
+START_TEST(rmshp_basic)
+{
+    ck_assert_int_eq(rbh_memory_huge_pages(), RBH_HP_NONE);
+
+    rbh_memory_set_huge_pages(RBH_HP_TRANSPARENT);
+    ck_assert_int_eq(rbh_memory_huge_pages(), RBH_HP_TRANSPARENT);
+
+    rbh_memory_set_huge_pages(RBH_HP_EXPLICIT);
+    ck_assert_int_eq(rbh_memory_huge_pages(), RBH_HP_EXPLICIT);
+}
+END_TEST
+
+/*----------------------------------------------------------------------------*
+ |                                  fallback                                  |
+ *----------------------------------------------------------------------------*/
+
+static const enum rbh_huge_pages POLICIES[] = {
+    RBH_HP_NONE,
+    RBH_HP_TRANSPARENT,
+    RBH_HP_EXPLICIT,
+};
+
+/* Whatever the policy (and the state of the hugetlb pool), rings and stacks
+ * must work as usual
+ */
+START_TEST(ring_fallback)
+{
+    struct rbh_ring *ring;
+    size_t readable;
+    char *data;
+
+    rbh_memory_set_huge_pages(POLICIES[_i]);
+
+    ring = rbh_ring_new(SIZE);
+    ck_assert_ptr_nonnull(ring);
+
+    /* Wrap around the ring */
+    ck_assert_ptr_nonnull(rbh_ring_push(ring, NULL, SIZE - 3));
+    ck_assert_int_eq(rbh_ring_pop(ring, SIZE - 3), 0);
+    ck_assert_ptr_nonnull(rbh_ring_push(ring, "abcdef", 6));
+
+    data = rbh_ring_peek(ring, &readable);
+    ck_assert_uint_eq(readable, 6);
+    ck_assert_mem_eq(data, "abcdef", 6);
+
+    rbh_ring_destroy(ring);
+}
+END_TEST
+
+START_TEST(growable_ring_fallback)
+{
+    struct rbh_ring *ring;
+    size_t readable;
+    char *data;
+
+    rbh_memory_set_huge_pages(POLICIES[_i]);
+
+    ring = rbh_ring_new_growable(SIZE, SIZE * 2);
+    ck_assert_ptr_nonnull(ring);
+
+    ck_assert_ptr_nonnull(rbh_ring_push(ring, "abc", 3));
+    ck_assert_ptr_nonnull(rbh_ring_push(ring, NULL, SIZE));
+
+    data = rbh_ring_peek(ring, &readable);
+    ck_assert_uint_eq(readable, SIZE + 3);
+    ck_assert_mem_eq(data, "abc", 3);
+
+    rbh_ring_destroy(ring);
+}
+END_TEST
+
+START_TEST(stack_fallback)
+{
+    struct rbh_stack *stack;
+    size_t readable;
+    char *data;
+
+    rbh_memory_set_huge_pages(POLICIES[_i]);
+
+    stack = rbh_stack_new(SIZE);
+    ck_assert_ptr_nonnull(stack);
+
+    ck_assert_ptr_nonnull(rbh_stack_push(stack, NULL, SIZE - 3));
+    ck_assert_ptr_nonnull(rbh_stack_push(stack, "abc", 3));
+
+    data = rbh_stack_peek(stack, &readable);
+    ck_assert_uint_eq(readable, SIZE);
+    ck_assert_mem_eq(data, "abc", 3);
+
+    rbh_stack_destroy(stack);
+}
+END_TEST
+
+/*----------------------------------------------------------------------------*
+ |                                   cache                                    |
+ *----------------------------------------------------------------------------*/
+
+static void
+reset_cache(void)
+{
+    rbh_memory_set_cache_limit(64 << 20);
+}
+
+START_TEST(cache_ring_reuse)
+{
+    struct rbh_ring *ring;
+    size_t readable;
+    void *data;
+
+    ring = rbh_ring_new(SIZE);
+    ck_assert_ptr_nonnull(ring);
+    data = rbh_ring_peek(ring, &readable);
+    rbh_ring_destroy(ring);
+
+    ring = rbh_ring_new(SIZE);
+    ck_assert_ptr_nonnull(ring);
+    ck_assert_ptr_eq(rbh_ring_peek(ring, &readable), data);
+    ck_assert_uint_eq(readable, 0);
+
+    /* The recycled ring is still mapped twice */
+    ck_assert_ptr_nonnull(rbh_ring_push(ring, NULL, SIZE - 3));
+    ck_assert_int_eq(rbh_ring_pop(ring, SIZE - 3), 0);
+    ck_assert_ptr_nonnull(rbh_ring_push(ring, "abcdef", 6));
+    ck_assert_mem_eq(rbh_ring_peek(ring, &readable), "abcdef", 6);
+
+    rbh_ring_destroy(ring);
+    rbh_memory_trim(0);
+}
+END_TEST
+
+START_TEST(cache_many_sizes)
+{
+    long page_size = sysconf(_SC_PAGESIZE);
+    struct rbh_ring *rings[64];
+
+    /* More sizes than there are classes in the cache */
+    for (size_t i = 0; i < ARRAY_SIZE(rings); i++) {
+        rings[i] = rbh_ring_new(page_size * (i + 1));
+        ck_assert_ptr_nonnull(rings[i]);
+    }
+
+    for (size_t i = 0; i < ARRAY_SIZE(rings); i++)
+        rbh_ring_destroy(rings[i]);
+
+    for (size_t i = 0; i < ARRAY_SIZE(rings); i++) {
+        rings[i] = rbh_ring_new(page_size * (i + 1));
+        ck_assert_ptr_nonnull(rings[i]);
+        ck_assert_ptr_nonnull(rbh_ring_push(rings[i], NULL,
+                                            page_size * (i + 1)));
+    }
+
+    for (size_t i = 0; i < ARRAY_SIZE(rings); i++)
+        rbh_ring_destroy(rings[i]);
+    rbh_memory_trim(0);
+}
+END_TEST
+
+START_TEST(cache_disabled)
+{
+    struct rbh_ring *ring;
+
+    rbh_memory_set_cache_limit(0);
+
+    for (int i = 0; i < 2; i++) {
+        ring = rbh_ring_new(SIZE);
+        ck_assert_ptr_nonnull(ring);
+        rbh_ring_destroy(ring);
+    }
+}
+END_TEST
+
+START_TEST(cache_stack_reuse)
+{
+    struct rbh_stack *stack;
+    size_t readable;
+    void *data;
+
+    /* Only mmap'ed stacks are cached */
+    rbh_memory_set_huge_pages(RBH_HP_TRANSPARENT);
+
+    stack = rbh_stack_new(SIZE);
+    ck_assert_ptr_nonnull(stack);
+    data = rbh_stack_peek(stack, &readable);
+    rbh_stack_destroy(stack);
+
+    stack = rbh_stack_new(SIZE);
+    ck_assert_ptr_nonnull(stack);
+    ck_assert_ptr_eq(rbh_stack_peek(stack, &readable), data);
+    ck_assert_uint_eq(readable, 0);
+    rbh_stack_destroy(stack);
+}
+END_TEST
+
+/*----------------------------------------------------------------------------*
+ |                                 accounting                                 |
+ *----------------------------------------------------------------------------*/
+
+static void
+reset_budget(void)
+{
+    rbh_memory_set_budget(0);
+}
+
+START_TEST(rms_ring)
+{
+    struct rbh_memory_stats before, stats;
+    struct rbh_ring *ring;
+
+    rbh_memory_trim(0);
+    rbh_memory_stats(&before);
+
+    ring = rbh_ring_new(SIZE);
+    ck_assert_ptr_nonnull(ring);
+
+    rbh_memory_stats(&stats);
+    ck_assert_uint_eq(stats.allocated, before.allocated + SIZE);
+    ck_assert_uint_ge(stats.peak, stats.allocated);
+
+    /* Cached memory is still allocated... */
+    rbh_ring_destroy(ring);
+    rbh_memory_stats(&stats);
+    ck_assert_uint_eq(stats.allocated, before.allocated + SIZE);
+    ck_assert_uint_eq(stats.cached, SIZE);
+
+    /* ... until it is released */
+    rbh_memory_trim(0);
+    rbh_memory_stats(&stats);
+    ck_assert_uint_eq(stats.allocated, before.allocated);
+    ck_assert_uint_eq(stats.cached, 0);
+}
+END_TEST
+
+START_TEST(rmsb_constructor)
+{
+    struct rbh_memory_stats before, stats;
+
+    rbh_memory_trim(0);
+    rbh_memory_stats(&before);
+    rbh_memory_set_budget(before.allocated + SIZE / 2);
+
+    errno = 0;
+    ck_assert_ptr_null(rbh_ring_new(SIZE));
+    ck_assert_int_eq(errno, ENOBUFS);
+
+    errno = 0;
+    ck_assert_ptr_null(rbh_stack_new(SIZE));
+    ck_assert_int_eq(errno, ENOBUFS);
+
+    rbh_memory_stats(&stats);
+    ck_assert_uint_eq(stats.allocated, before.allocated);
+    ck_assert_uint_eq(stats.failures, before.failures + 2);
+}
+END_TEST
+
+START_TEST(rmsb_growable_ring)
+{
+    struct rbh_memory_stats stats;
+    struct rbh_ring *ring;
+
+    rbh_memory_trim(0);
+    rbh_memory_stats(&stats);
+    rbh_memory_set_budget(stats.allocated + SIZE + SIZE / 2);
+
+    ring = rbh_ring_new_growable(SIZE, SIZE * 4);
+    ck_assert_ptr_nonnull(ring);
+
+    ck_assert_ptr_nonnull(rbh_ring_push(ring, NULL, SIZE));
+    errno = 0;
+    ck_assert_ptr_null(rbh_ring_push(ring, NULL, 1));
+    ck_assert_int_eq(errno, ENOBUFS);
+
+    rbh_ring_destroy(ring);
+}
+END_TEST
+
+START_TEST(rmsb_release_cache)
+{
+    struct rbh_memory_stats stats;
+    struct rbh_ring *ring;
+
+    rbh_memory_trim(0);
+
+    /* Cache a large ring */
+    ring = rbh_ring_new(SIZE);
+    ck_assert_ptr_nonnull(ring);
+    rbh_ring_destroy(ring);
+
+    /* Rings of another size may use the memory it occupies */
+    rbh_memory_stats(&stats);
+    rbh_memory_set_budget(stats.allocated);
+
+    ring = rbh_ring_new(SIZE / 2);
+    ck_assert_ptr_nonnull(ring);
+
+    rbh_memory_stats(&stats);
+    ck_assert_uint_eq(stats.cached, 0);
+
+    rbh_ring_destroy(ring);
+    rbh_memory_trim(0);
+}
+END_TEST
+
+START_TEST(rmu_sstack)
+{
+    static const struct rbh_sstack_mark BOTTOM;
+    struct rbh_memory_usage usage;
+    struct rbh_sstack *sstack;
+
+    sstack = rbh_sstack_new(64);
+    ck_assert_ptr_nonnull(sstack);
+
+    for (int i = 0; i < 4; i++)
+        ck_assert_ptr_nonnull(rbh_sstack_push(sstack, NULL, 48));
+
+    rbh_sstack_usage(sstack, &usage);
+    ck_assert_uint_eq(usage.allocated, 4 * 64);
+    ck_assert_uint_eq(usage.used, 4 * 48);
+    ck_assert_uint_eq(usage.cached, 0);
+
+    rbh_sstack_rewind(sstack, BOTTOM);
+    ck_assert_ptr_nonnull(rbh_sstack_push(sstack, NULL, 16));
+
+    rbh_sstack_usage(sstack, &usage);
+    ck_assert_uint_eq(usage.allocated, 4 * 64);
+    ck_assert_uint_eq(usage.used, 16);
+    ck_assert_uint_eq(usage.cached, 3 * 64);
+
+    rbh_sstack_destroy(sstack);
+}
+END_TEST
+
+START_TEST(rmu_queue)
+{
+    long page_size = sysconf(_SC_PAGESIZE);
+    struct rbh_memory_usage usage;
+    struct rbh_queue *queue;
+
+    queue = rbh_queue_new(page_size);
+    ck_assert_ptr_nonnull(queue);
+
+    for (int i = 0; i < 3; i++)
+        ck_assert_ptr_nonnull(rbh_queue_push(queue, NULL, page_size));
+    ck_assert_ptr_nonnull(rbh_queue_push(queue, NULL, 8));
+
+    rbh_queue_usage(queue, &usage);
+    ck_assert_uint_eq(usage.allocated, 4 * page_size);
+    ck_assert_uint_eq(usage.used, 3 * page_size + 8);
+    ck_assert_uint_eq(usage.cached, 0);
+
+    for (int i = 0; i < 2; i++)
+        ck_assert_int_eq(rbh_queue_pop(queue, page_size), 0);
+
+    rbh_queue_usage(queue, &usage);
+    ck_assert_uint_eq(usage.allocated, 4 * page_size);
+    ck_assert_uint_eq(usage.used, page_size + 8);
+    ck_assert_uint_eq(usage.cached, 2 * page_size);
+
+    rbh_queue_shrink(queue);
+    rbh_queue_usage(queue, &usage);
+    ck_assert_uint_eq(usage.allocated, 2 * page_size);
+    ck_assert_uint_eq(usage.cached, 0);
+
+    rbh_queue_destroy(queue);
+}
+END_TEST
+
+static Suite *
+unit_suite(void)
+{
+    Suite *suite;
+    TCase *tests;
+
+    suite = suite_create("unit tests");
+
+    tests = tcase_create("rbh_memory_set_huge_pages");
+    tcase_add_checked_fixture(tests, NULL, reset_policy);
+    tcase_add_test(tests, rmshp_basic);
+
+    suite_add_tcase(suite, tests);
+
+    tests = tcase_create("fallback");
+    tcase_add_checked_fixture(tests, NULL, reset_policy);
+    tcase_add_loop_test(tests, ring_fallback, 0, ARRAY_SIZE(POLICIES));
+    tcase_add_loop_test(tests, growable_ring_fallback, 0, ARRAY_SIZE(POLICIES));
+    tcase_add_loop_test(tests, stack_fallback, 0, ARRAY_SIZE(POLICIES));
+
+    suite_add_tcase(suite, tests);
+
+    tests = tcase_create("cache");
+    tcase_add_checked_fixture(tests, NULL, reset_cache);
+    tcase_add_checked_fixture(tests, NULL, reset_policy);
+    tcase_add_test(tests, cache_ring_reuse);
+    tcase_add_test(tests, cache_many_sizes);
+    tcase_add_test(tests, cache_disabled);
+    tcase_add_test(tests, cache_stack_reuse);
+
+    suite_add_tcase(suite, tests);
+
+    tests = tcase_create("accounting");
+    tcase_add_checked_fixture(tests, NULL, reset_budget);
+    tcase_add_test(tests, rms_ring);
+    tcase_add_test(tests, rmsb_constructor);
+    tcase_add_test(tests, rmsb_growable_ring);
+    tcase_add_test(tests, rmsb_release_cache);
+
+    suite_add_tcase(suite, tests);
+
+    tests = tcase_create("usage");
+    tcase_add_test(tests, rmu_sstack);
+    tcase_add_test(tests, rmu_queue);
+
+    suite_add_tcase(suite, tests);
+
+    return suite;
+}
+
+int
+main(void)
+{
+    int number_failed;
+    SRunner *runner;
+
+    runner = srunner_create(unit_suite());
+
+    srunner_run_all(runner, CK_NORMAL);
+    number_failed = srunner_ntests_failed(runner);
+    srunner_free(runner);
+
+    return (number_failed == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
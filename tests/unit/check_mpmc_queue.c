@@ -0,0 +1,350 @@
+/* This file is part of the RobinHood Library
+ * Copyright (C) 2022 Commissariat a l'energie atomique et aux energies
+ *                    alternatives
+ *
+ * SPDX-License-Identifer: LGPL-3.0-or-later
+ */
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "robinhood/mpmc_queue.h"
+
+#include "check-compat.h"
+
+/*----------------------------------------------------------------------------*
+ |                                 unit tests                                 |
+ *----------------------------------------------------------------------------*/
+
+START_TEST(rmqn_too_big)
+{
+    errno = 0;
+    ck_assert_ptr_null(rbh_mpmc_queue_new((1 << 30) + 1, 0));
+    ck_assert_int_eq(errno, EINVAL);
+}
+END_TEST
+
+START_TEST(rmqr_too_big)
+{
+    struct rbh_mpmc_queue *queue;
+
+    queue = rbh_mpmc_queue_new(16, 0);
+    ck_assert_ptr_nonnull(queue);
+
+    errno = 0;
+    ck_assert_ptr_null(rbh_mpmc_queue_reserve(queue, 17, true));
+    ck_assert_int_eq(errno, EINVAL);
+
+    rbh_mpmc_queue_destroy(queue);
+}
+END_TEST
+
+START_TEST(rmqa_empty)
+{
+    struct rbh_mpmc_queue *queue;
+    size_t size;
+
+    queue = rbh_mpmc_queue_new(16, 0);
+    ck_assert_ptr_nonnull(queue);
+
+    errno = 0;
+    ck_assert_ptr_null(rbh_mpmc_queue_acquire(queue, &size, false));
+    ck_assert_int_eq(errno, EAGAIN);
+
+    rbh_mpmc_queue_destroy(queue);
+}
+END_TEST
+
+START_TEST(rmqa_uncommitted)
+{
+    struct rbh_mpmc_queue *queue;
+    char *record;
+    size_t size;
+
+    queue = rbh_mpmc_queue_new(16, 0);
+    ck_assert_ptr_nonnull(queue);
+
+    record = rbh_mpmc_queue_reserve(queue, 3, false);
+    ck_assert_ptr_nonnull(record);
+    memcpy(record, "abc", 3);
+
+    errno = 0;
+    ck_assert_ptr_null(rbh_mpmc_queue_acquire(queue, &size, false));
+    ck_assert_int_eq(errno, EAGAIN);
+
+    rbh_mpmc_queue_commit(queue, record);
+    ck_assert_ptr_eq(rbh_mpmc_queue_acquire(queue, &size, false), record);
+    ck_assert_uint_eq(size, 3);
+    ck_assert_mem_eq(record, "abc", 3);
+    rbh_mpmc_queue_release(queue, record);
+
+    rbh_mpmc_queue_destroy(queue);
+}
+END_TEST
+
+START_TEST(rmq_fifo)
+{
+    const char STRING[] = "abcdefghijklmnopqrstuvwxyz";
+    struct rbh_mpmc_queue *queue;
+
+    queue = rbh_mpmc_queue_new(sizeof(STRING), 1 << 12);
+    ck_assert_ptr_nonnull(queue);
+
+    /* Go around the queue a few times */
+    for (size_t round = 0; round < 16; round++) {
+        for (size_t i = 0; i < sizeof(STRING); i++)
+            ck_assert_int_eq(rbh_mpmc_queue_push(queue, STRING, i, false), 0);
+
+        for (size_t i = 0; i < sizeof(STRING); i++) {
+            size_t size;
+            char *record;
+
+            record = rbh_mpmc_queue_acquire(queue, &size, false);
+            ck_assert_ptr_nonnull(record);
+            ck_assert_uint_eq(size, i);
+            ck_assert_mem_eq(record, STRING, i);
+            rbh_mpmc_queue_release(queue, record);
+        }
+    }
+
+    rbh_mpmc_queue_destroy(queue);
+}
+END_TEST
+
+START_TEST(rmq_full)
+{
+    struct rbh_mpmc_queue *queue;
+    size_t count = 0;
+    uint64_t value;
+    size_t size;
+    void *record;
+
+    queue = rbh_mpmc_queue_new(sizeof(value), 0);
+    ck_assert_ptr_nonnull(queue);
+
+    while (rbh_mpmc_queue_push(queue, &count, sizeof(count), false) == 0)
+        count++;
+    ck_assert_int_eq(errno, EAGAIN);
+    ck_assert_uint_gt(count, 0);
+
+    /* Space is only reclaimed once a whole chunk is released */
+    record = rbh_mpmc_queue_acquire(queue, &size, false);
+    ck_assert_ptr_nonnull(record);
+    rbh_mpmc_queue_release(queue, record);
+
+    for (size_t i = 1; i < count; i++) {
+        if (rbh_mpmc_queue_push(queue, &value, sizeof(value), false) == 0)
+            break;
+        ck_assert_int_eq(errno, EAGAIN);
+
+        record = rbh_mpmc_queue_acquire(queue, &size, false);
+        ck_assert_ptr_nonnull(record);
+        memcpy(&value, record, sizeof(value));
+        ck_assert_uint_eq(value, i);
+        rbh_mpmc_queue_release(queue, record);
+    }
+
+    rbh_mpmc_queue_destroy(queue);
+}
+END_TEST
+
+START_TEST(rmq_close)
+{
+    struct rbh_mpmc_queue *queue;
+    size_t size;
+    void *record;
+
+    queue = rbh_mpmc_queue_new(8, 0);
+    ck_assert_ptr_nonnull(queue);
+
+    ck_assert_int_eq(rbh_mpmc_queue_push(queue, "abc", 3, true), 0);
+    rbh_mpmc_queue_close(queue);
+
+    errno = 0;
+    ck_assert_int_eq(rbh_mpmc_queue_push(queue, "def", 3, true), -1);
+    ck_assert_int_eq(errno, EPIPE);
+
+    record = rbh_mpmc_queue_acquire(queue, &size, true);
+    ck_assert_ptr_nonnull(record);
+    ck_assert_mem_eq(record, "abc", 3);
+    rbh_mpmc_queue_release(queue, record);
+
+    errno = 0;
+    ck_assert_ptr_null(rbh_mpmc_queue_acquire(queue, &size, true));
+    ck_assert_int_eq(errno, ENODATA);
+
+    rbh_mpmc_queue_destroy(queue);
+}
+END_TEST
+
+static Suite *
+unit_suite(void)
+{
+    Suite *suite;
+    TCase *tests;
+
+    suite = suite_create("unit tests");
+
+    tests = tcase_create("rbh_mpmc_queue_new");
+    tcase_add_test(tests, rmqn_too_big);
+
+    suite_add_tcase(suite, tests);
+
+    tests = tcase_create("rbh_mpmc_queue_reserve");
+    tcase_add_test(tests, rmqr_too_big);
+
+    suite_add_tcase(suite, tests);
+
+    tests = tcase_create("rbh_mpmc_queue_acquire");
+    tcase_add_test(tests, rmqa_empty);
+    tcase_add_test(tests, rmqa_uncommitted);
+
+    suite_add_tcase(suite, tests);
+
+    tests = tcase_create("rbh_mpmc_queue");
+    tcase_add_test(tests, rmq_fifo);
+    tcase_add_test(tests, rmq_full);
+    tcase_add_test(tests, rmq_close);
+
+    suite_add_tcase(suite, tests);
+
+    return suite;
+}
+
+/*----------------------------------------------------------------------------*
+ |                             integration tests                              |
+ *----------------------------------------------------------------------------*/
+
+#define PRODUCERS 4
+#define CONSUMERS 4
+#define RECORDS (1 << 16)
+
+struct record {
+    uint32_t producer;
+    uint32_t index;
+    char padding[40];
+};
+
+static struct rbh_mpmc_queue *queue;
+static atomic_uint_fast64_t received[PRODUCERS];
+static atomic_uint_fast64_t checksums[PRODUCERS];
+
+static void *
+produce(void *arg)
+{
+    struct record record = {
+        .producer = (uintptr_t)arg,
+    };
+
+    for (record.index = 0; record.index < RECORDS; record.index++) {
+        /* Vary the size of records */
+        size_t size = offsetof(struct record, padding)
+                    + record.index % sizeof(record.padding);
+
+        ck_assert_int_eq(rbh_mpmc_queue_push(queue, &record, size, true), 0);
+    }
+
+    return NULL;
+}
+
+static void *
+consume(void *arg)
+{
+    uint32_t last[PRODUCERS];
+    struct record *record;
+    size_t size;
+
+    (void)arg;
+    memset(last, 0xff, sizeof(last));
+
+    while ((record = rbh_mpmc_queue_acquire(queue, &size, true)) != NULL) {
+        ck_assert_uint_lt(record->producer, PRODUCERS);
+        ck_assert_uint_eq(size, offsetof(struct record, padding)
+                                + record->index % sizeof(record->padding));
+
+        /* Each consumer sees each producer's records in order */
+        if (last[record->producer] != UINT32_MAX)
+            ck_assert_uint_gt(record->index, last[record->producer]);
+        last[record->producer] = record->index;
+
+        atomic_fetch_add(&received[record->producer], 1);
+        atomic_fetch_add(&checksums[record->producer], record->index);
+        rbh_mpmc_queue_release(queue, record);
+    }
+    ck_assert_int_eq(errno, ENODATA);
+
+    return NULL;
+}
+
+START_TEST(many_to_many)
+{
+    pthread_t consumers[CONSUMERS];
+    pthread_t producers[PRODUCERS];
+
+    /* A small queue, so that producers have to wait for consumers */
+    queue = rbh_mpmc_queue_new(sizeof(struct record), 1 << 12);
+    ck_assert_ptr_nonnull(queue);
+
+    for (uintptr_t i = 0; i < CONSUMERS; i++)
+        ck_assert_int_eq(pthread_create(&consumers[i], NULL, consume, NULL),
+                         0);
+    for (uintptr_t i = 0; i < PRODUCERS; i++)
+        ck_assert_int_eq(pthread_create(&producers[i], NULL, produce,
+                                        (void *)i), 0);
+
+    for (size_t i = 0; i < PRODUCERS; i++)
+        ck_assert_int_eq(pthread_join(producers[i], NULL), 0);
+    rbh_mpmc_queue_close(queue);
+    for (size_t i = 0; i < CONSUMERS; i++)
+        ck_assert_int_eq(pthread_join(consumers[i], NULL), 0);
+
+    for (size_t i = 0; i < PRODUCERS; i++) {
+        ck_assert_uint_eq(received[i], RECORDS);
+        ck_assert_uint_eq(checksums[i], (uint64_t)RECORDS * (RECORDS - 1) / 2);
+    }
+
+    rbh_mpmc_queue_destroy(queue);
+}
+END_TEST
+
+static Suite *
+integration_suite(void)
+{
+    Suite *suite;
+    TCase *tests;
+
+    suite = suite_create("integration tests");
+
+    tests = tcase_create("threads");
+    tcase_add_test(tests, many_to_many);
+    tcase_set_timeout(tests, 60);
+
+    suite_add_tcase(suite, tests);
+
+    return suite;
+}
+
+int
+main(void)
+{
+    int number_failed;
+    SRunner *runner;
+
+    runner = srunner_create(unit_suite());
+    srunner_add_suite(runner, integration_suite());
+
+    srunner_run_all(runner, CK_NORMAL);
+    number_failed = srunner_ntests_failed(runner);
+    srunner_free(runner);
+
+    return (number_failed == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -9,11 +9,13 @@
 # include "config.h"
 #endif
 
+#include <errno.h>
 #include <stdlib.h>
 
 #include "check-compat.h"
 #include "robinhood/backend.h"
 #include "robinhood/plugin.h"
+#include "robinhood/plugins/backend.h"
 
 /*----------------------------------------------------------------------------*
  |                          Robinhood Plugin Version                          |
@@ -62,6 +64,65 @@ START_TEST(rbi_posix)
 }
 END_TEST
 
+START_TEST(rbi_cached)
+{
+    void *symbol;
+
+    symbol = rbh_plugin_import("posix", "rbh_posix_backend_new");
+    ck_assert_ptr_nonnull(symbol);
+    ck_assert_ptr_eq(rbh_plugin_import("posix", "rbh_posix_backend_new"),
+                     symbol);
+}
+END_TEST
+
+START_TEST(rbi_missing)
+{
+    ck_assert_ptr_null(rbh_plugin_import("missing", "symbol"));
+    ck_assert_int_eq(rbh_plugin_preload("missing", "symbol"), -1);
+}
+END_TEST
+
+/*----------------------------------------------------------------------------*
+ |                           rbh_plugin_register()                            |
+ *----------------------------------------------------------------------------*/
+
+static int answer = 42;
+
+START_TEST(rpr_basic)
+{
+    ck_assert_int_eq(rbh_plugin_register("builtin", "answer", &answer), 0);
+    ck_assert_ptr_eq(rbh_plugin_import("builtin", "answer"), &answer);
+    ck_assert_int_eq(rbh_plugin_preload("builtin", "answer"), 0);
+}
+END_TEST
+
+START_TEST(rpr_twice)
+{
+    ck_assert_int_eq(rbh_plugin_register("builtin", "twice", &answer), 0);
+
+    errno = 0;
+    ck_assert_int_eq(rbh_plugin_register("builtin", "twice", NULL), -1);
+    ck_assert_int_eq(errno, EEXIST);
+    ck_assert_ptr_eq(rbh_plugin_import("builtin", "twice"), &answer);
+}
+END_TEST
+
+/*----------------------------------------------------------------------------*
+ |                        rbh_backend_plugin_preload()                        |
+ *----------------------------------------------------------------------------*/
+
+START_TEST(rbpp_posix)
+{
+    const struct rbh_backend_plugin *plugin;
+
+    ck_assert_int_eq(rbh_backend_plugin_preload("posix"), 0);
+
+    plugin = rbh_backend_plugin_import("posix");
+    ck_assert_ptr_nonnull(plugin);
+    ck_assert_str_eq(plugin->plugin.name, "posix");
+}
+END_TEST
+
 static Suite *
 unit_suite(void)
 {
@@ -79,6 +140,19 @@ unit_suite(void)
 
     tests = tcase_create("rbh_plugin_import");
     tcase_add_test(tests, rbi_posix);
+    tcase_add_test(tests, rbi_cached);
+    tcase_add_test(tests, rbi_missing);
+
+    suite_add_tcase(suite, tests);
+
+    tests = tcase_create("rbh_plugin_register");
+    tcase_add_test(tests, rpr_basic);
+    tcase_add_test(tests, rpr_twice);
+
+    suite_add_tcase(suite, tests);
+
+    tests = tcase_create("rbh_backend_plugin_preload");
+    tcase_add_test(tests, rbpp_posix);
 
     suite_add_tcase(suite, tests);
 
@@ -13,12 +13,18 @@
 #include <fcntl.h>
 #include <ftw.h>
 #include <limits.h>
+#include <sched.h>
+#include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <unistd.h>
 
+#include <sys/mount.h>
+
 #include "check-compat.h"
 #include "robinhood/backends/posix.h"
+#include "robinhood/backends/posix_internal.h"
 #ifndef HAVE_STATX
 # include "robinhood/statx-compat.h"
 #endif
@@ -115,11 +121,236 @@ START_TEST(pf_empty_root)
 }
 END_TEST
 
+/* Create `directory' with `subdirs' subdirectories of `files' files each */
+static void
+make_tree(const char *directory, size_t subdirs, size_t files)
+{
+    char path[PATH_MAX];
+
+    ck_assert_int_eq(mkdir(directory, S_IRWXU), 0);
+    for (size_t i = 0; i < subdirs; i++) {
+        ck_assert_int_lt(snprintf(path, sizeof(path), "%s/%zu", directory, i),
+                         sizeof(path));
+        ck_assert_int_eq(mkdir(path, S_IRWXU), 0);
+
+        for (size_t j = 0; j < files; j++) {
+            int fd;
+
+            ck_assert_int_lt(snprintf(path, sizeof(path), "%s/%zu/%zu",
+                                      directory, i, j), sizeof(path));
+            fd = creat(path, S_IRUSR);
+            ck_assert_int_ge(fd, 0);
+            ck_assert_int_eq(close(fd), 0);
+        }
+    }
+}
+
+static size_t
+drain_with_parents(struct rbh_mut_iterator *fsentries)
+{
+    struct rbh_fsentry *fsentry;
+    size_t count = 0;
+
+    while ((fsentry = rbh_mut_iter_next(fsentries)) != NULL) {
+        /* Sampling must not lose track of parents */
+        ck_assert(fsentry->mask & RBH_FP_PARENT_ID);
+        free(fsentry);
+        count++;
+    }
+    ck_assert_int_eq(errno, ENODATA);
+
+    return count;
+}
+
+START_TEST(pf_limit)
+{
+    static const char *TREE = "limit";
+    const struct rbh_filter_options OPTIONS = {
+        .limit = 3,
+    };
+    struct rbh_mut_iterator *fsentries;
+    struct rbh_backend *posix;
+
+    make_tree(TREE, 4, 4);
+
+    posix = rbh_posix_backend_new(TREE);
+    ck_assert_ptr_nonnull(posix);
+
+    fsentries = rbh_backend_filter(posix, NULL, &OPTIONS);
+    ck_assert_ptr_nonnull(fsentries);
+
+    ck_assert_uint_eq(drain_with_parents(fsentries), 3);
+
+    rbh_mut_iter_destroy(fsentries);
+    rbh_backend_destroy(posix);
+}
+END_TEST
+
+START_TEST(pf_sample_size)
+{
+    static const char *TREE = "sample_size";
+    const struct rbh_filter_options OPTIONS = {
+        .sample = {
+            .size = 5,
+        },
+    };
+    struct rbh_mut_iterator *fsentries;
+    struct rbh_backend *posix;
+
+    make_tree(TREE, 4, 4);
+
+    posix = rbh_posix_backend_new(TREE);
+    ck_assert_ptr_nonnull(posix);
+
+    fsentries = rbh_backend_filter(posix, NULL, &OPTIONS);
+    ck_assert_ptr_nonnull(fsentries);
+
+    ck_assert_uint_eq(drain_with_parents(fsentries), 5);
+
+    rbh_mut_iter_destroy(fsentries);
+    rbh_backend_destroy(posix);
+}
+END_TEST
+
+START_TEST(pf_sample_rate)
+{
+    static const char *TREE = "sample_rate";
+    const struct rbh_filter_options OPTIONS = {
+        .sample = {
+            .rate = 0.5,
+        },
+    };
+    struct rbh_mut_iterator *fsentries;
+    struct rbh_backend *posix;
+    size_t count;
+
+    /* 1 + 20 + 20 * 19 = 401 entries */
+    make_tree(TREE, 20, 19);
+
+    posix = rbh_posix_backend_new(TREE);
+    ck_assert_ptr_nonnull(posix);
+
+    fsentries = rbh_backend_filter(posix, NULL, &OPTIONS);
+    ck_assert_ptr_nonnull(fsentries);
+
+    /* More than 6 standard deviations away from the expected 200 */
+    count = drain_with_parents(fsentries);
+    ck_assert_uint_gt(count, 140);
+    ck_assert_uint_lt(count, 260);
+
+    rbh_mut_iter_destroy(fsentries);
+    rbh_backend_destroy(posix);
+}
+END_TEST
+
+START_TEST(pf_sample_invalid)
+{
+    static const char *EMPTY = "sample_invalid";
+    const struct rbh_filter_options OPTIONS = {
+        .sample = {
+            .rate = 2.,
+        },
+    };
+    struct rbh_backend *posix;
+
+    ck_assert_int_eq(mkdir(EMPTY, S_IRWXU), 0);
+
+    posix = rbh_posix_backend_new(EMPTY);
+    ck_assert_ptr_nonnull(posix);
+
+    errno = 0;
+    ck_assert_ptr_null(rbh_backend_filter(posix, NULL, &OPTIONS));
+    ck_assert_int_eq(errno, EINVAL);
+
+    rbh_backend_destroy(posix);
+}
+END_TEST
+
+/*----------------------------------------------------------------------------*
+ |                          posix filter_partitioned                          |
+ *----------------------------------------------------------------------------*/
+
+START_TEST(pfp_partitions)
+{
+    static const char *TREE = "partitioned";
+    const struct rbh_filter_options OPTIONS = {};
+    struct rbh_mut_iterator *partitions[3];
+    struct rbh_backend *posix;
+    size_t total = 0;
+
+    make_tree(TREE, 4, 4);
+
+    posix = rbh_posix_backend_new(TREE);
+    ck_assert_ptr_nonnull(posix);
+
+    ck_assert_int_eq(rbh_backend_filter_partitioned(posix, NULL, &OPTIONS,
+                                                    partitions, 3), 0);
+
+    for (size_t i = 0; i < 3; i++) {
+        size_t count = drain_with_parents(partitions[i]);
+
+        /* Every partition gets at least one subtree of 5 entries */
+        ck_assert_uint_ge(count, 5);
+        total += count;
+        rbh_mut_iter_destroy(partitions[i]);
+    }
+    rbh_backend_destroy(posix);
+
+    /* The root, 4 directories, and 4 files in each of them */
+    ck_assert_uint_eq(total, 21);
+}
+END_TEST
+
+START_TEST(pfp_more_partitions_than_subtrees)
+{
+    static const char *TREE = "more_partitions";
+    const struct rbh_filter_options OPTIONS = {};
+    struct rbh_mut_iterator *partitions[4];
+    struct rbh_backend *posix;
+    size_t total = 0;
+
+    make_tree(TREE, 2, 1);
+
+    posix = rbh_posix_backend_new(TREE);
+    ck_assert_ptr_nonnull(posix);
+
+    ck_assert_int_eq(rbh_backend_filter_partitioned(posix, NULL, &OPTIONS,
+                                                    partitions, 4), 0);
+
+    for (size_t i = 0; i < 4; i++) {
+        total += drain_with_parents(partitions[i]);
+        rbh_mut_iter_destroy(partitions[i]);
+    }
+
+    ck_assert_uint_eq(total, 5);
+    rbh_backend_destroy(posix);
+}
+END_TEST
+
+START_TEST(pfp_limit)
+{
+    const struct rbh_filter_options OPTIONS = {
+        .limit = 1,
+    };
+    struct rbh_mut_iterator *partitions[2];
+    struct rbh_backend *posix;
+
+    posix = rbh_posix_backend_new("");
+    ck_assert_ptr_nonnull(posix);
+
+    ck_assert_int_eq(rbh_backend_filter_partitioned(posix, NULL, &OPTIONS,
+                                                    partitions, 2), -1);
+    ck_assert_int_eq(errno, ENOTSUP);
+
+    rbh_backend_destroy(posix);
+}
+END_TEST
+
 /*----------------------------------------------------------------------------*
  |                               posix options                                |
  *----------------------------------------------------------------------------*/
 
-static const unsigned int PBO_MAX = RBH_PBO_STATX_SYNC_TYPE + 1;
+static const unsigned int PBO_MAX = RBH_PBO_MAX_PARTITIONS_PER_GROUP + 1;
 
 START_TEST(pbo_get_unknown)
 {
@@ -154,6 +385,8 @@ END_TEST
 
 static const size_t PBO_SIZES[] = {
     [BO_INDEX(RBH_PBO_STATX_SYNC_TYPE)] = sizeof(int),
+    [BO_INDEX(RBH_PBO_SHARD)] = sizeof(struct rbh_posix_shard),
+    [BO_INDEX(RBH_PBO_MAX_PARTITIONS_PER_GROUP)] = sizeof(uint32_t),
 };
 
 START_TEST(pbo_get_sizes)
@@ -186,9 +419,17 @@ START_TEST(pbo_get_sizes)
 END_TEST
 
 static const int PSST_DEFAULT = AT_STATX_SYNC_AS_STAT;
+static const struct rbh_posix_shard PS_DEFAULT = {
+    .index = 0,
+    .count = 1,
+};
+
+static const uint32_t PMPPG_DEFAULT = 0;
 
 static const void *PBO_DEFAULTS[] = {
     [BO_INDEX(RBH_PBO_STATX_SYNC_TYPE)] = &PSST_DEFAULT,
+    [BO_INDEX(RBH_PBO_SHARD)] = &PS_DEFAULT,
+    [BO_INDEX(RBH_PBO_MAX_PARTITIONS_PER_GROUP)] = &PMPPG_DEFAULT,
 };
 
 START_TEST(pbo_defaults)
@@ -247,8 +488,29 @@ static const void * const RSST_INVALIDS[] = {
     NULL,
 };
 
+static const struct rbh_posix_shard PS_NO_SHARDS = {
+    .index = 0,
+    .count = 0,
+};
+static const struct rbh_posix_shard PS_OUT_OF_RANGE = {
+    .index = 4,
+    .count = 4,
+};
+
+static const void * const PS_INVALIDS[] = {
+    &PS_NO_SHARDS,
+    &PS_OUT_OF_RANGE,
+    NULL,
+};
+
+static const void * const PMPPG_INVALIDS[] = {
+    NULL,
+};
+
 static const void * const * const RPBO_INVALIDS[] = {
     [BO_INDEX(RBH_PBO_STATX_SYNC_TYPE)] = RSST_INVALIDS,
+    [BO_INDEX(RBH_PBO_SHARD)] = PS_INVALIDS,
+    [BO_INDEX(RBH_PBO_MAX_PARTITIONS_PER_GROUP)] = PMPPG_INVALIDS,
 };
 
 START_TEST(pbo_set_invalids)
@@ -279,8 +541,18 @@ static const void * const RSST_UNSUPPORTEDS[] = {
     NULL,
 };
 
+static const void * const PS_UNSUPPORTEDS[] = {
+    NULL,
+};
+
+static const void * const PMPPG_UNSUPPORTEDS[] = {
+    NULL,
+};
+
 static const void * const * const RPBO_UNSUPPORTEDS[] = {
     [BO_INDEX(RBH_PBO_STATX_SYNC_TYPE)] = RSST_UNSUPPORTEDS,
+    [BO_INDEX(RBH_PBO_SHARD)] = PS_UNSUPPORTEDS,
+    [BO_INDEX(RBH_PBO_MAX_PARTITIONS_PER_GROUP)] = PMPPG_UNSUPPORTEDS,
 };
 
 START_TEST(pbo_set_unsupporteds)
@@ -314,8 +586,36 @@ static const void * const RSST_VALIDS[] = {
     NULL,
 };
 
+static const struct rbh_posix_shard PS_FIRST = {
+    .index = 0,
+    .count = 4,
+};
+static const struct rbh_posix_shard PS_LAST = {
+    .index = 3,
+    .count = 4,
+};
+
+static const void * const PS_VALIDS[] = {
+    &PS_DEFAULT,
+    &PS_FIRST,
+    &PS_LAST,
+    NULL,
+};
+
+static const uint32_t PMPPG_ONE = 1;
+static const uint32_t PMPPG_MANY = 64;
+
+static const void * const PMPPG_VALIDS[] = {
+    &PMPPG_DEFAULT,
+    &PMPPG_ONE,
+    &PMPPG_MANY,
+    NULL,
+};
+
 static const void * const * const RBPO_VALIDS[] = {
     [BO_INDEX(RBH_PBO_STATX_SYNC_TYPE)] = RSST_VALIDS,
+    [BO_INDEX(RBH_PBO_SHARD)] = PS_VALIDS,
+    [BO_INDEX(RBH_PBO_MAX_PARTITIONS_PER_GROUP)] = PMPPG_VALIDS,
 };
 
 START_TEST(pbo_set_valids)
@@ -343,6 +643,591 @@ START_TEST(pbo_set_valids)
 }
 END_TEST
 
+/*----------------------------------------------------------------------------*
+ |                                posix shards                                |
+ *----------------------------------------------------------------------------*/
+
+static const char *
+fsentry_path(const struct rbh_fsentry *fsentry)
+{
+    for (size_t i = 0; i < fsentry->xattrs.ns.count; i++) {
+        const struct rbh_value_pair *pair = &fsentry->xattrs.ns.pairs[i];
+
+        if (strcmp(pair->key, "path") == 0)
+            return pair->value->string;
+    }
+    ck_abort_msg("fsentry without a path");
+    return NULL;
+}
+
+static int
+strcmp_ptr(const void *first, const void *second)
+{
+    return strcmp(*(const char * const *)first, *(const char * const *)second);
+}
+
+/* Drain `fsentries' into `paths', return the number of paths added */
+static size_t
+drain_paths(struct rbh_mut_iterator *fsentries, char **paths)
+{
+    struct rbh_fsentry *fsentry;
+    size_t count = 0;
+
+    while ((fsentry = rbh_mut_iter_next(fsentries)) != NULL) {
+        paths[count] = strdup(fsentry_path(fsentry));
+        ck_assert_ptr_nonnull(paths[count]);
+        free(fsentry);
+        count++;
+    }
+    ck_assert_int_eq(errno, ENODATA);
+    rbh_mut_iter_destroy(fsentries);
+
+    return count;
+}
+
+/* Check that `paths' holds the `count' distinct paths of a tree */
+static void
+assert_complete(char **paths, size_t count, size_t expected)
+{
+    ck_assert_uint_eq(count, expected);
+
+    qsort(paths, count, sizeof(*paths), strcmp_ptr);
+    for (size_t i = 1; i < count; i++)
+        ck_assert_str_ne(paths[i - 1], paths[i]);
+
+    for (size_t i = 0; i < count; i++)
+        free(paths[i]);
+}
+
+START_TEST(ps_filter)
+{
+    static const char *TREE = "shards";
+    const struct rbh_filter_options OPTIONS = {};
+    struct rbh_posix_shard shard = {
+        .count = 3,
+    };
+    struct rbh_backend *posix;
+    char *paths[32];
+    size_t count = 0;
+
+    make_tree(TREE, 4, 4);
+
+    posix = rbh_posix_backend_new(TREE);
+    ck_assert_ptr_nonnull(posix);
+
+    for (shard.index = 0; shard.index < shard.count; shard.index++) {
+        struct rbh_mut_iterator *fsentries;
+
+        ck_assert_int_eq(rbh_backend_set_option(posix, RBH_PBO_SHARD, &shard,
+                                                sizeof(shard)), 0);
+
+        fsentries = rbh_backend_filter(posix, NULL, &OPTIONS);
+        ck_assert_ptr_nonnull(fsentries);
+        count += drain_paths(fsentries, &paths[count]);
+    }
+
+    /* The root, 4 directories, and 4 files in each of them */
+    assert_complete(paths, count, 21);
+    rbh_backend_destroy(posix);
+}
+END_TEST
+
+START_TEST(ps_root)
+{
+    const struct rbh_filter_projection ID_ONLY = {
+        .fsentry_mask = RBH_FP_ID,
+    };
+    struct rbh_posix_shard shard = {
+        .count = 2,
+    };
+    struct rbh_backend *posix;
+
+    posix = rbh_posix_backend_new("");
+    ck_assert_ptr_nonnull(posix);
+
+    /* The root can be looked up from any shard */
+    for (shard.index = 0; shard.index < shard.count; shard.index++) {
+        struct rbh_fsentry *root;
+
+        ck_assert_int_eq(rbh_backend_set_option(posix, RBH_PBO_SHARD, &shard,
+                                                sizeof(shard)), 0);
+
+        root = rbh_backend_root(posix, &ID_ONLY);
+        ck_assert_ptr_nonnull(root);
+        ck_assert_uint_eq(root->parent_id.size, 0);
+        free(root);
+    }
+
+    rbh_backend_destroy(posix);
+}
+END_TEST
+
+START_TEST(ps_filter_partitioned)
+{
+    static const char *TREE = "partitioned_shards";
+    const struct rbh_filter_options OPTIONS = {};
+    struct rbh_posix_shard shard = {
+        .count = 2,
+    };
+    struct rbh_backend *posix;
+    char *paths[32];
+    size_t count = 0;
+
+    make_tree(TREE, 3, 3);
+
+    posix = rbh_posix_backend_new(TREE);
+    ck_assert_ptr_nonnull(posix);
+
+    for (shard.index = 0; shard.index < shard.count; shard.index++) {
+        struct rbh_mut_iterator *partitions[2];
+
+        ck_assert_int_eq(rbh_backend_set_option(posix, RBH_PBO_SHARD, &shard,
+                                                sizeof(shard)), 0);
+
+        ck_assert_int_eq(rbh_backend_filter_partitioned(posix, NULL, &OPTIONS,
+                                                        partitions, 2), 0);
+        for (size_t i = 0; i < 2; i++)
+            count += drain_paths(partitions[i], &paths[count]);
+    }
+
+    /* The root, 3 directories, and 3 files in each of them */
+    assert_complete(paths, count, 13);
+    rbh_backend_destroy(posix);
+}
+END_TEST
+
+/* Check that `first' and `second' hold the same paths, and free them */
+static void
+assert_same(char **first, size_t first_count, char **second,
+            size_t second_count)
+{
+    ck_assert_uint_eq(first_count, second_count);
+
+    qsort(first, first_count, sizeof(*first), strcmp_ptr);
+    qsort(second, second_count, sizeof(*second), strcmp_ptr);
+    for (size_t i = 0; i < first_count; i++)
+        ck_assert_str_eq(first[i], second[i]);
+
+    for (size_t i = 0; i < first_count; i++) {
+        free(first[i]);
+        free(second[i]);
+    }
+}
+
+/* Mount a tmpfs on `directory', in a mount namespace of our own
+ *
+ * Returns false if that is not allowed.
+ */
+static bool
+mount_tmpfs(const char *directory)
+{
+    ck_assert_int_eq(mkdir(directory, S_IRWXU), 0);
+
+    if (unshare(CLONE_NEWNS)) {
+        ck_assert_int_eq(errno, EPERM);
+        return false;
+    }
+
+    /* Do not propagate mounts to the parent namespace */
+    ck_assert_int_eq(mount(NULL, "/", NULL, MS_REC | MS_PRIVATE, NULL), 0);
+    ck_assert_int_eq(mount("tmpfs", directory, "tmpfs", 0, NULL), 0);
+    return true;
+}
+
+START_TEST(ps_filter_partitioned_xdev)
+{
+    static const char *TREE = "partitioned_xdev";
+    const struct rbh_filter_options OPTIONS = {};
+    struct rbh_posix_shard shard;
+    struct rbh_backend *posix;
+    char tree[PATH_MAX];
+    char path[PATH_MAX];
+    char *expected[32];
+    char *paths[32];
+
+    make_tree(TREE, 3, 3);
+
+    /* The tmpfs is a subtree of its own, with children that must not be
+     * walked
+     */
+    ck_assert_int_lt(snprintf(path, sizeof(path), "%s/tmpfs", TREE),
+                     sizeof(path));
+    if (!mount_tmpfs(path))
+        return;
+    ck_assert_int_lt(snprintf(tree, sizeof(tree), "%s/tree", path),
+                     sizeof(tree));
+    make_tree(tree, 1, 3);
+
+    posix = rbh_posix_backend_new(TREE);
+    ck_assert_ptr_nonnull(posix);
+
+    /* Whether the children of the root and the ones of the tmpfs belong to
+     * the same shard depends on their IDs, try a few shard counts
+     */
+    for (shard.count = 2; shard.count <= 4; shard.count++) {
+        for (shard.index = 0; shard.index < shard.count; shard.index++) {
+            struct rbh_mut_iterator *partitions[2];
+            struct rbh_mut_iterator *fsentries;
+            size_t expected_count;
+            size_t count = 0;
+
+            ck_assert_int_eq(rbh_backend_set_option(posix, RBH_PBO_SHARD,
+                                                    &shard, sizeof(shard)),
+                             0);
+
+            /* Filters do not cross filesystems either */
+            fsentries = rbh_backend_filter(posix, NULL, &OPTIONS);
+            ck_assert_ptr_nonnull(fsentries);
+            expected_count = drain_paths(fsentries, expected);
+
+            ck_assert_int_eq(rbh_backend_filter_partitioned(posix, NULL,
+                                                            &OPTIONS,
+                                                            partitions, 2),
+                             0);
+            for (size_t i = 0; i < 2; i++)
+                count += drain_paths(partitions[i], &paths[count]);
+
+            assert_same(expected, expected_count, paths, count);
+        }
+    }
+
+    rbh_backend_destroy(posix);
+    ck_assert_int_eq(umount(path), 0);
+}
+END_TEST
+
+/*----------------------------------------------------------------------------*
+ |                                posix groups                                |
+ *----------------------------------------------------------------------------*/
+
+/* The trees of make_tree() have numbered subdirectories, group them by their
+ * number, modulo `groups'.
+ */
+static int groups;
+
+/* Stands in for lustre's MDT lookup */
+static int
+group_of_fd(int fd)
+{
+    char path[PATH_MAX];
+    char link[64];
+    ssize_t length;
+
+    ck_assert_int_lt(snprintf(link, sizeof(link), "/proc/self/fd/%d", fd),
+                     sizeof(link));
+    length = readlink(link, path, sizeof(path) - 1);
+    ck_assert_int_ge(length, 0);
+    path[length] = '\0';
+
+    return atoi(strrchr(path, '/') + 1) % groups;
+}
+
+static struct rbh_backend *
+grouped_backend_new(const char *path, uint32_t max_partitions_per_group)
+{
+    struct rbh_backend *posix;
+
+    posix = rbh_posix_backend_new(path);
+    ck_assert_ptr_nonnull(posix);
+
+    ((struct posix_backend *)posix)->group_of = group_of_fd;
+    ck_assert_int_eq(
+            rbh_backend_set_option(posix, RBH_PBO_MAX_PARTITIONS_PER_GROUP,
+                                   &max_partitions_per_group,
+                                   sizeof(max_partitions_per_group)),
+            0
+            );
+
+    return posix;
+}
+
+/* Drain `count' partitions, return the number of fsentries they yield
+ *
+ * The bit of each group a partition walks is set in `masks'.
+ */
+static size_t
+drain_groups(struct rbh_mut_iterator **partitions, size_t count,
+             unsigned int *masks)
+{
+    size_t total = 0;
+
+    for (size_t i = 0; i < count; i++) {
+        struct rbh_fsentry *fsentry;
+
+        masks[i] = 0;
+        while ((fsentry = rbh_mut_iter_next(partitions[i])) != NULL) {
+            const char *path = fsentry_path(fsentry);
+
+            /* Fsentries belong to the group of their top-level directory */
+            if (strcmp(path, "/"))
+                masks[i] |= 1U << (atoi(path + 1) % groups);
+            free(fsentry);
+            total++;
+        }
+        ck_assert_int_eq(errno, ENODATA);
+        rbh_mut_iter_destroy(partitions[i]);
+    }
+
+    return total;
+}
+
+/* Count the partitions which walk `group' */
+static size_t
+walkers(const unsigned int *masks, size_t count, int group)
+{
+    size_t walkers = 0;
+
+    for (size_t i = 0; i < count; i++) {
+        if (masks[i] & (1U << group))
+            walkers++;
+    }
+    return walkers;
+}
+
+START_TEST(pg_one_group_per_partition)
+{
+    static const char *TREE = "groups";
+    const struct rbh_filter_options OPTIONS = {};
+    struct rbh_mut_iterator *partitions[4];
+    struct rbh_backend *posix;
+    unsigned int masks[4];
+
+    make_tree(TREE, 6, 4);
+    groups = 2;
+
+    posix = grouped_backend_new(TREE, 0);
+    ck_assert_int_eq(rbh_backend_filter_partitioned(posix, NULL, &OPTIONS,
+                                                    partitions, 4), 0);
+
+    /* The root, 6 directories, and 4 files in each of them */
+    ck_assert_uint_eq(drain_groups(partitions, 4, masks), 31);
+    rbh_backend_destroy(posix);
+
+    /* Each group is worth 2 partitions, which only walk their own group */
+    for (size_t i = 0; i < 4; i++)
+        ck_assert(masks[i] == 1U || masks[i] == 2U);
+    for (int group = 0; group < groups; group++)
+        ck_assert_uint_eq(walkers(masks, 4, group), 2);
+}
+END_TEST
+
+START_TEST(pg_max_partitions_per_group)
+{
+    static const char *TREE = "max_partitions_per_group";
+    const struct rbh_filter_options OPTIONS = {};
+    struct rbh_mut_iterator *partitions[4];
+    struct rbh_backend *posix;
+    unsigned int masks[4];
+    size_t idle = 0;
+
+    make_tree(TREE, 6, 4);
+    groups = 2;
+
+    posix = grouped_backend_new(TREE, 1);
+    ck_assert_int_eq(rbh_backend_filter_partitioned(posix, NULL, &OPTIONS,
+                                                    partitions, 4), 0);
+
+    ck_assert_uint_eq(drain_groups(partitions, 4, masks), 31);
+    rbh_backend_destroy(posix);
+
+    for (int group = 0; group < groups; group++)
+        ck_assert_uint_eq(walkers(masks, 4, group), 1);
+
+    /* Partitions beyond the limit are left idle */
+    for (size_t i = 0; i < 4; i++) {
+        if (masks[i] == 0)
+            idle++;
+    }
+    ck_assert_uint_eq(idle, 2);
+}
+END_TEST
+
+START_TEST(pg_surplus_partitions)
+{
+    static const char *TREE = "surplus_partitions";
+    const struct rbh_filter_options OPTIONS = {};
+    struct rbh_mut_iterator *partitions[4];
+    size_t sizes[4] = { 0 };
+    struct rbh_backend *posix;
+    char path[PATH_MAX];
+    size_t total = 0;
+
+    make_tree(TREE, 2, 4);
+    groups = 2;
+
+    /* Top-level files do not belong to any group */
+    for (size_t i = 0; i < 4; i++) {
+        int fd;
+
+        ck_assert_int_lt(snprintf(path, sizeof(path), "%s/file-%zu", TREE, i),
+                         sizeof(path));
+        fd = creat(path, S_IRUSR);
+        ck_assert_int_ge(fd, 0);
+        ck_assert_int_eq(close(fd), 0);
+    }
+
+    posix = grouped_backend_new(TREE, 1);
+    ck_assert_int_eq(rbh_backend_filter_partitioned(posix, NULL, &OPTIONS,
+                                                    partitions, 4), 0);
+
+    for (size_t i = 0; i < 4; i++) {
+        struct rbh_fsentry *fsentry;
+
+        while ((fsentry = rbh_mut_iter_next(partitions[i])) != NULL) {
+            const char *name = fsentry_path(fsentry);
+
+            /* Partitions beyond the limit only walk ungrouped entries */
+            if (i >= (size_t)groups)
+                ck_assert_int_eq(strncmp(name, "/file-", 6), 0);
+            free(fsentry);
+            sizes[i]++;
+        }
+        ck_assert_int_eq(errno, ENODATA);
+        rbh_mut_iter_destroy(partitions[i]);
+        total += sizes[i];
+    }
+    rbh_backend_destroy(posix);
+
+    /* The root, 2 directories, 4 files in each of them, and 4 more files */
+    ck_assert_uint_eq(total, 15);
+
+    /* No partition is left empty */
+    for (size_t i = 0; i < 4; i++)
+        ck_assert_uint_ne(sizes[i], 0);
+}
+END_TEST
+
+START_TEST(pg_more_groups_than_partitions)
+{
+    static const char *TREE = "more_groups";
+    const struct rbh_filter_options OPTIONS = {};
+    struct rbh_mut_iterator *partitions[3];
+    struct rbh_backend *posix;
+    unsigned int masks[3];
+
+    make_tree(TREE, 6, 4);
+    groups = 4;
+
+    posix = grouped_backend_new(TREE, 0);
+    ck_assert_int_eq(rbh_backend_filter_partitioned(posix, NULL, &OPTIONS,
+                                                    partitions, 3), 0);
+
+    ck_assert_uint_eq(drain_groups(partitions, 3, masks), 31);
+    rbh_backend_destroy(posix);
+
+    /* Whole groups are dealt to partitions */
+    for (int group = 0; group < groups; group++)
+        ck_assert_uint_eq(walkers(masks, 3, group), 1);
+    for (size_t i = 0; i < 3; i++)
+        ck_assert_uint_ne(masks[i], 0);
+}
+END_TEST
+
+/*----------------------------------------------------------------------------*
+ |                                posix clone                                 |
+ *----------------------------------------------------------------------------*/
+
+START_TEST(pc_filter)
+{
+    static const char *TREE = "clone";
+    const struct rbh_filter_options OPTIONS = {};
+    struct rbh_mut_iterator *fsentries;
+    struct rbh_backend *posix;
+    struct rbh_backend *clone;
+
+    make_tree(TREE, 2, 2);
+
+    posix = rbh_posix_backend_new(TREE);
+    ck_assert_ptr_nonnull(posix);
+
+    clone = rbh_backend_clone(posix);
+    ck_assert_ptr_nonnull(clone);
+    ck_assert_uint_eq(clone->id, posix->id);
+
+    /* Clones may outlive the backend they were cloned from */
+    rbh_backend_destroy(posix);
+
+    fsentries = rbh_backend_filter(clone, NULL, &OPTIONS);
+    ck_assert_ptr_nonnull(fsentries);
+
+    /* The root, 2 directories, and 2 files in each of them */
+    ck_assert_uint_eq(drain_with_parents(fsentries), 7);
+
+    rbh_mut_iter_destroy(fsentries);
+    rbh_backend_destroy(clone);
+}
+END_TEST
+
+START_TEST(pc_options)
+{
+    const int force_sync = AT_STATX_FORCE_SYNC;
+    const int dont_sync = AT_STATX_DONT_SYNC;
+    struct rbh_backend *posix;
+    struct rbh_backend *clone;
+    size_t size = sizeof(int);
+    int value;
+
+    posix = rbh_posix_backend_new("");
+    ck_assert_ptr_nonnull(posix);
+
+    ck_assert_int_eq(rbh_backend_set_option(posix, RBH_PBO_STATX_SYNC_TYPE,
+                                            &force_sync, sizeof(force_sync)),
+                     0);
+
+    clone = rbh_backend_clone(posix);
+    ck_assert_ptr_nonnull(clone);
+
+    ck_assert_int_eq(rbh_backend_get_option(clone, RBH_PBO_STATX_SYNC_TYPE,
+                                            &value, &size), 0);
+    ck_assert_int_eq(value, force_sync);
+
+    /* Options are not shared */
+    ck_assert_int_eq(rbh_backend_set_option(clone, RBH_PBO_STATX_SYNC_TYPE,
+                                            &dont_sync, sizeof(dont_sync)),
+                     0);
+    ck_assert_int_eq(rbh_backend_get_option(posix, RBH_PBO_STATX_SYNC_TYPE,
+                                            &value, &size), 0);
+    ck_assert_int_eq(value, force_sync);
+
+    rbh_backend_destroy(clone);
+    rbh_backend_destroy(posix);
+}
+END_TEST
+
+START_TEST(pc_branch)
+{
+    static const char *TREE = "clone_branch";
+    const struct rbh_filter_projection ID_ONLY = {
+        .fsentry_mask = RBH_FP_ID,
+    };
+    struct rbh_backend *branch;
+    struct rbh_backend *posix;
+    struct rbh_backend *clone;
+    struct rbh_fsentry *fsentry;
+
+    ck_assert_int_eq(mkdir(TREE, S_IRWXU), 0);
+
+    posix = rbh_posix_backend_new(TREE);
+    ck_assert_ptr_nonnull(posix);
+
+    fsentry = rbh_backend_root(posix, &ID_ONLY);
+    ck_assert_ptr_nonnull(fsentry);
+    ck_assert(fsentry->mask & RBH_FP_ID);
+
+    branch = rbh_backend_branch(posix, &fsentry->id);
+    ck_assert_ptr_nonnull(branch);
+    free(fsentry);
+    rbh_backend_destroy(posix);
+
+    clone = rbh_backend_clone(branch);
+    ck_assert_ptr_nonnull(clone);
+    ck_assert_ptr_eq(clone->ops, branch->ops);
+
+    rbh_backend_destroy(branch);
+    rbh_backend_destroy(clone);
+}
+END_TEST
+
 static Suite *
 unit_suite(void)
 {
@@ -355,6 +1240,19 @@ unit_suite(void)
                                 unchecked_teardown_tmpdir);
     tcase_add_test(tests, pf_missing_root);
     tcase_add_test(tests, pf_empty_root);
+    tcase_add_test(tests, pf_limit);
+    tcase_add_test(tests, pf_sample_size);
+    tcase_add_test(tests, pf_sample_rate);
+    tcase_add_test(tests, pf_sample_invalid);
+
+    suite_add_tcase(suite, tests);
+
+    tests = tcase_create("filter_partitioned");
+    tcase_add_unchecked_fixture(tests, unchecked_setup_tmpdir,
+                                unchecked_teardown_tmpdir);
+    tcase_add_test(tests, pfp_partitions);
+    tcase_add_test(tests, pfp_more_partitions_than_subtrees);
+    tcase_add_test(tests, pfp_limit);
 
     suite_add_tcase(suite, tests);
 
@@ -373,6 +1271,35 @@ unit_suite(void)
 
     suite_add_tcase(suite, tests);
 
+    tests = tcase_create("shards");
+    tcase_add_unchecked_fixture(tests, unchecked_setup_tmpdir,
+                                unchecked_teardown_tmpdir);
+    tcase_add_test(tests, ps_filter);
+    tcase_add_test(tests, ps_root);
+    tcase_add_test(tests, ps_filter_partitioned);
+    tcase_add_test(tests, ps_filter_partitioned_xdev);
+
+    suite_add_tcase(suite, tests);
+
+    tests = tcase_create("groups");
+    tcase_add_unchecked_fixture(tests, unchecked_setup_tmpdir,
+                                unchecked_teardown_tmpdir);
+    tcase_add_test(tests, pg_one_group_per_partition);
+    tcase_add_test(tests, pg_max_partitions_per_group);
+    tcase_add_test(tests, pg_surplus_partitions);
+    tcase_add_test(tests, pg_more_groups_than_partitions);
+
+    suite_add_tcase(suite, tests);
+
+    tests = tcase_create("clone");
+    tcase_add_unchecked_fixture(tests, unchecked_setup_tmpdir,
+                                unchecked_teardown_tmpdir);
+    tcase_add_test(tests, pc_filter);
+    tcase_add_test(tests, pc_options);
+    tcase_add_test(tests, pc_branch);
+
+    suite_add_tcase(suite, tests);
+
     return suite;
 }
 
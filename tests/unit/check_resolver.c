@@ -0,0 +1,389 @@
+/* This file is part of the RobinHood Library
+ * Copyright (C) 2022 Commissariat a l'energie atomique et aux energies
+ *                    alternatives
+ *
+ * SPDX-License-Identifer: LGPL-3.0-or-later
+ */
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <errno.h>
+#include <fcntl.h>
+#include <ftw.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "check-compat.h"
+#include "robinhood/fsentry.h"
+#include "robinhood/resolver.h"
+
+#include "utils.h"
+
+/*----------------------------------------------------------------------------*
+ |                     fixtures to run tests in isolation                     |
+ *----------------------------------------------------------------------------*/
+
+static const char TMPDIR[] = "/tmp/tmp.d.XXXXXX";
+static __thread char tmpdir[sizeof(TMPDIR)];
+
+static void
+unchecked_setup_tmpdir(void)
+{
+    memcpy(tmpdir, TMPDIR, sizeof(tmpdir));
+    ck_assert_ptr_nonnull(mkdtemp(tmpdir));
+    ck_assert_int_eq(chdir(tmpdir), 0);
+}
+
+static int
+delete(const char *fpath, const struct stat *sb, int typeflags,
+       struct FTW * ftwbuf)
+{
+    ck_assert_int_eq(remove(fpath), 0);
+    return 0;
+}
+
+#ifndef NOPENFD
+#define NOPENFD (16)
+#endif
+
+static void
+unchecked_teardown_tmpdir(void)
+{
+    ck_assert_int_eq(
+            nftw(tmpdir, delete, NOPENFD, FTW_DEPTH | FTW_MOUNT | FTW_PHYS), 0
+            );
+}
+
+static struct rbh_id *
+id_from_path(const char *path)
+{
+    struct file_handle *handle;
+    struct rbh_id *id;
+    int mount_id;
+
+    handle = malloc(sizeof(*handle) + MAX_HANDLE_SZ);
+    ck_assert_ptr_nonnull(handle);
+    handle->handle_bytes = MAX_HANDLE_SZ;
+
+    ck_assert_int_eq(name_to_handle_at(AT_FDCWD, path, handle, &mount_id, 0),
+                     0);
+    id = rbh_id_from_file_handle(handle);
+    ck_assert_ptr_nonnull(id);
+
+    free(handle);
+    return id;
+}
+
+/*----------------------------------------------------------------------------*
+ |                             rbh_resolver_new()                             |
+ *----------------------------------------------------------------------------*/
+
+START_TEST(rrn_missing_root)
+{
+    errno = 0;
+    ck_assert_ptr_null(rbh_resolver_new("missing", 1, 0));
+    ck_assert_int_eq(errno, ENOENT);
+}
+END_TEST
+
+START_TEST(rrn_batch)
+{
+    const char *PATHS[] = { ".", "a", "a/b", "a/b/c", "a/d" };
+    const char *EXPECTED[] = { "/", "/a", "/a/b", "/a/b/c", "/a/d" };
+    struct rbh_id ids[2 * ARRAY_SIZE(PATHS)];
+    struct rbh_id *_ids[ARRAY_SIZE(PATHS)];
+    struct rbh_resolver *resolver;
+    char *paths[ARRAY_SIZE(ids)];
+    char directory[16];
+    int fd;
+
+    /* Loop tests share the same temporary directory */
+    sprintf(directory, "%d", _i);
+    ck_assert_int_eq(mkdir(directory, S_IRWXU), 0);
+    ck_assert_int_eq(chdir(directory), 0);
+
+    ck_assert_int_eq(mkdir("a", S_IRWXU), 0);
+    ck_assert_int_eq(mkdir("a/b", S_IRWXU), 0);
+    fd = open("a/b/c", O_WRONLY | O_CREAT | O_EXCL, S_IRWXU);
+    ck_assert_int_ge(fd, 0);
+    ck_assert_int_eq(close(fd), 0);
+    ck_assert_int_eq(symlink("b", "a/d"), 0);
+
+    for (size_t i = 0; i < ARRAY_SIZE(PATHS); i++) {
+        _ids[i] = id_from_path(PATHS[i]);
+        ids[i] = ids[ARRAY_SIZE(PATHS) + i] = *_ids[i];
+    }
+
+    resolver = rbh_resolver_new(".", _i + 1, _i * 4);
+    ck_assert_ptr_nonnull(resolver);
+
+    /* Every ID twice, the second one may come from the cache */
+    ck_assert_int_eq(rbh_resolver_resolve(resolver, ids, ARRAY_SIZE(ids),
+                                          paths), ARRAY_SIZE(ids));
+    for (size_t i = 0; i < ARRAY_SIZE(ids); i++) {
+        ck_assert_str_eq(paths[i], EXPECTED[i % ARRAY_SIZE(PATHS)]);
+        free(paths[i]);
+    }
+
+    rbh_resolver_destroy(resolver);
+    for (size_t i = 0; i < ARRAY_SIZE(PATHS); i++)
+        free(_ids[i]);
+
+    ck_assert_int_eq(chdir(".."), 0);
+}
+END_TEST
+
+START_TEST(rrn_unresolvable)
+{
+    const struct rbh_id IDS[] = {
+        {
+            .data = "not a file handle",
+            .size = 3,
+        },
+    };
+    struct rbh_resolver *resolver;
+    char *paths[ARRAY_SIZE(IDS)];
+
+    resolver = rbh_resolver_new(".", 2, 0);
+    ck_assert_ptr_nonnull(resolver);
+
+    ck_assert_int_eq(rbh_resolver_resolve(resolver, IDS, ARRAY_SIZE(IDS),
+                                          paths), 0);
+    ck_assert_ptr_null(paths[0]);
+
+    rbh_resolver_destroy(resolver);
+}
+END_TEST
+
+/*----------------------------------------------------------------------------*
+ |                         rbh_resolver_from_backend()                        |
+ *----------------------------------------------------------------------------*/
+
+/*   /
+ *   |-- a
+ *   |   |-- b
+ *   |   `-- c
+ *   `-- orphan (its parent is not in the backend)
+ */
+static const struct {
+    struct rbh_id id;
+    struct rbh_id parent_id;
+    const char *name;
+} ENTRIES[] = {
+    {
+        .id = { .data = "/", .size = 1, },
+        .parent_id = { .data = NULL, .size = 0, },
+        .name = "",
+    }, {
+        .id = { .data = "a", .size = 1, },
+        .parent_id = { .data = "/", .size = 1, },
+        .name = "a",
+    }, {
+        .id = { .data = "b", .size = 1, },
+        .parent_id = { .data = "a", .size = 1, },
+        .name = "b",
+    }, {
+        .id = { .data = "c", .size = 1, },
+        .parent_id = { .data = "a", .size = 1, },
+        .name = "c",
+    }, {
+        .id = { .data = "orphan", .size = 6, },
+        .parent_id = { .data = "missing", .size = 7, },
+        .name = "orphan",
+    },
+};
+
+struct one_fsentry_iterator {
+    struct rbh_mut_iterator iterator;
+    struct rbh_fsentry *fsentry;
+};
+
+static void *
+one_fsentry_iter_next(void *iterator)
+{
+    struct one_fsentry_iterator *one = iterator;
+    struct rbh_fsentry *fsentry = one->fsentry;
+
+    if (fsentry == NULL)
+        errno = ENODATA;
+    one->fsentry = NULL;
+    return fsentry;
+}
+
+static void
+one_fsentry_iter_destroy(void *iterator)
+{
+    struct one_fsentry_iterator *one = iterator;
+
+    free(one->fsentry);
+    free(one);
+}
+
+static const struct rbh_mut_iterator_operations ONE_FSENTRY_ITER_OPS = {
+    .next = one_fsentry_iter_next,
+    .destroy = one_fsentry_iter_destroy,
+};
+
+static size_t lookups;
+
+static struct rbh_mut_iterator *
+test_backend_filter(void *backend, const struct rbh_filter *filter,
+                    const struct rbh_filter_options *options)
+{
+    const struct rbh_value *value = &filter->compare.value;
+    struct one_fsentry_iterator *one;
+
+    ck_assert_int_eq(filter->op, RBH_FOP_EQUAL);
+    ck_assert_int_eq(filter->compare.field.fsentry, RBH_FP_ID);
+    lookups++;
+
+    one = malloc(sizeof(*one));
+    ck_assert_ptr_nonnull(one);
+    one->iterator.ops = &ONE_FSENTRY_ITER_OPS;
+    one->fsentry = NULL;
+
+    for (size_t i = 0; i < ARRAY_SIZE(ENTRIES); i++) {
+        if (ENTRIES[i].id.size != value->binary.size
+         || memcmp(ENTRIES[i].id.data, value->binary.data, value->binary.size))
+            continue;
+
+        one->fsentry = rbh_fsentry_new(&ENTRIES[i].id, &ENTRIES[i].parent_id,
+                                       ENTRIES[i].name, NULL, NULL, NULL,
+                                       NULL);
+        ck_assert_ptr_nonnull(one->fsentry);
+    }
+
+    return &one->iterator;
+}
+
+static const struct rbh_backend_operations TEST_BACKEND_OPS = {
+    .filter = test_backend_filter,
+};
+
+static struct rbh_backend TEST_BACKEND = {
+    .id = UINT8_MAX,
+    .ops = &TEST_BACKEND_OPS,
+};
+
+START_TEST(rrfb_batch)
+{
+    const struct rbh_id IDS[] = {
+        ENTRIES[2].id, ENTRIES[3].id, ENTRIES[0].id, ENTRIES[1].id,
+    };
+    const char *EXPECTED[] = { "/a/b", "/a/c", "/", "/a" };
+    struct rbh_resolver *resolver;
+    char *paths[ARRAY_SIZE(IDS)];
+
+    resolver = rbh_resolver_from_backend(&TEST_BACKEND, 16);
+    ck_assert_ptr_nonnull(resolver);
+
+    lookups = 0;
+    ck_assert_int_eq(rbh_resolver_resolve(resolver, IDS, ARRAY_SIZE(IDS),
+                                          paths), ARRAY_SIZE(IDS));
+    for (size_t i = 0; i < ARRAY_SIZE(IDS); i++) {
+        ck_assert_str_eq(paths[i], EXPECTED[i]);
+        free(paths[i]);
+    }
+
+    /* b, a, and / to resolve b; then only c, whose parent is memoized */
+    ck_assert_uint_eq(lookups, 4);
+
+    rbh_resolver_destroy(resolver);
+}
+END_TEST
+
+START_TEST(rrfb_no_cache)
+{
+    const struct rbh_id IDS[] = {
+        ENTRIES[2].id, ENTRIES[3].id,
+    };
+    struct rbh_resolver *resolver;
+    char *paths[ARRAY_SIZE(IDS)];
+
+    resolver = rbh_resolver_from_backend(&TEST_BACKEND, 0);
+    ck_assert_ptr_nonnull(resolver);
+
+    lookups = 0;
+    ck_assert_int_eq(rbh_resolver_resolve(resolver, IDS, ARRAY_SIZE(IDS),
+                                          paths), ARRAY_SIZE(IDS));
+    ck_assert_str_eq(paths[0], "/a/b");
+    ck_assert_str_eq(paths[1], "/a/c");
+    free(paths[0]);
+    free(paths[1]);
+
+    ck_assert_uint_eq(lookups, 6);
+
+    rbh_resolver_destroy(resolver);
+}
+END_TEST
+
+START_TEST(rrfb_unresolvable)
+{
+    const struct rbh_id IDS[] = {
+        ENTRIES[4].id,
+        { .data = "missing", .size = 7, },
+        ENTRIES[1].id,
+    };
+    struct rbh_resolver *resolver;
+    char *paths[ARRAY_SIZE(IDS)];
+
+    resolver = rbh_resolver_from_backend(&TEST_BACKEND, 16);
+    ck_assert_ptr_nonnull(resolver);
+
+    ck_assert_int_eq(rbh_resolver_resolve(resolver, IDS, ARRAY_SIZE(IDS),
+                                          paths), 1);
+    ck_assert_ptr_null(paths[0]);
+    ck_assert_ptr_null(paths[1]);
+    ck_assert_str_eq(paths[2], "/a");
+    free(paths[2]);
+
+    rbh_resolver_destroy(resolver);
+}
+END_TEST
+
+static Suite *
+unit_suite(void)
+{
+    Suite *suite;
+    TCase *tests;
+
+    suite = suite_create("resolver");
+    tests = tcase_create("rbh_resolver_new()");
+    tcase_add_unchecked_fixture(tests, unchecked_setup_tmpdir,
+                                unchecked_teardown_tmpdir);
+    tcase_add_test(tests, rrn_missing_root);
+    tcase_add_loop_test(tests, rrn_batch, 0, 4);
+    tcase_add_test(tests, rrn_unresolvable);
+
+    suite_add_tcase(suite, tests);
+
+    tests = tcase_create("rbh_resolver_from_backend()");
+    tcase_add_test(tests, rrfb_batch);
+    tcase_add_test(tests, rrfb_no_cache);
+    tcase_add_test(tests, rrfb_unresolvable);
+
+    suite_add_tcase(suite, tests);
+
+    return suite;
+}
+
+int
+main(void)
+{
+    int number_failed;
+    Suite *suite;
+    SRunner *runner;
+
+    suite = unit_suite();
+    runner = srunner_create(suite);
+
+    srunner_run_all(runner, CK_NORMAL);
+    number_failed = srunner_ntests_failed(runner);
+    srunner_free(runner);
+
+    return (number_failed == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -10,7 +10,11 @@
 #endif
 
 #include <errno.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdint.h>
 #include <stdlib.h>
+#include <string.h>
 #include <unistd.h>
 
 #include "robinhood/ring.h"
@@ -309,6 +313,192 @@ START_TEST(rrpo_full)
 
     rbh_ring_destroy(ring);
 }
+END_TEST
+
+    /*--------------------------------------------------------------------*
+     |                      rbh_ring_new_growable()                       |
+     *--------------------------------------------------------------------*/
+
+START_TEST(rrng_smaller_max_size)
+{
+    errno = 0;
+    ck_assert_ptr_null(rbh_ring_new_growable(2 * page_size, page_size));
+    ck_assert_int_eq(errno, EINVAL);
+}
+END_TEST
+
+START_TEST(rrng_grow)
+{
+    const char STRING[] = "abcdefghijklmno";
+    size_t count = page_size / sizeof(STRING);
+    struct rbh_ring *ring;
+    char *addresses[4];
+    char *head;
+    size_t size;
+
+    /* 3 pages is rounded down to 2 */
+    ring = rbh_ring_new_growable(page_size, 3 * page_size);
+    ck_assert_ptr_nonnull(ring);
+
+    /* Move the head forward and fill the ring, wrapping around its end */
+    ck_assert_ptr_nonnull(rbh_ring_push(ring, NULL, sizeof(STRING)));
+    ck_assert_int_eq(rbh_ring_pop(ring, sizeof(STRING)), 0);
+    for (size_t i = 0; i < count; i++) {
+        char *address = rbh_ring_push(ring, STRING, sizeof(STRING));
+
+        ck_assert_ptr_nonnull(address);
+        if (i == 0)
+            addresses[0] = address;
+        else if (i == count - 1)
+            addresses[1] = address;
+    }
+    head = rbh_ring_peek(ring, &size);
+
+    /* Grow the ring */
+    addresses[2] = rbh_ring_push(ring, STRING, sizeof(STRING));
+    ck_assert_ptr_nonnull(addresses[2]);
+    ck_assert_ptr_eq(rbh_ring_peek(ring, &size), head);
+    ck_assert_uint_eq(size, (count + 1) * sizeof(STRING));
+
+    /* Every address still points at the same data */
+    for (size_t i = 0; i < 3; i++)
+        ck_assert_mem_eq(addresses[i], STRING, sizeof(STRING));
+    for (size_t i = 0; i <= count; i++)
+        ck_assert_mem_eq(head + i * sizeof(STRING), STRING, sizeof(STRING));
+
+    /* The ring cannot grow past its maximum size */
+    errno = 0;
+    ck_assert_ptr_null(rbh_ring_push(ring, NULL, 2 * page_size + 1));
+    ck_assert_int_eq(errno, EINVAL);
+
+    addresses[3] = rbh_ring_push(ring, NULL, 2 * page_size - size);
+    ck_assert_ptr_nonnull(addresses[3]);
+    memset(addresses[3], 0, 2 * page_size - size);
+
+    errno = 0;
+    ck_assert_ptr_null(rbh_ring_push(ring, NULL, 1));
+    ck_assert_int_eq(errno, ENOBUFS);
+
+    for (size_t i = 0; i < 3; i++)
+        ck_assert_mem_eq(addresses[i], STRING, sizeof(STRING));
+
+    rbh_ring_destroy(ring);
+}
+END_TEST
+
+    /*--------------------------------------------------------------------*
+     |                          rbh_spsc_ring_*()                         |
+     *--------------------------------------------------------------------*/
+
+START_TEST(rsr_unaligned)
+{
+    errno = 0;
+    ck_assert_ptr_null(rbh_spsc_ring_new(page_size + 1));
+    ck_assert_int_eq(errno, EINVAL);
+}
+END_TEST
+
+START_TEST(rsr_push_too_much)
+{
+    struct rbh_spsc_ring *ring;
+
+    ring = rbh_spsc_ring_new(page_size);
+    ck_assert_ptr_nonnull(ring);
+
+    errno = 0;
+    ck_assert_ptr_null(rbh_spsc_ring_reserve(ring, page_size + 1));
+    ck_assert_int_eq(errno, EINVAL);
+
+    ck_assert_ptr_nonnull(rbh_spsc_ring_reserve(ring, page_size));
+    ck_assert_int_eq(rbh_spsc_ring_commit(ring, page_size - 1), 0);
+
+    errno = 0;
+    ck_assert_ptr_null(rbh_spsc_ring_push(ring, "ab", 2));
+    ck_assert_int_eq(errno, ENOBUFS);
+
+    errno = 0;
+    ck_assert_int_eq(rbh_spsc_ring_commit(ring, 2), -1);
+    ck_assert_int_eq(errno, EINVAL);
+
+    rbh_spsc_ring_destroy(ring);
+}
+END_TEST
+
+START_TEST(rsr_reserve_commit)
+{
+    struct rbh_spsc_ring *ring;
+    char *address;
+    size_t size;
+
+    ring = rbh_spsc_ring_new(page_size);
+    ck_assert_ptr_nonnull(ring);
+
+    address = rbh_spsc_ring_reserve(ring, 8);
+    ck_assert_ptr_nonnull(address);
+    memcpy(address, "abcdefgh", 8);
+
+    /* Reserved data is not visible until it is committed */
+    ck_assert_ptr_eq(rbh_spsc_ring_peek(ring, 8, &size), address);
+    ck_assert_uint_eq(size, 0);
+    ck_assert_ptr_eq(rbh_spsc_ring_reserve(ring, 8), address);
+
+    ck_assert_int_eq(rbh_spsc_ring_commit(ring, 8), 0);
+    ck_assert_ptr_eq(rbh_spsc_ring_peek(ring, 8, &size), address);
+    ck_assert_uint_eq(size, 8);
+    ck_assert_mem_eq(address, "abcdefgh", 8);
+
+    rbh_spsc_ring_destroy(ring);
+}
+END_TEST
+
+START_TEST(rsr_pop_too_much)
+{
+    struct rbh_spsc_ring *ring;
+    size_t size;
+    char *data;
+
+    ring = rbh_spsc_ring_new(page_size);
+    ck_assert_ptr_nonnull(ring);
+
+    data = rbh_spsc_ring_push(ring, "abcdefgh", 8);
+    ck_assert_ptr_nonnull(data);
+
+    errno = 0;
+    ck_assert_int_eq(rbh_spsc_ring_pop(ring, 9), -1);
+    ck_assert_int_eq(errno, EINVAL);
+
+    ck_assert_int_eq(rbh_spsc_ring_pop(ring, 3), 0);
+    ck_assert_ptr_eq(rbh_spsc_ring_peek(ring, 0, &size), data + 3);
+    ck_assert_uint_eq(size, 5);
+
+    rbh_spsc_ring_destroy(ring);
+}
+END_TEST
+
+START_TEST(rsr_wrap_around)
+{
+    const char STRING[] = "abcdefghijklmno";
+    struct rbh_spsc_ring *ring;
+    size_t size;
+    char *data;
+
+    ring = rbh_spsc_ring_new(page_size);
+    ck_assert_ptr_nonnull(ring);
+
+    /* Move the head close to the end of the ring */
+    ck_assert_ptr_nonnull(rbh_spsc_ring_reserve(ring, page_size - 4));
+    ck_assert_int_eq(rbh_spsc_ring_commit(ring, page_size - 4), 0);
+    rbh_spsc_ring_peek(ring, 0, &size);
+    ck_assert_int_eq(rbh_spsc_ring_pop(ring, size), 0);
+
+    /* Data that wraps around is still readable contiguously */
+    ck_assert_ptr_nonnull(rbh_spsc_ring_push(ring, STRING, sizeof(STRING)));
+    data = rbh_spsc_ring_peek(ring, sizeof(STRING), &size);
+    ck_assert_uint_eq(size, sizeof(STRING));
+    ck_assert_mem_eq(data, STRING, sizeof(STRING));
+
+    rbh_spsc_ring_destroy(ring);
+}
 END_TEST
 
 static Suite *
@@ -351,6 +541,21 @@ unit_suite(void)
 
     suite_add_tcase(suite, tests);
 
+    tests = tcase_create("rbh_ring_new_growable");
+    tcase_add_test(tests, rrng_smaller_max_size);
+    tcase_add_test(tests, rrng_grow);
+
+    suite_add_tcase(suite, tests);
+
+    tests = tcase_create("rbh_spsc_ring");
+    tcase_add_test(tests, rsr_unaligned);
+    tcase_add_test(tests, rsr_push_too_much);
+    tcase_add_test(tests, rsr_reserve_commit);
+    tcase_add_test(tests, rsr_pop_too_much);
+    tcase_add_test(tests, rsr_wrap_around);
+
+    suite_add_tcase(suite, tests);
+
     return suite;
 }
 
@@ -434,6 +639,65 @@ START_TEST(chunk_by_chunk_until_full)
 }
 END_TEST
 
+#define SPSC_COUNT (1 << 20)
+
+static void *
+spsc_produce(void *ring)
+{
+    for (uint64_t i = 0; i < SPSC_COUNT; i++) {
+        /* Vary the size of pushes so that they do not align with the ring */
+        uint64_t values[] = { i, i, i };
+        size_t size = sizeof(*values) * (1 + i % 3) - i % 2;
+
+        while (rbh_spsc_ring_push(ring, values, size) == NULL) {
+            ck_assert_int_eq(errno, ENOBUFS);
+            sched_yield();
+        }
+    }
+
+    return NULL;
+}
+
+START_TEST(spsc_threads)
+{
+    struct rbh_spsc_ring *ring;
+    pthread_t producer;
+    uint64_t i = 0;
+
+    ring = rbh_spsc_ring_new(page_size);
+    ck_assert_ptr_nonnull(ring);
+
+    ck_assert_int_eq(pthread_create(&producer, NULL, spsc_produce, ring), 0);
+
+    while (i < SPSC_COUNT) {
+        size_t size = sizeof(i) * (1 + i % 3) - i % 2;
+        size_t readable;
+        uint64_t value;
+        char *data;
+
+        data = rbh_spsc_ring_peek(ring, size, &readable);
+        if (readable < size) {
+            sched_yield();
+            continue;
+        }
+
+        for (size_t j = 0; j < size / sizeof(value); j++) {
+            memcpy(&value, data + j * sizeof(value), sizeof(value));
+            ck_assert_uint_eq(value, i);
+        }
+        ck_assert_int_eq(rbh_spsc_ring_pop(ring, size), 0);
+        i++;
+    }
+
+    ck_assert_int_eq(pthread_join(producer, NULL), 0);
+
+    rbh_spsc_ring_peek(ring, 0, &i);
+    ck_assert_uint_eq(i, 0);
+
+    rbh_spsc_ring_destroy(ring);
+}
+END_TEST
+
 static Suite *
 integration_suite(void)
 {
@@ -448,6 +712,12 @@ integration_suite(void)
 
     suite_add_tcase(suite, tests);
 
+    tests = tcase_create("threads");
+    tcase_add_test(tests, spsc_threads);
+    tcase_set_timeout(tests, 60);
+
+    suite_add_tcase(suite, tests);
+
     return suite;
 }
 
@@ -292,6 +292,108 @@ START_TEST(rra_multi_loop)
     rbh_ringr_destroy(ringr);
     rbh_ringr_destroy(duplicate);
 }
+END_TEST
+
+    /*--------------------------------------------------------------------*
+     |                      rbh_ringr_new_growable()                      |
+     *--------------------------------------------------------------------*/
+
+/* Fill `buffer' with `size' bytes of `c' */
+static void *
+fill(char *buffer, char c, size_t size)
+{
+    for (size_t i = 0; i < size; i++)
+        buffer[i] = c;
+    return buffer;
+}
+
+static void
+assert_filled(const char *data, char c, size_t size)
+{
+    for (size_t i = 0; i < size; i++)
+        ck_assert_int_eq(data[i], c);
+}
+
+START_TEST(rrng_starved_reader)
+{
+    struct rbh_ringr *readers[2];
+    size_t half = page_size / 2;
+    char buffer[page_size];
+    size_t readable;
+    char *data;
+
+    readers[0] = rbh_ringr_new_growable(page_size, 2 * page_size);
+    ck_assert_ptr_nonnull(readers[0]);
+    readers[1] = rbh_ringr_dup(readers[0]);
+    ck_assert_ptr_nonnull(readers[1]);
+
+    /* Fill the ring, the first reader reads everything */
+    ck_assert_ptr_nonnull(rbh_ringr_push(readers[0], fill(buffer, 'a', half),
+                                         half));
+    ck_assert_ptr_nonnull(rbh_ringr_push(readers[0], fill(buffer, 'b', half),
+                                         half));
+    ck_assert_int_eq(rbh_ringr_ack(readers[0], page_size), 0);
+
+    ck_assert_ptr_nonnull(rbh_ringr_push(readers[0], fill(buffer, 'c', 16),
+                                         16));
+
+    data = rbh_ringr_peek(readers[0], &readable);
+    ck_assert_uint_eq(readable, 16);
+    assert_filled(data, 'c', 16);
+
+    data = rbh_ringr_peek(readers[1], &readable);
+    ck_assert_uint_eq(readable, page_size + 16);
+    assert_filled(data, 'a', half);
+    assert_filled(data + half, 'b', half);
+    assert_filled(data + page_size, 'c', 16);
+
+    rbh_ringr_destroy(readers[1]);
+    rbh_ringr_destroy(readers[0]);
+}
+END_TEST
+
+START_TEST(rrng_wrapped_reader)
+{
+    struct rbh_ringr *readers[2];
+    size_t half = page_size / 2;
+    char buffer[page_size];
+    size_t readable;
+    char *data;
+
+    readers[0] = rbh_ringr_new_growable(page_size, 2 * page_size);
+    ck_assert_ptr_nonnull(readers[0]);
+    readers[1] = rbh_ringr_dup(readers[0]);
+    ck_assert_ptr_nonnull(readers[1]);
+
+    /* Move the ring's head to its middle */
+    ck_assert_ptr_nonnull(rbh_ringr_push(readers[0], buffer, half));
+    ck_assert_int_eq(rbh_ringr_ack(readers[0], half), 0);
+    ck_assert_int_eq(rbh_ringr_ack(readers[1], half), 0);
+
+    /* The first reader wraps around the ring's end */
+    ck_assert_ptr_nonnull(rbh_ringr_push(readers[0], fill(buffer, 'b', half),
+                                         half));
+    ck_assert_int_eq(rbh_ringr_ack(readers[0], half), 0);
+    ck_assert_ptr_nonnull(rbh_ringr_push(readers[0], fill(buffer, 'c', half),
+                                         half));
+
+    ck_assert_ptr_nonnull(rbh_ringr_push(readers[0], fill(buffer, 'd', 16),
+                                         16));
+
+    data = rbh_ringr_peek(readers[0], &readable);
+    ck_assert_uint_eq(readable, half + 16);
+    assert_filled(data, 'c', half);
+    assert_filled(data + half, 'd', 16);
+
+    data = rbh_ringr_peek(readers[1], &readable);
+    ck_assert_uint_eq(readable, page_size + 16);
+    assert_filled(data, 'b', half);
+    assert_filled(data + half, 'c', half);
+    assert_filled(data + page_size, 'd', 16);
+
+    rbh_ringr_destroy(readers[1]);
+    rbh_ringr_destroy(readers[0]);
+}
 END_TEST
 
 static Suite *
@@ -329,6 +431,12 @@ unit_suite(void)
 
     suite_add_tcase(suite, tests);
 
+    tests = tcase_create("rbh_ringr_new_growable");
+    tcase_add_test(tests, rrng_starved_reader);
+    tcase_add_test(tests, rrng_wrapped_reader);
+
+    suite_add_tcase(suite, tests);
+
     return suite;
 }
 
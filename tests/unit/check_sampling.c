@@ -0,0 +1,416 @@
+/* This file is part of the RobinHood Library
+ * Copyright (C) 2022 Commissariat a l'energie atomique et aux energies
+ *                    alternatives
+ *
+ * SPDX-License-Identifer: LGPL-3.0-or-later
+ */
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <errno.h>
+#include <math.h>
+#include <stdlib.h>
+
+#include "check-compat.h"
+#include "robinhood/itertools.h"
+#include "robinhood/sampling.h"
+
+/* ck_assert_double_eq_tol() is only available since check 0.11.0 */
+#define assert_close(X, Y, T) do { \
+    double _x = (X); \
+    double _y = (Y); \
+    ck_assert_msg(fabs(_x - _y) <= (T), \
+                  "Assertion '%s' failed: %s == %g, %s == %g", \
+                  "|"#X" - "#Y"| <= "#T, #X, _x, #Y, _y); \
+} while (0)
+
+/* An iterator that yields `count' malloc'ed integers, from 0 to count - 1 */
+struct counter_iterator {
+    struct rbh_mut_iterator iterator;
+    size_t index;
+    size_t count;
+};
+
+static void *
+counter_iter_next(void *iterator)
+{
+    struct counter_iterator *counter = iterator;
+    size_t *integer;
+
+    if (counter->index >= counter->count) {
+        errno = ENODATA;
+        return NULL;
+    }
+
+    integer = malloc(sizeof(*integer));
+    if (integer == NULL)
+        return NULL;
+
+    *integer = counter->index++;
+    return integer;
+}
+
+static const struct rbh_mut_iterator_operations COUNTER_ITER_OPS = {
+    .next = counter_iter_next,
+    .destroy = free,
+};
+
+static struct rbh_mut_iterator *
+counter_iter_new(size_t count)
+{
+    struct counter_iterator *counter;
+
+    counter = malloc(sizeof(*counter));
+    ck_assert_ptr_nonnull(counter);
+
+    counter->iterator.ops = &COUNTER_ITER_OPS;
+    counter->index = 0;
+    counter->count = count;
+    return &counter->iterator;
+}
+
+/*----------------------------------------------------------------------------*
+ |                            rbh_iter_bernoulli()                            |
+ *----------------------------------------------------------------------------*/
+
+START_TEST(rib_all)
+{
+    const int INTEGERS[] = { 0, 1, 2, 3, 4, 5, 6, 7, 8, 9 };
+    struct rbh_iterator *integers;
+
+    integers = rbh_iter_array(INTEGERS, sizeof(*INTEGERS),
+                              sizeof(INTEGERS) / sizeof(*INTEGERS));
+    ck_assert_ptr_nonnull(integers);
+
+    integers = rbh_iter_bernoulli(integers, 1.);
+    ck_assert_ptr_nonnull(integers);
+
+    for (size_t i = 0; i < sizeof(INTEGERS) / sizeof(*INTEGERS); i++)
+        ck_assert_mem_eq(rbh_iter_next(integers), &INTEGERS[i],
+                         sizeof(*INTEGERS));
+
+    errno = 0;
+    ck_assert_ptr_null(rbh_iter_next(integers));
+    ck_assert_int_eq(errno, ENODATA);
+
+    rbh_iter_destroy(integers);
+}
+END_TEST
+
+START_TEST(rib_invalid)
+{
+    const double RATES[] = { 0., -1., 1.5, NAN };
+
+    for (size_t i = 0; i < sizeof(RATES) / sizeof(*RATES); i++) {
+        errno = 0;
+        ck_assert_ptr_null(rbh_iter_bernoulli(NULL, RATES[i]));
+        ck_assert_int_eq(errno, EINVAL);
+    }
+}
+END_TEST
+
+/*----------------------------------------------------------------------------*
+ |                          rbh_mut_iter_bernoulli()                          |
+ *----------------------------------------------------------------------------*/
+
+START_TEST(rmib_rate)
+{
+    struct rbh_mut_iterator *integers;
+    size_t previous = 0;
+    size_t *integer;
+    size_t count = 0;
+
+    integers = rbh_mut_iter_bernoulli(counter_iter_new(10000), 0.1);
+    ck_assert_ptr_nonnull(integers);
+
+    while ((integer = rbh_mut_iter_next(integers)) != NULL) {
+        /* Order is preserved */
+        if (count++ > 0)
+            ck_assert_uint_gt(*integer, previous);
+        previous = *integer;
+        free(integer);
+    }
+    ck_assert_int_eq(errno, ENODATA);
+
+    /* More than 6 standard deviations away from the expected 1000 */
+    ck_assert_uint_gt(count, 820);
+    ck_assert_uint_lt(count, 1180);
+
+    rbh_mut_iter_destroy(integers);
+}
+END_TEST
+
+/*----------------------------------------------------------------------------*
+ |                          rbh_mut_iter_reservoir()                          |
+ *----------------------------------------------------------------------------*/
+
+START_TEST(rmir_small)
+{
+    struct rbh_mut_iterator *integers;
+    size_t population = 0;
+    size_t seen[5] = {};
+    size_t *integer;
+
+    integers = rbh_mut_iter_reservoir(counter_iter_new(5), 10, &population);
+    ck_assert_ptr_nonnull(integers);
+
+    for (size_t i = 0; i < 5; i++) {
+        integer = rbh_mut_iter_next(integers);
+        ck_assert_ptr_nonnull(integer);
+        ck_assert_uint_lt(*integer, 5);
+        seen[*integer]++;
+        free(integer);
+    }
+
+    errno = 0;
+    ck_assert_ptr_null(rbh_mut_iter_next(integers));
+    ck_assert_int_eq(errno, ENODATA);
+    ck_assert_uint_eq(population, 5);
+
+    for (size_t i = 0; i < 5; i++)
+        ck_assert_uint_eq(seen[i], 1);
+
+    rbh_mut_iter_destroy(integers);
+}
+END_TEST
+
+START_TEST(rmir_uniform)
+{
+    const size_t RUNS = 2000;
+    size_t selected[100] = {};
+
+    for (size_t run = 0; run < RUNS; run++) {
+        struct rbh_mut_iterator *integers;
+        size_t population = 0;
+        size_t *integer;
+        size_t count = 0;
+
+        integers = rbh_mut_iter_reservoir(counter_iter_new(100), 10,
+                                          &population);
+        ck_assert_ptr_nonnull(integers);
+
+        while ((integer = rbh_mut_iter_next(integers)) != NULL) {
+            selected[*integer]++;
+            free(integer);
+            count++;
+        }
+        ck_assert_int_eq(errno, ENODATA);
+        ck_assert_uint_eq(count, 10);
+        ck_assert_uint_eq(population, 100);
+
+        rbh_mut_iter_destroy(integers);
+    }
+
+    /* Each element is expected to be selected 200 times (standard deviation
+     * ~13.4), whatever its position.
+     */
+    for (size_t i = 0; i < 100; i++) {
+        ck_assert_uint_gt(selected[i], 120);
+        ck_assert_uint_lt(selected[i], 280);
+    }
+}
+END_TEST
+
+START_TEST(rmir_destroy_early)
+{
+    struct rbh_mut_iterator *integers;
+
+    integers = rbh_mut_iter_reservoir(counter_iter_new(1000), 10, NULL);
+    ck_assert_ptr_nonnull(integers);
+
+    free(rbh_mut_iter_next(integers));
+
+    /* The 9 elements left must not leak */
+    rbh_mut_iter_destroy(integers);
+}
+END_TEST
+
+START_TEST(rmir_invalid)
+{
+    errno = 0;
+    ck_assert_ptr_null(rbh_mut_iter_reservoir(NULL, 0, NULL));
+    ck_assert_int_eq(errno, EINVAL);
+}
+END_TEST
+
+/*----------------------------------------------------------------------------*
+ |                                 estimators                                 |
+ *----------------------------------------------------------------------------*/
+
+START_TEST(rem_basic)
+{
+    struct rbh_sample_stats stats = {};
+    struct rbh_estimate estimate;
+
+    /* 1, 2, ..., 100: mean 50.5, standard deviation ~29.01 */
+    for (int i = 1; i <= 100; i++)
+        rbh_sample_stats_add(&stats, i);
+
+    ck_assert_uint_eq(stats.count, 100);
+    assert_close(stats.mean, 50.5, 1e-9);
+
+    ck_assert_int_eq(rbh_estimate_mean(&stats, 0, 0.95, &estimate), 0);
+    assert_close(estimate.value, 50.5, 1e-9);
+    /* 1.96 * 29.01 / sqrt(100) */
+    assert_close(estimate.upper - estimate.value, 5.686, 1e-3);
+    assert_close(estimate.value - estimate.lower, 5.686, 1e-3);
+
+    /* Sampling the whole population leaves no uncertainty */
+    ck_assert_int_eq(rbh_estimate_mean(&stats, 100, 0.95, &estimate), 0);
+    assert_close(estimate.lower, 50.5, 1e-9);
+    assert_close(estimate.upper, 50.5, 1e-9);
+
+    ck_assert_int_eq(rbh_estimate_total(&stats, 100, 0.95, &estimate), 0);
+    assert_close(estimate.value, 5050., 1e-6);
+}
+END_TEST
+
+START_TEST(rem_invalid)
+{
+    struct rbh_sample_stats stats = {};
+    struct rbh_estimate estimate;
+
+    rbh_sample_stats_add(&stats, 1.);
+
+    errno = 0;
+    ck_assert_int_eq(rbh_estimate_mean(&stats, 0, 0.95, &estimate), -1);
+    ck_assert_int_eq(errno, ENODATA);
+
+    rbh_sample_stats_add(&stats, 2.);
+
+    errno = 0;
+    ck_assert_int_eq(rbh_estimate_mean(&stats, 0, 1., &estimate), -1);
+    ck_assert_int_eq(errno, EINVAL);
+
+    errno = 0;
+    ck_assert_int_eq(rbh_estimate_total(&stats, 0, 0.95, &estimate), -1);
+    ck_assert_int_eq(errno, EINVAL);
+}
+END_TEST
+
+START_TEST(rebc_basic)
+{
+    struct rbh_estimate estimate;
+
+    ck_assert_int_eq(rbh_estimate_bernoulli_count(1000, 0.1, 0.95, &estimate),
+                     0);
+    assert_close(estimate.value, 10000., 1e-6);
+    /* 1.96 * sqrt(1000 * 0.9) / 0.1 */
+    assert_close(estimate.upper - estimate.value, 588., 0.5);
+
+    ck_assert_int_eq(rbh_estimate_bernoulli_count(1000, 1., 0.95, &estimate),
+                     0);
+    assert_close(estimate.lower, 1000., 1e-6);
+    assert_close(estimate.upper, 1000., 1e-6);
+
+    errno = 0;
+    ck_assert_int_eq(rbh_estimate_bernoulli_count(1000, 0., 0.95, &estimate),
+                     -1);
+    ck_assert_int_eq(errno, EINVAL);
+}
+END_TEST
+
+START_TEST(rep_wilson)
+{
+    struct rbh_estimate estimate;
+
+    ck_assert_int_eq(rbh_estimate_proportion(50, 100, 0.95, &estimate), 0);
+    assert_close(estimate.value, 0.5, 1e-9);
+    assert_close(estimate.lower, 0.4038, 1e-4);
+    assert_close(estimate.upper, 0.5962, 1e-4);
+
+    /* The interval never goes below 0 */
+    ck_assert_int_eq(rbh_estimate_proportion(0, 10, 0.95, &estimate), 0);
+    assert_close(estimate.lower, 0., 1e-9);
+    ck_assert(estimate.upper > 0.);
+
+    errno = 0;
+    ck_assert_int_eq(rbh_estimate_proportion(11, 10, 0.95, &estimate), -1);
+    ck_assert_int_eq(errno, EINVAL);
+}
+END_TEST
+
+START_TEST(req_median)
+{
+    struct rbh_estimate estimate;
+    double values[1000];
+
+    /* 999, 998, ..., 0 */
+    for (size_t i = 0; i < 1000; i++)
+        values[i] = 999 - i;
+
+    ck_assert_int_eq(rbh_estimate_quantile(values, 1000, 0.5, 0.95, &estimate),
+                     0);
+    assert_close(estimate.value, 499., 0.);
+    /* Ranks 500 -/+ 1.96 * sqrt(1000 * 0.5 * 0.5) */
+    assert_close(estimate.lower, 468., 1.);
+    assert_close(estimate.upper, 531., 1.);
+
+    ck_assert_int_eq(rbh_estimate_quantile(values, 1000, 1., 0.95, &estimate),
+                     0);
+    assert_close(estimate.value, 999., 0.);
+    assert_close(estimate.upper, 999., 0.);
+
+    errno = 0;
+    ck_assert_int_eq(rbh_estimate_quantile(values, 0, 0.5, 0.95, &estimate),
+                     -1);
+    ck_assert_int_eq(errno, ENODATA);
+}
+END_TEST
+
+static Suite *
+unit_suite(void)
+{
+    Suite *suite;
+    TCase *tests;
+
+    suite = suite_create("sampling");
+    tests = tcase_create("rbh_iter_bernoulli()");
+    tcase_add_test(tests, rib_all);
+    tcase_add_test(tests, rib_invalid);
+
+    suite_add_tcase(suite, tests);
+
+    tests = tcase_create("rbh_mut_iter_bernoulli()");
+    tcase_add_test(tests, rmib_rate);
+
+    suite_add_tcase(suite, tests);
+
+    tests = tcase_create("rbh_mut_iter_reservoir()");
+    tcase_add_test(tests, rmir_small);
+    tcase_add_test(tests, rmir_uniform);
+    tcase_add_test(tests, rmir_destroy_early);
+    tcase_add_test(tests, rmir_invalid);
+
+    suite_add_tcase(suite, tests);
+
+    tests = tcase_create("estimators");
+    tcase_add_test(tests, rem_basic);
+    tcase_add_test(tests, rem_invalid);
+    tcase_add_test(tests, rebc_basic);
+    tcase_add_test(tests, rep_wilson);
+    tcase_add_test(tests, req_median);
+
+    suite_add_tcase(suite, tests);
+
+    return suite;
+}
+
+int
+main(void)
+{
+    int number_failed;
+    Suite *suite;
+    SRunner *runner;
+
+    suite = unit_suite();
+    runner = srunner_create(suite);
+
+    srunner_run_all(runner, CK_NORMAL);
+    number_failed = srunner_ntests_failed(runner);
+    srunner_free(runner);
+
+    return (number_failed == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
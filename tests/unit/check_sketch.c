@@ -0,0 +1,579 @@
+/* This file is part of the RobinHood Library
+ * Copyright (C) 2022 Commissariat a l'energie atomique et aux energies
+ *                    alternatives
+ *
+ * SPDX-License-Identifer: LGPL-3.0-or-later
+ */
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <errno.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "check-compat.h"
+#include "robinhood/itertools.h"
+#include "robinhood/sketch.h"
+#include "robinhood/statx.h"
+
+/* ck_assert_double_eq_tol() is only available since check 0.11.0 */
+#define assert_close(X, Y, T) do { \
+    double _x = (X); \
+    double _y = (Y); \
+    ck_assert_msg(fabs(_x - _y) <= (T), \
+                  "Assertion '%s' failed: %s == %g, %s == %g", \
+                  "|"#X" - "#Y"| <= "#T, #X, _x, #Y, _y); \
+} while (0)
+
+static void
+add_uint64(struct rbh_sketch *sketch, uint64_t integer)
+{
+    const struct rbh_value value = {
+        .type = RBH_VT_UINT64,
+        .uint64 = integer,
+    };
+
+    ck_assert_int_eq(rbh_sketch_add_value(sketch, &value), 0);
+}
+
+static void
+add_string(struct rbh_sketch *sketch, const char *string)
+{
+    const struct rbh_value value = {
+        .type = RBH_VT_STRING,
+        .string = string,
+    };
+
+    ck_assert_int_eq(rbh_sketch_add_value(sketch, &value), 0);
+}
+
+/* Serialize `sketch' and deserialize it back */
+static struct rbh_sketch *
+roundtrip(const struct rbh_sketch *sketch)
+{
+    struct rbh_sketch *copy;
+    size_t size = 0;
+    char *data;
+
+    errno = 0;
+    ck_assert_int_eq(rbh_sketch_serialize(sketch, NULL, &size), -1);
+    ck_assert_int_eq(errno, EOVERFLOW);
+    ck_assert_uint_gt(size, 0);
+
+    data = malloc(size);
+    ck_assert_ptr_nonnull(data);
+    ck_assert_int_eq(rbh_sketch_serialize(sketch, data, &size), 0);
+
+    /* Truncated sketches are rejected */
+    errno = 0;
+    ck_assert_ptr_null(rbh_sketch_deserialize(data, size - 1));
+    ck_assert_int_eq(errno, EINVAL);
+
+    copy = rbh_sketch_deserialize(data, size);
+    ck_assert_ptr_nonnull(copy);
+    free(data);
+
+    ck_assert_uint_eq(rbh_sketch_count(copy), rbh_sketch_count(sketch));
+    return copy;
+}
+
+/*----------------------------------------------------------------------------*
+ |                              rbh_sketch_new()                              |
+ *----------------------------------------------------------------------------*/
+
+START_TEST(rsn_invalid)
+{
+    const struct rbh_sketch_options OPTIONS[] = {
+        { .type = -1 },
+        { .type = RBH_SKT_HYPERLOGLOG, .hyperloglog = { .precision = 3 } },
+        { .type = RBH_SKT_HYPERLOGLOG, .hyperloglog = { .precision = 19 } },
+        { .type = RBH_SKT_KLL, .kll = { .k = 4 } },
+        { .type = RBH_SKT_COUNT_MIN, .count_min = { .delta = 0.01 } },
+        { .type = RBH_SKT_COUNT_MIN, .count_min = { .epsilon = 0.01 } },
+    };
+
+    for (size_t i = 0; i < sizeof(OPTIONS) / sizeof(*OPTIONS); i++) {
+        errno = 0;
+        ck_assert_ptr_null(rbh_sketch_new(NULL, &OPTIONS[i]));
+        ck_assert_int_eq(errno, EINVAL);
+    }
+}
+END_TEST
+
+/*----------------------------------------------------------------------------*
+ |                                hyperloglog                                 |
+ *----------------------------------------------------------------------------*/
+
+static const struct rbh_sketch_options HLL_OPTIONS = {
+    .type = RBH_SKT_HYPERLOGLOG,
+};
+
+START_TEST(hll_cardinality)
+{
+    struct rbh_sketch *sketch, *copy;
+    double cardinality;
+
+    sketch = rbh_sketch_new(NULL, &HLL_OPTIONS);
+    ck_assert_ptr_nonnull(sketch);
+
+    ck_assert_int_eq(rbh_sketch_cardinality(sketch, &cardinality), 0);
+    assert_close(cardinality, 0., 0.);
+
+    /* 100k distinct values, each added twice */
+    for (int pass = 0; pass < 2; pass++) {
+        for (uint64_t i = 0; i < 100000; i++)
+            add_uint64(sketch, i);
+    }
+    ck_assert_uint_eq(rbh_sketch_count(sketch), 200000);
+
+    /* The relative standard error is ~0.8% */
+    ck_assert_int_eq(rbh_sketch_cardinality(sketch, &cardinality), 0);
+    assert_close(cardinality, 100000., 4000.);
+
+    copy = roundtrip(sketch);
+    ck_assert_int_eq(rbh_sketch_cardinality(copy, &cardinality), 0);
+    assert_close(cardinality, 100000., 4000.);
+
+    rbh_sketch_destroy(copy);
+    rbh_sketch_destroy(sketch);
+}
+END_TEST
+
+START_TEST(hll_small)
+{
+    struct rbh_sketch *sketch;
+    double cardinality;
+
+    sketch = rbh_sketch_new(NULL, &HLL_OPTIONS);
+    ck_assert_ptr_nonnull(sketch);
+
+    add_string(sketch, "a");
+    add_string(sketch, "b");
+    add_string(sketch, "a");
+    add_string(sketch, "c");
+
+    ck_assert_int_eq(rbh_sketch_cardinality(sketch, &cardinality), 0);
+    assert_close(cardinality, 3., 0.1);
+
+    rbh_sketch_destroy(sketch);
+}
+END_TEST
+
+START_TEST(hll_merge)
+{
+    const struct rbh_sketch_options OTHER = {
+        .type = RBH_SKT_HYPERLOGLOG,
+        .hyperloglog = {
+            .precision = 10,
+        },
+    };
+    struct rbh_sketch *left, *right, *other;
+    double cardinality;
+
+    left = rbh_sketch_new(NULL, &HLL_OPTIONS);
+    ck_assert_ptr_nonnull(left);
+    right = rbh_sketch_new(NULL, &HLL_OPTIONS);
+    ck_assert_ptr_nonnull(right);
+
+    /* [0, 60000[ and [40000, 100000[ */
+    for (uint64_t i = 0; i < 60000; i++) {
+        add_uint64(left, i);
+        add_uint64(right, 40000 + i);
+    }
+
+    ck_assert_int_eq(rbh_sketch_merge(left, right), 0);
+    ck_assert_int_eq(rbh_sketch_cardinality(left, &cardinality), 0);
+    assert_close(cardinality, 100000., 4000.);
+
+    other = rbh_sketch_new(NULL, &OTHER);
+    ck_assert_ptr_nonnull(other);
+
+    errno = 0;
+    ck_assert_int_eq(rbh_sketch_merge(left, other), -1);
+    ck_assert_int_eq(errno, EINVAL);
+
+    rbh_sketch_destroy(other);
+    rbh_sketch_destroy(right);
+    rbh_sketch_destroy(left);
+}
+END_TEST
+
+/*----------------------------------------------------------------------------*
+ |                                    kll                                     |
+ *----------------------------------------------------------------------------*/
+
+static const struct rbh_sketch_options KLL_OPTIONS = {
+    .type = RBH_SKT_KLL,
+};
+
+START_TEST(kll_quantiles)
+{
+    struct rbh_sketch *sketch, *copy;
+    double value, rank;
+
+    sketch = rbh_sketch_new(NULL, &KLL_OPTIONS);
+    ck_assert_ptr_nonnull(sketch);
+
+    errno = 0;
+    ck_assert_int_eq(rbh_sketch_quantile(sketch, 0.5, &value), -1);
+    ck_assert_int_eq(errno, ENODATA);
+
+    /* A permutation of [0, 100000[ */
+    for (uint64_t i = 0; i < 100000; i++)
+        add_uint64(sketch, i * 7919 % 100000);
+
+    ck_assert_int_eq(rbh_sketch_quantile(sketch, 0., &value), 0);
+    assert_close(value, 0., 0.);
+    ck_assert_int_eq(rbh_sketch_quantile(sketch, 1., &value), 0);
+    assert_close(value, 99999., 0.);
+
+    /* The rank error is ~0.8% */
+    ck_assert_int_eq(rbh_sketch_quantile(sketch, 0.5, &value), 0);
+    assert_close(value, 50000., 2500.);
+    ck_assert_int_eq(rbh_sketch_quantile(sketch, 0.99, &value), 0);
+    assert_close(value, 99000., 2500.);
+
+    ck_assert_int_eq(rbh_sketch_rank(sketch, 25000., &rank), 0);
+    assert_close(rank, 0.25, 0.025);
+
+    copy = roundtrip(sketch);
+    ck_assert_int_eq(rbh_sketch_quantile(copy, 0.5, &value), 0);
+    assert_close(value, 50000., 2500.);
+
+    rbh_sketch_destroy(copy);
+    rbh_sketch_destroy(sketch);
+}
+END_TEST
+
+START_TEST(kll_merge)
+{
+    struct rbh_sketch *left, *right;
+    double value;
+
+    left = rbh_sketch_new(NULL, &KLL_OPTIONS);
+    ck_assert_ptr_nonnull(left);
+    right = rbh_sketch_new(NULL, &KLL_OPTIONS);
+    ck_assert_ptr_nonnull(right);
+
+    for (uint64_t i = 0; i < 50000; i++) {
+        add_uint64(left, i);
+        add_uint64(right, 50000 + i);
+    }
+
+    ck_assert_int_eq(rbh_sketch_merge(left, right), 0);
+    ck_assert_uint_eq(rbh_sketch_count(left), 100000);
+
+    ck_assert_int_eq(rbh_sketch_quantile(left, 0.5, &value), 0);
+    assert_close(value, 50000., 2500.);
+    ck_assert_int_eq(rbh_sketch_quantile(left, 1., &value), 0);
+    assert_close(value, 99999., 0.);
+
+    rbh_sketch_destroy(right);
+    rbh_sketch_destroy(left);
+}
+END_TEST
+
+START_TEST(kll_not_numeric)
+{
+    const struct rbh_value STRING = {
+        .type = RBH_VT_STRING,
+        .string = "abcdefg",
+    };
+    struct rbh_sketch *sketch;
+
+    sketch = rbh_sketch_new(NULL, &KLL_OPTIONS);
+    ck_assert_ptr_nonnull(sketch);
+
+    errno = 0;
+    ck_assert_int_eq(rbh_sketch_add_value(sketch, &STRING), -1);
+    ck_assert_int_eq(errno, ENOTSUP);
+    ck_assert_uint_eq(rbh_sketch_count(sketch), 0);
+
+    rbh_sketch_destroy(sketch);
+}
+END_TEST
+
+START_TEST(kll_fsentries)
+{
+    const struct rbh_filter_field SIZE = {
+        .fsentry = RBH_FP_STATX,
+        .statx = RBH_STATX_SIZE,
+    };
+    struct rbh_fsentry *fsentries[101];
+    struct rbh_iterator *iterator;
+    struct rbh_sketch *sketch;
+    double value;
+
+    for (size_t i = 0; i < 100; i++) {
+        const struct rbh_statx statxbuf = {
+            .stx_mask = RBH_STATX_SIZE,
+            .stx_size = i,
+        };
+
+        fsentries[i] = rbh_fsentry_new(NULL, NULL, NULL, &statxbuf, NULL, NULL,
+                                       NULL);
+        ck_assert_ptr_nonnull(fsentries[i]);
+    }
+    /* fsentries without the field are ignored */
+    fsentries[100] = rbh_fsentry_new(NULL, NULL, "a", NULL, NULL, NULL, NULL);
+    ck_assert_ptr_nonnull(fsentries[100]);
+
+    sketch = rbh_sketch_new(&SIZE, &KLL_OPTIONS);
+    ck_assert_ptr_nonnull(sketch);
+
+    iterator = rbh_iter_array(fsentries, sizeof(*fsentries), 101);
+    ck_assert_ptr_nonnull(iterator);
+
+    /* rbh_iter_array() yields pointers to the elements of the array */
+    for (size_t i = 0; i < 101; i++) {
+        struct rbh_fsentry *const *fsentry = rbh_iter_next(iterator);
+
+        ck_assert_ptr_nonnull(fsentry);
+        ck_assert_int_eq(rbh_sketch_add(sketch, *fsentry), 0);
+    }
+    rbh_iter_destroy(iterator);
+
+    /* With so few values, the sketch is exact */
+    ck_assert_uint_eq(rbh_sketch_count(sketch), 100);
+    ck_assert_int_eq(rbh_sketch_quantile(sketch, 0.5, &value), 0);
+    assert_close(value, 49., 0.);
+
+    rbh_sketch_destroy(sketch);
+    for (size_t i = 0; i < 101; i++)
+        free(fsentries[i]);
+}
+END_TEST
+
+/*----------------------------------------------------------------------------*
+ |                                 count-min                                  |
+ *----------------------------------------------------------------------------*/
+
+static const struct rbh_sketch_options CMS_OPTIONS = {
+    .type = RBH_SKT_COUNT_MIN,
+    .count_min = {
+        .epsilon = 0.001,
+        .delta = 0.01,
+        .heavy_hitters = 2,
+    },
+};
+
+static void
+fill_count_min(struct rbh_sketch *sketch)
+{
+    char string[16];
+
+    for (int i = 0; i < 1000; i++) {
+        add_string(sketch, "a");
+        if (i % 2 == 0)
+            add_string(sketch, "b");
+
+        ck_assert_int_lt(snprintf(string, sizeof(string), "c%d", i),
+                         sizeof(string));
+        add_string(sketch, string);
+    }
+}
+
+static void
+assert_heavy_hitters(const struct rbh_sketch *sketch)
+{
+    struct rbh_sketch_item items[2];
+    size_t count = 1;
+
+    errno = 0;
+    ck_assert_int_eq(rbh_sketch_heavy_hitters(sketch, items, &count), -1);
+    ck_assert_int_eq(errno, EOVERFLOW);
+    ck_assert_uint_eq(count, 2);
+
+    ck_assert_int_eq(rbh_sketch_heavy_hitters(sketch, items, &count), 0);
+    ck_assert_uint_eq(count, 2);
+
+    ck_assert_int_eq(items[0].value.type, RBH_VT_STRING);
+    ck_assert_str_eq(items[0].value.string, "a");
+    ck_assert_uint_ge(items[0].frequency, 1000);
+
+    ck_assert_int_eq(items[1].value.type, RBH_VT_STRING);
+    ck_assert_str_eq(items[1].value.string, "b");
+    ck_assert_uint_ge(items[1].frequency, 500);
+}
+
+START_TEST(cms_frequency)
+{
+    const struct rbh_value A = {
+        .type = RBH_VT_STRING,
+        .string = "a",
+    };
+    struct rbh_sketch *sketch, *copy;
+    uint64_t frequency;
+
+    sketch = rbh_sketch_new(NULL, &CMS_OPTIONS);
+    ck_assert_ptr_nonnull(sketch);
+
+    fill_count_min(sketch);
+    ck_assert_uint_eq(rbh_sketch_count(sketch), 2500);
+
+    /* Overestimated by at most 0.001 * 2500 (with a 99% probability) */
+    ck_assert_int_eq(rbh_sketch_frequency(sketch, &A, &frequency), 0);
+    ck_assert_uint_ge(frequency, 1000);
+    ck_assert_uint_le(frequency, 1003);
+
+    assert_heavy_hitters(sketch);
+
+    copy = roundtrip(sketch);
+    ck_assert_int_eq(rbh_sketch_frequency(copy, &A, &frequency), 0);
+    ck_assert_uint_ge(frequency, 1000);
+    assert_heavy_hitters(copy);
+
+    rbh_sketch_destroy(copy);
+    rbh_sketch_destroy(sketch);
+}
+END_TEST
+
+START_TEST(cms_merge)
+{
+    struct rbh_sketch *left, *right;
+
+    left = rbh_sketch_new(NULL, &CMS_OPTIONS);
+    ck_assert_ptr_nonnull(left);
+    right = rbh_sketch_new(NULL, &CMS_OPTIONS);
+    ck_assert_ptr_nonnull(right);
+
+    fill_count_min(right);
+    ck_assert_int_eq(rbh_sketch_merge(left, right), 0);
+    ck_assert_uint_eq(rbh_sketch_count(left), 2500);
+
+    assert_heavy_hitters(left);
+
+    rbh_sketch_destroy(right);
+    rbh_sketch_destroy(left);
+}
+END_TEST
+
+START_TEST(cms_integer_keys)
+{
+    const uint64_t INTEGER = UINT64_C(0x0102030405060708);
+    const unsigned char KEY[] = {
+        RBH_VT_UINT64, 0x08, 0x07, 0x06, 0x05, 0x04, 0x03, 0x02, 0x01,
+    };
+    struct rbh_sketch *sketch, *copy;
+    struct rbh_sketch_item item;
+    size_t count = 1;
+    size_t size = 0;
+    char *data;
+
+    sketch = rbh_sketch_new(NULL, &CMS_OPTIONS);
+    ck_assert_ptr_nonnull(sketch);
+
+    for (size_t i = 0; i < 10; i++)
+        add_uint64(sketch, INTEGER);
+
+    /* Heavy hitters are serialized in little endian, like everything else */
+    errno = 0;
+    ck_assert_int_eq(rbh_sketch_serialize(sketch, NULL, &size), -1);
+    ck_assert_int_eq(errno, EOVERFLOW);
+    data = malloc(size);
+    ck_assert_ptr_nonnull(data);
+    ck_assert_int_eq(rbh_sketch_serialize(sketch, data, &size), 0);
+    ck_assert_ptr_nonnull(memmem(data, size, KEY, sizeof(KEY)));
+    free(data);
+
+    copy = roundtrip(sketch);
+    ck_assert_int_eq(rbh_sketch_heavy_hitters(copy, &item, &count), 0);
+    ck_assert_uint_eq(count, 1);
+    ck_assert_int_eq(item.value.type, RBH_VT_UINT64);
+    ck_assert_uint_eq(item.value.uint64, INTEGER);
+    ck_assert_uint_eq(item.frequency, 10);
+
+    rbh_sketch_destroy(copy);
+    rbh_sketch_destroy(sketch);
+}
+END_TEST
+
+START_TEST(cms_wrong_type)
+{
+    struct rbh_sketch *hll, *cms;
+    uint64_t frequency;
+    double value;
+
+    hll = rbh_sketch_new(NULL, &HLL_OPTIONS);
+    ck_assert_ptr_nonnull(hll);
+    cms = rbh_sketch_new(NULL, &CMS_OPTIONS);
+    ck_assert_ptr_nonnull(cms);
+
+    errno = 0;
+    ck_assert_int_eq(rbh_sketch_merge(hll, cms), -1);
+    ck_assert_int_eq(errno, EINVAL);
+
+    errno = 0;
+    ck_assert_int_eq(rbh_sketch_cardinality(cms, &value), -1);
+    ck_assert_int_eq(errno, EINVAL);
+
+    errno = 0;
+    ck_assert_int_eq(rbh_sketch_quantile(cms, 0.5, &value), -1);
+    ck_assert_int_eq(errno, EINVAL);
+
+    errno = 0;
+    ck_assert_int_eq(rbh_sketch_frequency(hll, NULL, &frequency), -1);
+    ck_assert_int_eq(errno, EINVAL);
+
+    rbh_sketch_destroy(cms);
+    rbh_sketch_destroy(hll);
+}
+END_TEST
+
+static Suite *
+unit_suite(void)
+{
+    Suite *suite;
+    TCase *tests;
+
+    suite = suite_create("sketch");
+    tests = tcase_create("rbh_sketch_new()");
+    tcase_add_test(tests, rsn_invalid);
+
+    suite_add_tcase(suite, tests);
+
+    tests = tcase_create("hyperloglog");
+    tcase_add_test(tests, hll_cardinality);
+    tcase_add_test(tests, hll_small);
+    tcase_add_test(tests, hll_merge);
+
+    suite_add_tcase(suite, tests);
+
+    tests = tcase_create("kll");
+    tcase_add_test(tests, kll_quantiles);
+    tcase_add_test(tests, kll_merge);
+    tcase_add_test(tests, kll_not_numeric);
+    tcase_add_test(tests, kll_fsentries);
+
+    suite_add_tcase(suite, tests);
+
+    tests = tcase_create("count-min");
+    tcase_add_test(tests, cms_frequency);
+    tcase_add_test(tests, cms_merge);
+    tcase_add_test(tests, cms_integer_keys);
+    tcase_add_test(tests, cms_wrong_type);
+
+    suite_add_tcase(suite, tests);
+
+    return suite;
+}
+
+int
+main(void)
+{
+    int number_failed;
+    Suite *suite;
+    SRunner *runner;
+
+    suite = unit_suite();
+    runner = srunner_create(suite);
+
+    srunner_run_all(runner, CK_NORMAL);
+    number_failed = srunner_ntests_failed(runner);
+    srunner_free(runner);
+
+    return (number_failed == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
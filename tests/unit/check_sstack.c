@@ -10,7 +10,9 @@
 #endif
 
 #include <errno.h>
+#include <stdint.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include "robinhood/sstack.h"
 
@@ -52,16 +54,29 @@ START_TEST(rspu_none)
 }
 END_TEST
 
-START_TEST(rspu_more_than_possible)
+START_TEST(rspu_larger_than_chunks)
 {
+    const char STRING[] = "abcdefghijklmnopqrstuvwxyz";
     struct rbh_sstack *sstack;
+    size_t readable;
+    char *data;
 
-    sstack = rbh_sstack_new(0);
+    sstack = rbh_sstack_new(4);
     ck_assert_ptr_nonnull(sstack);
 
-    errno = 0;
-    ck_assert_ptr_null(rbh_sstack_push(sstack, NULL, 1));
-    ck_assert_int_eq(errno, EINVAL);
+    ck_assert_ptr_nonnull(rbh_sstack_push(sstack, "0123", 4));
+
+    data = rbh_sstack_push(sstack, STRING, sizeof(STRING));
+    ck_assert_ptr_nonnull(data);
+    ck_assert_mem_eq(data, STRING, sizeof(STRING));
+
+    ck_assert_ptr_eq(rbh_sstack_peek(sstack, &readable), data);
+    ck_assert_uint_eq(readable, sizeof(STRING));
+
+    ck_assert_int_eq(rbh_sstack_pop(sstack, sizeof(STRING)), 0);
+    data = rbh_sstack_peek(sstack, &readable);
+    ck_assert_uint_eq(readable, 4);
+    ck_assert_mem_eq(data, "0123", 4);
 
     rbh_sstack_destroy(sstack);
 }
@@ -201,6 +216,135 @@ START_TEST(rspo_after_full_twice)
 
     rbh_sstack_destroy(sstack);
 }
+END_TEST
+
+    /*--------------------------------------------------------------------*
+     |                         rbh_sstack_alloc()                         |
+     *--------------------------------------------------------------------*/
+
+START_TEST(rsa_bad_alignment)
+{
+    struct rbh_sstack *sstack;
+
+    sstack = rbh_sstack_new(64);
+    ck_assert_ptr_nonnull(sstack);
+
+    errno = 0;
+    ck_assert_ptr_null(rbh_sstack_alloc(sstack, 8, 0));
+    ck_assert_int_eq(errno, EINVAL);
+
+    errno = 0;
+    ck_assert_ptr_null(rbh_sstack_alloc(sstack, 8, 12));
+    ck_assert_int_eq(errno, EINVAL);
+
+    rbh_sstack_destroy(sstack);
+}
+END_TEST
+
+START_TEST(rsa_aligned)
+{
+    struct rbh_sstack *sstack;
+
+    sstack = rbh_sstack_new(64);
+    ck_assert_ptr_nonnull(sstack);
+
+    for (size_t i = 0; i < 64; i++) {
+        size_t alignment = 1 << (i % 7);
+        char *data;
+
+        ck_assert_ptr_nonnull(rbh_sstack_push(sstack, "x", 1));
+
+        data = rbh_sstack_alloc(sstack, i % 17, alignment);
+        ck_assert_ptr_nonnull(data);
+        ck_assert_uint_eq((uintptr_t)data % alignment, 0);
+        memset(data, 'y', i % 17);
+    }
+
+    rbh_sstack_destroy(sstack);
+}
+END_TEST
+
+    /*--------------------------------------------------------------------*
+     |                   rbh_sstack_{mark,rewind}()                       |
+     *--------------------------------------------------------------------*/
+
+START_TEST(rsr_same_chunk)
+{
+    struct rbh_sstack_mark mark;
+    struct rbh_sstack *sstack;
+    size_t readable;
+    char *data;
+
+    sstack = rbh_sstack_new(32);
+    ck_assert_ptr_nonnull(sstack);
+
+    ck_assert_ptr_nonnull(rbh_sstack_push(sstack, "abcd", 4));
+    mark = rbh_sstack_mark(sstack);
+    ck_assert_ptr_nonnull(rbh_sstack_push(sstack, "efgh", 4));
+    ck_assert_ptr_nonnull(rbh_sstack_push(sstack, "ijkl", 4));
+
+    rbh_sstack_rewind(sstack, mark);
+    data = rbh_sstack_peek(sstack, &readable);
+    ck_assert_uint_eq(readable, 4);
+    ck_assert_mem_eq(data, "abcd", 4);
+
+    rbh_sstack_destroy(sstack);
+}
+END_TEST
+
+START_TEST(rsr_across_chunks)
+{
+    struct rbh_sstack_mark mark;
+    struct rbh_sstack *sstack;
+    size_t readable;
+    char *data;
+
+    sstack = rbh_sstack_new(8);
+    ck_assert_ptr_nonnull(sstack);
+
+    ck_assert_ptr_nonnull(rbh_sstack_push(sstack, "abcd", 4));
+    mark = rbh_sstack_mark(sstack);
+    for (int i = 0; i < 16; i++)
+        ck_assert_ptr_nonnull(rbh_sstack_push(sstack, "efghijkl", 8));
+
+    rbh_sstack_rewind(sstack, mark);
+    data = rbh_sstack_peek(sstack, &readable);
+    ck_assert_uint_eq(readable, 4);
+    ck_assert_mem_eq(data, "abcd", 4);
+
+    /* Chunks above the mark are reused, and empty */
+    ck_assert_ptr_nonnull(rbh_sstack_push(sstack, "mnopqrst", 8));
+    data = rbh_sstack_peek(sstack, &readable);
+    ck_assert_uint_eq(readable, 8);
+    ck_assert_mem_eq(data, "mnopqrst", 8);
+
+    ck_assert_int_eq(rbh_sstack_pop(sstack, 8), 0);
+    data = rbh_sstack_peek(sstack, &readable);
+    ck_assert_uint_eq(readable, 4);
+    ck_assert_mem_eq(data, "abcd", 4);
+
+    rbh_sstack_destroy(sstack);
+}
+END_TEST
+
+START_TEST(rsr_bottom)
+{
+    static const struct rbh_sstack_mark BOTTOM;
+    struct rbh_sstack *sstack;
+    size_t readable;
+
+    sstack = rbh_sstack_new(8);
+    ck_assert_ptr_nonnull(sstack);
+
+    for (int i = 0; i < 16; i++)
+        ck_assert_ptr_nonnull(rbh_sstack_push(sstack, "abcdef", 6));
+
+    rbh_sstack_rewind(sstack, BOTTOM);
+    rbh_sstack_peek(sstack, &readable);
+    ck_assert_uint_eq(readable, 0);
+
+    rbh_sstack_destroy(sstack);
+}
 END_TEST
 
     /*--------------------------------------------------------------------*
@@ -239,7 +383,7 @@ unit_suite(void)
 
     tests = tcase_create("rbh_sstack_push()");
     tcase_add_test(tests, rspu_none);
-    tcase_add_test(tests, rspu_more_than_possible);
+    tcase_add_test(tests, rspu_larger_than_chunks);
     tcase_add_test(tests, rspu_full_twice);
     tcase_add_test(tests, rspu_reuse_stacks);
 
@@ -257,6 +401,19 @@ unit_suite(void)
 
     suite_add_tcase(suite, tests);
 
+    tests = tcase_create("rbh_sstack_alloc()");
+    tcase_add_test(tests, rsa_bad_alignment);
+    tcase_add_test(tests, rsa_aligned);
+
+    suite_add_tcase(suite, tests);
+
+    tests = tcase_create("rbh_sstack_rewind()");
+    tcase_add_test(tests, rsr_same_chunk);
+    tcase_add_test(tests, rsr_across_chunks);
+    tcase_add_test(tests, rsr_bottom);
+
+    suite_add_tcase(suite, tests);
+
     tests = tcase_create("rbh_sstack_shrink()");
     tcase_add_test(tests, rss_basic);
 
@@ -10,6 +10,7 @@
 #endif
 
 #include <errno.h>
+#include <stdint.h>
 #include <stdlib.h>
 
 #include "robinhood/stack.h"
@@ -105,6 +106,65 @@ START_TEST(rspu_full)
 }
 END_TEST
 
+/*----------------------------------------------------------------------------*
+ |                             rbh_stack_alloc()                              |
+ *----------------------------------------------------------------------------*/
+
+START_TEST(rsa_aligned)
+{
+    struct rbh_stack *stack;
+    size_t readable;
+    char *data;
+
+    stack = rbh_stack_new(64);
+    ck_assert_ptr_nonnull(stack);
+
+    ck_assert_ptr_nonnull(rbh_stack_push(stack, "abc", 3));
+
+    data = rbh_stack_alloc(stack, 8, 16);
+    ck_assert_ptr_nonnull(data);
+    ck_assert_uint_eq((uintptr_t)data % 16, 0);
+
+    /* Padding is part of the readable bytes */
+    ck_assert_ptr_eq(rbh_stack_peek(stack, &readable), data);
+    ck_assert_uint_ge(readable, 3 + 8);
+
+    rbh_stack_destroy(stack);
+}
+END_TEST
+
+START_TEST(rsa_more_than_available)
+{
+    struct rbh_stack *stack;
+
+    stack = rbh_stack_new(64);
+    ck_assert_ptr_nonnull(stack);
+
+    ck_assert_ptr_nonnull(rbh_stack_push(stack, NULL, 60));
+
+    errno = 0;
+    ck_assert_ptr_null(rbh_stack_alloc(stack, 8, 1));
+    ck_assert_int_eq(errno, ENOBUFS);
+
+    rbh_stack_destroy(stack);
+}
+END_TEST
+
+START_TEST(rsa_bad_alignment)
+{
+    struct rbh_stack *stack;
+
+    stack = rbh_stack_new(64);
+    ck_assert_ptr_nonnull(stack);
+
+    errno = 0;
+    ck_assert_ptr_null(rbh_stack_alloc(stack, 8, 3));
+    ck_assert_int_eq(errno, EINVAL);
+
+    rbh_stack_destroy(stack);
+}
+END_TEST
+
 /*----------------------------------------------------------------------------*
  |                              rbh_stack_peek()                              |
  *----------------------------------------------------------------------------*/
@@ -200,6 +260,13 @@ unit_suite(void)
 
     suite_add_tcase(suite, tests);
 
+    tests = tcase_create("rbh_stack_alloc");
+    tcase_add_test(tests, rsa_aligned);
+    tcase_add_test(tests, rsa_more_than_available);
+    tcase_add_test(tests, rsa_bad_alignment);
+
+    suite_add_tcase(suite, tests);
+
     tests = tcase_create("rbh_stack_peek");
     tcase_add_test(tests, rspe_empty);
     tcase_add_test(tests, rspe_some);